@@ -41,4 +41,23 @@ uint16 FindClosestColor16(rgb_color color);
 
 rgb_color MakeBlendColor(rgb_color col, rgb_color col2, float position);
 
+//! Name of the area in which the app_server publishes the system color map
+#define SYSTEM_COLOR_MAP_AREA "system_color_map"
+
+void BuildColorMap(color_map *map, const rgb_color *palette);
+const color_map *CloneSystemColorMap(void);
+uint8 IndexForColorDithered(const color_map *map, rgb_color color, int32 x, int32 y);
+
+/*!
+	\brief Looks up the palette index closest to a color in a color map
+	\param map A color map set up by BuildColorMap()
+	\param color Color to match
+	\return Index of the closest palette color
+*/
+inline uint8 IndexForColor(const color_map *map, rgb_color color)
+{
+	return map->index_map[((color.red & 0xf8) << 7) | ((color.green & 0xf8) << 2)
+		| (color.blue >> 3)];
+}
+
 #endif
@@ -19,6 +19,8 @@ class BFont;
 class BMessage;
 class BOutlineListView;
 class BView;
+class OutlineIndex;
+struct outline_node;
 
 /*----------------------------------------------------------------*/
 /*----- BListItem class ------------------------------------------*/
@@ -55,6 +57,7 @@ virtual status_t	Perform(perform_code d, void *arg);
 /*----- Private or reserved -----------------------------------------*/
 private:
 friend class BOutlineListView;
+friend class OutlineIndex;
 
 		bool 		HasSubitems() const;
 
@@ -68,7 +71,8 @@ virtual	void		_ReservedListItem2();
 		bool 		IsItemVisible() const;
 		void 		SetItemVisible(bool);
 
-		uint32		_reserved[2];
+		outline_node	*fOutlineNode;
+		uint32		_reserved[1];
 		float		fWidth;
 		float		fHeight;
 		uint32 		fLevel;
@@ -17,6 +17,7 @@
 #include <ListItem.h>
 
 struct track_data;
+struct item_tops;
 
 enum list_view_type {
 	B_SINGLE_SELECTION_LIST,
@@ -168,9 +169,15 @@ class BListView : public BView, public BInvoker
 			bool			DoSwapItems(int32 a, int32 b);
 			bool			DoMoveItem(int32 from, int32 to);
 			bool			DoReplaceItem(int32 index, BListItem *item);
+			void			DoRemoveItems(int32 index, int32 count);
 			void			RescanSelection(int32 from, int32 to);
 			void			DoMouseUp(BPoint where);
 			void			DoMouseMoved(BPoint where);
+			void			InvalidateItemTops(int32 index);
+			void			ItemHeightChanged(int32 index);
+			bool			ValidateItemTops() const;
+			float			ItemTop(int32 index) const;
+			int32			ItemIndexAt(float y) const;
 	
 		BList				fList;
 		list_view_type		fListType;
@@ -181,7 +188,10 @@ class BListView : public BView, public BInvoker
 		BMessage			*fSelectMessage;
 		BScrollView			*fScrollView;
 		track_data			*fTrack;
-		uint32				_reserved[3];
+		union {
+			item_tops		*fItemTops;
+			uint32			_reserved[3];
+		};
 };
 
 
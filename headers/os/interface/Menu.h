@@ -110,6 +110,8 @@ virtual void			SetMaxContentWidth(float max);
 
 virtual void			MessageReceived(BMessage *msg);
 virtual	void			KeyDown(const char *bytes, int32 numBytes);
+virtual	void			MouseMoved(BPoint where, uint32 code, const BMessage *msg);
+virtual	void			MouseUp(BPoint where);
 virtual void			Draw(BRect updateRect);
 virtual void			GetPreferredSize(float *width, float *height);
 virtual void			ResizeToPreferred();
@@ -195,6 +197,7 @@ virtual	void			_ReservedMenu6();
 								BMenuItem *item,
 								bool del = false);
 		void		LayoutItems(int32 index);
+		void		InvalidateItemLayout(int32 index);
 		void		ComputeLayout(int32 index, bool bestFit, bool moveItems,
 								  float* width, float* height);
 		BRect		Bump(BRect current, BPoint extent, int32 index) const;
@@ -15,6 +15,7 @@
 #include <ListView.h>
 
 class BListItem;
+class OutlineIndex;
 
 /*----------------------------------------------------------------*/
 /*----- BOutlineListView class -----------------------------------*/
@@ -146,7 +147,7 @@ static	void 		TrackOutLatchItem(void *);
 		BListItem	*SuperitemForIndex(int32 fullListIndex, int32 level);
 		int32		FindPreviousVisibleIndex(int32 fullListIndex);
 
-		BList		fullList;
+		OutlineIndex	*fFullList;
 		uint32		_reserved[2];
 };
 
@@ -86,7 +86,6 @@ friend class BView;
 friend class BDirectWindow;
 friend class Support;
 
-		void	_AddRect(clipping_rect r);
 		void	set_size(long new_size);
 
 private:
@@ -94,6 +93,10 @@ private:
 		long	data_size;
 		clipping_rect	bound;
 		clipping_rect	*data;
+
+		// Storage for small regions, so that the common case of a region
+		// made of a few rects doesn't need to allocate memory.
+		clipping_rect	small_data[4];
 };
 
 /*-------------------------------------------------------------*/
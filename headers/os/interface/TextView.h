@@ -59,6 +59,7 @@ class _BUndoBuffer_;
 class _BInlineInput_;
 class _BTextTrackState_;
 class _BTextChangeResult_;
+class _BTextLayoutState_;
 
 extern "C" status_t	_init_interface_kit_();
 
@@ -299,7 +300,9 @@ virtual void			_ReservedTextView12();
 								int32	toOffset, 
 								bool	erase, 
 								bool	scroll);
-		void			RecalLineBreaks(int32 *startLine, int32 *endLine);
+		void			RecalLineBreaks(int32 *startLine, int32 *endLine,
+										float stopOrigin = -1.0F);
+		void			LayoutPendingText();
 		int32			FindLineBreak(int32	fromOffset, 
 									  float	*outAscent, 
 								  	  float	*outDescent, 
@@ -411,7 +414,7 @@ static	void			UnlockWidthBuffer();
 		BPoint					fWhere;
 		_BTextTrackState_*		fTrackingMouse;	/* was _reserved[6] */
 		_BTextChangeResult_*	fTextChange;	/* was _reserved[7] */
-		uint32					_reserved[1];	/* was 8 */
+		_BTextLayoutState_*		fLayoutState;	/* was _reserved[8] */
 #if !_PR3_COMPATIBLE_
 		uint32					_more_reserved[8];
 #endif
@@ -588,6 +588,7 @@ private:
 			void		initCachedState();
 			void		setCachedState();
 			void		updateCachedState();
+			void		parentResizedBy(float dh, float dv);
 			void        setFontState(const BFont* font, uint16 mask);
 			void		fetch_font();
 			uchar		font_encoding() const;
@@ -114,7 +114,11 @@ enum {
 	B_NO_WORKSPACE_ACTIVATION	= 0x00000100,
 	B_NOT_ANCHORED_ON_ACTIVATE	= 0x00020000,
 	B_ASYNCHRONOUS_CONTROLS		= 0x00080000,
-	B_QUIT_ON_WINDOW_CLOSE		= 0x00100000
+	B_QUIT_ON_WINDOW_CLOSE		= 0x00100000,
+	
+	// Cosmoe extension: the app_server keeps an offscreen copy of the window's
+	// contents and restores obscured parts itself instead of asking for updates.
+	B_BACKING_STORE				= 0x00200000
 };
 
 #define B_CURRENT_WORKSPACE	0
@@ -128,6 +132,7 @@ class BMenuItem;
 class BMessage;
 class BMessageRunner;
 class BMessenger;
+class BRegion;
 class BView;
 
 struct message;
@@ -418,7 +423,8 @@ virtual BMessage	*ConvertToMessage(void* raw, int32 code);
 		void		activateView( BView *aView, bool active );
 		
 		void		drawAllViews(BView* aView);
-		void		DoUpdate(BView* aView, BRect& area);
+		void		DoUpdate(BRegion& region);
+		void		updateView(BView* aView, BRegion& region);
 
 		// Debug
 		void		PrintToStream() const;
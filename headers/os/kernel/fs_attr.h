@@ -37,6 +37,9 @@ extern int		fs_close_attr_dir(DIR *dir);
 extern struct dirent *fs_read_attr_dir(DIR *dir);
 extern void		fs_rewind_attr_dir(DIR *dir);
 
+// Cosmoe: removes the attributes kept outside of a node that is gone
+extern int		fs_remove_attr_sidecar(dev_t device, ino_t node);
+
 #ifdef  __cplusplus
 }
 #endif
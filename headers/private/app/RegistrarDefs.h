@@ -46,6 +46,7 @@ enum {
 	B_REG_GET_MIME_MESSENGER				= 'rgmm',
 	B_REG_GET_CLIPBOARD_MESSENGER			= 'rgcm',
 	B_REG_GET_DISK_DEVICE_MESSENGER			= 'rgdm',
+	B_REG_GET_INDEX_MESSENGER				= 'rgim',
 	// roster requests
 	B_REG_ADD_APP							= 'rgaa',
 	B_REG_COMPLETE_REGISTRATION				= 'rgcr',
@@ -107,6 +108,13 @@ enum {
 	B_REG_UPDATE_DISK_DEVICE				= 'rgud',
 	B_REG_DEVICE_START_WATCHING				= 'rgwd',
 	B_REG_DEVICE_STOP_WATCHING				= 'rgsd',
+	// index manager requests
+	B_REG_CREATE_INDEX						= 'rgIc',
+	B_REG_REMOVE_INDEX						= 'rgIr',
+	B_REG_STAT_INDEX						= 'rgIs',
+	B_REG_OPEN_QUERY						= 'rgQo',
+	B_REG_READ_QUERY						= 'rgQr',
+	B_REG_CLOSE_QUERY						= 'rgQc',
 };
 
 // B_REG_MIME_SET_PARAM "which" constants 
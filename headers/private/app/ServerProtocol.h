@@ -29,6 +29,8 @@ AS_CREATE_WINDOW,
 AS_DELETE_WINDOW,
 AS_CREATE_BITMAP,
 AS_DELETE_BITMAP,
+AS_CREATE_BITMAPS,
+AS_DELETE_BITMAPS,
 
 // Cursor definitions
 AS_SET_CURSOR_DATA,	
@@ -81,6 +83,9 @@ AS_WINDOW_MINIMIZE,
 AS_UPDATE_IF_NEEDED,
 _ALL_UPDATED_,	// this should be moved in place of _UPDATE_IF_NEEDED_ in AppDefs.h
 
+// Sent by the app_server to its own window threads
+AS_BACKING_STORE_EVICTED,
+
 
 // BPicture definitions
 AS_CREATE_PICTURE,
@@ -94,6 +99,7 @@ AS_UPDATED_CLIENT_FONTLIST,
 AS_GET_FAMILY_ID,
 AS_GET_STYLE_ID,
 AS_GET_STYLE_FOR_FACE,
+AS_GET_ESCAPEMENTS,
 
 // This will be modified. Currently a kludge for the input server until
 // BScreens are implemented by the IK Taeam
@@ -0,0 +1,120 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		FontEscapements.h
+//	Description:	Layout of the font metrics the app_server shares with clients
+//------------------------------------------------------------------------------
+#ifndef _FONT_ESCAPEMENTS_H
+#define _FONT_ESCAPEMENTS_H
+
+#include <OS.h>
+#include <SupportDefs.h>
+#include <Font.h>
+
+//! Name of the areas in which the app_server publishes escapement tables
+#define FONT_ESCAPEMENT_AREA "font_escapements"
+
+/*!
+	Size of an escapement area. When one is full the app_server creates 
+	another one, so the number of tables isn't limited. Tables are never moved 
+	or removed, so clients can hold on to them for as long as the server runs.
+*/
+#define FONT_ESCAPEMENT_AREA_SIZE (1024 * 1024)
+
+/*	The app_server lays out text one byte at a time, at the integer pixel size
+	of the font, so the metrics of a font style at one size are the advances
+	and glyph bounds of the 256 byte values and the kerning between them.
+	Everything is in 26.6 fixed point, the way FreeType hands it out, so that
+	a client adding up the same numbers as the server gets exactly the same
+	result.
+*/
+
+struct escapement_kerning_pair
+{
+	uint8	right;		// second byte of the pair
+	uint8	_reserved;
+	int16	delta;		// added to the advance of the first byte
+};
+
+struct escapement_glyph
+{
+	int32	advance;	// horizontal advance of the pen
+	int32	left;		// bounds of the glyph relative to the pen, y pointing down
+	int32	top;
+	int32	right;
+	int32	bottom;
+};
+
+struct escapement_table
+{
+	int32			size;			// pixel size the table was built for
+	font_height		height;
+	escapement_glyph	glyphs[256];
+	int32			kerning[257];	// first pair for each left byte, then the count
+	// kerning pairs follow, sorted by left and then right byte
+};
+
+struct escapement_area_header
+{
+	area_id	area;		// the area this header starts
+	int32	size;		// size of the area
+	int32	used;		// bytes in use, including this header
+};
+
+/*!
+	\brief Returns the kerning pairs stored after a table
+	\param table The table
+	\return The first kerning pair
+*/
+inline const escapement_kerning_pair *EscapementKerningPairs(const escapement_table *table)
+{
+	return (const escapement_kerning_pair*)(table + 1);
+}
+
+/*!
+	\brief Looks up the kerning between two bytes
+	\param table The table to look in
+	\param left First byte of the pair
+	\param right Second byte of the pair
+	\return The kerning in 26.6 fixed point, 0 if the pair isn't kerned
+*/
+inline int32 EscapementKerning(const escapement_table *table, uint8 left, uint8 right)
+{
+	int32 low = table->kerning[left];
+	int32 high = table->kerning[left + 1] - 1;
+	if (low > high)
+		return 0;
+
+	const escapement_kerning_pair *pairs = EscapementKerningPairs(table);
+	while (low <= high)
+	{
+		int32 middle = (low + high) / 2;
+		if (pairs[middle].right == right)
+			return pairs[middle].delta;
+		if (pairs[middle].right < right)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+	return 0;
+}
+
+#endif
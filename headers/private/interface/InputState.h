@@ -0,0 +1,65 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		InputState.h
+//	Description:	Mouse and keyboard state the app_server shares with clients
+//------------------------------------------------------------------------------
+#ifndef _INPUT_STATE_H
+#define _INPUT_STATE_H
+
+#include <SupportDefs.h>
+#include <OS.h>
+
+//! Name of the area in which the app_server publishes the input state
+#define INPUT_STATE_AREA "input_state"
+
+/*	The app_server updates the input state for every event it reads from the
+	input drivers, before moves are collapsed, so it's always at least as 
+	recent as the last mouse message a window got. Clients clone the area 
+	read-only.
+	
+	The sequence number is incremented before and after every update, so it's 
+	odd while the server is writing. A reader copies the state and retries if 
+	the sequence changed in the meantime or was odd to begin with. After an 
+	update the server releases the semaphore once for every thread waiting on 
+	it, so tracking loops can sleep until the input changes.
+*/
+
+struct input_state
+{
+	vint32		sequence;	// incremented before and after every update
+	sem_id		changed;	// released when the state changes
+	float		x;			// cursor position in screen coordinates
+	float		y;
+	int32		buttons;
+	int32		modifiers;
+	bigtime_t	when;		// time of the last event
+};
+
+namespace BPrivate {
+
+bool get_input_state(input_state *state);
+int32 input_sequence(void);
+bool wait_for_input(int32 *sequence, bigtime_t timeout);
+
+}	// namespace BPrivate
+
+#endif
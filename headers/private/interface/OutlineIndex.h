@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		OutlineIndex.h
+//	Description:	The full list of a BOutlineListView, indexed by position,
+//					visibility and outline level.
+//------------------------------------------------------------------------------
+#ifndef _OUTLINE_INDEX_H
+#define _OUTLINE_INDEX_H
+
+#include <SupportDefs.h>
+
+class BListItem;
+struct outline_node;
+
+/*	The items of an outline list are kept in the order they appear in when
+	everything is expanded, and an item's subitems are the items following it
+	with a higher outline level. They are stored in a balanced tree ordered by
+	position, in which every node knows how many items and how many visible
+	items its subtree holds and the lowest outline level in it.
+
+	This makes finding an item by position, the position of an item, the
+	position of an item in the visible list, the end of an item's subtree
+	and its superitem logarithmic, instead of a walk through the list.
+*/
+class OutlineIndex
+{
+public:
+	OutlineIndex(void);
+	~OutlineIndex(void);
+
+	int32 CountItems(void) const;
+	int32 CountVisibleItems(void) const;
+
+	bool AddItem(BListItem *item, int32 index);
+	BListItem *RemoveItem(int32 index);
+	void MakeEmpty(void);
+
+	BListItem *ItemAt(int32 index) const;
+	int32 IndexOf(const BListItem *item) const;
+	int32 VisibleIndexOf(const BListItem *item) const;
+	int32 CountVisibleBefore(int32 index) const;
+
+	void SetItemVisible(BListItem *item, bool visible);
+	void LevelChanged(BListItem *item);
+
+	int32 SubtreeEnd(int32 index) const;
+	int32 SuperitemIndex(int32 index, uint32 level) const;
+
+private:
+	static int32 Visible(const BListItem *item);
+	static void UpdateNode(outline_node *node);
+	static void SplitTree(outline_node *node, int32 count, outline_node **first,
+		outline_node **rest);
+	static outline_node *MergeTrees(outline_node *first, outline_node *second);
+	static void FreeTree(outline_node *node, bool clearItems);
+
+	outline_node *fRoot;
+	uint32 fSeed;
+};
+
+#endif
@@ -5,38 +5,49 @@
 
 #include <Region.h>
 
-class BRegion::Support 
+// The number of rects a region can hold without allocating memory
+#define REGION_SMALL_DATA_SIZE(region) \
+	((long)(sizeof((region)->small_data) / sizeof(clipping_rect)))
+
+/*	Regions are kept in y-x banded form: the rects are sorted by their top
+	coordinate and then by their left one. Rects with the same top also have
+	the same bottom and form a band; bands don't overlap, and the rects in a
+	band neither overlap nor touch. Two adjacent bands never have the same
+	horizontal spans, as they would have been coalesced into one.
+
+	All set operations walk the bands of both regions at once and merge them,
+	so they are linear in the number of rects of the two operands.
+*/
+class BRegion::Support
 {
 public:
 	static void ZeroRegion(BRegion *a_region);
 	static void ClearRegion(BRegion *a_region);
 	static void CopyRegion(BRegion *src_region, BRegion *dst_region);
+	static void TakeRegion(BRegion *src_region, BRegion *dst_region);
 	static void AndRegion(BRegion *first, BRegion *second, BRegion *dest);
 	static void OrRegion(BRegion *first, BRegion *second, BRegion *dest);
 	static void SubRegion(BRegion *first, BRegion *second, BRegion *dest);
 
 private:
-	static void CleanupRegion(BRegion *region_in);
-	static void CleanupRegionVertical(BRegion *region_in);
-	static void CleanupRegionHorizontal(BRegion *region_in);
-	
-	static void SortRects(clipping_rect *rects, long count);
-	static void SortTrans(long *lptr1, long *lptr2, long count);	
-	
-	static void CopyRegionMore(BRegion*, BRegion*, long);
-	
-	static void AndRegionComplex(BRegion*, BRegion*, BRegion*);
-	static void AndRegion1ToN(BRegion*, BRegion*, BRegion*);
-
-	static void AppendRegion(BRegion*, BRegion*, BRegion*);
-	
-	static void OrRegionComplex(BRegion*, BRegion*, BRegion*);
-	static void OrRegion1ToN(BRegion*, BRegion*, BRegion*);
-	static void OrRegionNoX(BRegion*, BRegion*, BRegion*);
-	static void ROr(long, long, BRegion*, BRegion*, BRegion*, long*, long *);
-
-	static void SubRegionComplex(BRegion*, BRegion*, BRegion*);
-	static void RSub(long , long, BRegion*, BRegion*, BRegion*, long*, long*);
+	enum region_op {
+		OP_AND,
+		OP_OR,
+		OP_SUB
+	};
+
+	static void RegionOp(BRegion*, BRegion*, BRegion*, region_op);
+
+	static void AppendRect(BRegion*, int32 left, int32 top, int32 right, int32 bottom);
+	static void AppendBand(BRegion*, const clipping_rect*, const clipping_rect*, int32, int32);
+	static long Coalesce(BRegion*, long prevStart, long curStart);
+
+	static void AndBand(BRegion*, const clipping_rect*, const clipping_rect*,
+		const clipping_rect*, const clipping_rect*, int32, int32);
+	static void OrBand(BRegion*, const clipping_rect*, const clipping_rect*,
+		const clipping_rect*, const clipping_rect*, int32, int32);
+	static void SubBand(BRegion*, const clipping_rect*, const clipping_rect*,
+		const clipping_rect*, const clipping_rect*, int32, int32);
 };
 
 #endif // __REGION_SUPPORT_H
@@ -0,0 +1,448 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2003, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		TextViewOffsetTree.h
+//	Description:	Template class used to keep the BTextView line and style
+//					run tables, indexed by position, text offset and origin.
+//------------------------------------------------------------------------------
+
+#ifndef __TEXT_VIEW_OFFSET_TREE__H__
+#define __TEXT_VIEW_OFFSET_TREE__H__
+
+// Standard Includes -----------------------------------------------------------
+#include <cstdlib>
+
+// System Includes -------------------------------------------------------------
+#include <SupportDefs.h>
+
+// Project Includes ------------------------------------------------------------
+
+// Local Includes --------------------------------------------------------------
+
+// Local Defines ---------------------------------------------------------------
+
+// Globals ---------------------------------------------------------------------
+
+/*	The entries are kept in a treap ordered by position. Every node stores its
+	text offset and its origin relative to the entry before it, and every
+	subtree knows the sum of these, so the absolute values are found on the
+	way down from the root.
+
+	Moving all the entries after an edit only touches the first one of them,
+	which makes BumpOffset() and BumpOrigin() logarithmic, as well as inserting,
+	removing and finding entries by offset or by origin. The offsets and the
+	origins must not decrease from one entry to the next.
+*/
+
+// _BTextViewOffsetTree_ class -------------------------------------------------
+template <class T>
+class _BTextViewOffsetTree_ {
+
+public:
+				_BTextViewOffsetTree_();
+virtual			~_BTextViewOffsetTree_();
+
+		void	InsertItemAt(int32 inAtIndex, const T *inItem, long inOffset,
+					float inOrigin = 0.0);
+		void	RemoveItemsAt(int32 inNumItems, int32 inAtIndex);
+		void	SetItemAt(int32 inAtIndex, const T *inItem, long inOffset,
+					float inOrigin = 0.0);
+		void	MakeEmpty();
+
+		const T	*ItemAt(int32 inIndex, long *outOffset = NULL,
+					float *outOrigin = NULL) const;
+		int32	ItemCount() const;
+
+		int32	OffsetToIndex(long inOffset) const;
+		int32	OriginToIndex(float inOrigin) const;
+
+		void	BumpItemOffsets(long inDelta, int32 inFromIndex);
+		void	BumpItemOrigins(float inDelta, int32 inFromIndex);
+
+private:
+		struct Node {
+			Node	*left;
+			Node	*right;
+			uint32	priority;
+			T		item;
+			long	offset;		// relative to the entry before
+			float	origin;		// relative to the entry before
+
+			// totals for the subtree of this node
+			int32	count;
+			long	sumOffset;
+			float	sumOrigin;
+		};
+
+static	int32	CountOf(const Node *node);
+static	void	UpdateNode(Node *node);
+static	void	SplitTree(Node *node, int32 count, Node **first, Node **rest);
+static	Node	*MergeTrees(Node *first, Node *second);
+static	void	AdjustNode(Node *node, int32 index, long offsetDelta,
+					float originDelta);
+static	void	FreeTree(Node *node);
+
+		Node	*fRoot;
+		uint32	fSeed;
+};
+//------------------------------------------------------------------------------
+template <class T>
+_BTextViewOffsetTree_<T>::_BTextViewOffsetTree_()
+	:	fRoot(NULL),
+		fSeed(0x2545f491)
+{
+}
+//------------------------------------------------------------------------------
+template <class T>
+_BTextViewOffsetTree_<T>::~_BTextViewOffsetTree_()
+{
+	FreeTree(fRoot);
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::InsertItemAt(int32 inAtIndex, const T *inItem,
+									   long inOffset, float inOrigin)
+{
+	int32 count = ItemCount();
+	inAtIndex = (inAtIndex > count) ? count : inAtIndex;
+	inAtIndex = (inAtIndex < 0) ? 0 : inAtIndex;
+
+	long prevOffset = 0;
+	float prevOrigin = 0.0;
+	if (inAtIndex > 0)
+		ItemAt(inAtIndex - 1, &prevOffset, &prevOrigin);
+
+	Node *node = (Node *)malloc(sizeof(Node));
+	if (node == NULL)
+		return;
+
+	fSeed = fSeed * 1103515245 + 12345;
+
+	node->left = node->right = NULL;
+	node->priority = fSeed;
+	node->item = *inItem;
+	node->offset = inOffset - prevOffset;
+	node->origin = inOrigin - prevOrigin;
+	UpdateNode(node);
+
+	// the entry that is now at this index keeps its absolute position
+	if (inAtIndex < count)
+		AdjustNode(fRoot, inAtIndex, -node->offset, -node->origin);
+
+	Node *first, *rest;
+	SplitTree(fRoot, inAtIndex, &first, &rest);
+	fRoot = MergeTrees(MergeTrees(first, node), rest);
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::RemoveItemsAt(int32 inNumItems, int32 inAtIndex)
+{
+	int32 count = ItemCount();
+	inAtIndex = (inAtIndex < 0) ? 0 : inAtIndex;
+	inNumItems = (inNumItems > count - inAtIndex) ? count - inAtIndex : inNumItems;
+	if (inNumItems < 1)
+		return;
+
+	Node *first, *removed, *rest;
+	SplitTree(fRoot, inAtIndex, &first, &rest);
+	SplitTree(rest, inNumItems, &removed, &rest);
+
+	// the entry after the removed ones keeps its absolute position
+	if (rest != NULL)
+		AdjustNode(rest, 0, removed->sumOffset, removed->sumOrigin);
+
+	FreeTree(removed);
+	fRoot = MergeTrees(first, rest);
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::SetItemAt(int32 inAtIndex, const T *inItem,
+									long inOffset, float inOrigin)
+{
+	long offset;
+	float origin;
+	if (ItemAt(inAtIndex, &offset, &origin) == NULL)
+		return;
+
+	// only this entry moves, the ones after it stay where they are
+	AdjustNode(fRoot, inAtIndex, inOffset - offset, inOrigin - origin);
+	if (inAtIndex + 1 < ItemCount())
+		AdjustNode(fRoot, inAtIndex + 1, offset - inOffset, origin - inOrigin);
+
+	Node *node = fRoot;
+	while (CountOf(node->left) != inAtIndex) {
+		if (inAtIndex < CountOf(node->left))
+			node = node->left;
+		else {
+			inAtIndex -= CountOf(node->left) + 1;
+			node = node->right;
+		}
+	}
+	node->item = *inItem;
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::MakeEmpty()
+{
+	FreeTree(fRoot);
+	fRoot = NULL;
+}
+//------------------------------------------------------------------------------
+template <class T>
+const T *
+_BTextViewOffsetTree_<T>::ItemAt(int32 inIndex, long *outOffset,
+								 float *outOrigin) const
+{
+	if (inIndex < 0 || inIndex >= ItemCount())
+		return NULL;
+
+	long offset = 0;
+	float origin = 0.0;
+	const Node *node = fRoot;
+
+	for (;;) {
+		int32 leftCount = CountOf(node->left);
+		if (inIndex < leftCount) {
+			node = node->left;
+			continue;
+		}
+
+		if (node->left != NULL) {
+			offset += node->left->sumOffset;
+			origin += node->left->sumOrigin;
+		}
+		offset += node->offset;
+		origin += node->origin;
+
+		if (inIndex == leftCount)
+			break;
+
+		inIndex -= leftCount + 1;
+		node = node->right;
+	}
+
+	if (outOffset)
+		*outOffset = offset;
+	if (outOrigin)
+		*outOrigin = origin;
+
+	return &node->item;
+}
+//------------------------------------------------------------------------------
+template <class T>
+inline int32
+_BTextViewOffsetTree_<T>::ItemCount() const
+{
+	return CountOf(fRoot);
+}
+//------------------------------------------------------------------------------
+/*! \brief Returns the index of the last entry which starts at or before the
+		given offset, or 0 if there is none.
+*/
+template <class T>
+int32
+_BTextViewOffsetTree_<T>::OffsetToIndex(long inOffset) const
+{
+	int32 index = 0;
+	int32 base = 0;
+	long offset = 0;
+	const Node *node = fRoot;
+
+	while (node != NULL) {
+		long nodeOffset = offset + node->offset;
+		if (node->left != NULL)
+			nodeOffset += node->left->sumOffset;
+
+		if (nodeOffset <= inOffset) {
+			base += CountOf(node->left);
+			index = base;
+			base++;
+			offset = nodeOffset;
+			node = node->right;
+		} else
+			node = node->left;
+	}
+
+	return index;
+}
+//------------------------------------------------------------------------------
+/*! \brief Returns the index of the last entry whose origin is at or above the
+		given one, or 0 if there is none.
+*/
+template <class T>
+int32
+_BTextViewOffsetTree_<T>::OriginToIndex(float inOrigin) const
+{
+	int32 index = 0;
+	int32 base = 0;
+	float origin = 0.0;
+	const Node *node = fRoot;
+
+	while (node != NULL) {
+		float nodeOrigin = origin + node->origin;
+		if (node->left != NULL)
+			nodeOrigin += node->left->sumOrigin;
+
+		if (nodeOrigin <= inOrigin) {
+			base += CountOf(node->left);
+			index = base;
+			base++;
+			origin = nodeOrigin;
+			node = node->right;
+		} else
+			node = node->left;
+	}
+
+	return index;
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::BumpItemOffsets(long inDelta, int32 inFromIndex)
+{
+	inFromIndex = (inFromIndex < 0) ? 0 : inFromIndex;
+	if (inFromIndex < ItemCount())
+		AdjustNode(fRoot, inFromIndex, inDelta, 0.0);
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::BumpItemOrigins(float inDelta, int32 inFromIndex)
+{
+	inFromIndex = (inFromIndex < 0) ? 0 : inFromIndex;
+	if (inFromIndex < ItemCount())
+		AdjustNode(fRoot, inFromIndex, 0, inDelta);
+}
+//------------------------------------------------------------------------------
+template <class T>
+inline int32
+_BTextViewOffsetTree_<T>::CountOf(const Node *node)
+{
+	return node ? node->count : 0;
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::UpdateNode(Node *node)
+{
+	node->count = 1;
+	node->sumOffset = node->offset;
+	node->sumOrigin = node->origin;
+
+	if (node->left != NULL) {
+		node->count += node->left->count;
+		node->sumOffset += node->left->sumOffset;
+		node->sumOrigin += node->left->sumOrigin;
+	}
+
+	if (node->right != NULL) {
+		node->count += node->right->count;
+		node->sumOffset += node->right->sumOffset;
+		node->sumOrigin += node->right->sumOrigin;
+	}
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::SplitTree(Node *node, int32 count, Node **first,
+									Node **rest)
+{
+	if (node == NULL) {
+		*first = *rest = NULL;
+		return;
+	}
+
+	if (CountOf(node->left) >= count) {
+		SplitTree(node->left, count, first, &node->left);
+		*rest = node;
+	} else {
+		SplitTree(node->right, count - CountOf(node->left) - 1, &node->right,
+			rest);
+		*first = node;
+	}
+
+	UpdateNode(node);
+}
+//------------------------------------------------------------------------------
+template <class T>
+typename _BTextViewOffsetTree_<T>::Node *
+_BTextViewOffsetTree_<T>::MergeTrees(Node *first, Node *second)
+{
+	if (first == NULL)
+		return second;
+	if (second == NULL)
+		return first;
+
+	if (first->priority > second->priority) {
+		first->right = MergeTrees(first->right, second);
+		UpdateNode(first);
+		return first;
+	}
+
+	second->left = MergeTrees(first, second->left);
+	UpdateNode(second);
+	return second;
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::AdjustNode(Node *node, int32 index, long offsetDelta,
+									 float originDelta)
+{
+	int32 leftCount = CountOf(node->left);
+	if (index < leftCount)
+		AdjustNode(node->left, index, offsetDelta, originDelta);
+	else if (index > leftCount)
+		AdjustNode(node->right, index - leftCount - 1, offsetDelta, originDelta);
+	else {
+		node->offset += offsetDelta;
+		node->origin += originDelta;
+	}
+
+	node->sumOffset += offsetDelta;
+	node->sumOrigin += originDelta;
+}
+//------------------------------------------------------------------------------
+template <class T>
+void
+_BTextViewOffsetTree_<T>::FreeTree(Node *node)
+{
+	if (node == NULL)
+		return;
+
+	FreeTree(node->left);
+	FreeTree(node->right);
+	free(node);
+}
+//------------------------------------------------------------------------------
+
+#endif // __TEXT_VIEW_OFFSET_TREE__H__
+
+/*
+ * $Log $
+ *
+ * $Id  $
+ *
+ */
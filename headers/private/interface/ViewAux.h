@@ -80,6 +80,8 @@ public:
 			uint16				flags;
 				// flags used for archiving
 			uint16				archivingFlags;
+				// state saved by PushState(), as on app_server
+			ViewAttr*			previous;
 };
 
 struct _array_hdr_{
@@ -154,6 +154,15 @@ rects_intersect(const clipping_rect &rectA, const clipping_rect &rectB)
 }
 
 
+// Checks if the first rect contains the whole second one.
+static inline bool
+rect_contains(const clipping_rect &rect, const clipping_rect &inner)
+{
+	return inner.left >= rect.left && inner.right <= rect.right
+			&& inner.top >= rect.top && inner.bottom <= rect.bottom;
+}
+
+
 // Returns the width of the given rect.
 static inline int32
 rect_width(const clipping_rect &rect)
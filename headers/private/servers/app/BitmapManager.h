@@ -22,7 +22,7 @@
 //	File Name:		BitmapManager.h
 //	Author:			DarkWyrm <bpmagic@columbus.rr.com>
 //	Description:	Handler for allocating and freeing area memory for BBitmaps 
-//					on the server side. Utilizes the BGET pool allocator.
+//					on the server side.
 //------------------------------------------------------------------------------
 #ifndef BITMAP_MANAGER_H_
 #define BITMAP_MANAGER_H_
@@ -34,7 +34,26 @@
 #include "TokenHandler.h"
 
 class ServerBitmap;
-class AreaPool;
+class ServerApp;
+class WinBorder;
+
+struct bitmap_entry;
+struct bitmap_owner;
+
+//! Number of size classes for bitmaps which are allocated from slabs
+#define BITMAP_SIZE_CLASSES 17
+
+//! Allocation statistics, as returned by BitmapManager::GetStats()
+typedef struct
+{
+	int32 bitmaps;			//!< Number of live bitmaps
+	int32 large_bitmaps;	//!< Number of bitmaps which have an area of their own
+	int32 slabs;			//!< Number of slab areas
+	int32 empty_slabs;		//!< Number of slab areas kept around without any bitmaps in them
+	uint32 requested;		//!< Bytes asked for by the live bitmaps
+	uint32 allocated;		//!< Bytes of chunks and areas handed out to them
+	uint32 reserved;		//!< Bytes of all areas owned by the manager
+} bitmap_manager_stats;
 
 /*!
 	\class BitmapManager BitmapManager.h
@@ -43,6 +62,11 @@ class AreaPool;
 	Whenever a ServerBitmap associated with a client-side BBitmap needs to be 
 	created or destroyed, the BitmapManager needs to handle it. It takes care of 
 	all memory management related to them.
+	
+	Small bitmaps are allocated from slabs: areas which are split into chunks of 
+	one size class. Large ones get an area of their own. Each bitmap is charged 
+	to the ServerApp which created it, and an app can't go over 
+	BITMAP_MEMORY_QUOTA.
 */
 class BitmapManager
 {
@@ -50,15 +74,52 @@ public:
 	BitmapManager(void);
 	~BitmapManager(void);
 	ServerBitmap *CreateBitmap(BRect bounds, color_space space, int32 flags,
-		int32 bytes_per_row=-1, screen_id screen=B_MAIN_SCREEN_ID);
+		int32 bytes_per_row=-1, screen_id screen=B_MAIN_SCREEN_ID,
+		ServerApp *owner=NULL);
 	void DeleteBitmap(ServerBitmap *bitmap);
+	void DeleteBitmapsOf(ServerApp *owner);
+	ServerBitmap *FindBitmap(int32 token, ServerApp *owner);
+	
+	uint32 MemoryUsedBy(ServerApp *owner);
+	void GetStats(bitmap_manager_stats *stats);
+	void PrintStats(void);
+	
+	ServerBitmap *CreateBackingStore(WinBorder *owner, BRect bounds, color_space space);
+	void DeleteBackingStore(WinBorder *owner);
+	void TouchBackingStore(WinBorder *owner);
+	bool FreeEvictedBackingStore(WinBorder *owner);
+	uint32 BackingStoreMemory(void) const { return fBackingStoreMemory; }
 protected:
-	BList *bmplist;
-	area_id bmparea;
-	int8 *buffer;
+	int32 _FindBackingStore(WinBorder *owner) const;
+	bool _FreeEvictedBackingStore(WinBorder *owner);
+	void _EvictBackingStores(uint32 needed);
+	
+	bool _AllocateChunk(bitmap_entry *entry, uint32 size);
+	void _FreeChunk(bitmap_entry *entry);
+	void _DeleteEntry(bitmap_entry *entry);
+	
+	bitmap_entry *_FindEntry(int32 token) const;
+	void _AddEntry(bitmap_entry *entry);
+	void _RemoveEntry(bitmap_entry *entry);
+	bitmap_owner *_FindOwner(ServerApp *owner, bool create);
+	
 	TokenHandler tokenizer;
 	sem_id lock;
-	AreaPool *fMemPool;
+	
+	// Hash table of all bitmaps, keyed by token
+	bitmap_entry **fTable;
+	int32 fTableSize;
+	int32 fBitmapCount;
+	
+	// One list of slabs per size class
+	BList fSlabs[BITMAP_SIZE_CLASSES];
+	BList fOwners;
+	
+	BList fBackingStores;
+	uint32 fBackingStoreMemory;
+	
+	// Evicted backing stores which their owners may still be using
+	BList fEvictedBackingStores;
 };
 
 extern BitmapManager *bitmapmanager;
@@ -127,6 +127,8 @@ public:
 	void DrawBitmap(BRegion *region, ServerBitmap *bitmap, const BRect &source, const BRect &dest, const DrawData *d);
 		// one more:
 	void CopyRegionList(BList* list, BList* pList, int32 rCount, BRegion* clipReg);
+	bool SaveRegionToBitmap(BRegion *region, ServerBitmap *bitmap, const BPoint &lefttop);
+	bool RestoreRegionFromBitmap(BRegion *region, ServerBitmap *bitmap, const BPoint &lefttop);
 
 	void FillArc(const BRect &r, const float &angle, const float &span, const RGBColor &color);
 	void FillArc(const BRect &r, const float &angle, const float &span, const DrawData *d);
@@ -270,6 +272,11 @@ friend class CursorHandler;
 		// temporarily virtual - until clipping code is added in DisplayDriver
 	virtual	void ConstrainClippingRegion(BRegion *reg);
 
+	bool _CopyRegionBitmap(BRegion *region, ServerBitmap *bitmap, const BPoint &lefttop, bool save);
+	BRect _CopyRegionOrdered(FBBitmap *fb, BRegion *region, int32 dx, int32 dy);
+	bool _RegionListOverlaps(BList* list, BList* pList, int32 rCount);
+	void _CopyRegionListStaged(FBBitmap *bmp, BList* list, BList* pList, int32 rCount);
+
 	PatternHandler fDrawPattern;
 	RGBColor fDrawColor;
 	int fLineThickness;
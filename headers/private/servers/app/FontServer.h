@@ -38,6 +38,8 @@
 class FontFamily;
 class FontStyle;
 class ServerFont;
+struct escapement_table;
+struct escapement_area_header;
 
 /*!
 	\class FontServer FontServer.h
@@ -68,6 +70,8 @@ public:
 	bool SetSystemPlain(const char *family, const char *style, float size);
 	bool SetSystemBold(const char *family, const char *style, float size);
 	bool SetSystemFixed(const char *family, const char *style, float size);
+	const escapement_table *GetEscapements(FontStyle *style, int32 size, area_id *area=NULL,
+		int32 *offset=NULL);
 	bool FontsNeedUpdated(void) { return need_update; }
 	/*!
 		\brief Called when the fonts list has been updated
@@ -76,11 +80,15 @@ public:
 protected:
 	FontFamily *_FindFamily(const char *name);
 	FT_CharMap _GetSupportedCharmap(const FT_Face &face);
+	escapement_table *_BuildEscapements(FontStyle *style, int32 size);
+	escapement_area_header *_AddEscapementArea(int32 tablesize);
 	bool init;
 	sem_id lock;
 	BList *families;
 	ServerFont *plain, *bold, *fixed;
 	bool need_update;
+	BList *escapementareas;
+	BList *escapementtables;
 };
 
 extern FTC_Manager ftmanager; 
@@ -91,4 +91,31 @@
 // and ServerWindows
 #define DEFAULT_MONITOR_PORT_SIZE 30
 
+// Uncomment this to give every window an offscreen backing store, not just the
+// ones created with the B_BACKING_STORE flag. Obscured window contents are then
+// restored by the server instead of being redrawn by the client.
+//#define BACKING_STORE_FOR_ALL_WINDOWS
+
+// Maximum number of bytes used by all window backing stores together. When the
+// limit is reached, the least recently used backing store is thrown away.
+#define BACKING_STORE_MEMORY_LIMIT (16 * 1024 * 1024)
+
+// Minimum time in microseconds between two mouse moves handled by the desktop.
+// Moves arriving faster are collapsed into one, so a 1000 Hz mouse doesn't
+// cost more than one hit test and one cursor update per frame.
+#define MOUSE_MOVE_INTERVAL 16667
+
+// Maximum number of bytes of bitmap memory a single application may allocate.
+// Creating a BBitmap which would go over it fails.
+#define BITMAP_MEMORY_QUOTA (64 * 1024 * 1024)
+
+// Size of the areas small bitmaps are allocated from. Bitmaps of up to a
+// quarter of this get a chunk of a slab, larger ones an area of their own.
+#define BITMAP_SLAB_SIZE (64 * B_PAGE_SIZE)
+
+// Uncomment this to dither solid fills in 8-bit modes. Colors which aren't in
+// the system palette are then drawn as a pattern of the palette colors around
+// them instead of the single closest one.
+//#define DITHER_8BIT
+
 #endif
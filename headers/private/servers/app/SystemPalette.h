@@ -33,4 +33,8 @@
 void GenerateSystemPalette(rgb_color *palette);
 extern const rgb_color system_palette[];
 
+void InitSystemColorMap(void);
+void UpdateSystemColorMap(const rgb_color *palette);
+const color_map *SystemColorMap(void);
+
 #endif
@@ -18,6 +18,7 @@
 #include <sys/stat.h>		// For struct stat
 #include <fcntl.h>			// For flock
 #include <fs_info.h>		// File sytem information functions, structs, defines
+#include <fs_index.h>		// index_info
 
 // Forward Declarations
 typedef struct attr_info;
@@ -198,12 +199,11 @@ int32 read_dir(int dir, DirEntry *buffer, size_t length,
 /*! Rewindes the directory to the first entry in the list. */
 status_t rewind_dir(int dir);
 
-/*! Iterates through the given directory searching for an entry whose name
-	matches that given by name. On success, places the DirEntry in result
-	and returns B_OK. On failures, returns an error code and sets result to
-	BPrivate::Storage::NullDir.
+/*! Looks up the entry of the given directory whose name matches that given
+	by name. On success, places the DirEntry in result and returns B_OK. On
+	failures, returns an error code.
 	
-	<b>Note:</b> This call modifies the internal position marker of dir. */
+	The position marker of dir is not changed. */
 status_t find_dir(int dir, const char *name, DirEntry *result,
 				   size_t length);
 
@@ -211,6 +211,9 @@ status_t find_dir(int dir, const char *name, DirEntry *result,
 	in the given entry_ref. */
 status_t find_dir(int dir, const char *name, entry_ref *result);
 
+/*! Returns the device and inode number of the given directory. */
+status_t dir_to_node(int dir, dev_t &device, ino_t &node);
+
 /*! Creates a duplicated of the given directory and places it in result if successful,
 	returning B_OK. Returns an error code and sets result to -1 if
 	unsuccessful. */
@@ -245,6 +248,21 @@ ssize_t read_link(const char *path, char *result, size_t size);
 ssize_t read_link(int fd, char *result, size_t size);
 
 
+//------------------------------------------------------------------------------
+// Index Functions
+//------------------------------------------------------------------------------
+/*! \brief Creates an index for the given attribute on the given volume. The
+	entries of the volume that already have the attribute are added to it. */
+status_t create_index(dev_t device, const char *name, uint32 type,
+					  uint32 flags);
+
+//! Removes the index of the given attribute from the given volume.
+status_t remove_index(dev_t device, const char *name);
+
+//! Returns information about the index of the given attribute.
+status_t stat_index(dev_t device, const char *name, index_info *info);
+
+
 //------------------------------------------------------------------------------
 // Query Functions
 //------------------------------------------------------------------------------
@@ -258,7 +276,9 @@ status_t open_query(dev_t device, const char *query, uint32 flags,
 status_t open_live_query(dev_t device, const char *query, uint32 flags,
 						 port_id port, int32 token, int &result);
 
-//! Returns the next entries in the given query.
+/*! Returns the next entries in the given query. Since a dirent has no room
+	for it, the inode number of an entry's directory is returned in d_off;
+	the entry's device is that of the query. */
 int32 read_query(int query, DirEntry *buffer, size_t length,
 				 int32 count = INT_MAX);
 
@@ -285,6 +305,22 @@ status_t entry_ref_to_path(const struct entry_ref *ref, char *result,
 status_t entry_ref_to_path(dev_t device, ino_t directory, const char *name,
 						   char *result, size_t size);
 
+/*! Finds a path to the node with the given device and inode number. Only
+	directories in the path cache, nodes this team has open, and entries of
+	directories it has open, can be found.
+
+	Returns B_OK if successful, B_ENTRY_NOT_FOUND if the node isn't known.
+*/
+status_t node_ref_to_path(dev_t device, ino_t node, char *result, size_t size);
+
+/*! Remembers the path of the given directory, so that the entry_refs of its
+	entries can be turned into paths without searching for it. */
+void cache_dir_path(dev_t device, ino_t node, const char *path);
+
+/*! Forgets the cached paths of the entry with the given path and of all
+	entries below it. To be called when the entry is moved or removed. */
+void uncache_path(const char *path);
+
 /*! Converts the given directory into an entry_ref. Note that the entry_ref is
 	actually a reference to the file "." in the given directory.
 
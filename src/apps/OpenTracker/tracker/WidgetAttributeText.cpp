@@ -1182,21 +1182,22 @@ GenericAttributeText::ReadValue()
 		case B_UINT64_TYPE:
 		case B_DOUBLE_TYPE:
 			{
-				attr_info info;
-				GenericValueStruct tmp;
-				if (fModel->Node()->GetAttrInfo(fColumn->AttrName(), &info) == B_OK) {
-					if (info.size && info.size <= sizeof(int64))
-						length = fModel->Node()->ReadAttr(fColumn->AttrName(),
-							fColumn->AttrType(), 0, &tmp, (size_t)info.size);
-	
+				// read one byte more than fits into the value, so that the
+				// size of the attribute is known without a GetAttrInfo()
+				struct {
+					GenericValueStruct value;
+					char overflow;
+				} tmpBuffer;
+				GenericValueStruct &tmp = tmpBuffer.value;
+				length = fModel->Node()->ReadAttr(fColumn->AttrName(),
+					fColumn->AttrType(), 0, &tmpBuffer, sizeof(int64) + 1);
+				if (length > 0 && length <= (ssize_t)sizeof(int64)) {
 						// We used tmp as a block of memory, now set the correct fValue:
 						
-						if (length == info.size)
-						
 							if (fColumn->AttrType() == B_FLOAT_TYPE
 								|| fColumn->AttrType() == B_DOUBLE_TYPE) {
 							
-								switch (info.size) {
+								switch (length) {
 									case sizeof(float):
 										fValueIsDefined = true;
 										fValue.floatt = tmp.floatt;
@@ -1213,7 +1214,7 @@ GenericAttributeText::ReadValue()
 								
 							} else { 	
 					
-								switch (info.size) {
+								switch (length) {
 									case sizeof(char):	// Takes care of bool, too.
 										fValueIsDefined = true;
 										fValue.int8t = tmp.int8t;
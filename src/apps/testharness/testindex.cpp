@@ -0,0 +1,793 @@
+// Checks the registrar's volume index against the files it indexes.
+//
+// A tree of files with an int32 "test:rank" attribute is built in /tmp and
+// indexed. Random query predicates over the name, size and rank indices are
+// then evaluated both by IndexQuery and by walking the tree, and the results
+// have to agree. After that the tree is changed while the index watches it,
+// and the index is reopened: the entries only the journal knows about have
+// to come back from it. The directory modification times are set back before
+// reopening, so the index can't just read the changed directories again.
+// Last, enough files are added for the journal to be merged into the base
+// file while the index runs, and a journal with a damaged record at its end
+// is read. No registrar or app_server is needed.
+//
+// usage: testindex [queries]
+
+#include <Looper.h>
+#include <OS.h>
+#include <TypeConstants.h>
+#include <fs_attr.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "IndexQuery.h"
+#include "VolumeIndex.h"
+
+static const char *kRankAttribute = "test:rank";
+
+static int32 sNextName = 0;
+
+
+class TestListener : public IndexListener
+{
+public:
+	virtual void EntryAdded(VolumeIndex *volume, const index_entry *entry) {}
+	virtual void EntryRemoved(VolumeIndex *volume, const index_entry *entry) {}
+	virtual void EntriesChanged(VolumeIndex *volume) {}
+};
+
+
+// #pragma mark - the files
+
+
+// an entry as found on disk
+struct disk_entry
+{
+	std::string	path;
+	std::string	name;
+	off_t		size;
+	bool		is_directory;
+	bool		has_rank;
+	int32		rank;
+};
+
+typedef std::pair<ino_t, std::string> entry_id;
+typedef std::map<entry_id, disk_entry> disk_map;
+
+
+static bool
+create_file(const std::string &path, bool hasRank)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+
+	std::string data(rand() % 4000, 'x');
+	bool ok = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+
+	if (hasRank)
+	{
+		int32 rank = rand() % 100;
+		ok = ok && fs_write_attr(fd, kRankAttribute, B_INT32_TYPE, 0, &rank,
+			sizeof(rank)) == sizeof(rank);
+	}
+
+	close(fd);
+	return ok;
+}
+
+
+static std::string
+new_name(char prefix)
+{
+	char name[16];
+	sprintf(name, "%c%05ld", prefix, sNextName++);
+	return name;
+}
+
+
+static void
+walk(const std::string &path, disk_map &entries)
+{
+	struct stat st;
+	if (lstat(path.c_str(), &st) != 0)
+		return;
+	ino_t directory = st.st_ino;
+
+	DIR *dir = opendir(path.c_str());
+	if (!dir)
+		return;
+
+	while (dirent *dirEntry = readdir(dir))
+	{
+		if (!strcmp(dirEntry->d_name, ".") || !strcmp(dirEntry->d_name, ".."))
+			continue;
+
+		disk_entry entry;
+		entry.path = path + "/" + dirEntry->d_name;
+		entry.name = dirEntry->d_name;
+		if (lstat(entry.path.c_str(), &st) != 0)
+			continue;
+		entry.size = st.st_size;
+		entry.is_directory = S_ISDIR(st.st_mode);
+		entry.has_rank = false;
+		entry.rank = 0;
+
+		int fd = open(entry.path.c_str(), O_RDONLY);
+		if (fd >= 0)
+		{
+			entry.has_rank = fs_read_attr(fd, kRankAttribute, B_INT32_TYPE, 0,
+				&entry.rank, sizeof(entry.rank)) == sizeof(entry.rank);
+			close(fd);
+		}
+
+		entries[entry_id(directory, entry.name)] = entry;
+		if (entry.is_directory)
+			walk(entry.path, entries);
+	}
+	closedir(dir);
+}
+
+
+static void
+directories(const disk_map &entries, const std::string &root,
+	std::vector<std::string> &paths)
+{
+	paths.push_back(root);
+	for (disk_map::const_iterator it = entries.begin(); it != entries.end(); ++it)
+		if (it->second.is_directory)
+			paths.push_back(it->second.path);
+}
+
+
+// the modification times of the directories, to set them back later
+static void
+save_times(const std::string &root, std::map<std::string, timespec> &times)
+{
+	disk_map entries;
+	std::vector<std::string> paths;
+	walk(root, entries);
+	directories(entries, root, paths);
+
+	times.clear();
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		struct stat st;
+		if (lstat(paths[i].c_str(), &st) == 0)
+			times[paths[i]] = st.st_mtim;
+	}
+}
+
+
+static void
+restore_times(const std::map<std::string, timespec> &times)
+{
+	for (std::map<std::string, timespec>::const_iterator it = times.begin();
+			it != times.end(); ++it)
+	{
+		timespec spec[2];
+		spec[0].tv_sec = 0;
+		spec[0].tv_nsec = UTIME_OMIT;
+		spec[1] = it->second;
+		utimensat(AT_FDCWD, it->first.c_str(), spec, AT_SYMLINK_NOFOLLOW);
+	}
+}
+
+
+static off_t
+file_size(const std::string &path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+
+// #pragma mark - the index
+
+
+static bool
+check_index(VolumeIndex *volume, const std::string &root, bool report)
+{
+	disk_map entries;
+	walk(root, entries);
+
+	AttributeIndex *names = volume->NameIndex();
+	int32 count = 0;
+
+	for (AttributeIndex::iterator it = names->Begin(); it != names->End(); ++it)
+	{
+		const index_entry *entry = *it;
+		disk_map::iterator found
+			= entries.find(entry_id(entry->directory, entry->name));
+
+		if (found == entries.end())
+		{
+			if (report)
+				printf("%s is indexed, but doesn't exist\n", entry->name.c_str());
+			return false;
+		}
+
+		std::map<std::string, index_value>::const_iterator rank
+			= entry->attributes.find(kRankAttribute);
+		bool hasRank = rank != entry->attributes.end();
+
+		if (entry->size != found->second.size
+			|| entry->is_directory != found->second.is_directory
+			|| hasRank != found->second.has_rank
+			|| (hasRank && rank->second.int_value != found->second.rank))
+		{
+			if (report)
+				printf("%s: the index is out of date\n", found->second.path.c_str());
+			return false;
+		}
+
+		count++;
+	}
+
+	if (count != (int32)entries.size())
+	{
+		if (report)
+			printf("%ld entries are indexed, %ld exist\n", count,
+				(int32)entries.size());
+		return false;
+	}
+
+	return true;
+}
+
+
+// waits until the index has seen the changes made to the files
+static bool
+wait_for_index(BLooper *owner, VolumeIndex *volume, const std::string &root)
+{
+	for (int32 i = 0; i < 100; i++)
+	{
+		owner->Lock();
+		bool done = check_index(volume, root, false);
+		owner->Unlock();
+
+		if (done)
+			return true;
+
+		snooze(100000);
+	}
+
+	owner->Lock();
+	check_index(volume, root, true);
+	owner->Unlock();
+	return false;
+}
+
+
+static VolumeIndex *
+open_index(BLooper *owner, IndexListener *listener, const std::string &root,
+	const std::string &storage)
+{
+	struct stat st;
+	if (stat(root.c_str(), &st) != 0)
+		return NULL;
+
+	VolumeIndex *volume = new VolumeIndex(st.st_dev, root.c_str(),
+		storage.c_str(), owner, listener);
+	status_t error = volume->Init();
+	if (error != B_OK)
+	{
+		printf("VolumeIndex::Init() failed: %s\n", strerror(error));
+		delete volume;
+		return NULL;
+	}
+
+	return volume;
+}
+
+
+// #pragma mark - the queries
+
+
+enum
+{
+	PREDICATE_COMPARE,
+	PREDICATE_AND,
+	PREDICATE_OR,
+	PREDICATE_NOT
+};
+
+enum
+{
+	ATTRIBUTE_NAME,
+	ATTRIBUTE_SIZE,
+	ATTRIBUTE_RANK
+};
+
+enum
+{
+	PATTERN_NONE,
+	PATTERN_PREFIX,		// "e01*"
+	PATTERN_SUFFIX		// "*7"
+};
+
+static const char *kOperators[] = { "==", "!=", "<", "<=", ">", ">=" };
+
+// a predicate and how the test evaluates it itself
+struct predicate
+{
+	predicate(int32 type) : type(type), left(NULL), right(NULL) {}
+	~predicate() { delete left; delete right; }
+
+	int32		type;
+	int32		attribute;
+	int32		op;			// index into kOperators
+	int32		pattern;
+	int64		number;
+	std::string	string;		// the name, or the literal part of the pattern
+	predicate	*left;
+	predicate	*right;
+};
+
+
+static predicate *
+random_predicate(int32 depth)
+{
+	predicate *term = new predicate(depth > 0 ? rand() % 4 : PREDICATE_COMPARE);
+
+	switch (term->type)
+	{
+		case PREDICATE_AND:
+		case PREDICATE_OR:
+			term->left = random_predicate(depth - 1);
+			term->right = random_predicate(depth - 1);
+			return term;
+		case PREDICATE_NOT:
+			term->left = random_predicate(depth - 1);
+			return term;
+	}
+
+	term->attribute = rand() % 3;
+	term->op = rand() % 6;
+	term->pattern = PATTERN_NONE;
+
+	switch (term->attribute)
+	{
+		case ATTRIBUTE_NAME:
+		{
+			char string[16];
+			switch (term->op < 2 ? rand() % 3 : PATTERN_NONE)
+			{
+				case PATTERN_NONE:
+					sprintf(string, "%c%05ld", rand() % 4 == 0 ? 'd' : 'e',
+						rand() % (sNextName + 1));
+					break;
+				case PATTERN_PREFIX:
+					term->pattern = PATTERN_PREFIX;
+					sprintf(string, "e%0*ld", (int)(rand() % 4 + 1),
+						(long)(rand() % 10));
+					break;
+				case PATTERN_SUFFIX:
+					term->pattern = PATTERN_SUFFIX;
+					sprintf(string, "%ld", (long)(rand() % 100));
+					break;
+			}
+			term->string = string;
+			break;
+		}
+		case ATTRIBUTE_SIZE:
+			term->number = rand() % 4200;
+			break;
+		case ATTRIBUTE_RANK:
+			term->number = rand() % 110 - 5;
+			break;
+	}
+
+	return term;
+}
+
+
+static std::string
+predicate_string(const predicate *term)
+{
+	switch (term->type)
+	{
+		case PREDICATE_AND:
+			return "(" + predicate_string(term->left) + " && "
+				+ predicate_string(term->right) + ")";
+		case PREDICATE_OR:
+			return "(" + predicate_string(term->left) + " || "
+				+ predicate_string(term->right) + ")";
+		case PREDICATE_NOT:
+			return "!(" + predicate_string(term->left) + ")";
+	}
+
+	std::string string;
+	char number[32];
+	switch (term->attribute)
+	{
+		case ATTRIBUTE_NAME:
+			string = "name";
+			break;
+		case ATTRIBUTE_SIZE:
+			string = "size";
+			break;
+		case ATTRIBUTE_RANK:
+			string = kRankAttribute;
+			break;
+	}
+	string += " ";
+	string += kOperators[term->op];
+
+	switch (term->attribute)
+	{
+		case ATTRIBUTE_NAME:
+			if (term->pattern == PATTERN_PREFIX)
+				return string + " \"" + term->string + "*\"";
+			if (term->pattern == PATTERN_SUFFIX)
+				return string + " \"*" + term->string + "\"";
+			return string + " \"" + term->string + "\"";
+		default:
+			sprintf(number, " %lld", term->number);
+			return string + number;
+	}
+}
+
+
+static bool
+evaluate(const predicate *term, const disk_entry &entry)
+{
+	switch (term->type)
+	{
+		case PREDICATE_AND:
+			return evaluate(term->left, entry) && evaluate(term->right, entry);
+		case PREDICATE_OR:
+			return evaluate(term->left, entry) || evaluate(term->right, entry);
+		case PREDICATE_NOT:
+			return !evaluate(term->left, entry);
+	}
+
+	int compare = 0;
+	switch (term->attribute)
+	{
+		case ATTRIBUTE_NAME:
+		{
+			if (term->pattern != PATTERN_NONE)
+			{
+				const std::string &name = entry.name;
+				const std::string &part = term->string;
+				bool matches = name.length() >= part.length()
+					&& (term->pattern == PATTERN_PREFIX
+						? name.compare(0, part.length(), part) == 0
+						: name.compare(name.length() - part.length(),
+							part.length(), part) == 0);
+				return term->op == 0 ? matches : !matches;
+			}
+			compare = entry.name.compare(term->string);
+			break;
+		}
+		case ATTRIBUTE_SIZE:
+			compare = entry.size < term->number ? -1
+				: (entry.size > term->number ? 1 : 0);
+			break;
+		case ATTRIBUTE_RANK:
+			// entries without the attribute never match
+			if (!entry.has_rank)
+				return false;
+			compare = entry.rank < term->number ? -1
+				: (entry.rank > term->number ? 1 : 0);
+			break;
+	}
+
+	switch (term->op)
+	{
+		case 0:
+			return compare == 0;
+		case 1:
+			return compare != 0;
+		case 2:
+			return compare < 0;
+		case 3:
+			return compare <= 0;
+		case 4:
+			return compare > 0;
+		default:
+			return compare >= 0;
+	}
+}
+
+
+static bool
+test_queries(VolumeIndex *volume, const std::string &root, int32 count)
+{
+	disk_map entries;
+	walk(root, entries);
+
+	const char *invalid[] = { "size <", "name == \"x", "(size > 1", "size > 1)",
+		"unindexed == 1", "test:rank > one", "size > 1 &&", NULL };
+	for (int32 i = 0; invalid[i]; i++)
+	{
+		IndexQuery query;
+		if (query.SetTo(invalid[i], volume) != B_BAD_VALUE)
+		{
+			printf("SetTo(\"%s\") didn't fail\n", invalid[i]);
+			return false;
+		}
+	}
+
+	int32 matches = 0;
+	for (int32 i = 0; i < count; i++)
+	{
+		predicate *term = random_predicate(rand() % 4);
+		std::string string = predicate_string(term);
+
+		IndexQuery query;
+		if (query.SetTo(string.c_str(), volume) != B_OK)
+		{
+			printf("SetTo(\"%s\") failed\n", string.c_str());
+			delete term;
+			return false;
+		}
+
+		std::set<const index_entry*> found;
+		query.GetEntries(found);
+
+		std::set<entry_id> expected;
+		for (disk_map::iterator it = entries.begin(); it != entries.end(); ++it)
+			if (evaluate(term, it->second))
+				expected.insert(it->first);
+
+		bool ok = found.size() == expected.size();
+		for (std::set<const index_entry*>::iterator it = found.begin();
+				ok && it != found.end(); ++it)
+			ok = expected.count(entry_id((*it)->directory, (*it)->name)) != 0
+				&& query.Matches(*it);
+
+		if (!ok)
+		{
+			printf("\"%s\" found %ld entries, expected %ld\n", string.c_str(),
+				(int32)found.size(), (int32)expected.size());
+			delete term;
+			return false;
+		}
+
+		matches += found.size();
+		delete term;
+	}
+
+	printf("%ld queries over %ld entries checked, %ld matches\n", count,
+		(int32)entries.size(), matches);
+	return true;
+}
+
+
+// #pragma mark - the test
+
+
+static bool
+build_tree(const std::string &root)
+{
+	std::vector<std::string> dirs;
+	dirs.push_back(root);
+
+	for (int32 i = 0; i < 10; i++)
+	{
+		// a few of them nested
+		std::string path = dirs[rand() % (i < 3 ? 1 : dirs.size())] + "/"
+			+ new_name('d');
+		if (mkdir(path.c_str(), 0755) != 0)
+			return false;
+		dirs.push_back(path);
+	}
+
+	for (int32 i = 0; i < 500; i++)
+	{
+		if (!create_file(dirs[rand() % dirs.size()] + "/" + new_name('e'),
+				rand() % 5 != 0))
+			return false;
+	}
+
+	return true;
+}
+
+
+// removes, adds, renames and changes files and removes a directory
+static bool
+change_tree(const std::string &root)
+{
+	disk_map entries;
+	walk(root, entries);
+
+	std::vector<std::string> files, dirs;
+	for (disk_map::iterator it = entries.begin(); it != entries.end(); ++it)
+		(it->second.is_directory ? dirs : files).push_back(it->second.path);
+
+	// the directory to remove must not have subdirectories
+	std::string removed;
+	for (size_t i = 0; i < dirs.size() && removed.empty(); i++)
+	{
+		removed = dirs[i];
+		for (size_t j = 0; j < dirs.size(); j++)
+			if (dirs[j].compare(0, dirs[i].length() + 1, dirs[i] + "/") == 0)
+				removed.erase();
+		if (!removed.empty())
+			dirs.erase(dirs.begin() + i);
+	}
+	dirs.push_back(root);
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		const std::string &path = files[i];
+		std::string parent = path.substr(0, path.rfind('/'));
+
+		switch (rand() % 8)
+		{
+			case 0:
+				unlink(path.c_str());
+				break;
+			case 1:
+				rename(path.c_str(),
+					(dirs[rand() % dirs.size()] + "/" + new_name('e')).c_str());
+				break;
+			case 2:
+			{
+				int fd = open(path.c_str(), O_WRONLY);
+				int32 rank = rand() % 100;
+				fs_write_attr(fd, kRankAttribute, B_INT32_TYPE, 0, &rank,
+					sizeof(rank));
+				close(fd);
+				break;
+			}
+			case 3:
+				if (!create_file(parent + "/" + new_name('e'), rand() % 5 != 0))
+					return false;
+				break;
+		}
+	}
+
+	DIR *dir = opendir(removed.c_str());
+	if (!dir)
+		return false;
+	while (dirent *entry = readdir(dir))
+	{
+		if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+			unlink((removed + "/" + entry->d_name).c_str());
+	}
+	closedir(dir);
+	return rmdir(removed.c_str()) == 0;
+}
+
+
+// waits for the index to follow changes, with the owner unlocked meanwhile
+static bool
+follow_changes(BLooper *owner, VolumeIndex *volume, const std::string &root)
+{
+	owner->Unlock();
+	bool ok = wait_for_index(owner, volume, root);
+	owner->Lock();
+
+	if (!ok)
+		puts("the index didn't follow the changes");
+	return ok;
+}
+
+
+// called and returns with the owner locked
+static bool
+run_test(BLooper *owner, IndexListener *listener, const std::string &root,
+	const std::string &storage, int32 queries, VolumeIndex *&volume)
+{
+	std::map<std::string, timespec> times;
+
+	// predicates over a fresh index
+	volume = open_index(owner, listener, root, storage);
+	if (!volume || volume->CreateIndex(kRankAttribute, B_INT32_TYPE) != B_OK
+		|| !check_index(volume, root, true) || !test_queries(volume, root, queries))
+		return false;
+
+	// changes the watcher sees go into the journal, which is replayed
+	save_times(root, times);
+	if (!change_tree(root) || !follow_changes(owner, volume, root))
+		return false;
+
+	delete volume;
+	volume = NULL;
+	if (file_size(storage + "/journal") <= 0)
+	{
+		puts("the changes weren't written to the journal");
+		return false;
+	}
+
+	restore_times(times);
+	volume = open_index(owner, listener, root, storage);
+	if (!volume || !check_index(volume, root, true)
+		|| !test_queries(volume, root, queries / 10))
+		return false;
+	if (file_size(storage + "/journal") != 0)
+	{
+		puts("the journal wasn't merged into the base file when opened");
+		return false;
+	}
+	puts("journal replayed");
+
+	// enough changes for the journal to be merged while the index runs
+	save_times(root, times);
+	for (int32 i = 0; i < 6000; i++)
+	{
+		if (!create_file(root + "/" + new_name('e'), true))
+			return false;
+	}
+	if (!follow_changes(owner, volume, root))
+		return false;
+
+	off_t journal = file_size(storage + "/journal");
+	off_t entries = file_size(storage + "/entries");
+	if (journal * 2 > entries)
+	{
+		printf("the journal wasn't compacted: %lld bytes, base file %lld\n",
+			(long long)journal, (long long)entries);
+		return false;
+	}
+
+	delete volume;
+	volume = NULL;
+
+	// a record cut short at the end of the journal is ignored
+	int fd = open((storage + "/journal").c_str(), O_WRONLY | O_APPEND);
+	if (fd < 0 || write(fd, "\1\0\0\0", 4) != 4)
+		return false;
+	close(fd);
+
+	restore_times(times);
+	volume = open_index(owner, listener, root, storage);
+	if (!volume || !check_index(volume, root, true))
+		return false;
+	puts("journal compacted");
+
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	int32 queries = argc > 1 ? atol(argv[1]) : 1000;
+	char base[64];
+	sprintf(base, "/tmp/testindex.%d", (int)getpid());
+	std::string root = std::string(base) + "/root";
+	std::string storage = std::string(base) + "/storage";
+
+	srand(42);
+
+	if (mkdir(base, 0755) != 0 || mkdir(root.c_str(), 0755) != 0
+		|| !build_tree(root))
+	{
+		printf("FAILED to create the files in %s\n", base);
+		return 1;
+	}
+
+	// a new looper is locked by the thread that created it
+	BLooper *owner = new BLooper("index owner");
+	TestListener listener;
+	VolumeIndex *volume = NULL;
+
+	bool ok = run_test(owner, &listener, root, storage, queries, volume);
+	delete volume;
+	owner->Unlock();
+
+	std::string command = std::string("rm -rf ") + base;
+	system(command.c_str());
+
+	if (!ok)
+	{
+		puts("FAILED");
+		return 1;
+	}
+
+	puts("PASSED");
+	return 0;
+}
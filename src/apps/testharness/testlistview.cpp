@@ -0,0 +1,200 @@
+// Checks the item positions BListView keeps against the item heights, and
+// times ItemFrame() and IndexOf() on a long list.
+//
+// The first part edits a list view at random: it adds, removes, swaps, moves
+// and replaces items and changes their heights, and after every step compares
+// ItemFrame() and IndexOf() with the positions added up from the heights. The
+// second part times both on a list of many items. No app_server is needed,
+// the list views are never attached to a window; they still ask it for their
+// colors when they are created, which only logs the failed requests.
+//
+// usage: testlistview [test iterations] [list length]
+
+#include <ListView.h>
+#include <ListItem.h>
+#include <OS.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+class TestItem : public BListItem
+{
+public:
+	TestItem(float height) { SetHeight(height); }
+
+	virtual void DrawItem(BView *owner, BRect frame, bool complete = false) {}
+	virtual void Update(BView *owner, const BFont *font) {}
+};
+
+
+static float
+random_height(void)
+{
+	// fractions, and now and then an empty item
+	if (rand() % 10 == 0)
+		return 0.0f;
+	return (rand() % 400) / 10.0f;
+}
+
+
+static bool
+check_list(BListView &list)
+{
+	int32 count = list.CountItems();
+	float top = 0.0f;
+
+	for (int32 i = 0; i < count; i++)
+	{
+		float bottom = top + (float)ceil(list.ItemAt(i)->Height());
+		BRect frame = list.ItemFrame(i);
+
+		if (frame.top != top || frame.bottom != bottom - 1)
+		{
+			printf("item %ld: frame %g - %g, expected %g - %g\n", i, frame.top,
+				frame.bottom, top, bottom - 1);
+			return false;
+		}
+
+		// the middle of the item, unless another item ends at the same spot
+		if (bottom > top)
+		{
+			float y = top + (bottom - top) / 2;
+			int32 index = list.IndexOf(BPoint(0, y));
+
+			if (index != i)
+			{
+				printf("IndexOf(%g) returned %ld, expected %ld\n", y, index, i);
+				return false;
+			}
+		}
+
+		top = bottom;
+	}
+
+	if (list.IndexOf(BPoint(0, top)) != -1)
+	{
+		printf("IndexOf(%g) below the last item returned %ld\n", top,
+			list.IndexOf(BPoint(0, top)));
+		return false;
+	}
+
+	return true;
+}
+
+
+static void
+random_edit(BListView &list)
+{
+	int32 count = list.CountItems();
+	int32 index = count > 0 ? rand() % count : 0;
+
+	switch (count > 0 ? rand() % 8 : 0)
+	{
+		case 0:
+			list.AddItem(new TestItem(random_height()));
+			break;
+		case 1:
+			list.AddItem(new TestItem(random_height()), rand() % (count + 1));
+			break;
+		case 2:
+			delete list.RemoveItem(index);
+			break;
+		case 3:
+			list.SwapItems(index, rand() % count);
+			break;
+		case 4:
+			list.MoveItem(index, rand() % count);
+			break;
+		case 5:
+		{
+			BListItem *item = list.ItemAt(index);
+			list.ReplaceItem(index, new TestItem(random_height()));
+			delete item;
+			break;
+		}
+		case 6:
+			list.ItemAt(index)->SetHeight(random_height());
+			list.InvalidateItem(index);
+			break;
+		case 7:
+		{
+			BList items;
+			for (int32 i = rand() % 5; i >= 0; i--)
+				items.AddItem(new TestItem(random_height()));
+			list.AddList(&items, rand() % (count + 1));
+			break;
+		}
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	int32 iterations = argc > 1 ? atol(argv[1]) : 2000;
+	int32 length = argc > 2 ? atol(argv[2]) : 100000;
+	BRect frame(0, 0, 99, 99);
+
+	srand(42);
+
+	BListView list(frame, "test");
+
+	for (int32 i = 0; i < iterations; i++)
+	{
+		random_edit(list);
+
+		if (!check_list(list))
+		{
+			printf("FAILED after %ld edits, %ld items\n", i + 1,
+				list.CountItems());
+			return 1;
+		}
+	}
+	printf("%ld edits checked, %ld items left\n", iterations, list.CountItems());
+
+	BListView longList(frame, "long");
+
+	for (int32 i = 0; i < length; i++)
+		longList.AddItem(new TestItem(16.0f));
+
+	bigtime_t start = system_time();
+	float sum = 0.0f;
+	for (int32 i = 0; i < length; i++)
+		sum += longList.ItemFrame(rand() % length).top;
+	bigtime_t frames = system_time() - start;
+
+	start = system_time();
+	int32 hits = 0;
+	for (int32 i = 0; i < length; i++)
+		hits += longList.IndexOf(BPoint(0, rand() % (length * 16))) >= 0;
+	bigtime_t lookups = system_time() - start;
+
+	start = system_time();
+	for (int32 i = 0; i < length; i++)
+	{
+		int32 index = rand() % length;
+		longList.ItemAt(index)->SetHeight(16.0f + i % 2);
+		longList.InvalidateItem(index);
+		sum += longList.ItemFrame(length - 1).top;
+	}
+	bigtime_t updates = system_time() - start;
+
+	if (hits != length)
+	{
+		printf("FAILED: %ld of %ld lookups found an item\n", hits, length);
+		return 1;
+	}
+
+	printf("%ld items: ItemFrame() %.3f us, IndexOf() %.3f us, "
+		"resize and ItemFrame() %.3f us\n", length,
+		(double)frames / length, (double)lookups / length,
+		(double)updates / length);
+
+	for (int32 i = longList.CountItems() - 1; i >= 0; i--)
+		delete longList.RemoveItem(i);
+	for (int32 i = list.CountItems() - 1; i >= 0; i--)
+		delete list.RemoveItem(i);
+
+	puts("PASSED");
+	return 0;
+}
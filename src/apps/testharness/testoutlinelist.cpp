@@ -0,0 +1,322 @@
+// Checks the index behind BOutlineListView, and BOutlineListView itself,
+// against a plain list of the items.
+//
+// The first part adds, removes, shows and hides items of random outline
+// levels in an OutlineIndex, and after every step compares every lookup with
+// the answer found by walking the plain list. The second part does the same
+// with a BOutlineListView, expanding and collapsing items, and compares both
+// its full and its visible list. No app_server is needed, the list view is
+// never attached to a window.
+//
+// usage: testoutlinelist [test iterations]
+
+#include <OutlineListView.h>
+#include <OutlineIndex.h>
+#include <List.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+class TestItem : public BListItem
+{
+public:
+	TestItem(uint32 level, bool expanded = true)
+		: BListItem(level, expanded), visible(true) {}
+
+	virtual void DrawItem(BView *owner, BRect frame, bool complete = false) {}
+	virtual void Update(BView *owner, const BFont *font) {}
+
+	// what the index should think, BListItem keeps its own flag private
+	bool visible;
+};
+
+
+static TestItem *
+model_at(BList &model, int32 index)
+{
+	return (TestItem *)model.ItemAt(index);
+}
+
+
+// the end of the subitems of the item at index
+static int32
+model_subtree_end(BList &model, int32 index)
+{
+	uint32 level = model_at(model, index)->OutlineLevel();
+	int32 end = index + 1;
+
+	while (end < model.CountItems() && model_at(model, end)->OutlineLevel() > level)
+		end++;
+
+	return end;
+}
+
+
+// the superitem of an item of the given level at index
+static int32
+model_superitem(BList &model, int32 index, uint32 level)
+{
+	for (int32 i = index - 1; i >= 0; i--)
+		if (model_at(model, i)->OutlineLevel() < level)
+			return i;
+
+	return -1;
+}
+
+
+static bool
+check_index(OutlineIndex &index, BList &model)
+{
+	int32 count = model.CountItems();
+	int32 visible = 0;
+
+	if (index.CountItems() != count)
+	{
+		printf("CountItems() returned %ld, expected %ld\n", index.CountItems(),
+			count);
+		return false;
+	}
+
+	for (int32 i = 0; i < count; i++)
+	{
+		TestItem *item = model_at(model, i);
+		uint32 level = item->OutlineLevel();
+
+		if (index.ItemAt(i) != item || index.IndexOf(item) != i)
+		{
+			printf("item %ld: ItemAt() or IndexOf() is wrong\n", i);
+			return false;
+		}
+
+		if (index.CountVisibleBefore(i) != visible
+			|| index.VisibleIndexOf(item) != visible)
+		{
+			printf("item %ld: %ld visible items before it, index says %ld/%ld\n",
+				i, visible, index.CountVisibleBefore(i), index.VisibleIndexOf(item));
+			return false;
+		}
+
+		if (index.SubtreeEnd(i) != model_subtree_end(model, i))
+		{
+			printf("item %ld: SubtreeEnd() returned %ld, expected %ld\n", i,
+				index.SubtreeEnd(i), model_subtree_end(model, i));
+			return false;
+		}
+
+		if (index.SuperitemIndex(i, level) != model_superitem(model, i, level))
+		{
+			printf("item %ld: SuperitemIndex() returned %ld, expected %ld\n", i,
+				index.SuperitemIndex(i, level), model_superitem(model, i, level));
+			return false;
+		}
+
+		visible += item->visible ? 1 : 0;
+	}
+
+	if (index.CountVisibleItems() != visible
+		|| index.CountVisibleBefore(count) != visible)
+	{
+		printf("CountVisibleItems() returned %ld, expected %ld\n",
+			index.CountVisibleItems(), visible);
+		return false;
+	}
+
+	return true;
+}
+
+
+static bool
+test_index(int32 iterations)
+{
+	OutlineIndex index;
+	BList model;
+
+	for (int32 i = 0; i < iterations; i++)
+	{
+		int32 count = model.CountItems();
+
+		switch (count > 0 ? rand() % 4 : 0)
+		{
+			case 0:
+			case 1:
+			{
+				TestItem *item = new TestItem(rand() % 4);
+				int32 position = rand() % (count + 1);
+
+				index.AddItem(item, position);
+				model.AddItem(item, position);
+				break;
+			}
+			case 2:
+			{
+				int32 position = rand() % count;
+				delete index.RemoveItem(position);
+				model.RemoveItem(position);
+				break;
+			}
+			case 3:
+			{
+				TestItem *item = model_at(model, rand() % count);
+				item->visible = !item->visible;
+				index.SetItemVisible(item, item->visible);
+				break;
+			}
+		}
+
+		if (!check_index(index, model))
+		{
+			printf("OutlineIndex FAILED after %ld steps, %ld items\n", i + 1,
+				model.CountItems());
+			return false;
+		}
+	}
+
+	printf("OutlineIndex: %ld steps checked, %ld items left\n", iterations,
+		model.CountItems());
+
+	for (int32 i = model.CountItems() - 1; i >= 0; i--)
+		delete index.RemoveItem(i);
+
+	return true;
+}
+
+
+static bool
+check_list(BOutlineListView &list, BList &model)
+{
+	int32 count = model.CountItems();
+	int32 visible = 0;
+	// the level from which on items are hidden by a collapsed superitem
+	uint32 hiddenFrom = ~0UL;
+
+	if (list.FullListCountItems() != count)
+	{
+		printf("FullListCountItems() returned %ld, expected %ld\n",
+			list.FullListCountItems(), count);
+		return false;
+	}
+
+	for (int32 i = 0; i < count; i++)
+	{
+		TestItem *item = model_at(model, i);
+		uint32 level = item->OutlineLevel();
+		int32 superitem = model_superitem(model, i, level);
+
+		if (list.FullListItemAt(i) != item || list.FullListIndexOf(item) != i)
+		{
+			printf("item %ld: FullListItemAt() or FullListIndexOf() is wrong\n", i);
+			return false;
+		}
+
+		if (list.Superitem(item) != (superitem < 0 ? NULL
+				: model_at(model, superitem)))
+		{
+			printf("item %ld: Superitem() is wrong\n", i);
+			return false;
+		}
+
+		if (level <= hiddenFrom)
+			hiddenFrom = ~0UL;
+
+		if (hiddenFrom == ~0UL)
+		{
+			if (list.ItemAt(visible) != item || list.IndexOf(item) != visible)
+			{
+				printf("item %ld: should be visible item %ld\n", i, visible);
+				return false;
+			}
+			visible++;
+
+			if (!item->IsExpanded())
+				hiddenFrom = level;
+		}
+		else if (list.IndexOf(item) >= 0)
+		{
+			printf("item %ld: should be hidden\n", i);
+			return false;
+		}
+	}
+
+	if (list.CountItems() != visible)
+	{
+		printf("CountItems() returned %ld, expected %ld\n", list.CountItems(),
+			visible);
+		return false;
+	}
+
+	return true;
+}
+
+
+static bool
+test_list(int32 iterations)
+{
+	BOutlineListView list(BRect(0, 0, 99, 99), "test");
+	BList model;
+
+	for (int32 i = 0; i < iterations; i++)
+	{
+		int32 count = model.CountItems();
+
+		switch (count > 0 ? rand() % 5 : 0)
+		{
+			case 0:
+			case 1:
+			{
+				TestItem *item = new TestItem(rand() % 4, rand() % 2 != 0);
+				int32 position = rand() % (count + 1);
+
+				list.AddItem(item, position);
+				model.AddItem(item, position);
+				break;
+			}
+			case 2:
+			{
+				// takes the subitems along
+				int32 position = rand() % count;
+				int32 end = model_subtree_end(model, position);
+
+				list.RemoveItem(position);
+				for (int32 j = end - 1; j >= position; j--)
+					delete (TestItem *)model.RemoveItem(j);
+				break;
+			}
+			case 3:
+				list.Expand(model_at(model, rand() % count));
+				break;
+			case 4:
+				list.Collapse(model_at(model, rand() % count));
+				break;
+		}
+
+		if (!check_list(list, model))
+		{
+			printf("BOutlineListView FAILED after %ld steps, %ld items\n", i + 1,
+				model.CountItems());
+			return false;
+		}
+	}
+
+	printf("BOutlineListView: %ld steps checked, %ld items left\n", iterations,
+		model.CountItems());
+
+	list.MakeEmpty();
+	for (int32 i = model.CountItems() - 1; i >= 0; i--)
+		delete (TestItem *)model.RemoveItem(i);
+
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	int32 iterations = argc > 1 ? atol(argv[1]) : 2000;
+
+	srand(42);
+
+	if (!test_index(iterations) || !test_list(iterations))
+		return 1;
+
+	puts("PASSED");
+	return 0;
+}
@@ -0,0 +1,409 @@
+// Checks BRegion against a simple pixel mask and times the common operations.
+//
+// The first part builds random regions and compares every operation with the
+// same operation done pixel by pixel; it also checks that the rects are kept
+// in banded form. The second part times Include(), Exclude(), IntersectWith(),
+// Contains() and Intersects() on regions like the ones the app_server works
+// with, so that the numbers can be compared between two versions of libcosmoe.
+//
+// usage: testregion [test iterations] [benchmark iterations]
+
+#include <Region.h>
+#include <OS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the random regions live in a kSize x kSize area, offset by kOrigin
+static const int32 kSize = 48;
+static const int32 kOrigin = -8;
+
+
+class PixelMask
+{
+public:
+	PixelMask(void) { MakeEmpty(); }
+
+	void MakeEmpty(void) { memset(fPixels, 0, sizeof(fPixels)); }
+
+	void Set(const BRegion &region)
+	{
+		MakeEmpty();
+		BRegion copy(region);
+		for (int32 i = 0; i < copy.CountRects(); i++)
+			Fill(copy.RectAtInt(i), true);
+	}
+
+	void Fill(clipping_rect rect, bool value)
+	{
+		for (int32 y = rect.top; y <= rect.bottom; y++)
+			for (int32 x = rect.left; x <= rect.right; x++)
+				if (Inside(x, y))
+					fPixels[y - kOrigin][x - kOrigin] = value;
+	}
+
+	bool At(int32 x, int32 y) const
+	{
+		return Inside(x, y) && fPixels[y - kOrigin][x - kOrigin];
+	}
+
+	bool operator==(const PixelMask &other) const
+	{
+		return memcmp(fPixels, other.fPixels, sizeof(fPixels)) == 0;
+	}
+
+	bool		fPixels[kSize][kSize];
+
+private:
+	static bool Inside(int32 x, int32 y)
+	{
+		return x >= kOrigin && x < kOrigin + kSize && y >= kOrigin && y < kOrigin + kSize;
+	}
+};
+
+
+static int32 sFailures = 0;
+
+
+static clipping_rect random_rect(int32 maxSize)
+{
+	clipping_rect rect;
+	rect.left = kOrigin + rand() % kSize;
+	rect.top = kOrigin + rand() % kSize;
+	rect.right = rect.left + rand() % maxSize;
+	rect.bottom = rect.top + rand() % maxSize;
+
+	// keep the whole rect inside the mask
+	if (rect.right >= kOrigin + kSize)
+		rect.right = kOrigin + kSize - 1;
+	if (rect.bottom >= kOrigin + kSize)
+		rect.bottom = kOrigin + kSize - 1;
+
+	return rect;
+}
+
+
+static void random_region(BRegion &region, PixelMask &mask)
+{
+	region.MakeEmpty();
+	mask.MakeEmpty();
+
+	int32 steps = rand() % 12;
+	for (int32 i = 0; i < steps; i++)
+	{
+		clipping_rect rect = random_rect(1 + rand() % 24);
+		if (rand() % 3 == 0)
+		{
+			region.Exclude(rect);
+			mask.Fill(rect, false);
+		}
+		else
+		{
+			region.Include(rect);
+			mask.Fill(rect, true);
+		}
+	}
+}
+
+
+static void fail(const char *what, int32 iteration, BRegion &region)
+{
+	if (sFailures++ < 10)
+	{
+		printf("FAILED: %s in iteration %ld\n", what, iteration);
+		region.PrintToStream();
+	}
+}
+
+
+// Checks that the rects are banded, and that the bounds are exact
+static bool is_banded(BRegion &region)
+{
+	int32 count = region.CountRects();
+	clipping_rect frame = region.FrameInt();
+
+	if (count == 0)
+		return true;
+
+	clipping_rect bounds = region.RectAtInt(0);
+	int32 bandStart = 0;
+
+	for (int32 i = 0; i < count; i++)
+	{
+		clipping_rect rect = region.RectAtInt(i);
+		if (rect.left > rect.right || rect.top > rect.bottom)
+			return false;
+
+		bounds.left = min_c(bounds.left, rect.left);
+		bounds.right = max_c(bounds.right, rect.right);
+		bounds.bottom = max_c(bounds.bottom, rect.bottom);
+
+		if (i == 0)
+			continue;
+
+		clipping_rect previous = region.RectAtInt(i - 1);
+		if (rect.top == previous.top)
+		{
+			// same band: same height, sorted, not touching
+			if (rect.bottom != previous.bottom || rect.left <= previous.right + 1)
+				return false;
+		}
+		else
+		{
+			// new band: below the previous one
+			if (rect.top <= previous.bottom)
+				return false;
+
+			// and not a copy of it directly below
+			int32 previousStart = bandStart;
+			int32 previousCount = i - bandStart;
+			bandStart = i;
+
+			int32 bandCount = 0;
+			while (i + bandCount < count && region.RectAtInt(i + bandCount).top == rect.top)
+				bandCount++;
+
+			if (bandCount == previousCount && previous.bottom + 1 == rect.top)
+			{
+				bool same = true;
+				for (int32 j = 0; j < bandCount && same; j++)
+				{
+					clipping_rect a = region.RectAtInt(previousStart + j);
+					clipping_rect b = region.RectAtInt(i + j);
+					same = a.left == b.left && a.right == b.right;
+				}
+				if (same)
+					return false;
+			}
+		}
+	}
+
+	return bounds.left == frame.left && bounds.right == frame.right
+		&& bounds.top == frame.top && bounds.bottom == frame.bottom;
+}
+
+
+static void check(const char *what, int32 iteration, BRegion &region, const PixelMask &expected)
+{
+	PixelMask mask;
+	mask.Set(region);
+
+	if (!(mask == expected))
+		fail(what, iteration, region);
+	else if (!is_banded(region))
+		fail("banded form", iteration, region);
+}
+
+
+static void run_tests(int32 iterations)
+{
+	for (int32 i = 0; i < iterations; i++)
+	{
+		BRegion a, b;
+		PixelMask maskA, maskB;
+
+		random_region(a, maskA);
+		random_region(b, maskB);
+
+		check("Include(rect)/Exclude(rect)", i, a, maskA);
+
+		// the three set operations
+		BRegion result(a);
+		PixelMask expected;
+
+		result.Include(&b);
+		for (int32 y = 0; y < kSize; y++)
+			for (int32 x = 0; x < kSize; x++)
+				expected.fPixels[y][x] = maskA.fPixels[y][x] || maskB.fPixels[y][x];
+		check("Include(region)", i, result, expected);
+
+		result = a;
+		result.Exclude(&b);
+		for (int32 y = 0; y < kSize; y++)
+			for (int32 x = 0; x < kSize; x++)
+				expected.fPixels[y][x] = maskA.fPixels[y][x] && !maskB.fPixels[y][x];
+		check("Exclude(region)", i, result, expected);
+
+		result = a;
+		result.IntersectWith(&b);
+		for (int32 y = 0; y < kSize; y++)
+			for (int32 x = 0; x < kSize; x++)
+				expected.fPixels[y][x] = maskA.fPixels[y][x] && maskB.fPixels[y][x];
+		check("IntersectWith(region)", i, result, expected);
+
+		// queries
+		for (int32 j = 0; j < 16; j++)
+		{
+			int32 x = kOrigin + rand() % kSize;
+			int32 y = kOrigin + rand() % kSize;
+
+			if (a.Contains(x, y) != maskA.At(x, y))
+				fail("Contains(x, y)", i, a);
+			if (a.Contains(BPoint(x, y)) != maskA.At(x, y))
+				fail("Contains(BPoint)", i, a);
+
+			clipping_rect rect = random_rect(16);
+			bool intersects = false;
+			for (int32 ry = rect.top; ry <= rect.bottom && !intersects; ry++)
+				for (int32 rx = rect.left; rx <= rect.right && !intersects; rx++)
+					intersects = maskA.At(rx, ry);
+			if (a.Intersects(rect) != intersects)
+				fail("Intersects(clipping_rect)", i, a);
+		}
+
+		// moving it around must not change the shape
+		BRegion moved(a);
+		moved.OffsetBy(5, -3);
+		moved.OffsetBy(-5, 3);
+		check("OffsetBy()", i, moved, maskA);
+	}
+
+	printf("%ld random regions tested, %ld failures\n", iterations, sFailures);
+}
+
+
+// A screen with a few dozen overlapping windows, as the app_server sees it
+static void make_desktop(BRegion &visible, BRegion &windows)
+{
+	visible.Set(BRect(0, 0, 1279, 1023));
+	windows.MakeEmpty();
+
+	for (int32 i = 0; i < 40; i++)
+	{
+		float left = rand() % 1100;
+		float top = rand() % 900;
+		BRect frame(left, top, left + 80 + rand() % 400, top + 60 + rand() % 300);
+
+		// the window and its tab
+		BRegion window(frame);
+		window.Include(BRect(frame.left, frame.top - 18, frame.left + 100, frame.top - 1));
+		window.IntersectWith(&visible);
+
+		windows.Include(&window);
+		visible.Exclude(&window);
+	}
+}
+
+
+static void report(const char *what, bigtime_t time, int32 iterations)
+{
+	printf("%-28s %8.2f us\n", what, (double)time / iterations);
+}
+
+
+// Returns the smallest step system_time() advances by
+static bigtime_t clock_resolution(void)
+{
+	bigtime_t resolution = B_INFINITE_TIMEOUT;
+
+	for (int32 i = 0; i < 10; i++)
+	{
+		bigtime_t start = system_time();
+		bigtime_t now;
+		while ((now = system_time()) == start)
+			;
+		if (now - start < resolution)
+			resolution = now - start;
+	}
+	return resolution;
+}
+
+
+static void run_benchmark(int32 iterations)
+{
+	BRegion visible, windows;
+	bigtime_t start;
+	int32 i;
+
+	// Each operation takes a few microseconds, a coarse clock can't time it
+	bigtime_t resolution = clock_resolution();
+	if (resolution > 1000)
+		printf("\nwarning: system_time() only advances in steps of %lld us, "
+			"the timings below are meaningless\n", resolution);
+
+	srand(1234);
+	make_desktop(visible, windows);
+	printf("\ndesktop: %ld visible rects, %ld window rects\n",
+		visible.CountRects(), windows.CountRects());
+
+	start = system_time();
+	for (i = 0; i < iterations; i++)
+	{
+		BRegion desktop, windowRegion;
+		make_desktop(desktop, windowRegion);
+	}
+	report("build desktop", system_time() - start, iterations);
+
+	start = system_time();
+	for (i = 0; i < iterations; i++)
+	{
+		BRegion region(visible);
+		region.Include(&windows);
+	}
+	report("Include(region)", system_time() - start, iterations);
+
+	start = system_time();
+	for (i = 0; i < iterations; i++)
+	{
+		BRegion region(windows);
+		region.Exclude(&visible);
+	}
+	report("Exclude(region)", system_time() - start, iterations);
+
+	start = system_time();
+	for (i = 0; i < iterations; i++)
+	{
+		BRegion region(windows);
+		region.IntersectWith(&visible);
+	}
+	report("IntersectWith(region)", system_time() - start, iterations);
+
+	start = system_time();
+	for (i = 0; i < iterations; i++)
+	{
+		BRegion region(visible);
+		region.Exclude(BRect(300, 200, 700, 600));
+	}
+	report("Exclude(rect)", system_time() - start, iterations);
+
+	start = system_time();
+	for (i = 0; i < iterations; i++)
+	{
+		BRegion region(BRect(0, 0, 500, 400));
+		region.Exclude(BRect(100, 100, 200, 200));
+	}
+	report("small region", system_time() - start, iterations);
+
+	int32 hits = 0;
+	start = system_time();
+	for (i = 0; i < iterations * 100; i++)
+	{
+		if (visible.Contains(BPoint(i % 1280, (i * 7) % 1024)))
+			hits++;
+		if (windows.Intersects(BRect(i % 1280, (i * 3) % 1024, i % 1280 + 8, (i * 3) % 1024 + 8)))
+			hits++;
+	}
+	report("Contains() + Intersects()", system_time() - start, iterations * 100);
+
+	// keeps the compiler from dropping the loop above
+	if (hits < 0)
+		printf("%ld\n", hits);
+}
+
+
+int main(int argc, char **argv)
+{
+	int32 tests = (argc > 1) ? atol(argv[1]) : 10000;
+	int32 iterations = (argc > 2) ? atol(argv[2]) : 1000;
+
+	if (tests <= 0)
+		tests = 10000;
+	if (iterations <= 0)
+		iterations = 1000;
+
+	srand(42);
+	run_tests(tests);
+	run_benchmark(iterations);
+
+	return sFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,359 @@
+// Replays a drawing script against the app_server and reports how fast it was.
+//
+// The script is a list of drawing commands, one per line, which are sent to the
+// server through a BView, so the server sees the same command stream as it
+// would from a real application. A "frame" line ends a frame: the view is
+// synced there, and the time from the first command to the end of the sync is
+// the frame time. Without a script file a built-in one is used, which redraws
+// a window full of controls, text and icons.
+//
+// Run it against an app_server started with --headless to get the server's
+// per-primitive timing as well.
+//
+// Commands:
+//   color r g b
+//   fillrect left top right bottom
+//   strokerect left top right bottom
+//   line x1 y1 x2 y2
+//   ellipse left top right bottom
+//   invert left top right bottom
+//   bitmap left top right bottom
+//   text x y string
+//   frame
+//
+// usage: testrender [frames] [script file]
+
+#include <Application.h>
+#include <Bitmap.h>
+#include <List.h>
+#include <Window.h>
+#include <View.h>
+#include <OS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+	OP_COLOR,
+	OP_FILL_RECT,
+	OP_STROKE_RECT,
+	OP_LINE,
+	OP_ELLIPSE,
+	OP_INVERT,
+	OP_BITMAP,
+	OP_TEXT,
+	OP_FRAME
+};
+
+struct render_op
+{
+	int32	code;
+	float	args[4];
+	char	text[64];
+};
+
+static const char *sDefaultScript =
+	"# window background and a row of buttons\n"
+	"color 216 216 216\n"
+	"fillrect 0 0 599 399\n"
+	"color 96 96 96\n"
+	"strokerect 10 10 109 39\n"
+	"strokerect 120 10 219 39\n"
+	"strokerect 230 10 329 39\n"
+	"color 0 0 0\n"
+	"text 30 30 Open\n"
+	"text 140 30 Save\n"
+	"text 250 30 Close\n"
+	"# a list with icons\n"
+	"color 255 255 255\n"
+	"fillrect 10 50 389 389\n"
+	"bitmap 14 54 45 85\n"
+	"bitmap 14 94 45 125\n"
+	"bitmap 14 134 45 165\n"
+	"bitmap 14 174 45 205\n"
+	"color 0 0 0\n"
+	"text 56 74 Documents\n"
+	"text 56 114 Pictures\n"
+	"text 56 154 Music\n"
+	"text 56 194 Projects\n"
+	"invert 10 90 389 129\n"
+	"# a chart\n"
+	"color 240 240 255\n"
+	"fillrect 400 50 589 389\n"
+	"color 200 40 40\n"
+	"line 400 380 440 300\n"
+	"line 440 300 480 320\n"
+	"line 480 320 520 200\n"
+	"line 520 200 560 240\n"
+	"line 560 240 589 100\n"
+	"color 40 40 200\n"
+	"ellipse 460 100 540 180\n"
+	"frame\n";
+
+
+static BList	gOps(64);
+static int32	gFrames = 100;
+
+
+static int32 parse_op(const char *line, render_op *op)
+{
+	char command[32];
+	int consumed = 0;
+
+	if (sscanf(line, "%31s %n", command, &consumed) < 1 || command[0] == '#')
+		return -1;
+
+	memset(op, 0, sizeof(render_op));
+	line += consumed;
+
+	if (strcmp(command, "frame") == 0)
+		op->code = OP_FRAME;
+	else if (strcmp(command, "color") == 0)
+		op->code = OP_COLOR;
+	else if (strcmp(command, "fillrect") == 0)
+		op->code = OP_FILL_RECT;
+	else if (strcmp(command, "strokerect") == 0)
+		op->code = OP_STROKE_RECT;
+	else if (strcmp(command, "line") == 0)
+		op->code = OP_LINE;
+	else if (strcmp(command, "ellipse") == 0)
+		op->code = OP_ELLIPSE;
+	else if (strcmp(command, "invert") == 0)
+		op->code = OP_INVERT;
+	else if (strcmp(command, "bitmap") == 0)
+		op->code = OP_BITMAP;
+	else if (strcmp(command, "text") == 0)
+	{
+		op->code = OP_TEXT;
+		if (sscanf(line, "%f %f %n", &op->args[0], &op->args[1], &consumed) < 2)
+			return -1;
+		strncpy(op->text, line + consumed, sizeof(op->text) - 1);
+		op->text[strcspn(op->text, "\r\n")] = '\0';
+		return op->code;
+	}
+	else
+		return -1;
+
+	sscanf(line, "%f %f %f %f", &op->args[0], &op->args[1], &op->args[2], &op->args[3]);
+	return op->code;
+}
+
+
+static void load_script(const char *script)
+{
+	const char *line = script;
+	while (line && *line)
+	{
+		render_op op;
+		if (parse_op(line, &op) >= 0)
+		{
+			render_op *copy = new render_op;
+			*copy = op;
+			gOps.AddItem(copy);
+		}
+
+		line = strchr(line, '\n');
+		if (line)
+			line++;
+	}
+
+	// a script without frame lines is one frame
+	render_op *last = (render_op*)gOps.LastItem();
+	if (last && last->code != OP_FRAME)
+	{
+		render_op *frame = new render_op;
+		memset(frame, 0, sizeof(render_op));
+		frame->code = OP_FRAME;
+		gOps.AddItem(frame);
+	}
+}
+
+
+static char *read_file(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char *buffer = (char*)malloc(size + 1);
+	size = fread(buffer, 1, size, file);
+	buffer[size] = '\0';
+	fclose(file);
+
+	return buffer;
+}
+
+
+static int compare_times(const void *a, const void *b)
+{
+	bigtime_t first = *(const bigtime_t*)a;
+	bigtime_t second = *(const bigtime_t*)b;
+	return (first > second) - (first < second);
+}
+
+
+static int32 render_thread(void *data)
+{
+	BWindow *window = new BWindow(BRect(50, 50, 649, 449), "testrender",
+		B_TITLED_WINDOW, B_NOT_RESIZABLE);
+	BView *view = new BView(window->Bounds(), "renderview", B_FOLLOW_ALL, B_WILL_DRAW);
+	window->AddChild(view);
+	window->Show();
+	window->Sync();
+
+	// a 32x32 icon with a gradient
+	BBitmap *icon = new BBitmap(BRect(0, 0, 31, 31), B_RGB32);
+	uint8 *bits = (uint8*)icon->Bits();
+	for (int32 y = 0; y < 32; y++)
+	{
+		for (int32 x = 0; x < 32; x++)
+		{
+			uint8 *pixel = bits + y * icon->BytesPerRow() + x * 4;
+			pixel[0] = x * 8;
+			pixel[1] = y * 8;
+			pixel[2] = 255 - x * 4;
+			pixel[3] = 255;
+		}
+	}
+
+	int32 framesPerLoop = 0;
+	for (int32 i = 0; i < gOps.CountItems(); i++)
+		if (((render_op*)gOps.ItemAt(i))->code == OP_FRAME)
+			framesPerLoop++;
+
+	bigtime_t *frameTimes = new bigtime_t[gFrames];
+	int32 frame = 0;
+	int64 ops = 0;
+	int32 index = 0;
+	bigtime_t start = system_time();
+
+	while (frame < gFrames)
+	{
+		bigtime_t frameStart = system_time();
+		window->Lock();
+
+		render_op *op;
+		while ((op = (render_op*)gOps.ItemAt(index++)) != NULL && op->code != OP_FRAME)
+		{
+			BRect rect(op->args[0], op->args[1], op->args[2], op->args[3]);
+			ops++;
+
+			switch (op->code)
+			{
+				case OP_COLOR:
+					view->SetHighColor((uint8)op->args[0], (uint8)op->args[1], (uint8)op->args[2]);
+					break;
+				case OP_FILL_RECT:
+					view->FillRect(rect);
+					break;
+				case OP_STROKE_RECT:
+					view->StrokeRect(rect);
+					break;
+				case OP_LINE:
+					view->StrokeLine(BPoint(op->args[0], op->args[1]), BPoint(op->args[2], op->args[3]));
+					break;
+				case OP_ELLIPSE:
+					view->FillEllipse(rect);
+					break;
+				case OP_INVERT:
+					view->InvertRect(rect);
+					break;
+				case OP_BITMAP:
+					view->DrawBitmap(icon, rect);
+					break;
+				case OP_TEXT:
+					view->DrawString(op->text, BPoint(op->args[0], op->args[1]));
+					break;
+			}
+		}
+
+		view->Sync();
+		window->Unlock();
+
+		frameTimes[frame++] = system_time() - frameStart;
+
+		// loop the script until there are enough frames
+		if (index >= gOps.CountItems())
+			index = 0;
+	}
+
+	bigtime_t total = system_time() - start;
+	if (total <= 0)
+		total = 1;
+
+	qsort(frameTimes, gFrames, sizeof(bigtime_t), compare_times);
+	bigtime_t sum = 0;
+	for (int32 i = 0; i < gFrames; i++)
+		sum += frameTimes[i];
+
+	printf("%ld frames, %lld drawing commands (%ld frames in the script)\n",
+		gFrames, ops, framesPerLoop);
+	printf("%.0f commands/s, %.1f frames/s\n", ops * 1000000.0 / total,
+		gFrames * 1000000.0 / total);
+	printf("frame time: average %lld us, best %lld us, median %lld us, 95%% %lld us, worst %lld us\n",
+		sum / gFrames, frameTimes[0], frameTimes[gFrames / 2],
+		frameTimes[gFrames * 95 / 100], frameTimes[gFrames - 1]);
+
+	delete [] frameTimes;
+	delete icon;
+
+	window->Lock();
+	window->Quit();
+
+	be_app->PostMessage(B_QUIT_REQUESTED);
+	return 0;
+}
+
+
+class RenderApp : public BApplication
+{
+public:
+	RenderApp(void)
+		: BApplication("application/x-vnd.Cosmoe-testrender")
+	{
+	}
+
+	virtual void ReadyToRun(void)
+	{
+		resume_thread(spawn_thread(render_thread, "render_thread", B_NORMAL_PRIORITY, NULL));
+	}
+};
+
+
+int main(int argc, char **argv)
+{
+	if (argc > 1)
+		gFrames = atol(argv[1]);
+	if (gFrames <= 0)
+		gFrames = 100;
+
+	if (argc > 2)
+	{
+		char *script = read_file(argv[2]);
+		if (!script)
+		{
+			printf("can't read %s\n", argv[2]);
+			return 1;
+		}
+		load_script(script);
+		free(script);
+	}
+	else
+		load_script(sDefaultScript);
+
+	if (gOps.CountItems() < 2)
+	{
+		printf("the script has no drawing commands\n");
+		return 1;
+	}
+
+	RenderApp app;
+	app.Run();
+
+	return 0;
+}
@@ -0,0 +1,179 @@
+// Drags a large window across the screen and reports how long every step takes
+// and how much the client had to redraw. A second window sits underneath, so
+// dragging over it also exercises exposing.
+//
+// usage: testwindowdrag [steps] [pixels per step] [-b]
+//        -b gives both windows a backing store
+
+#include <Application.h>
+#include <Window.h>
+#include <View.h>
+#include <OS.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+class DragView : public BView
+{
+public:
+	DragView(BRect frame, rgb_color color)
+		: BView(frame, "dragview", B_FOLLOW_ALL, B_WILL_DRAW),
+		  fColor(color),
+		  fDraws(0),
+		  fPixels(0)
+	{
+	}
+
+	virtual void Draw(BRect update)
+	{
+		fDraws++;
+		fPixels += (int64)(update.Width() + 1) * (int64)(update.Height() + 1);
+
+		SetHighColor(fColor);
+		FillRect(update);
+
+		// something which would be expensive to repaint for a real application
+		SetHighColor(0, 0, 0);
+		for (float y = 0; y < Bounds().bottom; y += 16)
+			StrokeLine(BPoint(0, y), BPoint(Bounds().right, y));
+	}
+
+	void Reset(void) { fDraws = 0; fPixels = 0; }
+	int32 Draws(void) const { return fDraws; }
+	int64 Pixels(void) const { return fPixels; }
+
+private:
+	rgb_color	fColor;
+	int32		fDraws;
+	int64		fPixels;
+};
+
+
+class DragWindow : public BWindow
+{
+public:
+	DragWindow(BRect frame, const char *title, rgb_color color, uint32 flags)
+		: BWindow(frame, title, B_TITLED_WINDOW, flags)
+	{
+		fView = new DragView(Bounds(), color);
+		AddChild(fView);
+	}
+
+	void Reset(void)
+	{
+		Lock();
+		fView->Reset();
+		Unlock();
+	}
+
+	void Report(const char *name)
+	{
+		Lock();
+		printf("%s: %ld Draw() calls, %lld pixels repainted by the client\n",
+			name, fView->Draws(), fView->Pixels());
+		Unlock();
+	}
+
+private:
+	DragView	*fView;
+};
+
+
+static int32	gSteps = 200;
+static float	gStepSize = 8;
+static uint32	gFlags = 0;
+
+
+static int32 drag_thread(void *data)
+{
+	rgb_color grey = { 200, 200, 200, 255 };
+	rgb_color blue = { 80, 120, 220, 255 };
+
+	DragWindow *below = new DragWindow(BRect(40, 40, 640, 480), "Below", grey, gFlags);
+	DragWindow *dragged = new DragWindow(BRect(100, 100, 900, 700), "Dragged", blue, gFlags);
+
+	below->Show();
+	dragged->Show();
+	below->Sync();
+	dragged->Sync();
+
+	// let the initial updates go through
+	snooze(500000);
+	below->Reset();
+	dragged->Reset();
+
+	bigtime_t worst = 0;
+	bigtime_t start = system_time();
+	float direction = 1;
+
+	for (int32 i = 0; i < gSteps; i++)
+	{
+		// turn around every 50 steps so the window stays on screen
+		if (i > 0 && (i % 50) == 0)
+			direction = -direction;
+
+		bigtime_t stepStart = system_time();
+		dragged->MoveBy(direction * gStepSize, direction * gStepSize / 2);
+		dragged->Sync();
+
+		bigtime_t step = system_time() - stepStart;
+		if (step > worst)
+			worst = step;
+	}
+
+	bigtime_t total = system_time() - start;
+	if (total <= 0)
+		total = 1;
+
+	// updates are handled asynchronously by the window threads
+	snooze(500000);
+
+	printf("%ld steps of %.0f pixels%s\n", gSteps, gStepSize,
+		(gFlags & B_BACKING_STORE) ? " with backing store" : "");
+	printf("total %lld us, %lld us per step, worst %lld us, %.1f steps/s\n",
+		total, total / gSteps, worst, gSteps * 1000000.0 / total);
+	dragged->Report("Dragged window");
+	below->Report("Window below");
+
+	be_app->PostMessage(B_QUIT_REQUESTED);
+	return 0;
+}
+
+
+class DragApp : public BApplication
+{
+public:
+	DragApp(void)
+		: BApplication("application/x-vnd.Cosmoe-testwindowdrag")
+	{
+	}
+
+	virtual void ReadyToRun(void)
+	{
+		resume_thread(spawn_thread(drag_thread, "drag_thread", B_NORMAL_PRIORITY, NULL));
+	}
+};
+
+
+int main(int argc, char **argv)
+{
+	int positional = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-b") == 0)
+			gFlags |= B_BACKING_STORE;
+		else if (positional++ == 0)
+			gSteps = atol(argv[i]);
+		else
+			gStepSize = atof(argv[i]);
+	}
+
+	if (gSteps <= 0)
+		gSteps = 200;
+
+	DragApp app;
+	app.Run();
+
+	return 0;
+}
@@ -309,6 +309,8 @@ static const char *kASCodeNames[] =
 "AS_DELETE_WINDOW",
 "AS_CREATE_BITMAP",
 "AS_DELETE_BITMAP",
+"AS_CREATE_BITMAPS",
+"AS_DELETE_BITMAPS",
 "AS_SET_CURSOR_DATA",	
 "AS_SET_CURSOR_BCURSOR",
 "AS_SET_CURSOR_BBITMAP",
@@ -361,6 +363,7 @@ static const char *kASCodeNames[] =
 "AS_GET_FAMILY_ID",
 "AS_GET_STYLE_ID",
 "AS_GET_STYLE_FOR_FACE",
+"AS_GET_ESCAPEMENTS",
 "AS_GET_SCREEN_MODE",
 "AS_SET_UI_COLORS",
 "AS_GET_UI_COLORS",
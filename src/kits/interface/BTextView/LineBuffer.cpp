@@ -39,8 +39,16 @@
 
 //------------------------------------------------------------------------------
 _BLineBuffer_::_BLineBuffer_()
-	:	_BTextViewSupportBuffer_<STELine>(20, 2)
+	:	_BTextViewOffsetTree_<STELine>()
 {
+	// an empty text still has one line, and the entry after the last line
+	STELine line;
+	line.offset = 0;
+	line.origin = 0.0;
+	line.ascent = 0.0;
+
+	InsertLine(&line, 0);
+	InsertLine(&line, 1);
 }
 //------------------------------------------------------------------------------
 _BLineBuffer_::~_BLineBuffer_()
@@ -50,7 +58,13 @@ _BLineBuffer_::~_BLineBuffer_()
 void
 _BLineBuffer_::InsertLine(STELine *inLine, int32 index)
 {
-	InsertItemsAt(1, index, inLine);
+	InsertItemAt(index, inLine, inLine->offset, inLine->origin);
+}
+//------------------------------------------------------------------------------
+void
+_BLineBuffer_::SetLine(const STELine *inLine, int32 index)
+{
+	SetItemAt(index, inLine, inLine->offset, inLine->origin);
 }
 //------------------------------------------------------------------------------
 void
@@ -75,58 +89,47 @@ _BLineBuffer_::RemoveLineRange(int32 fromOffset, int32 toOffset)
 int32
 _BLineBuffer_::OffsetToLine(int32 offset) const
 {
-	int32 minIndex = 0;
-	int32 maxIndex = fItemCount - 1;
-	int32 index = 0;
-	
-	while (minIndex < maxIndex) {
-		index = (minIndex + maxIndex) >> 1;
-		if (offset >= fBuffer[index].offset) {
-			if (offset < fBuffer[index + 1].offset)
-				break;
-			else
-				minIndex = index + 1;
-		}
-		else
-			maxIndex = index;
-	}
+	// the entry after the last line is never returned
+	int32 index = OffsetToIndex(offset);
+	int32 lastLine = NumLines() - 1;
 	
-	return index;
+	return (index > lastLine && lastLine >= 0) ? lastLine : index;
 }
 //------------------------------------------------------------------------------
 int32 _BLineBuffer_::PixelToLine(float pixel) const
 {
-	int32 minIndex = 0;
-	int32 maxIndex = fItemCount - 1;
-	int32 index = 0;
+	int32 index = OriginToIndex(pixel);
+	int32 lastLine = NumLines() - 1;
 	
-	while (minIndex < maxIndex) {
-		index = (minIndex + maxIndex) >> 1;
-		if (pixel >= fBuffer[index].origin) {
-			if (pixel < fBuffer[index + 1].origin)
-				break;
-			else
-				minIndex = index + 1;
-		}
-		else
-			maxIndex = index;
-	}
-	
-	return index;
+	return (index > lastLine && lastLine >= 0) ? lastLine : index;
 }
 //------------------------------------------------------------------------------
 void
 _BLineBuffer_::BumpOrigin(float delta, long index)
 {	
-	for (long i = index; i < fItemCount; i++)
-		fBuffer[i].origin += delta;
+	BumpItemOrigins(delta, index);
 }
 //------------------------------------------------------------------------------
 void
 _BLineBuffer_::BumpOffset(int32 delta, int32 index)
 {
-	for (long i = index; i < fItemCount; i++)
-		fBuffer[i].offset += delta;
+	BumpItemOffsets(delta, index);
+}
+//------------------------------------------------------------------------------
+STELine
+_BLineBuffer_::operator[](int32 index) const
+{
+	STELine line;
+	const STELine *item = ItemAt(index, &line.offset, &line.origin);
+	if (item != NULL)
+		line.ascent = item->ascent;
+	else {
+		line.offset = 0;
+		line.origin = 0.0;
+		line.ascent = 0.0;
+	}
+	
+	return line;
 }
 //------------------------------------------------------------------------------
 
@@ -25,7 +25,7 @@
 //------------------------------------------------------------------------------
 
 #include <SupportDefs.h>
-#include "TextViewSupportBuffer.h"
+#include "TextViewOffsetTree.h"
 
 typedef struct STELine {
 	long			offset;		// offset of first character of line
@@ -35,13 +35,14 @@ typedef struct STELine {
 
 
 // _BLineBuffer_ class ---------------------------------------------------------
-class _BLineBuffer_ : public _BTextViewSupportBuffer_<STELine> {
+class _BLineBuffer_ : public _BTextViewOffsetTree_<STELine> {
 
 public:
 						_BLineBuffer_();
 virtual					~_BLineBuffer_();
 
 		void			InsertLine(STELine *inLine, int32 index);
+		void			SetLine(const STELine *inLine, int32 index);
 		void			RemoveLines(int32 index, int32 count = 1);
 		void			RemoveLineRange(int32 fromOffset, int32 toOffset);
 
@@ -52,21 +53,14 @@ virtual					~_BLineBuffer_();
 		void			BumpOffset(int32 delta, int32 index);
 
 		long			NumLines() const;
-		const STELinePtr operator[](int32 index) const;
+		STELine			operator[](int32 index) const;
 };
 
 
-inline int32
+inline long
 _BLineBuffer_::NumLines() const
 {
-	return fItemCount - 1;
-}
-
-
-inline const STELinePtr
-_BLineBuffer_::operator[](int32 index) const
-{
-	return &fBuffer[index];
+	return ItemCount() - 1;
 }
 
 
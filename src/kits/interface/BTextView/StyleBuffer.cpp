@@ -33,7 +33,7 @@
 // _BStyleRunDescBuffer_
 
 _BStyleRunDescBuffer_::_BStyleRunDescBuffer_()
-	:	_BTextViewSupportBuffer_<STEStyleRunDesc>(20)
+	:	_BTextViewOffsetTree_<STEStyleRunDesc>()
 {
 }
 
@@ -41,7 +41,14 @@ _BStyleRunDescBuffer_::_BStyleRunDescBuffer_()
 void
 _BStyleRunDescBuffer_::InsertDesc(STEStyleRunDescPtr inDesc, int32 index)
 {
-	InsertItemsAt(1, index, inDesc);
+	InsertItemAt(index, inDesc, inDesc->offset);
+}
+
+
+void
+_BStyleRunDescBuffer_::SetDesc(const STEStyleRunDesc *inDesc, int32 index)
+{
+	SetItemAt(index, inDesc, inDesc->offset);
 }
 
 
@@ -55,37 +62,33 @@ _BStyleRunDescBuffer_::RemoveDescs(int32 index, int32 count)
 int32
 _BStyleRunDescBuffer_::OffsetToRun(int32 offset) const
 {
-	if (fItemCount <= 1)
+	if (ItemCount() <= 1)
 		return 0;
-		
-	int32 minIndex = 0;
-	int32 maxIndex = fItemCount;
-	int32 index = 0;
-	
-	while (minIndex < maxIndex) {
-		index = (minIndex + maxIndex) >> 1;
-		if (offset >= fBuffer[index].offset) {
-			if (index >= (fItemCount - 1)) {
-				break;
-			} else {
-				if (offset < fBuffer[index + 1].offset)
-					break;
-				else
-					minIndex = index + 1;
-			}
-		} else
-			maxIndex = index;
-	}
-	
-	return index;
+
+	return OffsetToIndex(offset);
 }
 
 
 void
 _BStyleRunDescBuffer_::BumpOffset(int32 delta, int32 index)
 {
-	for (int32 i = index; i < fItemCount; i++)
-		fBuffer[i].offset += delta;
+	BumpItemOffsets(delta, index);
+}
+
+
+STEStyleRunDesc
+_BStyleRunDescBuffer_::operator[](int32 index) const
+{
+	STEStyleRunDesc desc;
+	const STEStyleRunDesc *item = ItemAt(index, &desc.offset);
+	if (item != NULL)
+		desc.index = item->index;
+	else {
+		desc.offset = 0;
+		desc.index = 0;
+	}
+
+	return desc;
 }
 
 
@@ -202,7 +205,7 @@ _BStyleBuffer_::SyncNullStyle(int32 offset)
 		return;
 	
 	int32 index = OffsetToRun(offset);
-	fNullStyle = fStyleRecord[fStyleRunDesc[index]->index]->style;
+	fNullStyle = fStyleRecord[fStyleRunDesc[index].index]->style;
 
 	fValidNullStyle = true;
 }	
@@ -216,7 +219,7 @@ _BStyleBuffer_::SetNullStyle(uint32 inMode, const BFont *inFont,
 		SetStyle(inMode, inFont, &fNullStyle.font, inColor, &fNullStyle.color);
 	else {
 		int32 index = OffsetToRun(offset - 1);
-		fNullStyle = fStyleRecord[fStyleRunDesc[index]->index]->style;
+		fNullStyle = fStyleRecord[fStyleRunDesc[index].index]->style;
 		SetStyle(inMode, inFont, &fNullStyle.font, inColor, &fNullStyle.color);	
 	}
 	
@@ -264,10 +267,10 @@ _BStyleBuffer_::SetStyleRange(int32 fromOffset, int32 toOffset,
 	int32 offset = fromOffset;
 	int32 runIndex = OffsetToRun(offset);
 	do {
-		STEStyleRunDesc	runDesc = *fStyleRunDesc[runIndex];
+		STEStyleRunDesc	runDesc = fStyleRunDesc[runIndex];
 		int32			runEnd = textLen;
 		if (runIndex < (fStyleRunDesc.ItemCount() - 1))
-			runEnd = fStyleRunDesc[runIndex + 1]->offset;
+			runEnd = fStyleRunDesc[runIndex + 1].offset;
 		
 		STEStyle style = fStyleRecord[runDesc.index]->style;
 		SetStyle(inMode, inFont, &style.font, inColor, &style.color);
@@ -275,7 +278,7 @@ _BStyleBuffer_::SetStyleRange(int32 fromOffset, int32 toOffset,
 		styleIndex = fStyleRecord.InsertRecord(&style.font, &style.color);
 		
 		if ( (runDesc.offset == offset) && (runIndex > 0) && 
-			 (fStyleRunDesc[runIndex - 1]->index == styleIndex) ) {
+			 (fStyleRunDesc[runIndex - 1].index == styleIndex) ) {
 			RemoveStyles(runIndex);
 			runIndex--;	
 		}
@@ -289,7 +292,9 @@ _BStyleBuffer_::SetStyleRange(int32 fromOffset, int32 toOffset,
 				fStyleRecord.CommitRecord(newDesc.index);
 				runIndex++;		
 			} else {
-				fStyleRunDesc[runIndex]->index = styleIndex;
+				STEStyleRunDesc newDesc = fStyleRunDesc[runIndex];
+				newDesc.index = styleIndex;
+				fStyleRunDesc.SetDesc(&newDesc, runIndex);
 				fStyleRecord.CommitRecord(styleIndex);
 			}
 				
@@ -307,7 +312,7 @@ _BStyleBuffer_::SetStyleRange(int32 fromOffset, int32 toOffset,
 	} while (offset < toOffset);
 	
 	if ( (offset == toOffset) && (runIndex < fStyleRunDesc.ItemCount()) &&
-		 (fStyleRunDesc[runIndex]->index == styleIndex) )
+		 (fStyleRunDesc[runIndex].index == styleIndex) )
 		RemoveStyles(runIndex);
 }
 
@@ -324,7 +329,7 @@ _BStyleBuffer_::GetStyle(int32 inOffset, BFont *outFont, rgb_color *outColor) co
 	}
 	
 	int32 runIndex = OffsetToRun(inOffset);
-	int32 styleIndex = fStyleRunDesc[runIndex]->index;
+	int32 styleIndex = fStyleRunDesc[runIndex].index;
 
 	if (outFont)
 		*outFont = fStyleRecord[styleIndex]->style.font;
@@ -377,21 +382,20 @@ _BStyleBuffer_::RemoveStyleRange(int32 fromOffset, int32 toOffset)
 	fStyleRunDesc.BumpOffset(fromOffset - toOffset, fromIndex + 1);
 
 	if ((toIndex == fromIndex) && (toIndex < (fStyleRunDesc.ItemCount() - 1))) {
-		STEStyleRunDescPtr runDesc = fStyleRunDesc[toIndex + 1];
-		runDesc->offset = fromOffset;
+		STEStyleRunDesc runDesc = fStyleRunDesc[toIndex + 1];
+		runDesc.offset = fromOffset;
+		fStyleRunDesc.SetDesc(&runDesc, toIndex + 1);
 	}
 	
 	if (fromIndex < (fStyleRunDesc.ItemCount() - 1)) {
-		STEStyleRunDescPtr runDesc = fStyleRunDesc[fromIndex];
-		if (runDesc->offset == (runDesc + 1)->offset) {
+		if (fStyleRunDesc[fromIndex].offset == fStyleRunDesc[fromIndex + 1].offset) {
 			RemoveStyles(fromIndex);
 			fromIndex--;
 		}
 	}
 	
 	if ((fromIndex >= 0) && (fromIndex < (fStyleRunDesc.ItemCount() - 1))) {
-		STEStyleRunDescPtr runDesc = fStyleRunDesc[fromIndex];
-		if (runDesc->index == (runDesc + 1)->index)
+		if (fStyleRunDesc[fromIndex].index == fStyleRunDesc[fromIndex + 1].index)
 			RemoveStyles(fromIndex + 1);
 	}
 }
@@ -401,7 +405,7 @@ void
 _BStyleBuffer_::RemoveStyles(int32 index, int32 count)
 {
 	for (int32 i = index; i < (index + count); i++)
-		fStyleRecord.RemoveRecord(fStyleRunDesc[i]->index);
+		fStyleRecord.RemoveRecord(fStyleRunDesc[i].index);
 		
 	fStyleRunDesc.RemoveDescs(index, count);
 }
@@ -419,19 +423,19 @@ _BStyleBuffer_::Iterate(int32 fromOffset, int32 length, _BInlineInput_ *input,
 
 	int32 				result = length;
 	int32 				runIndex = fStyleRunDesc.OffsetToRun(fromOffset);
-	STEStyleRunDescPtr	run = fStyleRunDesc[runIndex];
+	STEStyleRunDesc		run = fStyleRunDesc[runIndex];
 	
 	if (outFont != NULL)
-		*outFont = &fStyleRecord[run->index]->style.font;
+		*outFont = &fStyleRecord[run.index]->style.font;
 	if (outColor != NULL)
-		*outColor = &fStyleRecord[run->index]->style.color;
+		*outColor = &fStyleRecord[run.index]->style.color;
 	if (outAscent != NULL)
-		*outAscent = fStyleRecord[run->index]->ascent;
+		*outAscent = fStyleRecord[run.index]->ascent;
 	if (outDescent != NULL)
-		*outDescent = fStyleRecord[run->index]->descent;
+		*outDescent = fStyleRecord[run.index]->descent;
 	
 	if (runIndex < (numRuns - 1)) {
-		int32 nextOffset = (run + 1)->offset - fromOffset;
+		int32 nextOffset = fStyleRunDesc[runIndex + 1].offset - fromOffset;
 		result = (result > nextOffset) ? nextOffset : result;
 	}
 	
@@ -481,9 +485,9 @@ _BStyleBuffer_::operator[](int32 index) const
 		run.offset = 0;
 		run.style = fNullStyle;
 	} else {
-		STEStyleRunDescPtr	runDesc = fStyleRunDesc[index];
-		STEStyleRecordPtr	record = fStyleRecord[runDesc->index];
-		run.offset = runDesc->offset;
+		STEStyleRunDesc		runDesc = fStyleRunDesc[index];
+		STEStyleRecordPtr	record = fStyleRecord[runDesc.index];
+		run.offset = runDesc.offset;
 		run.style = record->style;
 	}
 	
@@ -513,7 +517,7 @@ _BStyleBuffer_::ContinuousGetStyle(BFont *outFont, uint32 *ioMode,
 	int32 toIndex = OffsetToRun(toOffset - 1);
 	
 	if (fromIndex == toIndex) {		
-		int32 styleIndex = fStyleRunDesc[fromIndex]->index;
+		int32 styleIndex = fStyleRunDesc[fromIndex].index;
 		STEStylePtr style = &fStyleRecord[styleIndex]->style;
 		
 		if (ioMode)
@@ -527,12 +531,12 @@ _BStyleBuffer_::ContinuousGetStyle(BFont *outFont, uint32 *ioMode,
 		
 	} else {
 		bool oneColor = true;
-		int32 		styleIndex = fStyleRunDesc[toIndex]->index;
+		int32 		styleIndex = fStyleRunDesc[toIndex].index;
 		STEStyle	theStyle = fStyleRecord[styleIndex]->style;
 		STEStylePtr	style = NULL;
 		
 		for (int32 i = fromIndex; i < toIndex; i++) {
-			styleIndex = fStyleRunDesc[i]->index;
+			styleIndex = fStyleRunDesc[i].index;
 			style = &fStyleRecord[styleIndex]->style;
 			
 			if (mode & B_FONT_FAMILY_AND_STYLE) {
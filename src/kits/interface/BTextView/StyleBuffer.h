@@ -31,6 +31,7 @@
 #include <InterfaceDefs.h>
 #include <SupportDefs.h>
 
+#include "TextViewOffsetTree.h"
 #include "TextViewSupportBuffer.h"
 
 
@@ -64,26 +65,21 @@ typedef struct STEStyleRunDesc {
 // Globals ---------------------------------------------------------------------
 
 // _BStyleRunDescBuffer_ class -------------------------------------------------
-class _BStyleRunDescBuffer_ : public _BTextViewSupportBuffer_<STEStyleRunDesc> {
+class _BStyleRunDescBuffer_ : public _BTextViewOffsetTree_<STEStyleRunDesc> {
 
 public:
 				_BStyleRunDescBuffer_();
 						
 		void	InsertDesc(STEStyleRunDescPtr inDesc, int32 index);
+		void	SetDesc(const STEStyleRunDesc *inDesc, int32 index);
 		void	RemoveDescs(int32 index, int32 count = 1);
 
-		long	OffsetToRun(int32 offset) const;
+		int32	OffsetToRun(int32 offset) const;
 		void	BumpOffset(int32 delta, int32 index);
 	
-		const STEStyleRunDescPtr	operator[](int32 index) const;
+		STEStyleRunDesc	operator[](int32 index) const;
 };
 //------------------------------------------------------------------------------
-inline const
-STEStyleRunDescPtr _BStyleRunDescBuffer_::operator[](int32 index) const
-{
-	return &fBuffer[index];
-}
-//------------------------------------------------------------------------------
 	
 // _BStyleRecordBuffer_ class --------------------------------------------------
 class _BStyleRecordBuffer_ : public _BTextViewSupportBuffer_<STEStyleRecord> {
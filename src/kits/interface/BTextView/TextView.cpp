@@ -73,6 +73,13 @@
 	#define CALLED()
 #endif
 
+// Posted to the view to lay out the next chunk of pending text
+#define _LAYOUT_TEXT_	'_LTX'
+
+// Line breaks are computed at least this many bytes at a time; the rest of
+// a larger change is laid out in the background
+#define LAYOUT_CHUNK_SIZE	(64 * 1024)
+
 
 struct flattened_text_run {
 	int32	offset;
@@ -120,6 +127,61 @@ public:
 };
 
 
+// _BTextLayoutState_ class ----------------------------------------------------
+class _BTextLayoutState_ {
+
+	// The part of the text whose line breaks haven't been computed yet. It
+	// is kept as a range of offsets, which moves along with the edits made
+	// to the text before it is laid out.
+public:
+	_BTextLayoutState_()
+		:	fPending(false),
+			fPosted(false),
+			fFromOffset(0),
+			fToOffset(0)
+	{}
+
+	void Include(int32 fromOffset, int32 toOffset)
+	{
+		if (fPending) {
+			fFromOffset = min_c(fFromOffset, fromOffset);
+			fToOffset = max_c(fToOffset, toOffset);
+		} else {
+			fFromOffset = fromOffset;
+			fToOffset = toOffset;
+			fPending = true;
+		}
+	}
+
+	void TextInserted(int32 offset, int32 length)
+	{
+		if (fFromOffset > offset)
+			fFromOffset += length;
+		if (fToOffset > offset)
+			fToOffset += length;
+	}
+
+	void TextRemoved(int32 fromOffset, int32 toOffset)
+	{
+		fFromOffset = Removed(fFromOffset, fromOffset, toOffset);
+		fToOffset = Removed(fToOffset, fromOffset, toOffset);
+	}
+
+	bool	fPending;
+	bool	fPosted;
+	int32	fFromOffset;
+	int32	fToOffset;
+
+private:
+	static int32 Removed(int32 offset, int32 fromOffset, int32 toOffset)
+	{
+		if (offset >= toOffset)
+			return offset - (toOffset - fromOffset);
+		return min_c(offset, fromOffset);
+	}
+};
+
+
 #ifndef COMPILE_FOR_R5
 // Initialized/finalized by init/fini_interface_kit
 _BWidthBuffer_* BTextView::sWidths = NULL;
@@ -302,6 +364,7 @@ BTextView::~BTextView()
 	delete fStyles;
 	delete fDisallowedChars;
 	delete fUndo;
+	delete fLayoutState;
 }
 
 
@@ -392,6 +455,12 @@ BTextView::AttachedToWindow()
 	
 	UpdateScrollbars();
 	
+	// go on with any text that was left to lay out
+	if (fLayoutState->fPending) {
+		Window()->PostMessage(_LAYOUT_TEXT_, this);
+		fLayoutState->fPosted = true;
+	}
+	
 	if (!fCursor)
 		SetViewCursor(B_CURSOR_I_BEAM);
 	else
@@ -407,6 +476,9 @@ BTextView::DetachedFromWindow()
 {
 	CALLED();
 	BView::DetachedFromWindow();
+	
+	// a layout message still in the queue won't reach us anymore
+	fLayoutState->fPosted = false;
 }
 
 
@@ -418,6 +490,13 @@ void
 BTextView::Draw(BRect updateRect)
 {
 	CALLED();
+	// if the text to draw hasn't been laid out yet, do it now
+	if (fLayoutState->fPending) {
+		int32 pendingLine = LineAt(fLayoutState->fFromOffset);
+		if (updateRect.bottom >= fTextRect.top + (*fLines)[pendingLine].origin)
+			LayoutPendingText();
+	}
+	
 	// what lines need to be drawn?
 	int32 startLine = LineAt(BPoint(0.0f, updateRect.top));
 	int32 endLine = LineAt(BPoint(0.0f, updateRect.bottom));
@@ -537,8 +616,8 @@ BTextView::MouseDown(BPoint where)
 		switch (fClickCount) {
 			case 0:
 				// triple click, select line by line
-				start = (*fLines)[LineAt(start)]->offset;
-				end = (*fLines)[LineAt(end) + 1]->offset;
+				start = (*fLines)[LineAt(start)].offset;
+				end = (*fLines)[LineAt(end) + 1].offset;
 				break;
 												
 			case 2:
@@ -925,6 +1004,12 @@ BTextView::MessageReceived(BMessage *message)
 			break;
 		}
 
+		case _LAYOUT_TEXT_:
+			fLayoutState->fPosted = false;
+			if (fLayoutState->fPending)
+				LayoutPendingText();
+			break;
+			
 		// TODO: Find out what these two do
 		case _PING_:
 		case _DISPOSE_DRAG_:
@@ -1091,6 +1176,7 @@ BTextView::SetText(BFile *inFile, int32 inOffset, int32 inLength,
 	
 	// update the start offsets of each line below offset
 	fLines->BumpOffset(inLength, LineAt(inOffset) + 1);
+	fLayoutState->TextInserted(inOffset, inLength);
 	
 	// update the style runs
 	fStyles->BumpOffset(inLength, fStyles->OffsetToRun(inOffset - 1) + 1);
@@ -1788,11 +1874,12 @@ BTextView::PointAt(int32 inOffset, float *outHeight) const
 	BPoint result;
 	int32 textLength = fText->Length();
 	int32 lineNum = LineAt(inOffset);
-	STELinePtr line = (*fLines)[lineNum];
+	STELine line = (*fLines)[lineNum];
+	STELine nextLine = (*fLines)[lineNum + 1];
 	float height = 0;
 	
 	result.x = 0.0;
-	result.y = line->origin + fTextRect.top;
+	result.y = line.origin + fTextRect.top;
 	
 	// Handle the case where there is only one line
 	// (no text inserted)
@@ -1807,7 +1894,7 @@ BTextView::PointAt(int32 inOffset, float *outHeight) const
 		height = fontHeight.ascent + fontHeight.descent;
 		
 	} else {	
-		height = (line + 1)->origin - line->origin;
+		height = nextLine.origin - line.origin;
 	
 		// special case: go down one line if inOffset is a newline
 		if (inOffset == textLength && (*fText)[textLength - 1] == '\n') {
@@ -1818,8 +1905,8 @@ BTextView::PointAt(int32 inOffset, float *outHeight) const
 			height = ascent + descent;
 	
 		} else {
-			int32 offset = line->offset;
-			int32 length = inOffset - line->offset;
+			int32 offset = line.offset;
+			int32 length = inOffset - line.offset;
 			int32 numChars = length;
 			bool foundTab = false;		
 			do {
@@ -1878,14 +1965,15 @@ BTextView::OffsetAt(BPoint point) const
 		return 0;
 
 	int32 lineNum = LineAt(point);
-	STELinePtr line = (*fLines)[lineNum];
+	STELine line = (*fLines)[lineNum];
+	STELine nextLine = (*fLines)[lineNum + 1];
 	
 	// special case: if point is within the text rect and PixelToLine()
 	// tells us that it's on the last line, but if point is actually  
 	// lower than the bottom of the last line, return the last offset 
 	// (can happen for newlines)
 	if (lineNum == (fLines->NumLines() - 1)) {
-		if (point.y >= ((line + 1)->origin + fTextRect.top))
+		if (point.y >= (nextLine.origin + fTextRect.top))
 			return (fText->Length());
 	}
 	
@@ -1903,11 +1991,11 @@ BTextView::OffsetAt(BPoint point) const
 	// do a pseudo-binary search of the character widths on the line
 	// that PixelToLine() gave us
 	// note: the right half of a character returns its offset + 1
-	int32 offset = line->offset;
+	int32 offset = line.offset;
 	int32 saveOffset = offset;
 	int32 delta = 0;
-	int32 limit = (line + 1)->offset;
-	int32 length = limit - line->offset;
+	int32 limit = nextLine.offset;
+	int32 length = limit - line.offset;
 	float sigmaWidth = 0.0;
 	float tabWidth = 0.0;
 	int32 numChars = length;
@@ -1984,7 +2072,7 @@ BTextView::OffsetAt(BPoint point) const
 		numChars = length;
 	} while (foundTab && length > 0);
 	
-	if (offset == (line + 1)->offset) {
+	if (offset == nextLine.offset) {
 		// special case: newlines aren't visible
 		// return the offset of the character preceding the newline
 		if ((*fText)[offset - 1] == '\n')
@@ -2010,7 +2098,7 @@ BTextView::OffsetAt(int32 line) const
 	if (line > fLines->NumLines())
 		return fText->Length();
 
-	return (*fLines)[line]->offset;
+	return (*fLines)[line].offset;
 }
 
 
@@ -2059,8 +2147,9 @@ BTextView::LineWidth(int32 lineNum) const
 	if (lineNum < 0 || lineNum >= fLines->NumLines())
 		return 0;
 	else {
-		STELinePtr line = (*fLines)[lineNum];
-		return StyledWidth(line->offset, (line + 1)->offset - line->offset);
+		STELine line = (*fLines)[lineNum];
+		STELine nextLine = (*fLines)[lineNum + 1];
+		return StyledWidth(line.offset, nextLine.offset - line.offset);
 	}
 }
 
@@ -2091,10 +2180,10 @@ BTextView::TextHeight(int32 startLine, int32 endLine) const
 		endLine = numLines - 1;
 	
 	// TODO: This looks broken as well. What do we do if there's only one line ?
-	float height = (*fLines)[endLine + 1]->origin - (*fLines)[startLine]->origin;
+	float height = (*fLines)[endLine + 1].origin - (*fLines)[startLine].origin;
 				
 	if (endLine == numLines - 1 && (*fText)[fText->Length() - 1] == '\n')
-		height += (*fLines)[endLine + 1]->origin - (*fLines)[endLine]->origin;
+		height += (*fLines)[endLine + 1].origin - (*fLines)[endLine].origin;
 	
 	return height;
 }
@@ -2734,6 +2823,7 @@ BTextView::InsertText(const char *inText, int32 inLength, int32 inOffset,
 	
 	// update the start offsets of each line below offset
 	fLines->BumpOffset(inLength, LineAt(inOffset) + 1);
+	fLayoutState->TextInserted(inOffset, inLength);
 	
 	// update the style runs
 	fStyles->BumpOffset(inLength, fStyles->OffsetToRun(inOffset - 1) + 1);
@@ -2766,6 +2856,7 @@ BTextView::DeleteText(int32 fromOffset, int32 toOffset)
 	
 	// remove any lines that have been obliterated
 	fLines->RemoveLineRange(fromOffset, toOffset);
+	fLayoutState->TextRemoved(fromOffset, toOffset);
 	
 	// remove any style runs that have been obliterated
 	fStyles->RemoveStyleRange(fromOffset, toOffset);
@@ -2895,6 +2986,7 @@ BTextView::InitObject(BRect textRect, const BFont *initialFont,
 	fClickRunner = NULL;
 	fTrackingMouse = NULL;
 	fTextChange = NULL;
+	fLayoutState = new _BTextLayoutState_;
 }
 
 
@@ -3070,14 +3162,14 @@ BTextView::HandlePageKey(uint32 inPageKey)
 	mods = modifiers();
 	bool shiftDown = mods & B_SHIFT_KEY;
 	
-	STELinePtr line = NULL; 
+	STELine line;
 	
 	int32 start = fSelStart, end = fSelEnd;
 	
 	switch (inPageKey) {
 		case B_HOME:
 			line = (*fLines)[CurrentLine()];
-			fClickOffset = line->offset;
+			fClickOffset = line.offset;
 			if (shiftDown) {
 				if (fClickOffset <= fSelStart) {
 					start = fClickOffset;
@@ -3097,7 +3189,7 @@ BTextView::HandlePageKey(uint32 inPageKey)
 			// offset of the next line, and go to the previous charachter
 			if (CurrentLine() + 1 < fLines->NumLines()) {
 				line = (*fLines)[CurrentLine() + 1];
-				fClickOffset = PreviousInitialByte(line->offset);
+				fClickOffset = PreviousInitialByte(line.offset);
 			} else {
 				// This check if needed to avoid moving the cursor
 				// when the cursor is on the last line, and that line
@@ -3225,6 +3317,10 @@ BTextView::HandleAlphaKey(const char *bytes, int32 numBytes)
 	\param erase If true, the function will also erase the textview content
 	in the parts where text isn't present.
 	\param scroll If true, function will scroll the view to the end offset.
+
+	When the view is in a window, only the changed text down to the bottom of
+	the visible area is laid out at once; the rest is left to
+	LayoutPendingText().
 */
 void
 BTextView::Refresh(int32 fromOffset, int32 toOffset, bool erase,
@@ -3240,7 +3336,10 @@ BTextView::Refresh(int32 fromOffset, int32 toOffset, bool erase,
 	float saveLineHeight = LineHeight(fromLine);
 	BRect bounds = Bounds();
 	
-	RecalLineBreaks(&fromLine, &toLine);
+	if (Window() != NULL)
+		RecalLineBreaks(&fromLine, &toLine, bounds.bottom - fTextRect.top);
+	else
+		RecalLineBreaks(&fromLine, &toLine);
 
 	float newHeight = fTextRect.Height();
 	
@@ -3266,7 +3365,7 @@ BTextView::Refresh(int32 fromOffset, int32 toOffset, bool erase,
 	int32 drawOffset = fromOffset;
 	if (LineHeight(fromLine) != saveLineHeight || 
 		 newHeight < saveHeight || fromLine < saveFromLine )
-		drawOffset = (*fLines)[fromLine]->offset;
+		drawOffset = (*fLines)[fromLine].offset;
 	
 	// TODO: Is it ok here ?
 	if (fResizable)
@@ -3276,7 +3375,7 @@ BTextView::Refresh(int32 fromOffset, int32 toOffset, bool erase,
 	
 	// erase the area below the text
 	BRect eraseRect = bounds;
-	eraseRect.top = fTextRect.top + (*fLines)[fLines->NumLines()]->origin;
+	eraseRect.top = fTextRect.top + (*fLines)[fLines->NumLines()].origin;
 	eraseRect.bottom = fTextRect.top + saveHeight;
 	if (eraseRect.bottom > eraseRect.top && eraseRect.Intersects(bounds)) {
 		SetLowColor(ViewColor());
@@ -3294,8 +3393,18 @@ BTextView::Refresh(int32 fromOffset, int32 toOffset, bool erase,
 }
 
 
+/*! \brief Recalculates the line breaks of the given lines, and of the ones
+		after them until the old and new line breaks match again.
+	\param startLine The first line to recalculate, set to the first line
+		that changed.
+	\param endLine The last line to recalculate, set to the last line
+		that was laid out.
+	\param stopOrigin If not negative, the layout may stop once it has done
+		at least LAYOUT_CHUNK_SIZE bytes and reached a line below this origin.
+		The rest becomes pending text, which is laid out from the looper.
+*/
 void
-BTextView::RecalLineBreaks(int32 *startLine, int32 *endLine)
+BTextView::RecalLineBreaks(int32 *startLine, int32 *endLine, float stopOrigin)
 {
 	CALLED();
 	// are we insane?
@@ -3304,14 +3413,15 @@ BTextView::RecalLineBreaks(int32 *startLine, int32 *endLine)
 	
 	int32 textLength = fText->Length();
 	int32 lineIndex = (*startLine > 0) ? *startLine - 1 : 0;
-	int32 recalThreshold = (*fLines)[*endLine + 1]->offset;
+	int32 recalThreshold = (*fLines)[*endLine + 1].offset;
 	float width = fTextRect.Width();
-	STELinePtr curLine = (*fLines)[lineIndex];
-	STELinePtr nextLine = curLine + 1;
+	STELine curLine = (*fLines)[lineIndex];
+	int32 firstOffset = curLine.offset;
+	bool stopped = false;
 
 	do {
 		float ascent, descent;
-		int32 fromOffset = curLine->offset;
+		int32 fromOffset = curLine.offset;
 		int32 toOffset = FindLineBreak(fromOffset, &ascent, 
 										 &descent, &width);
 
@@ -3320,33 +3430,35 @@ BTextView::RecalLineBreaks(int32 *startLine, int32 *endLine)
 			toOffset = NextInitialByte(toOffset);
 		
 		// set the ascent of this line
-		curLine->ascent = ascent;
+		curLine.ascent = ascent;
+		fLines->SetLine(&curLine, lineIndex);
 		
 		lineIndex++;
-		STELine saveLine = *nextLine;		
+		STELine saveLine = (*fLines)[lineIndex];		
 		if ( lineIndex > fLines->NumLines() || 
-			 toOffset < nextLine->offset ) {
+			 toOffset < saveLine.offset ) {
 			// the new line comes before the old line start, add a line
 			STELine newLine;
 			newLine.offset = toOffset;
-			newLine.origin = curLine->origin + ascent + descent;
+			newLine.origin = curLine.origin + ascent + descent;
 			newLine.ascent = 0;
 			fLines->InsertLine(&newLine, lineIndex);
 		} else {
 			// update the exising line
-			nextLine->offset = toOffset;
-			nextLine->origin = curLine->origin + ascent + descent;
+			STELine nextLine = saveLine;
+			nextLine.offset = toOffset;
+			nextLine.origin = curLine.origin + ascent + descent;
+			fLines->SetLine(&nextLine, lineIndex);
 			
 			// remove any lines that start before the current line
 			while ( lineIndex < fLines->NumLines() &&
-					toOffset >= ((*fLines)[lineIndex] + 1)->offset )
+					toOffset >= (*fLines)[lineIndex + 1].offset )
 				fLines->RemoveLines(lineIndex + 1);
 			
-			nextLine = (*fLines)[lineIndex];
-			if (nextLine->offset == saveLine.offset) {
-				if (nextLine->offset >= recalThreshold) {
-					if (nextLine->origin != saveLine.origin)
-						fLines->BumpOrigin(nextLine->origin - saveLine.origin, 
+			if (nextLine.offset == saveLine.offset) {
+				if (nextLine.offset >= recalThreshold) {
+					if (nextLine.origin != saveLine.origin)
+						fLines->BumpOrigin(nextLine.origin - saveLine.origin, 
 										  lineIndex + 1);
 					break;
 				}
@@ -3357,8 +3469,34 @@ BTextView::RecalLineBreaks(int32 *startLine, int32 *endLine)
 		}
 
 		curLine = (*fLines)[lineIndex];
-		nextLine = curLine + 1;
-	} while (curLine->offset < textLength);
+		
+		if (stopOrigin >= 0.0 && curLine.offset < textLength
+			&& curLine.offset - firstOffset >= LAYOUT_CHUNK_SIZE
+			&& curLine.origin > stopOrigin) {
+			// leave the rest for later, the current line holds all of it
+			// until then; keep the lines after it below it
+			STELine restLine = (*fLines)[lineIndex + 1];
+			float restOrigin = curLine.origin + ascent + descent;
+			if (restLine.origin != restOrigin)
+				fLines->BumpOrigin(restOrigin - restLine.origin, lineIndex + 1);
+			
+			fLayoutState->Include(curLine.offset,
+				max_c(recalThreshold, restLine.offset));
+			if (!fLayoutState->fPosted && Window() != NULL) {
+				Window()->PostMessage(_LAYOUT_TEXT_, this);
+				fLayoutState->fPosted = true;
+			}
+			
+			stopped = true;
+			break;
+		}
+	} while (curLine.offset < textLength);
+	
+	// the pending text may have been laid out along the way
+	if (!stopped && fLayoutState->fPending
+		&& fLayoutState->fFromOffset >= firstOffset
+		&& fLayoutState->fToOffset <= (*fLines)[lineIndex].offset)
+		fLayoutState->fPending = false;
 
 	// update the text rect
 	float newHeight = TextHeight(0, fLines->NumLines() - 1);
@@ -3369,6 +3507,18 @@ BTextView::RecalLineBreaks(int32 *startLine, int32 *endLine)
 }
 
 
+/*! \brief Lays out the next chunk of the pending text, and draws what of it
+		is visible.
+*/
+void
+BTextView::LayoutPendingText()
+{
+	CALLED();
+	fLayoutState->fPending = false;
+	Refresh(fLayoutState->fFromOffset, fLayoutState->fToOffset, true, false);
+}
+
+
 int32
 BTextView::FindLineBreak(int32 fromOffset, float *outAscent,
 							   float *outDescent, float	*ioWidth)
@@ -3630,7 +3780,8 @@ void
 BTextView::DrawLines(int32 startLine, int32 endLine, int32 startOffset,
 						  bool erase)
 {
-	// TODO: Draw on the "fOffscreen" BBitmap, then draw it on the view
+	// TODO: Draw on the "fOffscreen" BBitmap, then draw it on the view,
+	// once bitmaps accept views
 
 	// clip the text
 	BRect clipRect = Bounds() & fTextRect;
@@ -3653,23 +3804,24 @@ BTextView::DrawLines(int32 startLine, int32 endLine, int32 startOffset,
 
 	BRect eraseRect = clipRect;
 	long startEraseLine = startLine;
-	STELinePtr line = (*fLines)[startLine];
+	STELine line = (*fLines)[startLine];
+	STELine nextLine = (*fLines)[startLine + 1];
 	if (erase && startOffset != -1) {
 		// erase only to the right of startOffset
 		startEraseLine++;
 		long startErase = startOffset;
-		if (startErase > line->offset) {
+		if (startErase > line.offset) {
 			for ( ; ((*fText)[startErase] != B_SPACE) && ((*fText)[startErase] != B_TAB); startErase--) {
-				if (startErase <= line->offset)
+				if (startErase <= line.offset)
 					break;	
 			}
-			if (startErase > line->offset)
+			if (startErase > line.offset)
 				startErase--;
 		}
 		
 		eraseRect.left = PointAt(startErase).x;
-		eraseRect.top = line->origin + fTextRect.top;
-		eraseRect.bottom = (line + 1)->origin + fTextRect.top;
+		eraseRect.top = line.origin + fTextRect.top;
+		eraseRect.bottom = nextLine.origin + fTextRect.top;
 		
 		FillRect(eraseRect, B_SOLID_LOW);
 
@@ -3678,9 +3830,9 @@ BTextView::DrawLines(int32 startLine, int32 endLine, int32 startOffset,
 	
 	float startLeft = fTextRect.left;
 	for (long i = startLine; i <= endLine; i++) {
-		long length = (line + 1)->offset - line->offset;
+		long length = nextLine.offset - line.offset;
 		// DrawString() chokes if you draw a newline
-		if ((*fText)[(line + 1)->offset - 1] == '\n')
+		if ((*fText)[nextLine.offset - 1] == '\n')
 			length--;	
 
 		if (fAlignment != B_ALIGN_LEFT) {
@@ -3691,11 +3843,11 @@ BTextView::DrawLines(int32 startLine, int32 endLine, int32 startOffset,
 			startLeft += fTextRect.left;
 		}
 			
-		MovePenTo(startLeft, line->origin + line->ascent + fTextRect.top);
+		MovePenTo(startLeft, line.origin + line.ascent + fTextRect.top);
 
 		if (erase && i >= startEraseLine) {
-			eraseRect.top = line->origin + fTextRect.top;
-			eraseRect.bottom = (line + 1)->origin + fTextRect.top;
+			eraseRect.top = line.origin + fTextRect.top;
+			eraseRect.bottom = nextLine.origin + fTextRect.top;
 			
 			FillRect(eraseRect, B_SOLID_LOW);
 		}
@@ -3707,7 +3859,7 @@ BTextView::DrawLines(int32 startLine, int32 endLine, int32 startOffset,
 			bool foundTab = false;
 			long tabChars = 0;
 			long numTabs = 0;
-			long offset = line->offset;
+			long offset = line.offset;
 			const BFont *font = NULL;
 			const rgb_color *color = NULL;
 			int32 numChars;
@@ -3784,7 +3936,8 @@ BTextView::DrawLines(int32 startLine, int32 endLine, int32 startOffset,
 				} while (foundTab && tabChars > 0);
 			}
 		}
-		line++;
+		line = nextLine;
+		nextLine = (*fLines)[i + 2];
 	}
 
 	ConstrainClippingRegion(NULL);
@@ -4064,7 +4217,9 @@ BTextView::AutoResize(bool doredraw)
 /*! \brief Creates a new offscreen BBitmap with an associated BView.
 	param padding Padding (?)
 	
-	Creates an offscreen BBitmap which will be used to draw.
+	Creates an offscreen BBitmap which will be used to draw. Only the visible
+	lines are drawn through it, so it is as large as the view's bounds, not
+	as the whole text.
 */
 void
 BTextView::NewOffscreen(float padding)
@@ -4073,8 +4228,8 @@ BTextView::NewOffscreen(float padding)
 	if (fOffscreen != NULL)
 		DeleteOffscreen();
 	
-	// TODO: Is this correct ?
-	BRect bitmapRect(0, 0, fTextRect.Width() + padding, fTextRect.Height());
+	BRect bounds = Bounds();
+	BRect bitmapRect(0, 0, bounds.Width() + padding, bounds.Height());
 	fOffscreen = new BBitmap(bitmapRect, fColorSpace, true, false);
 	if (fOffscreen != NULL && fOffscreen->Lock()) {
 		BView *bufferView = new BView(bitmapRect, "drawing view", 0, 0);
@@ -42,6 +42,7 @@
 #include <Application.h>
 #include <ServerProtocol.h>
 #include <AppServerLink.h>
+#include <ColorUtils.h>
 
 enum {
 	NOT_IMPLEMENTED	= B_ERROR
@@ -270,38 +271,6 @@ brightness_for(uint8 red, uint8 green, uint8 blue)
 	return uint8((308 * red + 600 * green + 116 * blue) / 1024);
 }
 
-// color_distance
-/*!	\brief Returns the "distance" between two RGB colors.
-
-	This functions defines an metric on the RGB color space. The distance
-	between two colors is 0, if and only if the colors are equal.
-
-	\param red1 Red component of the first color.
-	\param green1 Green component of the first color.
-	\param blue1 Blue component of the first color.
-	\param red2 Red component of the second color.
-	\param green2 Green component of the second color.
-	\param blue2 Blue component of the second color.
-	\return The distance between the given colors.
-*/
-static inline
-unsigned
-color_distance(uint8 red1, uint8 green1, uint8 blue1,
-			   uint8 red2, uint8 green2, uint8 blue2)
-{
-	// euklidian distance (its square actually)
-	int rd = (int)red1 - (int)red2;
-	int gd = (int)green1 - (int)green2;
-	int bd = (int)blue1 - (int)blue2;
-//	return rd * rd + gd * gd + bd * bd;
-
-	// distance according to psycho-visual tests
-	int rmean = ((int)red1 + (int)red2) / 2;
-	return (((512 + rmean) * rd * rd) >> 8)
-		   + 4 * gd * gd
-		   + (((767 - rmean) * bd * bd) >> 8);
-}
-
 // bit_mask, inverse_bit_mask
 static inline int32 bit_mask(int32 bit)			{ return (1 << bit); }
 static inline int32 inverse_bit_mask(int32 bit)	{ return ~bit_mask(bit); }
@@ -417,32 +386,8 @@ PaletteConverter::SetTo(const rgb_color *palette)
 	// init color map
 	if (error == B_OK) {
 		fColorMap = fOwnColorMap;
-		// init color list
-		memcpy(fOwnColorMap->color_list, palette, sizeof(rgb_color) * 256);
-		// init index map
-		for (int32 color = 0; color < 32768; color++) {
-			// get components
-			uint8 red = (color & 0x7c00) >> 7;
-			uint8 green = (color & 0x3e0) >> 2;
-			uint8 blue = (color & 0x1f) << 3;
-			red |= red >> 5;
-			green |= green >> 5;
-			blue |= blue >> 5;
-			// find closest color
-			uint8 closestIndex = 0;
-			unsigned closestDistance = UINT_MAX;
-			for (int32 i = 0; i < 256; i++) {
-				const rgb_color &c = fOwnColorMap->color_list[i];
-				unsigned distance = color_distance(red, green, blue,
-												   c.red, c.green, c.blue);
-				if (distance < closestDistance) {
-					closestIndex = i;
-					closestDistance = distance;
-				}
-			}
-			fOwnColorMap->index_map[color] = closestIndex;
-		}
-		// no need to init inversion map
+		fOwnColorMap->id = 0;
+		BuildColorMap(fOwnColorMap, palette);
 	}
 	fCStatus = error;
 	return error;
@@ -706,12 +651,16 @@ PaletteConverter::GrayColorForIndex(uint8 index) const
 	return brightness_for(color.red, color.green, color.blue);
 }
 
-// TODO: Remove these and palette_converter() when BScreen is available.
 static BLocker			gPaletteConverterLock;
 static PaletteConverter	gPaletteConverter;
 
 // palette_converter
 /*!	\brief Returns a PaletteConverter using the system color palette.
+
+	The converter uses the color map published by the app_server, so that the
+	index map doesn't have to be built in every team. Without an app_server it
+	falls back to building its own map for the built-in system palette.
+
 	\return A PaletteConverter.
 */
 static
@@ -719,14 +668,339 @@ const PaletteConverter*
 palette_converter()
 {
 	if (gPaletteConverterLock.Lock()) {
-		if (gPaletteConverter.InitCheck() != B_OK)
-			gPaletteConverter.SetTo(kSystemPalette);
+		if (gPaletteConverter.InitCheck() != B_OK) {
+			const color_map *map = CloneSystemColorMap();
+			if (map)
+				gPaletteConverter.SetTo(map);
+			else
+				gPaletteConverter.SetTo(kSystemPalette);
+		}
 		gPaletteConverterLock.Unlock();
 	}
 	return &gPaletteConverter;
 }
 
 
+#ifndef RUN_WITHOUT_APP_SERVER
+
+/*	Creating a bitmap used to take a round trip to the app_server, and every
+	bitmap cloned the server's area on its own, although small bitmaps share
+	a slab area in the server. Now small bitmaps without special flags come
+	from a pool of server bitmaps of the same size and color space, which is
+	refilled several bitmaps at a time. Areas are cloned once and shared by
+	all bitmaps in them, and deleted bitmaps are given back to the server in
+	batches, without waiting for a reply.
+
+	A deleted bitmap is never handed out again: a DrawBitmapAsync() for it
+	may still sit in a window's link, which is served by another thread of
+	the server, and would then draw what the next owner put into it. The
+	server never reuses a token, so such a request just finds no bitmap.
+
+	The locking order is the application lock taken by BAppServerLink first,
+	then gBitmapPoolLock, so the pool lock must never be held while creating
+	a link.
+*/
+
+//! Bitmaps with at most this many bytes of data are pooled
+static const int32 kPooledBitmapSize = 16384;
+//! Number of bitmaps asked for when a pool is empty
+static const int32 kBitmapPoolRefill = 8;
+//! Number of deleted bitmaps that are collected before telling the server
+static const int32 kBitmapDeleteBatch = 32;
+
+struct server_bitmap {
+	int32	token;
+	area_id	area;
+	int32	offset;
+};
+
+struct bitmap_pool {
+	int32		width;
+	int32		height;
+	color_space	colorSpace;
+	int32		bytesPerRow;
+	BList		bitmaps;
+};
+
+struct cloned_area {
+	area_id	source;
+	area_id	clone;
+	uint8	*address;
+	int32	refCount;
+};
+
+static BLocker	gBitmapPoolLock("bitmap pool");
+static BList	gBitmapPools;
+static BList	gClonedAreas;
+static BList	gDeletedBitmaps;
+
+// is_pooled
+/*!	\brief Returns whether bitmaps of the given kind are taken from a pool.
+	\param flags The bitmap's creation flags.
+	\param size The size of the bitmap data in bytes.
+	\return \c true, if the bitmap is pooled.
+*/
+static inline
+bool
+is_pooled(uint32 flags, int32 size)
+{
+	return flags == 0 && size <= kPooledBitmapSize;
+}
+
+// find_bitmap_pool
+/*!	\brief Returns the pool for bitmaps of the given kind.
+
+	gBitmapPoolLock must be held.
+
+	\param bounds The bitmap dimensions.
+	\param colorSpace The bitmap's color space.
+	\param bytesPerRow The number of bytes per row.
+	\param create Whether to create the pool, if there is none yet.
+	\return The pool, or \c NULL, if there is none.
+*/
+static
+bitmap_pool*
+find_bitmap_pool(BRect bounds, color_space colorSpace, int32 bytesPerRow,
+				 bool create)
+{
+	int32 width = bounds.IntegerWidth();
+	int32 height = bounds.IntegerHeight();
+	for (int32 i = 0; i < gBitmapPools.CountItems(); i++) {
+		bitmap_pool *pool = (bitmap_pool*)gBitmapPools.ItemAt(i);
+		if (pool->width == width && pool->height == height
+			&& pool->colorSpace == colorSpace
+			&& pool->bytesPerRow == bytesPerRow) {
+			return pool;
+		}
+	}
+	if (!create)
+		return NULL;
+
+	bitmap_pool *pool = new(std::nothrow) bitmap_pool;
+	if (pool) {
+		pool->width = width;
+		pool->height = height;
+		pool->colorSpace = colorSpace;
+		pool->bytesPerRow = bytesPerRow;
+		gBitmapPools.AddItem(pool);
+	}
+	return pool;
+}
+
+// acquire_area
+/*!	\brief Maps an area of the app_server into our team.
+
+	The area is only cloned the first time, afterwards the clone is shared.
+	gBitmapPoolLock must be held.
+
+	\param source The server's area.
+	\param clone Set to the ID of the clone.
+	\return The address of the clone, or \c NULL, if the area can't be cloned.
+*/
+static
+uint8*
+acquire_area(area_id source, area_id *clone)
+{
+	for (int32 i = 0; i < gClonedAreas.CountItems(); i++) {
+		cloned_area *area = (cloned_area*)gClonedAreas.ItemAt(i);
+		if (area->source == source) {
+			area->refCount++;
+			*clone = area->clone;
+			return area->address;
+		}
+	}
+
+	cloned_area *area = new(std::nothrow) cloned_area;
+	if (!area)
+		return NULL;
+	area->source = source;
+	area->refCount = 1;
+	area->clone = clone_area("shared bitmap area", (void**)&area->address,
+		B_ANY_ADDRESS, B_READ_AREA | B_WRITE_AREA, source);
+	if (area->clone < 0) {
+		delete area;
+		return NULL;
+	}
+	gClonedAreas.AddItem(area);
+	*clone = area->clone;
+	return area->address;
+}
+
+// release_area
+/*!	\brief Releases an area mapped by acquire_area().
+
+	The clone is deleted when the last bitmap in it is gone. gBitmapPoolLock
+	must be held.
+
+	\param source The server's area.
+*/
+static
+void
+release_area(area_id source)
+{
+	for (int32 i = 0; i < gClonedAreas.CountItems(); i++) {
+		cloned_area *area = (cloned_area*)gClonedAreas.ItemAt(i);
+		if (area->source == source) {
+			if (--area->refCount == 0) {
+				delete_area(area->clone);
+				gClonedAreas.RemoveItem(i);
+				delete area;
+			}
+			return;
+		}
+	}
+}
+
+// attach_deleted_bitmaps
+/*!	\brief Adds an AS_DELETE_BITMAPS message for the deleted bitmaps to a link.
+
+	The message goes out with the next flush of the link. Must be called
+	without holding gBitmapPoolLock.
+
+	\param link The link to the app_server.
+*/
+static
+void
+attach_deleted_bitmaps(BPrivate::BAppServerLink &link)
+{
+	if (!gBitmapPoolLock.Lock())
+		return;
+
+	int32 count = gDeletedBitmaps.CountItems();
+	if (count > 0) {
+		// AS_DELETE_BITMAPS:
+		// Attached Data:
+		//	1) int32 number of bitmaps
+		//	2) int32 server token of each of them
+		// No reply
+		link.StartMessage(AS_DELETE_BITMAPS);
+		link.Attach<int32>(count);
+		for (int32 i = 0; i < count; i++)
+			link.Attach<int32>((int32)gDeletedBitmaps.ItemAt(i));
+		gDeletedBitmaps.MakeEmpty();
+	}
+
+	gBitmapPoolLock.Unlock();
+}
+
+// create_pooled_bitmap
+/*!	\brief Takes a bitmap out of the pool, refilling it if necessary.
+	\param bounds The bitmap dimensions.
+	\param colorSpace The bitmap's color space.
+	\param bytesPerRow The number of bytes per row.
+	\param screenID The screen the bitmap is created for.
+	\param bitmap Set to the server bitmap.
+	\return \c B_OK if everything went fine, an error code otherwise.
+*/
+static
+status_t
+create_pooled_bitmap(BRect bounds, color_space colorSpace, int32 bytesPerRow,
+					 screen_id screenID, server_bitmap *bitmap)
+{
+	// the common case doesn't involve the server at all
+	if (!gBitmapPoolLock.Lock())
+		return B_ERROR;
+	bitmap_pool *pool = find_bitmap_pool(bounds, colorSpace, bytesPerRow, true);
+	server_bitmap *pooled = pool
+		? (server_bitmap*)pool->bitmaps.RemoveItem(pool->bitmaps.CountItems() - 1)
+		: NULL;
+	gBitmapPoolLock.Unlock();
+
+	if (!pool)
+		return B_NO_MEMORY;
+	if (pooled) {
+		*bitmap = *pooled;
+		delete pooled;
+		return B_OK;
+	}
+
+	BPrivate::BAppServerLink link;
+	attach_deleted_bitmaps(link);
+
+	// AS_CREATE_BITMAPS:
+	// Attached Data:
+	//	1) BRect bounds
+	//	2) color_space space
+	//	3) int32 bitmap_flags
+	//	4) int32 bytes_per_row
+	//	5) int32 screen_id::id
+	//	6) int32 number of bitmaps
+	// Reply Code: SERVER_TRUE
+	// Reply Data:
+	//	1) int32 number of bitmaps created
+	//	2) for each of them the server token, area_id and area offset
+	link.StartMessage(AS_CREATE_BITMAPS);
+	link.Attach<BRect>(bounds);
+	link.Attach<color_space>(colorSpace);
+	link.Attach<int32>(0);
+	link.Attach<int32>(bytesPerRow);
+	link.Attach<int32>(screenID.id);
+	link.Attach<int32>(kBitmapPoolRefill);
+
+	int32 code = SERVER_FALSE;
+	status_t error = link.FlushWithReply(&code);
+	if (error != B_OK)
+		return error;
+	if (code != SERVER_TRUE)
+		return B_NO_MEMORY;
+
+	int32 count = 0;
+	link.Read<int32>(&count);
+	link.Read<int32>(&bitmap->token);
+	link.Read<area_id>(&bitmap->area);
+	link.Read<int32>(&bitmap->offset);
+
+	if (gBitmapPoolLock.Lock()) {
+		for (int32 i = 1; i < count; i++) {
+			server_bitmap *spare = new(std::nothrow) server_bitmap;
+			if (!spare)
+				break;
+			link.Read<int32>(&spare->token);
+			link.Read<area_id>(&spare->area);
+			link.Read<int32>(&spare->offset);
+			pool->bitmaps.AddItem(spare);
+		}
+		gBitmapPoolLock.Unlock();
+	}
+	return B_OK;
+}
+
+// delete_server_bitmap
+/*!	\brief Frees a bitmap of the app_server and releases its area.
+
+	The bitmap is deleted with the next batch; its token is never reused,
+	not even for pooled bitmaps.
+
+	\param token The bitmap's server token.
+	\param area The server's area the bitmap resides in.
+	\param flags The bitmap's creation flags.
+	\param size The size of the bitmap data in bytes.
+*/
+static
+void
+delete_server_bitmap(int32 token, area_id area, uint32 flags, int32 size)
+{
+	if (token < 0 || !gBitmapPoolLock.Lock())
+		return;
+
+	release_area(area);
+	gDeletedBitmaps.AddItem((void*)token);
+
+	// big bitmaps are given back right away, they hold a whole area
+	bool flush = gDeletedBitmaps.CountItems() >= kBitmapDeleteBatch
+		|| !is_pooled(flags, size);
+	gBitmapPoolLock.Unlock();
+
+	if (flush) {
+		BPrivate::BAppServerLink link;
+		attach_deleted_bitmaps(link);
+		link.Flush();
+	}
+}
+
+#endif	// RUN_WITHOUT_APP_SERVER
+
+
 /////////////
 // BBitmap //
 /////////////
@@ -829,11 +1103,13 @@ BBitmap::BBitmap(const BBitmap *source, bool acceptsViews,
 */
 BBitmap::~BBitmap()
 {
-	// TODO: don't free fBasePtr, as it's owned by the app_server
-	// should probably decrement an associated reference count, though,
-	// so the app_server knows this bitmap isn't used anymore
 #ifdef RUN_WITHOUT_APP_SERVER
 	free(fBasePtr);
+#else
+	// fBasePtr is owned by the app_server
+	if (fBasePtr) {
+		delete_server_bitmap(fServerToken, fOrigArea, fFlags, fSize);
+	}
 #endif	// RUN_WITHOUT_APP_SERVER
 }
 
@@ -2227,37 +2503,17 @@ BBitmap::InitObject(BRect bounds, color_space colorSpace, uint32 flags,
 {
 	status_t error = B_OK;
 
-#ifndef RUN_WITHOUT_APP_SERVER
-	BPrivate::BAppServerLink link;
-#endif	// RUN_WITHOUT_APP_SERVER
-
 	// clean up
 	if (fBasePtr) {
 #ifdef RUN_WITHOUT_APP_SERVER
 		free(fBasePtr);
-#endif	// RUN_WITHOUT_APP_SERVER
-		fBasePtr = NULL;
-
-#ifndef RUN_WITHOUT_APP_SERVER
-		// AS_DELETE_BITMAP:
-		// Attached Data: 
-		//	1) int32 server token
-		
-		// Reply Code: SERVER_TRUE if successful, 
-		//				SERVER_FALSE if the buffer was already deleted
-		// Reply Data:
-		//		none
-//		status_t freestat;
-		int32 code = SERVER_FALSE;
-		link.StartMessage(AS_DELETE_BITMAP);
-		link.Attach<int32>(fServerToken);
-		error=link.FlushWithReply(&code);
-		if(code==SERVER_FALSE)
-			error=B_NO_MEMORY;
-		fBasePtr=NULL;
+#else
+		delete_server_bitmap(fServerToken, fOrigArea, fFlags, fSize);
 		fArea=-1;
+		fOrigArea=-1;
 		fServerToken=-1;
 #endif	// RUN_WITHOUT_APP_SERVER
+		fBasePtr = NULL;
 	}
 	// check params
 	if (!bounds.IsValid() || !is_supported(colorSpace))
@@ -2283,54 +2539,69 @@ BBitmap::InitObject(BRect bounds, color_space colorSpace, uint32 flags,
 		} else
 			error = B_NO_MEMORY;
 #else
-		// Ask the server (via our owning application) to create a bitmap.
-
-		// Attach Data: 
-		// 1) BRect bounds
-		// 2) color_space space
-		// 3) int32 bitmap_flags
-		// 4) int32 bytes_per_row
-		// 5) int32 screen_id::id
-		link.StartMessage(AS_CREATE_BITMAP);
-		link.Attach<BRect>(bounds);
-		link.Attach<color_space>(colorSpace);
-		link.Attach<int32>((int32)flags);
-		link.Attach<int32>(bytesPerRow);
-		link.Attach<int32>(screenID.id);
-		
-		// Reply Code: SERVER_TRUE
-		// Reply Data:
-		//	1) int32 server token
-		//	2) area_id id of the area in which the bitmap data resides
-		//	3) int32 area pointer offset used to calculate fBasePtr
-		
-		// alternatively, if something went wrong
-		// Reply Code: SERVER_FALSE
-		// Reply Data:
-		//		None
-		int32 code = SERVER_FALSE;
-		error=link.FlushWithReply(&code);
-		
-		// We shouldn't ever have to execute this block, but just in case...
-		if(error!=B_OK)
-			fBasePtr=NULL;
-
-		if(code==SERVER_TRUE)
-		{
-			// Get token
-			area_id bmparea;
-			int32 areaoffset;
+		server_bitmap bitmap;
+		if (is_pooled(flags, size)) {
+			error = create_pooled_bitmap(bounds, colorSpace, bytesPerRow,
+										 screenID, &bitmap);
+		} else {
+			// Ask the server (via our owning application) to create a bitmap.
+			BPrivate::BAppServerLink link;
+			attach_deleted_bitmaps(link);
+
+			// Attach Data: 
+			// 1) BRect bounds
+			// 2) color_space space
+			// 3) int32 bitmap_flags
+			// 4) int32 bytes_per_row
+			// 5) int32 screen_id::id
+			link.StartMessage(AS_CREATE_BITMAP);
+			link.Attach<BRect>(bounds);
+			link.Attach<color_space>(colorSpace);
+			link.Attach<int32>((int32)flags);
+			link.Attach<int32>(bytesPerRow);
+			link.Attach<int32>(screenID.id);
 			
-			link.Read<int32>(&fServerToken);
-			link.Read<area_id>(&bmparea);
-			link.Read<int32>(&areaoffset);
+			// Reply Code: SERVER_TRUE
+			// Reply Data:
+			//	1) int32 server token
+			//	2) area_id id of the area in which the bitmap data resides
+			//	3) int32 area pointer offset used to calculate fBasePtr
 			
+			// alternatively, if something went wrong
+			// Reply Code: SERVER_FALSE
+			// Reply Data:
+			//		None
+			int32 code = SERVER_FALSE;
+			error=link.FlushWithReply(&code);
+			if(error==B_OK && code!=SERVER_TRUE)
+				error=B_NO_MEMORY;
+			if(error==B_OK)
+			{
+				link.Read<int32>(&bitmap.token);
+				link.Read<area_id>(&bitmap.area);
+				link.Read<int32>(&bitmap.offset);
+			}
+		}
+
+		uint8 *address = NULL;
+		if(error==B_OK && gBitmapPoolLock.Lock())
+		{
 			// Get the area in which the data resides
-			fArea=clone_area("shared bitmap area",(void**)&fBasePtr,B_ANY_ADDRESS,
-				B_READ_AREA | B_WRITE_AREA,bmparea);
-			
+			address=acquire_area(bitmap.area,&fArea);
+			gBitmapPoolLock.Unlock();
+			if(!address)
+			{
+				// give the bitmap back, we can't use it
+				delete_server_bitmap(bitmap.token,-1,B_BITMAP_IS_AREA,size);
+			}
+		}
+
+		if(address)
+		{
 			// Jump to the location in the area
-			fBasePtr=(int8*)fBasePtr + areaoffset;
+			fBasePtr=address + bitmap.offset;
+			fServerToken=bitmap.token;
+			fOrigArea=bitmap.area;
 
 			fSize = size;
 			fColorSpace = colorSpace;
@@ -2340,16 +2611,18 @@ BBitmap::InitObject(BRect bounds, color_space colorSpace, uint32 flags,
 		}
 		else
 		{
+			fBasePtr = NULL;
 			fServerToken = -1;
 			fArea = -1;
+			fOrigArea = -1;
 			fFlags = flags;
 
-			error = B_NO_MEMORY;
+			if(error==B_OK)
+				error = B_NO_MEMORY;
 		}
 #endif	// RUN_WITHOUT_APP_SERVER
 		fWindow = NULL;
 		fToken = -1;
-		fOrigArea = -1;
 	}
 	fInitError = error;
 }
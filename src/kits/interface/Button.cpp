@@ -30,6 +30,7 @@
 #include <Button.h>
 #include <Window.h>
 #include <Errors.h>
+#include <InputState.h>
 
 // Project Includes ------------------------------------------------------------
 
@@ -285,16 +286,18 @@ void BButton::MouseDown(BPoint point)
  	{
 		BRect bounds = Bounds();
 		uint32 buttons;
+		int32 sequence = BPrivate::input_sequence();
 
 		do
 		{
 			Window()->UpdateIfNeeded();
 			
-			snooze(40000);
+			// sleep until the mouse changes, but not longer than we used to
+			BPrivate::wait_for_input(&sequence, 40000);
 
 			GetMouse(&point, &buttons, true);
 
- 			bool inside = bounds.Contains(ConvertFromScreen(point));
+ 			bool inside = bounds.Contains(point);
 
 			if ((Value() == B_CONTROL_ON) != inside)
 				SetValue(inside ? B_CONTROL_ON : B_CONTROL_OFF);
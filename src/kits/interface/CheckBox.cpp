@@ -30,6 +30,7 @@
 #include <CheckBox.h>
 #include <Window.h>
 #include <Errors.h>
+#include <InputState.h>
 
 // Project Includes ------------------------------------------------------------
 
@@ -252,10 +253,12 @@ void BCheckBox::MouseDown(BPoint point)
 	{
 		BRect bounds = Bounds();
 		uint32 buttons;
+		int32 sequence = BPrivate::input_sequence();
 
 		do
 		{
-			snooze(40000);
+			// sleep until the mouse changes, but not longer than we used to
+			BPrivate::wait_for_input(&sequence, 40000);
 
 			GetMouse(&point, &buttons, true);
 
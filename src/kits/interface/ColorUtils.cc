@@ -24,7 +24,9 @@
 //	Description:	Useful global functions for working with rgb_color structures
 //------------------------------------------------------------------------------
 #include "ColorUtils.h"
+#include <OS.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*!
 	\brief An approximation of 31/255, which is needed for converting from 32-bit
@@ -285,3 +287,148 @@ rgb_color MakeBlendColor(rgb_color col, rgb_color col2, float position)
 
 	return newcol;
 }
+
+/*!
+	\brief Distance between two colors, weighted according to psycho-visual tests
+	
+	The distance is 0 if and only if the colors are equal.
+*/
+static inline int32 color_distance(const rgb_color &a, uint8 red, uint8 green, uint8 blue)
+{
+	int32 rd=(int32)a.red-red, gd=(int32)a.green-green, bd=(int32)a.blue-blue;
+	int32 rmean=((int32)a.red+red)/2;
+	return (((512+rmean)*rd*rd) >> 8) + 4*gd*gd + (((767-rmean)*bd*bd) >> 8);
+}
+
+//! Index of the 15-bit cell a color falls into
+static inline int32 color_cell(const rgb_color &color)
+{
+	return ((color.red & 0xf8) << 7) | ((color.green & 0xf8) << 2) | (color.blue >> 3);
+}
+
+/*!
+	\brief Sets up a color map for a palette
+	\param map The color map to fill in
+	\param palette Array of 256 rgb_color objects
+	
+	The index map gets the closest palette color for each 15-bit color, so that 
+	finding the index for a color is a single table lookup instead of a search 
+	through the palette. A palette color maps to itself, unless another palette 
+	color falls into the same 15-bit cell and is closer to its middle. The 
+	inversion map gets the closest palette color to the inverse of each entry. 
+	The id of the map is incremented, so anyone holding on to the map can tell 
+	that it has changed.
+*/
+void BuildColorMap(color_map *map, const rgb_color *palette)
+{
+	if(!map || !palette)
+		return;
+	
+	memcpy(map->color_list,palette,sizeof(rgb_color)*256);
+	
+	for(int32 color=0; color<32768; color++)
+	{
+		// use the middle of the range of 8-bit values each 5-bit value stands for
+		uint8 red=((color >> 7) & 0xf8) | 4;
+		uint8 green=((color >> 2) & 0xf8) | 4;
+		uint8 blue=((color << 3) & 0xf8) | 4;
+		
+		uint8 closest=0;
+		int32 closestDistance=0x7fffffff;
+		for(int32 i=0; i<256 && closestDistance>0; i++)
+		{
+			int32 distance=color_distance(palette[i],red,green,blue);
+			if(distance<closestDistance)
+			{
+				closest=i;
+				closestDistance=distance;
+			}
+		}
+		map->index_map[color]=closest;
+	}
+	
+	// The middle of a cell can be closer to a color in a neighbouring cell than 
+	// to one inside it, so palette colors are made to map to a color in their 
+	// own cell. If there are several, the one closest to the middle stays.
+	for(int32 i=0; i<256; i++)
+	{
+		int32 cell=color_cell(palette[i]);
+		if(color_cell(palette[map->index_map[cell]])!=cell)
+			map->index_map[cell]=i;
+	}
+	
+	for(int32 i=0; i<256; i++)
+	{
+		rgb_color inverse;
+		SetRGBColor(&inverse,255-palette[i].red,255-palette[i].green,
+			255-palette[i].blue);
+		map->inversion_map[i]=FindClosestColor(palette,inverse);
+	}
+	
+	map->id++;
+}
+
+/*!
+	\brief Returns the system color map published by the app_server
+	\return The color map or NULL if the app_server doesn't publish one
+	
+	The map is mapped read-only into the team the first time this is called. 
+	The app_server updates it in place when the system palette changes.
+*/
+const color_map *CloneSystemColorMap(void)
+{
+	static const color_map *sMap=NULL;
+	static area_id sArea=-1;
+	
+	if(sArea<0)
+	{
+		area_id source=find_area(SYSTEM_COLOR_MAP_AREA);
+		if(source<0)
+			return NULL;
+		
+		void *address;
+		area_id area=clone_area("system_color_map clone",&address,B_ANY_ADDRESS,
+			B_READ_AREA,source);
+		if(area<0)
+			return NULL;
+		
+		sMap=(const color_map*)address;
+		sArea=area;
+	}
+	
+	return sMap;
+}
+
+/*!
+	\brief Looks up the palette index for a color, using ordered dithering
+	\param map A color map set up by BuildColorMap()
+	\param color Color to match
+	\param x Horizontal position of the pixel
+	\param y Vertical position of the pixel
+	\return Index of the palette color to use for this pixel
+	
+	A 4x4 Bayer matrix adds an offset of up to half a step of the palette's color 
+	cube in either direction, so that areas of a color which isn't in the palette 
+	are drawn as a pattern of the colors around it.
+*/
+uint8 IndexForColorDithered(const color_map *map, rgb_color color, int32 x, int32 y)
+{
+	static const uint8 kBayer[4][4]=
+	{
+		{  0,  8,  2, 10 },
+		{ 12,  4, 14,  6 },
+		{  3, 11,  1,  9 },
+		{ 15,  7, 13,  5 }
+	};
+	
+	// the color cube has a step of 51 between levels
+	int32 offset=((int32)kBayer[y & 3][x & 3]*51 >> 4)-25;
+	
+	int32 red=color.red+offset, green=color.green+offset, blue=color.blue+offset;
+	rgb_color dithered;
+	SetRGBColor(&dithered,red<0 ? 0 : (red>255 ? 255 : red),
+		green<0 ? 0 : (green>255 ? 255 : green),
+		blue<0 ? 0 : (blue>255 ? 255 : blue),color.alpha);
+	
+	return IndexForColor(map,dithered);
+}
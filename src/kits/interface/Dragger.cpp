@@ -33,6 +33,7 @@
 #include <PopUpMenu.h>
 #include <Shelf.h>
 #include <Window.h>
+#include <InputState.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -206,6 +207,7 @@ BDragger::MouseDown(BPoint where)
 		get_click_speed(&click_speed);*/
 
 		bool drag = false;
+		int32 sequence = BPrivate::input_sequence();
 
 		while (true) {
 			BPoint where2;
@@ -221,7 +223,7 @@ BDragger::MouseDown(BPoint where)
 				break;
 			}
 
-			snooze(40000);
+			BPrivate::wait_for_input(&sequence, 40000);
 		}
 
 		if (drag) {
@@ -25,11 +25,21 @@
 //------------------------------------------------------------------------------
 #include <Rect.h>
 #include <stdio.h>
+#include <math.h>
 #include <Font.h>
+#include <Application.h>
+#include <Autolock.h>
+#include <List.h>
+#include <Locker.h>
 #include <PortLink.h>
+#include <AppServerLink.h>
+#include <ServerProtocol.h>
+#include <FontEscapements.h>
 
 #include <string.h>
 
+using namespace BPrivate;
+
 
 //----------------------------------------------------------------------------------------
 //		Globals
@@ -44,6 +54,172 @@ const BFont *be_plain_font=&be_plain_bfont;
 const BFont *be_bold_font=&be_bold_bfont;
 const BFont *be_fixed_font=&be_fixed_bfont;
 
+// Escapement tables this team has looked up, by family and style code, face and size
+struct escapement_lookup
+{
+	uint32 code;
+	uint16 face;
+	int32 size;
+	const escapement_table *table;
+	escapement_lookup *next;
+};
+
+// An escapement area of the app_server and where this team has cloned it
+struct escapement_clone
+{
+	area_id source;
+	const uint8 *address;
+};
+
+#define ESCAPEMENT_LOOKUP_BUCKETS 64
+
+// Entries are only ever added in front of a bucket, and never removed
+static escapement_lookup * volatile	gEscapementLookup[ESCAPEMENT_LOOKUP_BUCKETS];
+static int32				gEscapementLookupCount=0;
+static BList				gEscapementClones;
+static BLocker				gEscapementLock("escapement lookup");
+
+
+/*!
+	\brief Returns the escapement table the app_server draws a font with
+	\param code Family and style code of the font
+	\param face Face of the font
+	\param size Size of the font
+	\return The table or NULL if the server can't provide one
+	
+	The tables live in areas the app_server shares read-only with all teams. 
+	Once a table has been asked for, later lookups find it in a hash table of 
+	the tables this team has used, however many fonts and sizes that are, 
+	without locking or talking to the server, and the tables stay valid for as 
+	long as the server runs.
+*/
+static const escapement_table *get_escapements(uint32 code, uint16 face, float size)
+{
+	int32 pixels=int32(size);
+	if(pixels<1)
+		return NULL;
+	
+	escapement_lookup * volatile *bucket=&gEscapementLookup[(code ^ (face << 8)
+		^ (uint32(pixels) * 31)) % ESCAPEMENT_LOOKUP_BUCKETS];
+	escapement_lookup *first=*bucket;
+	for(escapement_lookup *entry=first; entry; entry=entry->next)
+	{
+		if(entry->code==code && entry->face==face && entry->size==pixels)
+			return entry->table;
+	}
+	
+	// Without an application there is no connection to the server
+	if(!be_app)
+		return NULL;
+	
+	BAutolock locker(gEscapementLock);
+	
+	// Another thread may have asked for the table in the meantime
+	for(escapement_lookup *entry=*bucket; entry!=first; entry=entry->next)
+	{
+		if(entry->code==code && entry->face==face && entry->size==pixels)
+			return entry->table;
+	}
+	
+	BAppServerLink link;
+	int32 reply=SERVER_FALSE;
+	area_id source=-1;
+	int32 offset=-1;
+	link.StartMessage(AS_GET_ESCAPEMENTS);
+	link.Attach<uint32>(code);
+	link.Attach<uint16>(face);
+	link.Attach<int32>(pixels);
+	if(link.FlushWithReply(&reply)<B_OK || reply!=SERVER_TRUE
+			|| link.Read<area_id>(&source)<B_OK || link.Read<int32>(&offset)<B_OK)
+		return NULL;
+	
+	// The server starts a new area whenever one is full; each is cloned once
+	escapement_clone *clone=NULL;
+	for(int32 i=0; i<gEscapementClones.CountItems(); i++)
+	{
+		escapement_clone *item=(escapement_clone*)gEscapementClones.ItemAt(i);
+		if(item->source==source)
+		{
+			clone=item;
+			break;
+		}
+	}
+	
+	if(!clone)
+	{
+		void *address;
+		if(clone_area("font_escapements clone",&address,B_ANY_ADDRESS,
+				B_READ_AREA,source)<0)
+			return NULL;
+		
+		clone=new escapement_clone;
+		clone->source=source;
+		clone->address=(const uint8*)address;
+		gEscapementClones.AddItem(clone);
+	}
+	
+	const escapement_table *table=(const escapement_table*)(clone->address+offset);
+	
+	// The entry is filled in before it's linked in, so readers never see half
+	// of it; the atomic count doubles as the memory barrier in between
+	escapement_lookup *entry=new escapement_lookup;
+	entry->code=code;
+	entry->face=face;
+	entry->size=pixels;
+	entry->table=table;
+	entry->next=*bucket;
+	atomic_add(&gEscapementLookupCount,1);
+	*bucket=entry;
+	
+	return table;
+}
+
+/*!
+	\brief Returns the number of bytes in the character a string starts with
+	\param string A UTF-8 string
+	\param length Number of bytes left in the string
+	\return The length of the character, at least 1
+*/
+static inline int32 char_length(const char *string, int32 length)
+{
+	int32 bytes=1;
+	while(bytes<length && (string[bytes] & 0xc0)==0x80)
+		bytes++;
+	return bytes;
+}
+
+/*!
+	\brief Adds up the advances of a string the way the app_server draws it
+	\param table Escapement table of the font
+	\param string The string
+	\param length Number of bytes to measure
+	\param kerning true to include kerning, for B_STRING_SPACING
+	\return The width in 26.6 fixed point
+*/
+static int32 escapement_width(const escapement_table *table, const char *string,
+	int32 length, bool kerning)
+{
+	int32 pen=0;
+	uint8 previous=0;
+	
+	for(int32 i=0; i<length && string[i]; i++)
+	{
+		uint8 c=(uint8)string[i];
+		if(kerning && i>0)
+			pen+=EscapementKerning(table,previous,c);
+		pen+=table->glyphs[c].advance;
+		previous=c;
+	}
+	return pen;
+}
+
+//! Modes for BFont::_GetEscapements_()
+enum
+{
+	ESCAPEMENTS_AS_FLOATS=0,
+	ESCAPEMENTS_AS_POINTS
+};
+
 
 /*!
 	\brief Private function used by Be. Exists only for compatibility. Does nothing.
@@ -312,9 +488,7 @@ void BFont::GetFamilyAndStyle(font_family *family, font_style *style) const
 
 uint32 BFont::FamilyAndStyle(void) const
 {
-	uint32 token;
-	token=(fFamilyID << 16) | fStyleID;
-	return 0L;
+	return (fFamilyID << 16) | fStyleID;
 }
 
 float BFont::Size(void) const
@@ -423,27 +597,48 @@ void BFont::GetTruncatedStrings(const char *stringArray[], int32 numStrings,
 	// TODO: implement
 }
 
+/*!
+	\brief Returns the width of a string in pixels
+	\param string The string to measure
+	\return The width the app_server will draw the string with
+*/
 float BFont::StringWidth(const char *string) const
 {
-	// TODO: implement
-
- 	// an estimate
- 	return (fHeight.ascent - fHeight.descent) * strlen(string);
+	if(!string)
+		return 0.0;
+	return StringWidth(string,strlen(string));
 }
 
-
+/*!
+	\brief Returns the width of a string in pixels
+	\param string The string to measure
+	\param length Number of bytes to measure
+	\return The width the app_server will draw the string with
+*/
 float BFont::StringWidth(const char *string, int32 length) const
 {
-	// TODO: implement
-
- 	// an estimate
- 	return (fHeight.ascent - fHeight.descent) * length;
+	if(!string || length<1)
+		return 0.0;
+	
+	const escapement_table *table=get_escapements(FamilyAndStyle(),fFace,fSize);
+	if(!table)
+	{
+		// an estimate, for when there is no app_server to ask
+		return (fHeight.ascent - fHeight.descent) * length;
+	}
+	
+	// to the nearest pixel, the way the app_server measures it
+	return (escapement_width(table,string,length,fSpacing==B_STRING_SPACING)+32)>>6;
 }
 
 void BFont::GetStringWidths(const char *stringArray[], const int32 lengthArray[], 
 		int32 numStrings, float widthArray[]) const
 {
-	// TODO: implement
+	if(!stringArray || !lengthArray || !widthArray)
+		return;
+	
+	for(int32 i=0; i<numStrings; i++)
+		widthArray[i]=StringWidth(stringArray[i],lengthArray[i]);
 }
 
 
@@ -458,73 +653,335 @@ int BFont::GetStringLength( const char* pzString, int nLength, float vWidth, boo
 	const char*        apzStrPtr[] = { pzString };
 	int                nMaxLength;
 
-	if ((float)nLength <= (vWidth / 9.0f))
-		return nLength;
-	else
-		return (vWidth / 9.0f);
-
 	GetStringLengths( apzStrPtr, &nLength, 1, vWidth, &nMaxLength, bIncludeLast );
 	return( nMaxLength );
 }
 
 
+/*!
+	\brief Finds how many bytes of each string fit into a width
+	\param apzStringArray The strings
+	\param anLengthArray Length of each string in bytes
+	\param nStringCount Number of strings
+	\param vWidth Width available
+	\param anMaxLengthArray Receives the number of bytes of each string that fit
+	\param bIncludeLast If true, the character which crosses the width is counted as well
+	
+	Only whole UTF-8 characters are counted.
+*/
 void BFont::GetStringLengths( const char** apzStringArray, const int* anLengthArray,
                                int nStringCount, float vWidth, int* anMaxLengthArray, bool bIncludeLast ) const
 {
+	if(!apzStringArray || !anLengthArray || !anMaxLengthArray)
+		return;
+	
+	const escapement_table *table=get_escapements(FamilyAndStyle(),fFace,fSize);
+	bool kerning=fSpacing==B_STRING_SPACING;
+	int32 limit=int32(vWidth*64);
+	int32 estimate=int32((fHeight.ascent - fHeight.descent)*64);
+	
+	for(int i=0; i<nStringCount; i++)
+	{
+		const char *string=apzStringArray[i];
+		int32 length=anLengthArray[i];
+		int32 pen=0;
+		int32 fits=0;
+		uint8 previous=0;
+		
+		while(fits<length && string[fits])
+		{
+			int32 bytes=char_length(string+fits,length-fits);
+			int32 end=pen;
+			
+			for(int32 j=fits; j<fits+bytes; j++)
+			{
+				uint8 c=(uint8)string[j];
+				if(!table)
+					end+=estimate;
+				else
+				{
+					if(kerning && j>0)
+						end+=EscapementKerning(table,previous,c);
+					end+=table->glyphs[c].advance;
+				}
+				previous=c;
+			}
+			
+			if(end>limit)
+			{
+				if(bIncludeLast && pen<limit)
+					fits+=bytes;
+				break;
+			}
+			
+			pen=end;
+			fits+=bytes;
+		}
+		
+		anMaxLengthArray[i]=fits;
+	}
+}
+
+/*!
+	\brief Gets the escapements of characters
+	\param charArray The characters, in UTF-8
+	\param numChars Number of characters
+	\param delta Escapement padding in pixels, added to each byte, or NULL
+	\param mode ESCAPEMENTS_AS_FLOATS or ESCAPEMENTS_AS_POINTS
+	\param escapements Receives the escapements, as fractions of the font size
+	\param offsets If non-NULL, receives the offset of each glyph, as points
+	
+	The app_server draws one glyph per byte, so the escapement of a character 
+	which takes several bytes is that of all its bytes.
+*/
+void BFont::_GetEscapements_(const char charArray[], int32 numChars, escapement_delta *delta,
+		uint8 mode, float *escapements, float *offsets) const
+{
+	if(!charArray || !escapements)
+		return;
+	
+	const escapement_table *table=get_escapements(FamilyAndStyle(),fFace,fSize);
+	int32 estimate=int32((fHeight.ascent - fHeight.descent)*64);
+	int32 space=delta ? int32(delta->space*64) : 0;
+	int32 nonspace=delta ? int32(delta->nonspace*64) : 0;
+	float scale=(fSize>0) ? 1.0/(64*fSize) : 0.0;
+	float cosine=1.0, sine=0.0;
+	
+	if(mode==ESCAPEMENTS_AS_POINTS && fRotation!=0)
+	{
+		cosine=cos(fRotation*M_PI/180);
+		sine=sin(fRotation*M_PI/180);
+	}
+	
+	int32 length=strlen(charArray);
+	int32 offset=0;
+	
+	for(int32 i=0; i<numChars; i++)
+	{
+		int32 advance=0;
+		if(offset<length)
+		{
+			int32 bytes=char_length(charArray+offset,length-offset);
+			for(int32 j=offset; j<offset+bytes; j++)
+			{
+				uint8 c=(uint8)charArray[j];
+				advance+=(table) ? table->glyphs[c].advance : estimate;
+				advance+=(c<=0x20) ? space : nonspace;
+			}
+			offset+=bytes;
+		}
+		
+		if(mode==ESCAPEMENTS_AS_POINTS)
+		{
+			escapements[2*i]=advance*scale*cosine;
+			escapements[2*i+1]=advance*scale*sine;
+			if(offsets)
+			{
+				offsets[2*i]=0.0;
+				offsets[2*i+1]=0.0;
+			}
+		}
+		else
+			escapements[i]=advance*scale;
+	}
 }
 
 void BFont::GetEscapements(const char charArray[], int32 numChars, float escapementArray[]) const
 {
-	// TODO: implement
+	_GetEscapements_(charArray,numChars,NULL,ESCAPEMENTS_AS_FLOATS,escapementArray);
 }
 
 void BFont::GetEscapements(const char charArray[], int32 numChars, escapement_delta *delta, 
 		float escapementArray[]) const
 {
-	// TODO: implement
+	_GetEscapements_(charArray,numChars,delta,ESCAPEMENTS_AS_FLOATS,escapementArray);
 }
 
 void BFont::GetEscapements(const char charArray[], int32 numChars, escapement_delta *delta, 
 		BPoint escapementArray[]) const
 {
-	// TODO: implement
+	_GetEscapements_(charArray,numChars,delta,ESCAPEMENTS_AS_POINTS,(float*)escapementArray);
 }
 
 void BFont::GetEscapements(const char charArray[], int32 numChars, escapement_delta *delta, 
 		BPoint escapementArray[], BPoint offsetArray[]) const
 {
-	// TODO: implement
+	_GetEscapements_(charArray,numChars,delta,ESCAPEMENTS_AS_POINTS,(float*)escapementArray,
+		(float*)offsetArray);
 }
 
+/*!
+	\brief Gets how far the glyphs of characters reach out of their escapements
+	\param charArray The characters, in UTF-8
+	\param numBytes Number of characters
+	\param edgeArray Receives the edges, as fractions of the font size
+	
+	The left edge is the space between the origin and the glyph, the right edge 
+	is how far the glyph sticks out past the next origin. Both are 0 when there 
+	is no app_server to ask.
+*/
 void BFont::GetEdges(const char charArray[], int32 numBytes, edge_info edgeArray[]) const
 {
-	// TODO: implement
+	if(!charArray || !edgeArray)
+		return;
+	
+	const escapement_table *table=get_escapements(FamilyAndStyle(),fFace,fSize);
+	float scale=(fSize>0) ? 1.0/(64*fSize) : 0.0;
+	int32 length=strlen(charArray);
+	int32 offset=0;
+	
+	for(int32 i=0; i<numBytes; i++)
+	{
+		edgeArray[i].left=0.0;
+		edgeArray[i].right=0.0;
+		if(offset>=length)
+			continue;
+		
+		int32 bytes=char_length(charArray+offset,length-offset);
+		if(table)
+		{
+			int32 pen=0, right=0;
+			for(int32 j=offset; j<offset+bytes; j++)
+			{
+				const escapement_glyph *glyph=&table->glyphs[(uint8)charArray[j]];
+				right=pen+glyph->right;
+				pen+=glyph->advance;
+			}
+			edgeArray[i].left=table->glyphs[(uint8)charArray[offset]].left*scale;
+			edgeArray[i].right=(right-pen)*scale;
+		}
+		offset+=bytes;
+	}
 }
 
 void BFont::GetHeight(font_height *height) const
 {
 	if(height)
 	{
-		*height=fHeight;
+		const escapement_table *table=get_escapements(FamilyAndStyle(),fFace,fSize);
+		*height=(table) ? table->height : fHeight;
+	}
+}
+
+/*!
+	\brief Gets the bounding boxes of the glyphs of characters
+	\param charArray The characters, in UTF-8
+	\param numChars Number of characters
+	\param mode Ignored, screen and printing metrics are the same
+	\param string_escapement If true, the boxes are placed where the characters 
+		are drawn in the string, otherwise each is relative to its own origin
+	\param delta Escapement padding in pixels, added to each byte, or NULL
+	\param boundingBoxArray Receives the boxes in pixels. Characters without 
+		a visible glyph get an invalid rect.
+*/
+void BFont::_GetBoundingBoxes_(const char charArray[], int32 numChars, font_metric_mode mode,
+		bool string_escapement, escapement_delta *delta, BRect boundingBoxArray[]) const
+{
+	if(!charArray || !boundingBoxArray)
+		return;
+	
+	const escapement_table *table=get_escapements(FamilyAndStyle(),fFace,fSize);
+	bool kerning=string_escapement && fSpacing==B_STRING_SPACING;
+	int32 space=delta ? int32(delta->space*64) : 0;
+	int32 nonspace=delta ? int32(delta->nonspace*64) : 0;
+	int32 length=strlen(charArray);
+	int32 offset=0;
+	int32 pen=0;
+	uint8 previous=0;
+	
+	for(int32 i=0; i<numChars; i++)
+	{
+		BRect box(0,0,-1,-1);
+		if(!string_escapement)
+			pen=0;
+		
+		int32 bytes=(offset<length) ? char_length(charArray+offset,length-offset) : 0;
+		for(int32 j=offset; j<offset+bytes && table; j++)
+		{
+			uint8 c=(uint8)charArray[j];
+			const escapement_glyph *glyph=&table->glyphs[c];
+			
+			pen+=(c<=0x20) ? space : nonspace;
+			if(kerning && j>0)
+				pen+=EscapementKerning(table,previous,c);
+			
+			if(glyph->right>glyph->left && glyph->bottom>glyph->top)
+			{
+				BRect glyphBox((pen+glyph->left)/64.0,glyph->top/64.0,
+					(pen+glyph->right)/64.0,glyph->bottom/64.0);
+				box=box.IsValid() ? (box | glyphBox) : glyphBox;
+			}
+			
+			pen+=glyph->advance;
+			previous=c;
+		}
+		
+		offset+=bytes;
+		boundingBoxArray[i]=box;
 	}
 }
 
 void BFont::GetBoundingBoxesAsGlyphs(const char charArray[], int32 numChars, font_metric_mode mode,
 		BRect boundingBoxArray[]) const
 {
-	// TODO: implement
+	_GetBoundingBoxes_(charArray,numChars,mode,false,NULL,boundingBoxArray);
 }
 
 void BFont::GetBoundingBoxesAsString(const char charArray[], int32 numChars, font_metric_mode mode,
 		escapement_delta *delta, BRect boundingBoxArray[]) const
 {
-	// TODO: implement
+	_GetBoundingBoxes_(charArray,numChars,mode,true,delta,boundingBoxArray);
 }
 
+/*!
+	\brief Gets the bounding box of each string as it is drawn
+	\param stringArray The strings, in UTF-8
+	\param numStrings Number of strings
+	\param mode Ignored, screen and printing metrics are the same
+	\param deltas Escapement padding for each string, or NULL
+	\param boundingBoxArray Receives the boxes in pixels, relative to the origin 
+		of each string
+*/
 void BFont::GetBoundingBoxesForStrings(const char *stringArray[], int32 numStrings,
 		font_metric_mode mode, escapement_delta deltas[], BRect boundingBoxArray[]) const
 {
-	// TODO: implement
+	if(!stringArray || !boundingBoxArray)
+		return;
+	
+	const escapement_table *table=get_escapements(FamilyAndStyle(),fFace,fSize);
+	bool kerning=fSpacing==B_STRING_SPACING;
+	
+	for(int32 i=0; i<numStrings; i++)
+	{
+		const char *string=stringArray[i];
+		int32 space=deltas ? int32(deltas[i].space*64) : 0;
+		int32 nonspace=deltas ? int32(deltas[i].nonspace*64) : 0;
+		int32 pen=0;
+		uint8 previous=0;
+		BRect box(0,0,-1,-1);
+		
+		for(int32 j=0; string && string[j] && table; j++)
+		{
+			uint8 c=(uint8)string[j];
+			const escapement_glyph *glyph=&table->glyphs[c];
+			
+			pen+=(c<=0x20) ? space : nonspace;
+			if(kerning && j>0)
+				pen+=EscapementKerning(table,previous,c);
+			
+			if(glyph->right>glyph->left && glyph->bottom>glyph->top)
+			{
+				BRect glyphBox((pen+glyph->left)/64.0,glyph->top/64.0,
+					(pen+glyph->right)/64.0,glyph->bottom/64.0);
+				box=box.IsValid() ? (box | glyphBox) : glyphBox;
+			}
+			
+			pen+=glyph->advance;
+			previous=c;
+		}
+		
+		boundingBoxArray[i]=box;
+	}
 }
 
 void BFont::GetGlyphShapes(const char charArray[], int32 numChars, BShape *glyphShapeArray[]) const
@@ -0,0 +1,139 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		InputState.cpp
+//	Description:	Reads the input state the app_server shares with clients
+//------------------------------------------------------------------------------
+
+// System Includes -------------------------------------------------------------
+#include <Autolock.h>
+#include <Locker.h>
+#include <OS.h>
+
+// Project Includes ------------------------------------------------------------
+#include <InputState.h>
+
+namespace BPrivate {
+
+static BLocker gInputStateLock("input state");
+static const input_state *gInputState = NULL;
+
+/*!
+	\brief Returns the shared input state, cloning its area the first time
+	\return The state or NULL if the app_server doesn't publish it
+*/
+static const input_state *shared_input_state(void)
+{
+	if(gInputState)
+		return gInputState;
+	
+	BAutolock locker(gInputStateLock);
+	if(gInputState)
+		return gInputState;
+	
+	area_id source=find_area(INPUT_STATE_AREA);
+	if(source<0)
+		return NULL;
+	
+	void *address;
+	if(clone_area("input_state clone",&address,B_ANY_ADDRESS,B_READ_AREA,source)<0)
+		return NULL;
+	
+	gInputState=(const input_state*)address;
+	return gInputState;
+}
+
+/*!
+	\brief Copies the current input state
+	\param state The copy
+	\return false if the app_server doesn't publish it
+*/
+bool get_input_state(input_state *state)
+{
+	const volatile input_state *shared=shared_input_state();
+	if(!shared)
+		return false;
+	
+	int32 sequence;
+	do
+	{
+		sequence=shared->sequence;
+		if(sequence & 1)
+			continue;
+		
+		state->sequence=sequence;
+		state->changed=shared->changed;
+		state->x=shared->x;
+		state->y=shared->y;
+		state->buttons=shared->buttons;
+		state->modifiers=shared->modifiers;
+		state->when=shared->when;
+	} while((sequence & 1) || sequence!=shared->sequence);
+	
+	return true;
+}
+
+/*!
+	\brief Returns the sequence number of the current input state
+	\return The number, or 0 if the app_server doesn't publish the state
+*/
+int32 input_sequence(void)
+{
+	const volatile input_state *shared=shared_input_state();
+	return shared ? shared->sequence & ~1 : 0;
+}
+
+/*!
+	\brief Waits until the input state changes
+	\param sequence The sequence number of the state the caller has seen. It is 
+	set to the number of the current state on return.
+	\param timeout The longest time to wait
+	\return true if the state changed, false if the time ran out
+	
+	Without a shared input state this just sleeps for \a timeout, which is how 
+	tracking loops used to poll the mouse.
+*/
+bool wait_for_input(int32 *sequence, bigtime_t timeout)
+{
+	const volatile input_state *shared=shared_input_state();
+	if(!shared)
+	{
+		snooze(timeout);
+		return false;
+	}
+	
+	bigtime_t deadline=system_time()+timeout;
+	while((shared->sequence & ~1)==*sequence)
+	{
+		// The server wakes up the threads waiting at the time of an update, 
+		// so a change that slips in just before we block costs one timeout
+		// at most. Left over releases only cause another look at the sequence.
+		bigtime_t left=deadline-system_time();
+		if(left<=0)
+			return false;
+		acquire_sem_etc(shared->changed,1,B_RELATIVE_TIMEOUT,left);
+	}
+	
+	*sequence=shared->sequence & ~1;
+	return true;
+}
+
+}	// namespace BPrivate
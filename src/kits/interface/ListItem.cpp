@@ -45,7 +45,8 @@
 
 //------------------------------------------------------------------------------
 BListItem::BListItem(uint32 level, bool expanded)
-	:	fWidth(0),
+	:	fOutlineNode(NULL),
+		fWidth(0),
 		fHeight(0),
 		fLevel(level),
 		fSelected(false),
@@ -58,6 +59,7 @@ BListItem::BListItem(uint32 level, bool expanded)
 //------------------------------------------------------------------------------
 BListItem::BListItem(BMessage *data)
 	:	BArchivable(data),
+		fOutlineNode(NULL),
 		fWidth(0),
 		fHeight(0),
 		fLevel(0),
@@ -26,6 +26,8 @@
 //------------------------------------------------------------------------------
 
 // Standard Includes -----------------------------------------------------------
+#include <math.h>
+#include <stdlib.h>
 
 // System Includes -------------------------------------------------------------
 #include <ListView.h>
@@ -40,27 +42,39 @@
 // Local Includes --------------------------------------------------------------
 
 // Local Defines ---------------------------------------------------------------
+// The item heights, rounded up as in ItemFrame(), and a Fenwick tree over
+// them: tree[i] is the sum of the heights of the items i - (i & -i) to
+// i - 1. The first count items are up to date.
+struct item_tops {
+	item_tops() : heights(NULL), tree(NULL), count(0), capacity(0) {}
+	~item_tops() { free(heights); free(tree); }
+
+	float	*heights;
+	float	*tree;
+	int32	count;
+	int32	capacity;
+};
 
 // Globals ---------------------------------------------------------------------
 static property_info prop_list[] =
 {
-	{ "Item", { B_COUNT_PROPERTIES, 0 }, { B_DIRECT_SPECIFIER, 0 },
-		"Returns the number of BListItems currently in the list." },
-	{ "Item", { B_EXECUTE_PROPERTY, 0 }, { B_INDEX_SPECIFIER, B_REVERSE_INDEX_SPECIFIER,
+	{ (char *)"Item", { B_COUNT_PROPERTIES, 0 }, { B_DIRECT_SPECIFIER, 0 },
+		(char *)"Returns the number of BListItems currently in the list." },
+	{ (char *)"Item", { B_EXECUTE_PROPERTY, 0 }, { B_INDEX_SPECIFIER, B_REVERSE_INDEX_SPECIFIER,
 		B_RANGE_SPECIFIER, B_REVERSE_RANGE_SPECIFIER, 0 },
-		"Select and invoke the specified items, first removing any existing selection." },
-	{ "Selection", { B_COUNT_PROPERTIES, 0 }, { B_DIRECT_SPECIFIER, 0 },
-		"Returns int32 count of items in the selection." },
-	{ "Selection", { B_EXECUTE_PROPERTY, 0 }, { B_DIRECT_SPECIFIER, 0 },
-		"Invoke items in selection." },
-	{ "Selection", { B_GET_PROPERTY, 0 }, { B_DIRECT_SPECIFIER, 0 },
-		"Returns int32 indices of all items in the selection." },
-	{ "Selection", { B_SET_PROPERTY, 0 }, { B_INDEX_SPECIFIER, B_REVERSE_INDEX_SPECIFIER,
+		(char *)"Select and invoke the specified items, first removing any existing selection." },
+	{ (char *)"Selection", { B_COUNT_PROPERTIES, 0 }, { B_DIRECT_SPECIFIER, 0 },
+		(char *)"Returns int32 count of items in the selection." },
+	{ (char *)"Selection", { B_EXECUTE_PROPERTY, 0 }, { B_DIRECT_SPECIFIER, 0 },
+		(char *)"Invoke items in selection." },
+	{ (char *)"Selection", { B_GET_PROPERTY, 0 }, { B_DIRECT_SPECIFIER, 0 },
+		(char *)"Returns int32 indices of all items in the selection." },
+	{ (char *)"Selection", { B_SET_PROPERTY, 0 }, { B_INDEX_SPECIFIER, B_REVERSE_INDEX_SPECIFIER,
 		B_RANGE_SPECIFIER, B_REVERSE_RANGE_SPECIFIER, 0 },
-		"Extends current selection or deselects specified items. Boolean field \"data\" "
+		(char *)"Extends current selection or deselects specified items. Boolean field \"data\" "
 		"chooses selection or deselection." },
-	{ "Selection", { B_SET_PROPERTY, 0 }, { B_DIRECT_SPECIFIER, 0 },
-		"Select or deselect all items in the selection. Boolean field \"data\" chooses "
+	{ (char *)"Selection", { B_SET_PROPERTY, 0 }, { B_DIRECT_SPECIFIER, 0 },
+		(char *)"Select or deselect all items in the selection. Boolean field \"data\" chooses "
 		"selection or deselection." },
 };
 
@@ -88,6 +102,8 @@ BListView::BListView(BMessage *archive)
 	fScrollView = NULL;
 	fTrack = NULL;
 
+	fItemTops = new item_tops;
+
 	fWidth = Bounds().Width();
 	
 	int32 i = 0;
@@ -131,6 +147,8 @@ BListView::~BListView()
 
 	if (fSelectMessage)
 		delete fSelectMessage;
+
+	delete fItemTops;
 }
 //------------------------------------------------------------------------------
 BArchivable *BListView::Instantiate(BMessage *archive)
@@ -174,12 +192,25 @@ status_t BListView::Archive(BMessage *archive, bool deep) const
 //------------------------------------------------------------------------------
 void BListView::Draw(BRect updateRect)
 {
-	for (int i = 0; i < CountItems(); i++)
+	// only the items from the one at the top of the update rect down to the
+	// bottom of it are drawn, no matter how long the list is
+	int32 count = CountItems();
+	int32 index = ItemIndexAt(updateRect.top);
+
+	if (index < 0)
+		return;
+
+	float width = Bounds().Width();
+
+	for (; index < count; index++)
 	{
-		BRect item_frame = ItemFrame(i);
+		BRect item_frame(0, ItemTop(index), width, ItemTop(index + 1) - 1);
+
+		if (item_frame.top > updateRect.bottom)
+			break;
 
 		if (item_frame.Intersects(updateRect))
-			DrawItem(((BListItem*)ItemAt(i)), item_frame);
+			DrawItem(ItemAt(index), item_frame);
 	}
 }
 //------------------------------------------------------------------------------
@@ -437,6 +468,8 @@ bool BListView::AddItem(BListItem *item, int32 index)
 	if (!fList.AddItem(item, index))
 		return false;
 
+	InvalidateItemTops(index);
+
 	if (fFirstSelected != -1 && index < fFirstSelected)
 		fFirstSelected++;
 
@@ -462,6 +495,8 @@ bool BListView::AddItem(BListItem *item)
 	if (!fList.AddItem(item))
 		return false;
 
+	InvalidateItemTops(CountItems() - 1);
+
 	if (Window())
 	{
 		BFont font;
@@ -481,7 +516,9 @@ bool BListView::AddList(BList *list, int32 index)
 	if (!fList.AddList(list, index))
 		return false;
 
-	int32 count = fList.CountItems();
+	InvalidateItemTops(index);
+
+	int32 count = list->CountItems();
 
 	if (fFirstSelected != -1 && index < fFirstSelected)
 		fFirstSelected += count;
@@ -526,6 +563,8 @@ BListItem *BListView::RemoveItem(int32 index)
 	if(!fList.RemoveItem(item))
 		return item;
 
+	InvalidateItemTops(index);
+
 	if (fFirstSelected != -1 && index < fFirstSelected)
 		fFirstSelected--;
 
@@ -619,17 +658,7 @@ int32 BListView::IndexOf(BListItem *item) const
 //------------------------------------------------------------------------------
 int32 BListView::IndexOf(BPoint point) const
 {
-	float y = 0.0f;
-
-	for (int i = 0; i < fList.CountItems(); i++)
-	{
-		y += ItemAt(i)->Height();
-
-		if ( point.y < y )
-			return i;
-	}
-
-	return -1;
+	return ItemIndexAt(point.y);
 }
 //------------------------------------------------------------------------------
 BListItem *BListView::FirstItem() const
@@ -656,6 +685,7 @@ void BListView::MakeEmpty()
 {
 	_DeselectAll(-1, -1);
 	fList.MakeEmpty();
+	InvalidateItemTops(0);
 	//virtual(&int32[2])
 	Invalidate();
 }
@@ -682,6 +712,8 @@ const BListItem **BListView::Items() const
 //------------------------------------------------------------------------------
 void BListView::InvalidateItem(int32 index)
 {
+	// the item may have changed its height
+	ItemHeightChanged(index);
 	Invalidate(Bounds() & ItemFrame(index));
 }
 //------------------------------------------------------------------------------
@@ -853,6 +885,7 @@ void BListView::SortItems(int (*cmp)(const void *, const void *))
 	}
 
 	fList.SortItems(cmp);
+	InvalidateItemTops(0);
 	Invalidate();
 }
 //------------------------------------------------------------------------------
@@ -909,12 +942,9 @@ BRect BListView::ItemFrame(int32 index)
 	if (index < 0 || index >= CountItems())
 		return frame;
 
-	for (int32 i = 0; i <= index; i++)
-	{
-		frame.top = frame.bottom + 1;
-		frame.bottom += (float)ceil(ItemAt(i)->Height());
-	}
-	
+	frame.top = ItemTop(index);
+	frame.bottom = ItemTop(index + 1) - 1;
+
 	return frame;
 }
 //------------------------------------------------------------------------------
@@ -935,7 +965,8 @@ BHandler *BListView::ResolveSpecifier(BMessage *msg, int32 index,
 status_t BListView::GetSupportedSuites( BMessage *data )
 {
 	data->AddString("suites", "suite/vnd.Be-list-view");
-	data->AddFlat("messages", &BPropertyInfo(prop_list));
+	BPropertyInfo propertyInfo(prop_list);
+	data->AddFlat("messages", &propertyInfo);
 	
 	return BView::GetSupportedSuites(data);
 }
@@ -1016,15 +1047,15 @@ bool BListView::DoMiscellaneous(MiscCode code, MiscData *data)
 		}
 		case B_REPLACE_OP:
 		{
-			return ReplaceItem(data->replace.index, data->replace.item);
+			return DoReplaceItem(data->replace.index, data->replace.item);
 		}
 		case B_MOVE_OP:
 		{
-			return MoveItem(data->move.from, data->move.to);
+			return DoMoveItem(data->move.from, data->move.to);
 		}
 		case B_SWAP_OP:
 		{
-			return SwapItems(data->swap.a, data->swap.b);
+			return DoSwapItems(data->swap.a, data->swap.b);
 		}
 	}
 
@@ -1050,11 +1081,12 @@ void BListView::InitObject(list_view_type type)
 	fSelectMessage = NULL;
 	fScrollView = NULL;
 	fTrack = NULL;
+	fItemTops = new item_tops;
 }
 //------------------------------------------------------------------------------
 void BListView::FixupScrollBar()
 {
-	BRect bounds, frame;
+	BRect bounds;
 	BScrollBar *vertScroller = ScrollBar(B_VERTICAL);
 
 	if (!vertScroller)
@@ -1063,13 +1095,7 @@ void BListView::FixupScrollBar()
 	bounds = Bounds();
 	int32 count = CountItems();
 
-	float y = 0;
-
-	for (int32 i = 0; i < count; i++)
-	{
-		frame = ItemFrame(i);
-		y += frame.Height();
-	}
+	float y = ItemTop(count);
 
 	if (bounds.Height() > y)
 	{
@@ -1100,6 +1126,8 @@ void BListView::FontChanged()
 
 	for (int i = 0; i < CountItems (); i ++)
 		ItemAt(i)->Update(this, &font);
+
+	InvalidateItemTops(0);
 }
 //------------------------------------------------------------------------------
 bool BListView::_Select(int32 index, bool extend)
@@ -1292,6 +1320,9 @@ bool BListView::DoSwapItems(int32 a, int32 b)
 	if (!fList.SwapItems(a, b))
 		return false;
 
+	ItemHeightChanged(a);
+	ItemHeightChanged(b);
+
 	Invalidate(ItemFrame(a));
 	Invalidate(ItemFrame(b));
 
@@ -1313,6 +1344,8 @@ bool BListView::DoMoveItem(int32 from, int32 to)
 	if (!fList.MoveItem(from, to))
 		return false;
 
+	InvalidateItemTops(min_c(from, to));
+
 	RescanSelection(from, to);
 
 	BRect frame = frameFrom | frameTo;
@@ -1330,6 +1363,8 @@ bool BListView::DoReplaceItem(int32 index, BListItem *item)
 	if (!fList.ReplaceItem(index, item))
 		return false;
 
+	ItemHeightChanged(index);
+
 	if (frame != ItemFrame(index))
 		InvalidateFrom(index);
 	else
@@ -1338,6 +1373,80 @@ bool BListView::DoReplaceItem(int32 index, BListItem *item)
 	return true;
 }
 //------------------------------------------------------------------------------
+/*!
+	\brief Removes a range of items at once
+	\param index Index of the first item
+	\param count Number of items to remove
+
+	Unlike RemoveItems(), which removes the items one by one, this moves the
+	items behind the range only once, and fixes the selection and the anchor
+	for all of them together. Removed items are deselected.
+*/
+void BListView::DoRemoveItems(int32 index, int32 count)
+{
+	if (index < 0 || count <= 0 || index >= CountItems())
+		return;
+
+	if (index + count > CountItems())
+		count = CountItems() - index;
+
+	int32 end = index + count;
+	bool selectionRemoved = false;
+
+	if (fFirstSelected != -1 && fFirstSelected < end && fLastSelected >= index)
+	{
+		for (int32 i = max_c(index, fFirstSelected); i <= min_c(end - 1, fLastSelected); i++)
+		{
+			if (ItemAt(i)->IsSelected())
+			{
+				ItemAt(i)->Deselect();
+				selectionRemoved = true;
+			}
+		}
+	}
+
+	fList.RemoveItems(index, count);
+	InvalidateItemTops(index);
+
+	if (fFirstSelected != -1)
+	{
+		if (fFirstSelected >= end)
+			fFirstSelected -= count;
+		else if (fFirstSelected >= index)
+			fFirstSelected = CalcFirstSelected(index);
+
+		if (fLastSelected >= end)
+			fLastSelected -= count;
+		else if (fLastSelected >= index)
+			fLastSelected = CalcLastSelected(index - 1);
+
+		if (fFirstSelected == -1 || fLastSelected == -1)
+			fFirstSelected = fLastSelected = -1;
+	}
+
+	if (fAnchorIndex >= end)
+		fAnchorIndex -= count;
+	else if (fAnchorIndex >= index)
+		fAnchorIndex = -1;
+
+	if (Window())
+	{
+		// everything below the first removed item moves up
+		BRect bounds = Bounds();
+		bounds.top = max_c(bounds.top, ItemTop(index));
+
+		FixupScrollBar();
+		if (bounds.IsValid())
+			Invalidate(bounds);
+	}
+
+	if (selectionRemoved)
+	{
+		SelectionChanged();
+		InvokeNotify(fSelectMessage, B_CONTROL_MODIFIED);
+	}
+}
+//------------------------------------------------------------------------------
 void BListView::RescanSelection(int32 from, int32 to)
 {
 	if (from > to)
@@ -1385,6 +1494,194 @@ void BListView::DoMouseMoved(BPoint where)
 {
 }
 //------------------------------------------------------------------------------
+/*!
+	\brief Marks the cached item positions after an item as out of date
+	\param index Index of the first item which was added, removed or moved
+	
+	The positions are brought up to date the next time they are needed. Items 
+	added to the end of the list are added to the tree one by one, otherwise 
+	it is built again, in linear time.
+*/
+void BListView::InvalidateItemTops(int32 index)
+{
+	if (index < 0)
+		index = 0;
+
+	// the tree of the items before stays valid
+	if (fItemTops->count > index)
+		fItemTops->count = index;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Updates the cached item positions for an item of a new height
+	\param index Index of the item
+*/
+void BListView::ItemHeightChanged(int32 index)
+{
+	item_tops *tops = fItemTops;
+	BListItem *item = ItemAt(index);
+
+	if (index < 0 || index >= tops->count || !item)
+		return;
+
+	float delta = (float)ceil(item->Height()) - tops->heights[index];
+
+	if (delta == 0.0f)
+		return;
+
+	tops->heights[index] += delta;
+
+	for (int32 i = index + 1; i <= tops->count; i += i & -i)
+		tops->tree[i] += delta;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Brings the cached item positions up to date
+	\return \c false if there was not enough memory for them
+*/
+bool BListView::ValidateItemTops() const
+{
+	item_tops *tops = fItemTops;
+	int32 count = CountItems();
+
+	if (tops->count == count)
+		return true;
+
+	if (tops->capacity < count)
+	{
+		int32 capacity = max_c(count, tops->capacity * 2);
+		float *heights = (float*)realloc(tops->heights, capacity * sizeof(float));
+
+		if (!heights)
+			return false;
+
+		tops->heights = heights;
+
+		float *tree = (float*)realloc(tops->tree, (capacity + 1) * sizeof(float));
+
+		if (!tree)
+			return false;
+
+		tops->tree = tree;
+		tops->capacity = capacity;
+	}
+
+	// with more new items than old ones, building it all again is cheaper
+	int32 first = tops->count;
+
+	if (count - first > first)
+		first = 0;
+
+	for (int32 i = first; i < count; i++)
+		tops->heights[i] = (float)ceil(ItemAt(i)->Height());
+
+	if (first == 0)
+	{
+		for (int32 i = 1; i <= count; i++)
+			tops->tree[i] = tops->heights[i - 1];
+
+		for (int32 i = 1; i <= count; i++)
+		{
+			int32 parent = i + (i & -i);
+
+			if (parent <= count)
+				tops->tree[parent] += tops->tree[i];
+		}
+	}
+	else
+	{
+		// the other items a node covers are covered by nodes before it
+		for (int32 i = first + 1; i <= count; i++)
+		{
+			float sum = tops->heights[i - 1];
+
+			for (int32 j = i - 1; j > i - (i & -i); j -= j & -j)
+				sum += tops->tree[j];
+
+			tops->tree[i] = sum;
+		}
+	}
+
+	tops->count = count;
+
+	return true;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Returns the top of an item in the view's coordinate system
+	\param index Index of the item, CountItems() for the bottom of the list
+	\return The top of the item
+*/
+float BListView::ItemTop(int32 index) const
+{
+	int32 count = CountItems();
+
+	if (index <= 0)
+		return 0.0f;
+
+	if (index > count)
+		index = count;
+
+	float top = 0.0f;
+
+	if (!ValidateItemTops())
+	{
+		// fall back to adding up the heights
+		for (int32 i = 0; i < index; i++)
+			top += (float)ceil(ItemAt(i)->Height());
+		return top;
+	}
+
+	for (int32 i = index; i > 0; i -= i & -i)
+		top += fItemTops->tree[i];
+
+	return top;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Finds the item at a vertical position
+	\param y The position in the view's coordinate system
+	\return The index of the item or -1 if there is no item at this position
+*/
+int32 BListView::ItemIndexAt(float y) const
+{
+	int32 count = CountItems();
+
+	if (count == 0 || y >= ItemTop(count))
+		return -1;
+
+	if (y < 0)
+		return 0;
+
+	if (!ValidateItemTops())
+	{
+		for (int32 i = 0; i < count; i++)
+			if (y < ItemTop(i + 1))
+				return i;
+		return -1;
+	}
+
+	// descend the tree to the last item with its top at or above y
+	int32 step = 1;
+
+	while (step * 2 <= count)
+		step *= 2;
+
+	int32 index = 0;
+	float top = 0.0f;
+
+	for (; step > 0; step /= 2)
+	{
+		if (index + step <= count && top + fItemTops->tree[index + step] <= y)
+		{
+			index += step;
+			top += fItemTops->tree[index];
+		}
+	}
+
+	return index;
+}
+//------------------------------------------------------------------------------
 
 /*
  * $Log $
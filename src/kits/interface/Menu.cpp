@@ -38,6 +38,34 @@
 #include <stdio.h>
 #define CALLED() printf("%s\n", __PRETTY_FUNCTION__);
 
+// How long _track() waits for a mouse event before asking where the mouse is.
+// Events only reach us while the mouse is over the menu's window.
+static const bigtime_t kTrackPollInterval = 50000;
+
+
+class _ExtraMenuData_
+{
+public:
+	_ExtraMenuData_()
+		:	invalidIndex(0),
+			trackSem(-1),
+			trackButtons(0),
+			trackEvent(false)
+	{
+	}
+
+	// First item whose frame is out of date, -1 if the layout is current.
+	// Items before it keep their frames, so a layout can start there.
+	int32	invalidIndex;
+
+	// Released by the mouse hooks while _track() runs, so it doesn't have
+	// to poll. The last event is kept for it, both under the window's lock.
+	sem_id	trackSem;
+	BPoint	trackWhere;
+	uint32	trackButtons;
+	bool	trackEvent;
+};
+
 #ifndef COMPILE_FOR_R5
 menu_info BMenu::sMenuInfo;
 #endif
@@ -195,6 +223,8 @@ BMenu::~BMenu()
 {
 	for (int i = 0; i < CountItems(); i++)
 		delete ItemAt(i);
+
+	delete fExtraMenuData;
 }
 
 
@@ -273,7 +303,10 @@ BMenu::AttachedToWindow()
 	CALLED();
 	BView::AttachedToWindow();
 
-	LayoutItems(0);
+	// Items added while we weren't in a window are laid out now, when the
+	// menu is first shown. A menu shown again keeps its layout.
+	if (fExtraMenuData->invalidIndex >= 0)
+		LayoutItems(fExtraMenuData->invalidIndex);
 }
 
 
@@ -302,9 +335,12 @@ BMenu::AddItem(BMenuItem *item, int32 index)
 	if (!err)
 		return err;
 
-	// Make sure we update the layout in case we are already attached.
+	InvalidateItemLayout(index);
+
+	// Make sure we update the layout in case we are already attached. Only
+	// the items from the new one on are moved, so appending is cheap.
 	if (Window() && fResizeToFit)
-		LayoutItems(index);
+		LayoutItems(fExtraMenuData->invalidIndex);
 
 	// Find the root menu window, so we can install this item.
 	BMenu *root = this;
@@ -312,7 +348,7 @@ BMenu::AddItem(BMenuItem *item, int32 index)
 		root = root->Supermenu();
 
 	if (root->Window())
-		Install(root->Window());
+		item->Install(root->Window());
 	
 	return err;
 }
@@ -378,23 +414,35 @@ bool
 BMenu::AddSeparatorItem()
 {
 	BMenuItem *item = new BSeparatorItem();
-	item->fSuper = this;
 	
-	return fItems.AddItem(item);
+	return AddItem(item);
 }
 
 
 bool
 BMenu::RemoveItem(BMenuItem *item)
 {
-	return fItems.RemoveItem(item);
+	return RemoveItem(IndexOf(item)) != NULL;
 }
 
 
 BMenuItem *
 BMenu::RemoveItem(int32 index)
 {
-	return static_cast<BMenuItem *>(fItems.RemoveItem(index));
+	BMenuItem *item = static_cast<BMenuItem *>(fItems.RemoveItem(index));
+
+	if (item) {
+		if (item == fSelected)
+			fSelected = NULL;
+
+		// the remaining items may be narrower, so they are all laid out again
+		InvalidateItemLayout(0);
+
+		if (Window() && fResizeToFit)
+			LayoutItems(0);
+	}
+
+	return item;
 }
 
 
@@ -408,11 +456,11 @@ BMenu::RemoveItems(int32 index, int32 count, bool del)
 bool
 BMenu::RemoveItem(BMenu *submenu)
 {
-	for (int i = 0; i < fItems.CountItems(); i++)
-		if (static_cast<BMenuItem *>(fItems.ItemAt(i))->Submenu() == submenu)
-			return fItems.RemoveItem(fItems.ItemAt(i));
+	int32 index = IndexOf(submenu);
+	if (index < 0)
+		return false;
 
-	return false;
+	return RemoveItem(index) != NULL;
 }
 
 
@@ -632,6 +680,38 @@ BMenu::MessageReceived(BMessage *msg)
 }
 
 
+void
+BMenu::MouseMoved(BPoint where, uint32 code, const BMessage *msg)
+{
+	if (fExtraMenuData->trackSem >= 0) {
+		int32 buttons = 0;
+		if (Window()->CurrentMessage())
+			Window()->CurrentMessage()->FindInt32("buttons", &buttons);
+
+		fExtraMenuData->trackWhere = where;
+		fExtraMenuData->trackButtons = buttons;
+		fExtraMenuData->trackEvent = true;
+		release_sem(fExtraMenuData->trackSem);
+	}
+
+	BView::MouseMoved(where, code, msg);
+}
+
+
+void
+BMenu::MouseUp(BPoint where)
+{
+	if (fExtraMenuData->trackSem >= 0) {
+		fExtraMenuData->trackWhere = where;
+		fExtraMenuData->trackButtons = 0;
+		fExtraMenuData->trackEvent = true;
+		release_sem(fExtraMenuData->trackSem);
+	}
+
+	BView::MouseUp(where);
+}
+
+
 void
 BMenu::KeyDown(const char *bytes, int32 numBytes)
 {
@@ -707,7 +787,7 @@ BMenu::Draw(BRect updateRect)
 {
 	CALLED();
 	DrawBackground(updateRect);
-	DrawItems(Bounds());
+	DrawItems(updateRect);
 }
 
 
@@ -748,6 +828,7 @@ BMenu::InvalidateLayout()
 {
 	CALLED();
 	CacheFontInfo();
+	InvalidateItemLayout(0);
 	LayoutItems(0);
 }
 
@@ -1040,6 +1121,8 @@ BMenu::operator=(const BMenu &)
 void
 BMenu::InitData(BMessage *data)
 {
+	fExtraMenuData = new _ExtraMenuData_;
+
 	BFont font;
 	font.SetFamilyAndStyle(sMenuInfo.f_family, sMenuInfo.f_style);
 	font.SetSize(sMenuInfo.font_size);
@@ -1099,29 +1182,49 @@ BMenu::_track(int *action, long start)
 {
 	CALLED();
 	BPoint location;
-	ulong buttons;
+	ulong buttons = 0;
 	BMenuItem *item = NULL;
-			
-	do {
+
+	fExtraMenuData->trackSem = create_sem(0, "menu tracking");
+	fExtraMenuData->trackEvent = false;
+
+	while (true) {
 		if (LockLooper()) {
-			GetMouse(&location, &buttons);
+			if (fExtraMenuData->trackEvent) {
+				location = fExtraMenuData->trackWhere;
+				buttons = fExtraMenuData->trackButtons;
+				fExtraMenuData->trackEvent = false;
+			} else
+				GetMouse(&location, &buttons);
+
 			item = HitTestItems(location);
 			 
 			if (item && fSelected != item) {
+				// only the two items involved are drawn again
 				SelectItem(item);
-				/*if (fSelected)
-					fSelected->Select(false);
-				fSelected = item;
-				item->Select(true);
-				*/
-				Invalidate();
 				Window()->UpdateIfNeeded();
 			}
 			
 			UnlockLooper();
 		}
-		snooze(50000);
-	} while (buttons != 0);
+
+		if (buttons == 0)
+			break;
+
+		// Wait for the next mouse event. Moves outside of our window don't
+		// reach us, so we look at the mouse now and then anyway.
+		if (acquire_sem_etc(fExtraMenuData->trackSem, 1, B_RELATIVE_TIMEOUT,
+				kTrackPollInterval) == B_OK) {
+			// events that came in meanwhile are covered by the last one
+			int32 count;
+			if (get_sem_count(fExtraMenuData->trackSem, &count) == B_OK && count > 0)
+				acquire_sem_etc(fExtraMenuData->trackSem, count, B_RELATIVE_TIMEOUT, 0);
+		}
+	}
+
+	sem_id sem = fExtraMenuData->trackSem;
+	fExtraMenuData->trackSem = -1;
+	delete_sem(sem);
 	
 	return item;
 }
@@ -1149,8 +1252,24 @@ BMenu::LayoutItems(int32 index)
 	float width, height;
 
 	ComputeLayout(index, true, true, &width, &height);
+	fExtraMenuData->invalidIndex = -1;
 
 	ResizeTo(width, height);
+
+	if (Window())
+		Invalidate();
+}
+
+
+/*!
+	\brief Notes that the frames of the items from \a index on are out of date
+	\param index Index of the first item whose frame changed
+*/
+void
+BMenu::InvalidateItemLayout(int32 index)
+{
+	if (fExtraMenuData->invalidIndex < 0 || index < fExtraMenuData->invalidIndex)
+		fExtraMenuData->invalidIndex = index;
 }
 
 
@@ -1161,28 +1280,49 @@ BMenu::ComputeLayout(int32 index, bool bestFit, bool moveItems,
 	BRect frame;
 	float iWidth, iHeight;
 	BMenuItem *item;
+	int32 count = fItems.CountItems();
+
+	// Starting in the middle needs the items before index to be where they
+	// belong, which is only known if we place the items ourselves.
+	if (!moveItems || index < 0 || index > count)
+		index = 0;
 
 	if (fLayout == B_ITEMS_IN_COLUMN) {
 		frame = BRect(0.0f, 0.0f, 0.0f, 2.0f);
 
-		for (int i = 0; i < fItems.CountItems(); i++) {
-			item = static_cast<BMenuItem *>(fItems.ItemAt(i));
+		if (index > 0) {
+			item = ItemAt(index - 1);
+			frame.right = item->fBounds.right;
+			frame.bottom = item->fBounds.bottom + 1.0f;
+		}
+
+		float oldRight = frame.right;
+
+		for (int32 i = index; i < count; i++) {
+			item = ItemAt(i);
 			
 			item->GetContentSize(&iWidth, &iHeight);
 
 			if (item->fModifiers && item->fShortcutChar)
 				iWidth += 25.0f;
 
-			item->fBounds.left = 2.0f;
-			item->fBounds.top = frame.bottom;
-			item->fBounds.bottom = item->fBounds.top + iHeight + fPad.top + fPad.bottom;
+			float bottom = frame.bottom + iHeight + fPad.top + fPad.bottom;
+
+			if (moveItems) {
+				item->fBounds.left = 2.0f;
+				item->fBounds.top = frame.bottom;
+				item->fBounds.bottom = bottom;
+			}
 
 			frame.right = max_c(frame.right, iWidth + fPad.left + fPad.right);
-			frame.bottom = item->fBounds.bottom + 1.0f;
+			frame.bottom = bottom + 1.0f;
 		}
 
-		for (int i = 0; i < fItems.CountItems(); i++)
-			ItemAt(i)->fBounds.right = frame.right;
+		// the items before index only need to be widened if the column grew
+		if (moveItems) {
+			for (int32 i = frame.right != oldRight ? 0 : index; i < count; i++)
+				ItemAt(i)->fBounds.right = frame.right;
+		}
 
 		frame.right = (float)ceil(frame.right) + 2.0f;
 		frame.bottom += 1.0f;
@@ -1193,21 +1333,36 @@ BMenu::ComputeLayout(int32 index, bool bestFit, bool moveItems,
 		frame = BRect(0.0f, 0.0f, 0.0f,
 			(float)ceil(fh.ascent) + (float)ceil(fh.descent) + fPad.top + fPad.bottom);
 
-		for (int i = 0; i < fItems.CountItems(); i++) {
-			item = static_cast<BMenuItem *>(fItems.ItemAt(i));
+		if (index > 0) {
+			item = ItemAt(index - 1);
+			frame.right = item->fBounds.right + 1.0f;
+			frame.bottom = max_c(frame.bottom, item->fBounds.bottom);
+		}
+
+		float oldBottom = frame.bottom;
+
+		for (int32 i = index; i < count; i++) {
+			item = ItemAt(i);
 			
 			item->GetContentSize(&iWidth, &iHeight);
 
-			item->fBounds.left = frame.right;
-			item->fBounds.top = 0.0f;
-			item->fBounds.right = item->fBounds.left + iWidth + fPad.left + fPad.right;
+			float right = frame.right + iWidth + fPad.left + fPad.right;
 
-			frame.right = item->fBounds.right + 1.0f;
+			if (moveItems) {
+				item->fBounds.left = frame.right;
+				item->fBounds.top = 0.0f;
+				item->fBounds.right = right;
+			}
+
+			frame.right = right + 1.0f;
 			frame.bottom = max_c(frame.bottom, iHeight + fPad.top + fPad.bottom);
 		}
 
-		for (int i = 0; i < fItems.CountItems(); i++)
-			ItemAt(i)->fBounds.bottom = frame.bottom;
+		// the items before index only need to be heightened if the row grew
+		if (moveItems) {
+			for (int32 i = frame.bottom != oldBottom ? 0 : index; i < count; i++)
+				ItemAt(i)->fBounds.bottom = frame.bottom;
+		}
 
 		frame.right = (float)ceil(frame.right) + 8.0f;
 	}
@@ -1412,6 +1567,24 @@ void
 BMenu::SelectItem(BMenuItem *m, uint32 showSubmenu,bool selectFirstItem)
 {
 	CALLED();
+	// disabled items can't be selected, unless they open a submenu
+	if (m && !m->IsEnabled() && !m->Submenu())
+		m = NULL;
+
+	if (m == fSelected)
+		return;
+
+	if (fSelected) {
+		fSelected->fSelected = false;
+		Invalidate(fSelected->Frame());
+	}
+
+	fSelected = m;
+
+	if (fSelected) {
+		fSelected->fSelected = true;
+		Invalidate(fSelected->Frame());
+	}
 }
 
 
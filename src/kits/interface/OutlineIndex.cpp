@@ -0,0 +1,446 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		OutlineIndex.cpp
+//	Description:	The full list of a BOutlineListView, indexed by position,
+//					visibility and outline level.
+//------------------------------------------------------------------------------
+
+// Standard Includes -----------------------------------------------------------
+#include <new>
+
+// System Includes -------------------------------------------------------------
+#include <ListItem.h>
+
+// Project Includes ------------------------------------------------------------
+#include <OutlineIndex.h>
+
+/*	The tree is a treap: it is ordered by position, and every node has a
+	random priority which is never lower than the ones of its children. This
+	keeps it balanced with a high probability, without any rotations.
+*/
+struct outline_node
+{
+	BListItem		*item;
+	outline_node	*left;
+	outline_node	*right;
+	outline_node	*parent;
+	uint32			priority;
+
+	// totals for the subtree of this node
+	int32			count;
+	int32			visible;
+	uint32			min_level;
+};
+
+static inline int32 node_count(const outline_node *node)
+{
+	return node ? node->count : 0;
+}
+
+static inline int32 node_visible(const outline_node *node)
+{
+	return node ? node->visible : 0;
+}
+
+//------------------------------------------------------------------------------
+inline int32 OutlineIndex::Visible(const BListItem *item)
+{
+	return item->IsItemVisible() ? 1 : 0;
+}
+//------------------------------------------------------------------------------
+//! Recalculates the totals of a node from its children
+void OutlineIndex::UpdateNode(outline_node *node)
+{
+	node->count = 1 + node_count(node->left) + node_count(node->right);
+	node->visible = Visible(node->item) + node_visible(node->left)
+		+ node_visible(node->right);
+	node->min_level = node->item->OutlineLevel();
+
+	if (node->left)
+	{
+		node->left->parent = node;
+		if (node->left->min_level < node->min_level)
+			node->min_level = node->left->min_level;
+	}
+
+	if (node->right)
+	{
+		node->right->parent = node;
+		if (node->right->min_level < node->min_level)
+			node->min_level = node->right->min_level;
+	}
+}
+
+//------------------------------------------------------------------------------
+//! Splits a tree into one with the first \a count items and one with the rest
+void OutlineIndex::SplitTree(outline_node *node, int32 count, outline_node **first,
+	outline_node **rest)
+{
+	if (!node)
+	{
+		*first = *rest = NULL;
+		return;
+	}
+
+	if (node_count(node->left) >= count)
+	{
+		SplitTree(node->left, count, first, &node->left);
+		*rest = node;
+	}
+	else
+	{
+		SplitTree(node->right, count - node_count(node->left) - 1, &node->right, rest);
+		*first = node;
+	}
+
+	UpdateNode(node);
+	node->parent = NULL;
+}
+
+//------------------------------------------------------------------------------
+//! Joins two trees, all items of \a first come before the ones of \a second
+outline_node *OutlineIndex::MergeTrees(outline_node *first, outline_node *second)
+{
+	if (!first)
+		return second;
+	if (!second)
+		return first;
+
+	if (first->priority > second->priority)
+	{
+		first->right = MergeTrees(first->right, second);
+		UpdateNode(first);
+		first->parent = NULL;
+		return first;
+	}
+
+	second->left = MergeTrees(first, second->left);
+	UpdateNode(second);
+	second->parent = NULL;
+	return second;
+}
+
+//------------------------------------------------------------------------------
+void OutlineIndex::FreeTree(outline_node *node, bool clearItems)
+{
+	if (!node)
+		return;
+
+	FreeTree(node->left, clearItems);
+	FreeTree(node->right, clearItems);
+
+	if (clearItems)
+		node->item->fOutlineNode = NULL;
+
+	delete node;
+}
+
+/*!
+	\brief Finds the first item at or after a position up to a given level
+	\param node Subtree to search
+	\param offset Position of the first item of the subtree
+	\param from First position to look at
+	\param level Highest outline level to look for
+	\return The position of the item or -1 if there is none
+
+	Subtrees without an item of a low enough level are skipped as a whole.
+*/
+static int32 first_up_to_level(const outline_node *node, int32 offset, int32 from,
+	uint32 level)
+{
+	if (!node || node->min_level > level || offset + node->count <= from)
+		return -1;
+
+	int32 result = first_up_to_level(node->left, offset, from, level);
+	if (result >= 0)
+		return result;
+
+	int32 position = offset + node_count(node->left);
+	if (position >= from && node->item->OutlineLevel() <= level)
+		return position;
+
+	return first_up_to_level(node->right, position + 1, from, level);
+}
+
+/*!
+	\brief Finds the last item before a position below a given level
+	\param node Subtree to search
+	\param offset Position of the first item of the subtree
+	\param before Position to look in front of
+	\param level The items' outline level has to be lower than this
+	\return The position of the item or -1 if there is none
+*/
+static int32 last_below_level(const outline_node *node, int32 offset, int32 before,
+	uint32 level)
+{
+	if (!node || node->min_level >= level || offset >= before)
+		return -1;
+
+	int32 position = offset + node_count(node->left);
+
+	int32 result = last_below_level(node->right, position + 1, before, level);
+	if (result >= 0)
+		return result;
+
+	if (position < before && node->item->OutlineLevel() < level)
+		return position;
+
+	return last_below_level(node->left, offset, before, level);
+}
+
+//------------------------------------------------------------------------------
+OutlineIndex::OutlineIndex(void)
+	:	fRoot(NULL),
+		fSeed(0x2545f491)
+{
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Frees the index, but not the items
+
+	The items aren't touched, as they may already have been deleted.
+*/
+OutlineIndex::~OutlineIndex(void)
+{
+	FreeTree(fRoot, false);
+}
+//------------------------------------------------------------------------------
+int32 OutlineIndex::CountItems(void) const
+{
+	return node_count(fRoot);
+}
+//------------------------------------------------------------------------------
+int32 OutlineIndex::CountVisibleItems(void) const
+{
+	return node_visible(fRoot);
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Inserts an item
+	\param item The item, which must not be in an outline list yet
+	\param index Position of the item in the full list
+	\return true if successful, false if out of memory or \a index is invalid
+
+	The item's outline level and visibility have to be set up before it is
+	added; changing them later requires a call to LevelChanged() or
+	SetItemVisible().
+*/
+bool OutlineIndex::AddItem(BListItem *item, int32 index)
+{
+	if (!item || index < 0 || index > CountItems())
+		return false;
+
+	outline_node *node = new(std::nothrow) outline_node;
+	if (!node)
+		return false;
+
+	// xorshift, which is good enough to keep the tree balanced
+	fSeed ^= fSeed << 13;
+	fSeed ^= fSeed >> 17;
+	fSeed ^= fSeed << 5;
+
+	node->item = item;
+	node->left = node->right = node->parent = NULL;
+	node->priority = fSeed;
+	UpdateNode(node);
+	item->fOutlineNode = node;
+
+	outline_node *first, *rest;
+	SplitTree(fRoot, index, &first, &rest);
+	fRoot = MergeTrees(MergeTrees(first, node), rest);
+
+	return true;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Removes the item at a position
+	\param index Position of the item in the full list
+	\return The item or NULL if \a index is invalid
+*/
+BListItem *OutlineIndex::RemoveItem(int32 index)
+{
+	if (index < 0 || index >= CountItems())
+		return NULL;
+
+	outline_node *first, *middle, *rest;
+	SplitTree(fRoot, index, &first, &middle);
+	SplitTree(middle, 1, &middle, &rest);
+	fRoot = MergeTrees(first, rest);
+
+	BListItem *item = middle->item;
+	item->fOutlineNode = NULL;
+	delete middle;
+
+	return item;
+}
+//------------------------------------------------------------------------------
+void OutlineIndex::MakeEmpty(void)
+{
+	FreeTree(fRoot, true);
+	fRoot = NULL;
+}
+//------------------------------------------------------------------------------
+BListItem *OutlineIndex::ItemAt(int32 index) const
+{
+	const outline_node *node = fRoot;
+
+	while (node)
+	{
+		int32 leftCount = node_count(node->left);
+
+		if (index < leftCount)
+			node = node->left;
+		else if (index == leftCount)
+			return node->item;
+		else
+		{
+			index -= leftCount + 1;
+			node = node->right;
+		}
+	}
+
+	return NULL;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Returns the position of an item in the full list
+	\param item The item to look for
+	\return The position or -1 if the item isn't in this index
+*/
+int32 OutlineIndex::IndexOf(const BListItem *item) const
+{
+	if (!item || !item->fOutlineNode)
+		return -1;
+
+	const outline_node *node = item->fOutlineNode;
+	int32 index = node_count(node->left);
+
+	for (; node->parent; node = node->parent)
+	{
+		if (node == node->parent->right)
+			index += node_count(node->parent->left) + 1;
+	}
+
+	// the item could belong to another outline list
+	return node == fRoot ? index : -1;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Returns the number of visible items before an item
+	\param item The item to look for
+	\return The position of the item in the list of visible items, if it's
+		visible itself, or -1 if the item isn't in this index
+*/
+int32 OutlineIndex::VisibleIndexOf(const BListItem *item) const
+{
+	if (!item || !item->fOutlineNode)
+		return -1;
+
+	const outline_node *node = item->fOutlineNode;
+	int32 index = node_visible(node->left);
+
+	for (; node->parent; node = node->parent)
+	{
+		if (node == node->parent->right)
+		{
+			index += node_visible(node->parent->left)
+				+ Visible(node->parent->item);
+		}
+	}
+
+	return node == fRoot ? index : -1;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Returns the number of visible items in front of a position
+	\param index Position in the full list, CountItems() counts all items
+*/
+int32 OutlineIndex::CountVisibleBefore(int32 index) const
+{
+	const outline_node *node = fRoot;
+	int32 visible = 0;
+
+	while (node)
+	{
+		int32 leftCount = node_count(node->left);
+
+		if (index <= leftCount)
+			node = node->left;
+		else
+		{
+			visible += node_visible(node->left) + Visible(node->item);
+			index -= leftCount + 1;
+			node = node->right;
+		}
+	}
+
+	return visible;
+}
+//------------------------------------------------------------------------------
+//! Changes the visibility of an item and updates the counts
+void OutlineIndex::SetItemVisible(BListItem *item, bool visible)
+{
+	if (item->IsItemVisible() == visible)
+		return;
+
+	item->SetItemVisible(visible);
+
+	for (outline_node *node = item->fOutlineNode; node; node = node->parent)
+	{
+		node->visible = Visible(node->item) + node_visible(node->left)
+			+ node_visible(node->right);
+	}
+}
+//------------------------------------------------------------------------------
+//! Has to be called after the outline level of an item changed
+void OutlineIndex::LevelChanged(BListItem *item)
+{
+	for (outline_node *node = item->fOutlineNode; node; node = node->parent)
+		UpdateNode(node);
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Returns the end of the subtree of an item
+	\param index Position of the item in the full list
+	\return Position of the first item after \a index which isn't one of its
+		subitems, or CountItems()
+*/
+int32 OutlineIndex::SubtreeEnd(int32 index) const
+{
+	BListItem *item = ItemAt(index);
+	if (!item)
+		return CountItems();
+
+	int32 end = first_up_to_level(fRoot, 0, index + 1, item->OutlineLevel());
+	return end < 0 ? CountItems() : end;
+}
+//------------------------------------------------------------------------------
+/*!
+	\brief Returns the superitem of an item
+	\param index Position of the item in the full list
+	\param level Outline level of the item
+	\return Position of the superitem or -1 if there is none
+*/
+int32 OutlineIndex::SuperitemIndex(int32 index, uint32 level) const
+{
+	return last_below_level(fRoot, 0, index, level);
+}
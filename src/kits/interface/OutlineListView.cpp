@@ -25,11 +25,13 @@
 //------------------------------------------------------------------------------
 
 // Standard Includes -----------------------------------------------------------
+#include <stdio.h>
 
 // System Includes -------------------------------------------------------------
 #include <OutlineListView.h>
 
 // Project Includes ------------------------------------------------------------
+#include <OutlineIndex.h>
 
 // Local Includes --------------------------------------------------------------
 
@@ -43,16 +45,25 @@ BOutlineListView::BOutlineListView(BRect frame, const char * name,
 								   uint32 flags)
 	:	BListView(frame, name, type, resizeMask, flags)
 {
+	fFullList = new OutlineIndex;
 }
 //------------------------------------------------------------------------------	
 BOutlineListView::BOutlineListView(BMessage *archive)
 	:	BListView(archive)
 {
+	fFullList = new OutlineIndex;
+
+	// BListView added the archived items to its own list only
+	for (int32 i = 0; i < CountItems(); i++)
+	{
+		ItemAt(i)->SetItemVisible(true);
+		fFullList->AddItem(ItemAt(i), i);
+	}
 }
 //------------------------------------------------------------------------------
 BOutlineListView::~BOutlineListView()
 {
-	fullList.MakeEmpty();
+	delete fFullList;
 }
 //------------------------------------------------------------------------------
 BArchivable *BOutlineListView::Instantiate(BMessage *archive)
@@ -139,56 +150,93 @@ void BOutlineListView::MouseUp(BPoint where)
 //------------------------------------------------------------------------------
 bool BOutlineListView::AddUnder(BListItem *item, BListItem *superitem)
 {
-	fullList.AddItem(item, FullListIndexOf(superitem) + 1);
+	int32 superIndex = FullListIndexOf(superitem);
 
-	item->fLevel = superitem->OutlineLevel() + 1;
-	superitem->fHasSubitems = true;
-
-	if (superitem->IsItemVisible() && superitem->IsExpanded())
-	{
-		item->SetItemVisible(true);
-
-		int32 index = BListView::IndexOf(superitem);
+	if (superIndex < 0)
+		return false;
 
-		BListView::AddItem(item, index + 1);
-		Invalidate(LatchRect(ItemFrame(index), superitem->OutlineLevel()));
-	}
-	else
-		item->SetItemVisible(false);
+	item->fLevel = superitem->OutlineLevel() + 1;
 
-	return true;
+	return BOutlineListView::AddItem(item, superIndex + 1);
 }
 //------------------------------------------------------------------------------
 bool BOutlineListView::AddItem(BListItem *item)
 {
-	bool result = fullList.AddItem(item);
-
-	if (!result)
-		return false;
-
-	return BListView::AddItem(item);
+	return BOutlineListView::AddItem(item, FullListCountItems());
 }
 //------------------------------------------------------------------------------
 bool BOutlineListView::AddItem(BListItem *item, int32 fullListIndex)
 {
 	if (fullListIndex < 0)
 		fullListIndex = 0;
-	else if (fullListIndex > CountItems())
-		fullListIndex = CountItems();
+	else if (fullListIndex > FullListCountItems())
+		fullListIndex = FullListCountItems();
 
-	fullList.AddItem(item, fullListIndex);
+	BListItem *super = NULL;
 
 	if (item->fLevel > 0)
+		super = SuperitemForIndex(fullListIndex, item->fLevel);
+
+	// the item is only shown if all its superitems are expanded
+	bool visible = super == NULL || (super->IsItemVisible() && super->IsExpanded());
+	item->SetItemVisible(visible);
+
+	if (!fFullList->AddItem(item, fullListIndex))
+		return false;
+
+	if (super && !super->fHasSubitems)
+	{
+		super->fHasSubitems = true;
+
+		// the latch has to be drawn
+		if (super->IsItemVisible() && Window())
+		{
+			int32 index = fFullList->VisibleIndexOf(super);
+			Invalidate(LatchRect(ItemFrame(index), super->OutlineLevel()));
+		}
+	}
+
+	if (visible && !BListView::AddItem(item, fFullList->VisibleIndexOf(item)))
+		return false;
+
+	// an item of a lower level takes over the items following it
+	int32 end = fFullList->SubtreeEnd(fullListIndex);
+
+	BListItem *previous = FullListItemAt(fullListIndex - 1);
+
+	if (previous && previous->fHasSubitems
+		&& previous->OutlineLevel() >= item->OutlineLevel())
+	{
+		previous->fHasSubitems = false;
+
+		if (previous->IsItemVisible() && Window())
+		{
+			int32 index = fFullList->VisibleIndexOf(previous);
+			Invalidate(LatchRect(ItemFrame(index), previous->OutlineLevel()));
+		}
+	}
+
+	if (end > fullListIndex + 1)
 	{
-		BListItem *super = SuperitemForIndex(fullListIndex, item->fLevel);
+		item->fHasSubitems = true;
+
+		// they were shown or hidden for their old superitems
+		int32 first = fFullList->CountVisibleBefore(fullListIndex + 1);
+		int32 count = fFullList->CountVisibleBefore(end) - first;
 
-		if (!super->IsItemVisible() || !super->IsExpanded())
-			return true;
+		for (int32 i = first; i < first + count; i++)
+			fFullList->SetItemVisible(ItemAt(i), false);
+
+		DoRemoveItems(first, count);
+
+		if (item->fExpanded)
+		{
+			item->fExpanded = false;
+			ExpandOrCollapse(item, true);
+		}
 	}
 
-	int32 list_index = FindPreviousVisibleIndex(fullListIndex);
-		
-	return BListView::AddItem(item, IndexOf(FullListItemAt(list_index)) + 1);
+	return true;
 }
 //------------------------------------------------------------------------------
 bool BOutlineListView::AddList(BList *newItems)
@@ -205,32 +253,12 @@ bool BOutlineListView::AddList(BList *newItems, int32 fullListIndex)
 //------------------------------------------------------------------------------
 bool BOutlineListView::RemoveItem(BListItem *item)
 {
-	if (!FullListHasItem(item))
-		return false;
-
-	fullList.RemoveItem(item);
-	if (item->fVisible)
-		BListView::RemoveItem(item);
-
-	// TODO: remove children
-
-	return true;
+	return RemoveCommon(FullListIndexOf(item)) != NULL;
 }
 //------------------------------------------------------------------------------
 BListItem *BOutlineListView::RemoveItem(int32 fullListIndex)
 {
-	BListItem *item = FullListItemAt(fullListIndex);
-
-	if (item == NULL)
-		return NULL;
-
-	fullList.RemoveItem(fullListIndex);
-	if (item->fVisible)
-		BListView::RemoveItem(item);
-
-	// TODO: remove children
-
-	return item;
+	return RemoveCommon(fullListIndex);
 }
 //------------------------------------------------------------------------------
 bool BOutlineListView::RemoveItems(int32 fullListIndex, int32 count)
@@ -242,37 +270,37 @@ bool BOutlineListView::RemoveItems(int32 fullListIndex, int32 count)
 //------------------------------------------------------------------------------
 BListItem *BOutlineListView::FullListItemAt(int32 fullListIndex) const
 {
-	return (BListItem*)fullList.ItemAt(fullListIndex);
+	return fFullList->ItemAt(fullListIndex);
 }
 //------------------------------------------------------------------------------
 int32 BOutlineListView::FullListIndexOf(BPoint point) const
 {
-	return BListView::IndexOf(point);
+	return FullListIndex(BListView::IndexOf(point));
 }
 //------------------------------------------------------------------------------
 int32 BOutlineListView::FullListIndexOf(BListItem *item) const
 {
-	return fullList.IndexOf(item);
+	return fFullList->IndexOf(item);
 }
 //------------------------------------------------------------------------------
 BListItem *BOutlineListView::FullListFirstItem() const
 {
-	return (BListItem*)fullList.FirstItem();
+	return fFullList->ItemAt(0);
 }
 //------------------------------------------------------------------------------
 BListItem *BOutlineListView::FullListLastItem() const
 {
-	return (BListItem*)fullList.LastItem();
+	return fFullList->ItemAt(fFullList->CountItems() - 1);
 }
 //------------------------------------------------------------------------------
 bool BOutlineListView::FullListHasItem(BListItem *item) const
 {
-	return fullList.HasItem(item);
+	return fFullList->IndexOf(item) >= 0;
 }
 //------------------------------------------------------------------------------
 int32 BOutlineListView::FullListCountItems() const
 {
-	return fullList.CountItems();
+	return fFullList->CountItems();
 }
 //------------------------------------------------------------------------------
 int32 BOutlineListView::FullListCurrentSelection(int32 index) const
@@ -281,33 +309,39 @@ int32 BOutlineListView::FullListCurrentSelection(int32 index) const
 	BListItem *item = BListView::ItemAt(i);
 
 	if (item)
-		return fullList.IndexOf(item);
+		return fFullList->IndexOf(item);
 	else
 		return -1;
 }
 //------------------------------------------------------------------------------
 void BOutlineListView::MakeEmpty()
 {
-	fullList.MakeEmpty();
+	fFullList->MakeEmpty();
 	BListView::MakeEmpty();
 }
 //------------------------------------------------------------------------------
 bool BOutlineListView::FullListIsEmpty() const
 {
-	return fullList.IsEmpty();
+	return fFullList->CountItems() == 0;
 }
 //------------------------------------------------------------------------------
 void BOutlineListView::FullListDoForEach(bool(*func)(BListItem *))
 {
-	printf("BOutlineListView::fullListDoForEach Not implemented\n");
-	//fullList.DoForEach(func);
+	for (int32 i = 0; i < FullListCountItems(); i++)
+	{
+		if (func(FullListItemAt(i)))
+			break;
+	}
 }
 //------------------------------------------------------------------------------
 void BOutlineListView::FullListDoForEach(bool (*func)(BListItem *, void *),
 										 void *data)
 {
-	printf("BOutlineListView::fullListDoForEach Not implemented\n");
-	//fullList.DoForEach(func, data);
+	for (int32 i = 0; i < FullListCountItems(); i++)
+	{
+		if (func(FullListItemAt(i), data))
+			break;
+	}
 }
 //------------------------------------------------------------------------------
 BListItem *BOutlineListView::Superitem(const BListItem *item)
@@ -322,76 +356,12 @@ BListItem *BOutlineListView::Superitem(const BListItem *item)
 //------------------------------------------------------------------------------
 void BOutlineListView::Expand(BListItem *item)
 {
-	if (!FullListHasItem(item))
-		return;
-
-	if (item->fExpanded)
-		return;
-
-	item->fExpanded = true;
-
-	uint32 level = item->fLevel, full_index = FullListIndexOf(item),
-		index = IndexOf(item) + 1, count = FullListCountItems() - full_index - 1;
-	BListItem **items = (BListItem**)fullList.Items() + full_index + 1;
-
-	BFont font;
-	GetFont(&font);
-
-	while (count-- > 0 && (*items)->fLevel > level)
-	{
-		if (!(*items)->IsItemVisible())
-		{
-			//BListView::AddItem((*items), index++);
-			fList.AddItem((*items), index++);
-			(*items)->Update(this,&font);
-			(*items)->SetItemVisible(true);
-		}
-
-		// Skip hidden children
-		if ((*items)->HasSubitems() && !(*items)->IsExpanded())
-		{
-			uint32 level = (*items)->fLevel;
-			items++;
-			
-			while (--count > 0 && (*items)->fLevel > level)
-				items++;
-		}
-		else
-			items++;
-	}
-
-	FixupScrollBar();
-	Invalidate();
+	ExpandOrCollapse(item, true);
 }
 //------------------------------------------------------------------------------
 void BOutlineListView::Collapse(BListItem *item)
 {
-	if (!FullListHasItem(item))
-		return;
-
-	if (!item->fExpanded)
-		return;
-
-	item->fExpanded = false;
-
-	uint32 level = item->fLevel, full_index = FullListIndexOf(item),
-		index = IndexOf(item) + 1, count = FullListCountItems() - full_index - 1;
-	BListItem **items = (BListItem**)fullList.Items() + full_index + 1;
-
-	while (count-- > 0 && (*items)->fLevel > level)
-	{
-		if ((*items)->IsItemVisible())
-		{
-			//BListView::RemoveItem ((*items));
-			fList.RemoveItem((*items));
-			(*items)->SetItemVisible(false);
-		}
-
-		items++;
-	}
-
-	FixupScrollBar();
-	Invalidate();
+	ExpandOrCollapse(item, false);
 }
 //------------------------------------------------------------------------------
 bool BOutlineListView::IsExpanded(int32 fullListIndex)
@@ -467,46 +437,21 @@ void BOutlineListView::SortItemsUnder(BListItem *underItem, bool oneLevelOnly,
 int32 BOutlineListView::CountItemsUnder(BListItem *underItem,
 									  bool oneLevelOnly) const
 {
-	int32 i = IndexOf(underItem);
+	int32 index = FullListIndexOf(underItem);
 
-	if (i == -1)
+	if (index == -1)
 		return 0;
 
-	int32 count = 0;
-
-	if (oneLevelOnly)
-	{
-		while (i < FullListCountItems())
-		{
-			BListItem *item = FullListItemAt(i);
-
-			// If we jump out of the subtree, return count
-			if (item->fLevel < underItem->OutlineLevel())
-				return count;
-
-			// If the level matches, increase count
-			if (item->fLevel == underItem->OutlineLevel() + 1)
-				count++;
-
-			i++;
-		}
-	}
-	else
-	{
-		while (i < FullListCountItems())
-		{
-			BListItem *item = FullListItemAt(i);
+	int32 end = fFullList->SubtreeEnd(index);
 
-			// If we jump out of the subtree, return count
-			if (item->fLevel < underItem->OutlineLevel())
-				return count;
+	if (!oneLevelOnly)
+		return end - index - 1;
 
-			// Increase count
-			count++;
+	// jump from one direct subitem to the next
+	int32 count = 0;
 
-			i++;
-		}
-	}
+	for (int32 i = index + 1; i < end; i = fFullList->SubtreeEnd(i))
+		count++;
 
 	return count;
 }
@@ -524,51 +469,20 @@ BListItem *BOutlineListView::EachItemUnder(BListItem *underItem,
 BListItem *BOutlineListView::ItemUnderAt(BListItem *underItem,
 										 bool oneLevelOnly, int32 index) const
 {
-	int32 i = IndexOf(underItem);
+	int32 i = FullListIndexOf(underItem);
 
-	if (i == -1)
+	if (i == -1 || index < 0)
 		return NULL;
 
-	if (oneLevelOnly)
-	{
-		while (i < FullListCountItems())
-		{
-			BListItem *item = FullListItemAt(i);
+	int32 end = fFullList->SubtreeEnd(i);
 
-			// If we jump out of the subtree, return NULL
-			if (item->fLevel < underItem->OutlineLevel())
-				return NULL;
+	if (!oneLevelOnly)
+		return i + 1 + index < end ? FullListItemAt(i + 1 + index) : NULL;
 
-			// If the level matches, check the index
-			if (item->fLevel == underItem->OutlineLevel() + 1)
-			{
-				if (index == 0)
-					return item;
-				else
-					index--;
-			}
-
-			i++;
-		}
-	}
-	else
+	for (i++; i < end; i = fFullList->SubtreeEnd(i))
 	{
-		while (i < FullListCountItems())
-		{
-			BListItem *item = FullListItemAt(i);
-
-			// If we jump out of the subtree, return NULL
-			if (item->fLevel < underItem->OutlineLevel())
-				return NULL;
-
-			// Check the index
-			if (index == 0)
-				return item;
-			else
-				index--;
-
-			i++;
-		}
+		if (index-- == 0)
+			return FullListItemAt(i);
 	}
 
 	return NULL;
@@ -609,8 +523,62 @@ int32 BOutlineListView::ListViewIndex(int32 index) const
 		return BListView::IndexOf(item);
 }
 //------------------------------------------------------------------------------
-void BOutlineListView::ExpandOrCollapse(BListItem *underItem, bool expand)
+/*!
+	\brief Shows or hides the subitems of an item
+	\param item The item to expand or collapse
+	\param expand true to expand the item, false to collapse it
+
+	Only the items which are shown or hidden are touched: subitems of
+	collapsed items are skipped as a whole, and they are added to or removed
+	from the visible list in one go.
+*/
+void BOutlineListView::ExpandOrCollapse(BListItem *item, bool expand)
 {
+	int32 fullIndex = FullListIndexOf(item);
+
+	if (fullIndex < 0 || item->fExpanded == expand)
+		return;
+
+	item->fExpanded = expand;
+
+	// the subitems of a hidden item stay hidden
+	if (!item->IsItemVisible())
+		return;
+
+	int32 index = fFullList->VisibleIndexOf(item);
+	int32 end = fFullList->SubtreeEnd(fullIndex);
+
+	if (expand)
+	{
+		BList items;
+
+		for (int32 i = fullIndex + 1; i < end;)
+		{
+			BListItem *subitem = FullListItemAt(i);
+
+			fFullList->SetItemVisible(subitem, true);
+			items.AddItem(subitem);
+
+			if (subitem->IsExpanded())
+				i++;
+			else
+				i = fFullList->SubtreeEnd(i);
+		}
+
+		BListView::AddList(&items, index + 1);
+	}
+	else
+	{
+		int32 count = fFullList->CountVisibleBefore(end) - index - 1;
+
+		for (int32 i = index + 1; i <= index + count; i++)
+			fFullList->SetItemVisible(ItemAt(i), false);
+
+		DoRemoveItems(index + 1, count);
+	}
+
+	if (Window())
+		Invalidate(LatchRect(ItemFrame(index), item->OutlineLevel()));
 }
 //------------------------------------------------------------------------------
 BRect BOutlineListView::LatchRect(BRect itemRect, int32 level) const
@@ -664,14 +632,58 @@ void BOutlineListView::DrawItem(BListItem *item, BRect itemRect, bool complete)
 	item->DrawItem(this, itemRect, complete);
 }
 //------------------------------------------------------------------------------
+/*!
+	\brief Removes an item and all its subitems
+	\param fullListIndex Index of the item in the full list
+	\return The item or NULL if the index is invalid
+
+	The subitems are removed from the list, but not deleted.
+*/
 BListItem *BOutlineListView::RemoveCommon(int32 fullListIndex)
 {
-	return NULL;
+	BListItem *item = FullListItemAt(fullListIndex);
+
+	if (item == NULL)
+		return NULL;
+
+	int32 end = fFullList->SubtreeEnd(fullListIndex);
+
+	if (item->IsItemVisible())
+	{
+		int32 index = fFullList->VisibleIndexOf(item);
+		int32 count = fFullList->CountVisibleBefore(end) - index;
+
+		DoRemoveItems(index, count);
+	}
+
+	int32 superIndex = -1;
+	if (item->fLevel > 0)
+		superIndex = fFullList->SuperitemIndex(fullListIndex, item->fLevel);
+
+	// from the back, so that the positions of the others don't change
+	for (int32 i = end - 1; i >= fullListIndex; i--)
+		fFullList->RemoveItem(i);
+
+	BListItem *super = FullListItemAt(superIndex);
+	BListItem *next = FullListItemAt(superIndex + 1);
+
+	if (super && (next == NULL || next->fLevel <= super->fLevel))
+	{
+		super->fHasSubitems = false;
+
+		if (super->IsItemVisible() && Window())
+		{
+			int32 index = fFullList->VisibleIndexOf(super);
+			Invalidate(LatchRect(ItemFrame(index), super->OutlineLevel()));
+		}
+	}
+
+	return item;
 }
 //------------------------------------------------------------------------------
 BListItem *BOutlineListView::RemoveOne(int32 fullListIndex)
 {
-	return NULL;
+	return RemoveCommon(fullListIndex);
 }
 //------------------------------------------------------------------------------
 void BOutlineListView::TrackInLatchItem(void *)
@@ -703,34 +715,20 @@ void BOutlineListView::CommonMoveItems(int32 from, int32 count, int32 to)
 //------------------------------------------------------------------------------
 BListItem *BOutlineListView::SuperitemForIndex(int32 fullListIndex, int32 level)
 {
-	BListItem *item;
-	fullListIndex--;
-
-	while (fullListIndex >= 0)
-	{
-		if ((item = FullListItemAt(fullListIndex))->OutlineLevel() <
-			(uint32)level)
-			return item;
-
-		fullListIndex--;
-	}
+	if (level <= 0)
+		return NULL;
 
-	return NULL;
+	return FullListItemAt(fFullList->SuperitemIndex(fullListIndex, level));
 }
 //------------------------------------------------------------------------------
 int32 BOutlineListView::FindPreviousVisibleIndex(int32 fullListIndex)
 {
-	fullListIndex--;
-
-	while (fullListIndex >= 0)
-	{
-		if (FullListItemAt(fullListIndex)->fVisible)
-			return fullListIndex;
+	int32 visible = fFullList->CountVisibleBefore(fullListIndex);
 
-		fullListIndex--;
-	}
+	if (visible == 0)
+		return -1;
 
-	return -1;
+	return FullListIndexOf(ItemAt(visible - 1));
 }
 //------------------------------------------------------------------------------
 
@@ -137,14 +137,14 @@ BPopUpMenu::MouseDown(BPoint point)
 void
 BPopUpMenu::MouseUp(BPoint point)
 {
-	BView::MouseUp(point);
+	BMenu::MouseUp(point);
 }
 
 
 void
 BPopUpMenu::MouseMoved(BPoint point, uint32 code, const BMessage *msg)
 {
-	BView::MouseMoved(point, code, msg);
+	BMenu::MouseMoved(point, code, msg);
 }
 
 
@@ -25,6 +25,7 @@
 //					for the proxy class BScreen (it interacts with the app server).
 //------------------------------------------------------------------------------
 
+#include <ColorUtils.h>
 #include <Window.h>
 #include <stdlib.h>
 
@@ -419,11 +420,9 @@ BPrivateScreen::BPrivateScreen()
 	fRetraceSem(-1),
 	fOwnsColorMap(false)
 {
-	// TODO: Get a pointer or a copy of the colormap from the app server
-	// if we only have one screen (one card, one monitor),
-	// it's better to get only a pointer (with BApplication::ro_offset_to_ptr() ?)
-	// otherwise every BApplication will keep a copy of the same colormap,
-	// and we would waste memory for nothing
+	// The app_server publishes the colormap in an area, which is shared by all
+	// teams instead of every BApplication keeping a copy of it
+	fColorMap = const_cast<color_map*>(CloneSystemColorMap());
 }
 
 
@@ -31,6 +31,7 @@
 // System Includes -------------------------------------------------------------
 #include <RadioButton.h>
 #include <Errors.h>
+#include <InputState.h>
 #include <Box.h>
 #include <Window.h>
 
@@ -247,10 +248,12 @@ void BRadioButton::MouseDown(BPoint point)
 	{
 		BRect bounds = Bounds();
 		uint32 buttons;
+		int32 sequence = BPrivate::input_sequence();
 
 		do
 		{
-			snooze(40000);
+			// sleep until the mouse changes, but not longer than we used to
+			BPrivate::wait_for_input(&sequence, 40000);
 
 			GetMouse(&point, &buttons, true);
 
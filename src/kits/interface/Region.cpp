@@ -25,23 +25,23 @@
 //
 //------------------------------------------------------------------------------
 
-//	Notes: As now, memory is always allocated and never freed (except on destruction,
-//	or sometimes when a copy is made).
-//  This let us be a bit faster since we don't do many reallocations.
+//	Notes: Regions of up to four rects are kept in the object itself and don't
+//	allocate any memory. Bigger ones allocate their rect array on the heap, and
+//	keep it (except on destruction) even when they shrink again.
+//	This let us be a bit faster since we don't do many reallocations.
 //	But that means that even an empty region could "waste" much space, if it contained
 //	many rects before being emptied.
-//	I.E: a region which contains 24 rects allocates more than 24 * 4 * sizeof(int32)
-//  = 96 * sizeof(int32) bytes. If we call MakeEmpty(), that region will contain no rects,
-//  but it will still keep the allocated memory.
 //	This shouldnt' be an issue, since usually BRegions are just used for calculations, 
 //	and don't last so long.
-//	Anyway, we can change that behaviour if we want, but BeOS's BRegion seems to behave exactly
-//	like this.
+//	The rects are kept in y-x banded form, see RegionSupport.h.
 
 
 // Standard Includes -----------------------------------------------------------
 #include <cstdlib>
 #include <cstring>
+#if __SSE2__
+#include <emmintrin.h>
+#endif
 
 // System Includes -------------------------------------------------------------
 #include <Debug.h>
@@ -52,16 +52,76 @@
 #include <RegionSupport.h>
 
 
+/*!	\brief Finds the first rect which reaches down to the given row.
+	\param rects The rects of a region, in banded form.
+	\param count The number of rects.
+	\param y The row.
+	\return The index of the first rect whose bottom is not above \a y,
+		or \a count if there is none.
+	
+	Since bands don't overlap, the bottoms of the rects never decrease, so
+	this can be a binary search.
+*/
+template<class T>
+static inline long
+find_first_rect(const clipping_rect *rects, long count, T y)
+{
+	long low = 0;
+	long high = count;
+	
+	while (low < high) {
+		long middle = (low + high) / 2;
+		if (rects[middle].bottom < y)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	
+	return low;
+}
+
+
+/*!	\brief Checks if any of the given rects intersects another one.
+	\param rects The rects to check. They must be valid.
+	\param count The number of rects.
+	\param rect The rect to check them against.
+*/
+static inline bool
+any_rect_intersects(const clipping_rect *rects, long count, const clipping_rect &rect)
+{
+#if __SSE2__
+	// Checks all four sides of a rect at once: its left and top against
+	// rect's right and bottom, and its right and bottom against rect's left and top.
+	// This needs 32 bit coordinates, the compiler drops the branch otherwise.
+	if (sizeof(clipping_rect) == sizeof(__m128i)) {
+		const __m128i other = _mm_setr_epi32(rect.right, rect.bottom, rect.left, rect.top);
+		
+		for (long c = 0; c < count; c++) {
+			__m128i current = _mm_loadu_si128((const __m128i *)&rects[c]);
+			int outside = (_mm_movemask_epi8(_mm_cmpgt_epi32(current, other)) & 0x00ff)
+				| (_mm_movemask_epi8(_mm_cmplt_epi32(current, other)) & 0xff00);
+			if (outside == 0)
+				return true;
+		}
+		return false;
+	}
+#endif
+	for (long c = 0; c < count; c++) {
+		if (rects_intersect(rects[c], rect))
+			return true;
+	}
+	return false;
+}
+
+
 /*! \brief Initializes a region. The region will have no rects,
 	and its bound will be invalid.
 */
 BRegion::BRegion()
 	:
-	data_size(8),
-	data(NULL)	
+	data_size(REGION_SMALL_DATA_SIZE(this)),
+	data(small_data)
 {
-	data = (clipping_rect *)malloc(data_size * sizeof(clipping_rect));
-
 	Support::ZeroRegion(this);
 }
 
@@ -71,18 +131,11 @@ BRegion::BRegion()
 */
 BRegion::BRegion(const BRegion &region)
 	:
-	data(NULL)
+	count(0),
+	data_size(REGION_SMALL_DATA_SIZE(this)),
+	data(small_data)
 {
-	bound = region.bound;
-	count = region.count;
-	data_size = region.data_size;
-	
-	if (data_size <= 0)
-		data_size = 1;
-		
-	data = (clipping_rect *)malloc(data_size * sizeof(clipping_rect));
-	
-	memcpy(data, region.data, count * sizeof(clipping_rect));
+	Support::CopyRegion(const_cast<BRegion *>(&region), this);
 }
 
 
@@ -91,11 +144,9 @@ BRegion::BRegion(const BRegion &region)
 */
 BRegion::BRegion(const BRect rect)
 	:
-	data_size(8),
-	data(NULL)	
+	data_size(REGION_SMALL_DATA_SIZE(this)),
+	data(small_data)
 {
-	data = (clipping_rect *)malloc(data_size * sizeof(clipping_rect));
-		
 	Set(rect);	
 }
 
@@ -104,7 +155,8 @@ BRegion::BRegion(const BRect rect)
 */
 BRegion::~BRegion()
 {
-	free(data);
+	if (data != small_data)
+		free(data);
 }
 
 
@@ -219,12 +271,13 @@ BRegion::Intersects(clipping_rect rect) const
 	if (!rects_intersect(rect, bound))
 		return false;
 
-	for (long c = 0; c < count; c++) {
-		if (rects_intersect(data[c], rect))
-			return true;
-	}
+	// Only the bands between rect's top and bottom can intersect it
+	long first = find_first_rect(data, count, rect.top);
+	long last = first;
+	while (last < count && data[last].top <= rect.bottom)
+		last++;
 	
-	return false;	
+	return any_rect_intersects(data + first, last - first, rect);
 }
 
 
@@ -240,7 +293,10 @@ BRegion::Contains(BPoint pt) const
 	if (!point_in(bound, pt))
 		return false;
 
-	for (long c = 0; c < count; c++) {
+	// Only the band containing the point's row needs to be checked.
+	// Its rects are sorted from left to right.
+	for (long c = find_first_rect(data, count, pt.y);
+			c < count && data[c].top <= pt.y && data[c].left <= pt.x; c++) {
 		if (point_in(data[c], pt))
 			return true;
 	}
@@ -260,7 +316,8 @@ BRegion::Contains(int32 x, int32 y)
 	if (!point_in(bound, x, y))
 		return false;
 
-	for (long c = 0; c < count; c++) {
+	for (long c = find_first_rect(data, count, y);
+			c < count && data[c].top <= y && data[c].left <= x; c++) {
 		if (point_in(data[c], x, y))
 			return true;
 	}
@@ -330,7 +387,7 @@ BRegion::Include(clipping_rect rect)
 	region.Set(rect);
 
 	Support::OrRegion(this, &region, &newRegion);
-	Support::CopyRegion(&newRegion, this);
+	Support::TakeRegion(&newRegion, this);
 }
 
 
@@ -343,7 +400,7 @@ BRegion::Include(const BRegion *region)
 	BRegion newRegion;
 	
 	Support::OrRegion(this, const_cast<BRegion *>(region), &newRegion);
-	Support::CopyRegion(&newRegion, this);
+	Support::TakeRegion(&newRegion, this);
 }
 
 
@@ -369,7 +426,7 @@ BRegion::Exclude(clipping_rect rect)
 	region.Set(rect);
 
 	Support::SubRegion(this, &region, &newRegion);
-	Support::CopyRegion(&newRegion, this);
+	Support::TakeRegion(&newRegion, this);
 }
 
 
@@ -382,7 +439,7 @@ BRegion::Exclude(const BRegion *region)
 	BRegion newRegion;
 
 	Support::SubRegion(this, const_cast<BRegion *>(region), &newRegion);
-	Support::CopyRegion(&newRegion, this);
+	Support::TakeRegion(&newRegion, this);
 }
 
 
@@ -395,7 +452,7 @@ BRegion::IntersectWith(const BRegion *region)
 	BRegion newRegion;
 
 	Support::AndRegion(this, const_cast<BRegion *>(region), &newRegion);
-	Support::CopyRegion(&newRegion, this);
+	Support::TakeRegion(&newRegion, this);
 }
 
 
@@ -406,92 +463,13 @@ BRegion::IntersectWith(const BRegion *region)
 BRegion &
 BRegion::operator=(const BRegion &region)
 {
-	if (&region != this) {
-		free(data);
-		bound = region.bound;
-		count = region.count;
-		data_size = region.data_size;
-		
-		if (data_size <= 0)
-			data_size = 1;
-			
-		data = (clipping_rect *)malloc(data_size * sizeof(clipping_rect));
-		
-		memcpy(data, region.data, count * sizeof(clipping_rect));
-	}
+	if (&region != this)
+		Support::CopyRegion(const_cast<BRegion *>(&region), this);
 	
 	return *this;
 }
 
 
-/*!	\brief Adds a rect to the region.
-	\param rect The clipping_rect to be added.
-
-	Adds the given rect to the region, merging it with another already contained in the region,
-	if possible. Recalculate the region's bounds if needed.
-*/
-void
-BRegion::_AddRect(clipping_rect rect)
-{
-	ASSERT(count >= 0);
-	ASSERT(data_size >= 0);
-	ASSERT(valid_rect(rect));
-
-	// Should we just reallocate the memory and
-	// copy the rect ?
-	bool addRect = true; 
-		
-	if (count > 0) {
-		// Wait! We could merge the rect with one of the
-		// existing rectangles, if it's adiacent.
-		// We just check it against the last rectangle, since
-		// we are keeping them sorted by their "top" coordinates.
-		long last = count - 1;
-		if (rect.left == data[last].left && rect.right == data[last].right
-				&& rect.top == data[last].bottom + 1) {
-
-			data[last].bottom = rect.bottom;
-			addRect = false;
-
-		} else if (rect.top == data[last].top && rect.bottom == data[last].bottom) {			
-			if (rect.left == data[last].right + 1) {
-
-				data[last].right = rect.right;
-				addRect = false;
-
-			} else if (rect.right == data[last].left - 1) {
-
-				data[last].left = rect.left;
-				addRect = false;
-			}	
-		}
-	}		
-
-	// We weren't lucky.... just add the rect as a new one
-	if (addRect) {
-		if (data_size <= count)
-			set_size(count + 16);
-			
-		data[count] = rect;
-		
-		count++;
-	}
-
-	// Recalculate bounds
-	if (rect.top < bound.top)
-		bound.top = rect.top;
-
-	if (rect.left < bound.left)
-		bound.left = rect.left;
- 
-	if (rect.right > bound.right)
-		bound.right = rect.right;
-
-	if (rect.bottom > bound.bottom)
-		bound.bottom = rect.bottom;
-}
-
-
 /*!	\brief Reallocate the memory in the region.
 	\param new_size The amount of rectangles that the region could contain.
 */
@@ -501,7 +479,16 @@ BRegion::set_size(long new_size)
 	if (new_size <= 0)
 		new_size = data_size + 16;
 
-	data = (clipping_rect *)realloc(data, new_size * sizeof(clipping_rect));
+	// we never give memory back
+	if (new_size <= data_size)
+		return;
+
+	if (data == small_data) {
+		data = (clipping_rect *)malloc(new_size * sizeof(clipping_rect));
+		if (data != NULL)
+			memcpy(data, small_data, count * sizeof(clipping_rect));
+	} else
+		data = (clipping_rect *)realloc(data, new_size * sizeof(clipping_rect));
 
 	if (data == NULL)
 		debugger("BRegion::set_size realloc error\n");
@@ -25,10 +25,8 @@
 //
 //------------------------------------------------------------------------------
 
-// TODO: check for possible performance issue in ROr() and RSub().
-// Check if inlining some methods can make us be faster.
-  
 // Standard Includes -----------------------------------------------------------
+#include <cstdlib>
 #include <cstring>
 #include <new>
 
@@ -41,8 +39,6 @@
 #include <RegionSupport.h>
 
 // Constants --------------------------------------------------------------------
-static const int32 kMaxPoints = 1024;
-static const int32 kMaxVerticalExtent = 0x10000000;
 static const int32 kMaxPositive = 0x7ffffffd;
 static const int32 kMaxNegative = 0x80000003;
 
@@ -60,6 +56,8 @@ static const int32 kMaxNegative = 0x80000003;
 using namespace std;
 
 
+
+
 /*!	\brief zeroes the given region, setting its rect count to 0,
 	and invalidating its bound rectangle.
 	\param region The region to be zeroed.
@@ -109,12 +107,11 @@ BRegion::Support::CopyRegion(BRegion *source, BRegion *dest)
 	ASSERT(dest);
 	ASSERT(source != dest);
 		
-	// If there is not enough memory, allocate
-	if (dest->data_size < source->count) {
-		free(dest->data);
-		dest->data_size = source->count + 8;
-		dest->data = (clipping_rect *)malloc(dest->data_size * sizeof(clipping_rect));
-	}
+	// If there is not enough memory, allocate.
+	// Emptying the region first avoids copying the old rects around.
+	dest->count = 0;
+	if (dest->data_size < source->count)
+		dest->set_size(source->count);
 	
 	dest->count = source->count;
 	
@@ -124,13 +121,48 @@ BRegion::Support::CopyRegion(BRegion *source, BRegion *dest)
 }
 
 
+/*!	\brief Moves the content of a region to another.
+	\param source The region to be moved. It's empty afterwards.
+	\param dest The destination region.
+	
+	Unlike CopyRegion(), this hands the source's rect array over to the
+	destination when the source had to allocate one.
+*/
+void
+BRegion::Support::TakeRegion(BRegion *source, BRegion *dest)
+{
+	CALLED();
+	ASSERT(source);
+	ASSERT(dest);
+	ASSERT(source != dest);
+	
+	if (source->data == source->small_data) {
+		CopyRegion(source, dest);
+		ZeroRegion(source);
+		return;
+	}
+	
+	if (dest->data != dest->small_data)
+		free(dest->data);
+	
+	dest->data = source->data;
+	dest->data_size = source->data_size;
+	dest->count = source->count;
+	dest->bound = source->bound;
+	
+	source->data = source->small_data;
+	source->data_size = REGION_SMALL_DATA_SIZE(source);
+	ZeroRegion(source);
+}
+
+
 /*!	\brief Modify the destination region to be the intersection of the two given regions.
 	\param first The first region to be intersected.
 	\param second The second region to be intersected.
 	\param dest The destination region.
 	
-	This function is a sort of method selector. It checks for some special
-	cases, then it calls the appropriate specialized function.
+	This function checks for some special cases which don't need
+	to look at the single rects, then it calls RegionOp().
 */
 void
 BRegion::Support::AndRegion(BRegion *first, BRegion *second, BRegion *dest)
@@ -149,15 +181,15 @@ BRegion::Support::AndRegion(BRegion *first, BRegion *second, BRegion *dest)
 		dest->data[0] = intersection;
 		dest->bound = intersection;
 		dest->count = 1;
-	} 
-	else if (first->count > 1 && second->count == 1)
-		AndRegion1ToN(second, first, dest);
+	}
+	else if (second->count == 1 && rect_contains(second->data[0], first->bound))
+		CopyRegion(first, dest);
 	
-	else if (first->count == 1 && second->count > 1)
-		AndRegion1ToN(first, second, dest);
+	else if (first->count == 1 && rect_contains(first->data[0], second->bound))
+		CopyRegion(second, dest);
 	
 	else
-		AndRegionComplex(first, second, dest);		
+		RegionOp(first, second, dest, OP_AND);
 }
 
 
@@ -166,8 +198,8 @@ BRegion::Support::AndRegion(BRegion *first, BRegion *second, BRegion *dest)
 	\param second The second region to be merged.
 	\param dest The destination region.
 	
-	This function is a sort of method selector. It checks for some special
-	cases, then it calls the appropriate specialized function.
+	This function checks for some special cases which don't need
+	to look at the single rects, then it calls RegionOp().
 */
 void
 BRegion::Support::OrRegion(BRegion *first, BRegion *second, BRegion *dest)
@@ -177,51 +209,30 @@ BRegion::Support::OrRegion(BRegion *first, BRegion *second, BRegion *dest)
 	ASSERT(second);
 	ASSERT(dest);
 	
-	BRegion *regionA, *regionB;		
+	if (second->count == 0)
+		CopyRegion(first, dest);
 	
-	// A little trick, to save some work...
-	if (first->count != 0) {
-		regionA = first;
-		regionB = second;
-	} else {
-		regionA = second;
-		regionB = first;
-	}
+	else if (first->count == 0)
+		CopyRegion(second, dest);
 	
-	if (regionB->count == 0)
-		CopyRegion(regionA, dest);
-	else {
-		if (regionB->bound.top > regionA->bound.bottom)
-			AppendRegion(regionA, regionB, dest);
-		
-		else if (regionA->bound.top > regionB->bound.bottom)
-			AppendRegion(regionB, regionA, dest);
-		
-		else if (regionA->bound.left > regionB->bound.right)
-			OrRegionNoX(regionB, regionA, dest);
-		
-		else if (regionB->bound.left > regionA->bound.right)
-			OrRegionNoX(regionA, regionB, dest);
-		
-		else if (regionA->count == 1)
-			OrRegion1ToN(regionA, regionB, dest);
-		
-		else if (regionB->count == 1)
-			OrRegion1ToN(regionB, regionA, dest);
-		
-		else 
-			OrRegionComplex(regionA, regionB, dest);		
-	}
+	else if (first->count == 1 && rect_contains(first->data[0], second->bound))
+		CopyRegion(first, dest);
+	
+	else if (second->count == 1 && rect_contains(second->data[0], first->bound))
+		CopyRegion(second, dest);
+	
+	else
+		RegionOp(first, second, dest, OP_OR);
 }
 
 
 /*!	\brief Modify the destination region to be the difference of the two given regions.
-	\param first The subtraend region.
-	\param second The minuend region.
+	\param first The minuend region.
+	\param second The subtrahend region.
 	\param dest The destination region.
 	
-	This function is a sort of method selector. It checks for some special
-	cases, then it calls the appropriate specialized function.
+	This function checks for some special cases which don't need
+	to look at the single rects, then it calls RegionOp().
 */
 void
 BRegion::Support::SubRegion(BRegion *first, BRegion *second, BRegion *dest)
@@ -236,701 +247,317 @@ BRegion::Support::SubRegion(BRegion *first, BRegion *second, BRegion *dest)
 		
 	else if (second->count == 0	|| !rects_intersect(first->bound, second->bound))
 		CopyRegion(first, dest);
+	
+	else if (second->count == 1 && rect_contains(second->data[0], first->bound))
+		ZeroRegion(dest);
 		
 	else
-		SubRegionComplex(second, first, dest);	
+		RegionOp(first, second, dest, OP_SUB);
 }
 
 
-/*!	\brief Cleanup the region, by merging rects that can be merged.
-	\param region The region to be cleaned.
+/*!	\brief Combines two regions band by band.
+	\param first The first region. Must not be empty.
+	\param second The second region. Must not be empty.
+	\param dest The destination region. Must be neither of the other two.
+	\param op The operation to perform.
+	
+	The bands of both regions are walked from top to bottom. Wherever only
+	one region has rects, they are copied or dropped depending on the
+	operation; where both of them have rects, the two bands are merged by
+	AndBand(), OrBand() or SubBand(). Every new band is coalesced with the
+	one above it when possible, so the result is in banded form again.
 */
 void
-BRegion::Support::CleanupRegion(BRegion *region)
+BRegion::Support::RegionOp(BRegion *first, BRegion *second, BRegion *dest, region_op op)
 {
 	CALLED();
+	ASSERT(first->count > 0);
+	ASSERT(second->count > 0);
+	ASSERT(dest != first && dest != second);
 	
-	long oldCount;
+	const bool appendFirst = op != OP_AND;
+	const bool appendSecond = op == OP_OR;
 	
-	do {
-		oldCount = region->count;
-		CleanupRegionVertical(region);
-		CleanupRegionHorizontal(region);
-	} while (region->count < oldCount);
-}
-
-
-/*!	\brief Cleanup the region vertically.
-	\param region The region to be cleaned.
-*/
-void
-BRegion::Support::CleanupRegionVertical(BRegion *region)
-{
-	CALLED();
+	const clipping_rect *r1 = first->data;
+	const clipping_rect *r1End = r1 + first->count;
+	const clipping_rect *r2 = second->data;
+	const clipping_rect *r2End = r2 + second->count;
+	const clipping_rect *r1BandEnd, *r2BandEnd;
 	
-	clipping_rect testRect = { 1, 1, -1, -2 };	
-	long newCount = -1;
-		
-	for (long x = 0; x < region->count; x++) {
-		clipping_rect &rect = region->data[x];
-					
-		if (rect.left == testRect.left && rect.right == testRect.right
-				&& rect.top == testRect.bottom + 1) {
-			
-			ASSERT(newCount >= 0);
-			region->data[newCount].bottom = rect.bottom;
-					
-		} else {
-			newCount++;
-			region->data[newCount] = region->data[x];
-			testRect = region->data[x]; 
-		}
-	}
-	region->count = newCount + 1;
-}
-
-
-/*!	\brief Cleanup the region horizontally.
-	\param region The region to be cleaned.
-*/
-void
-BRegion::Support::CleanupRegionHorizontal(BRegion *region)
-{
-	CALLED();
+	long prevBand = -1;
+	long curBand;
 	
-	clipping_rect testRect = { 1, 1, -2, -1 };
-	long newCount = -1;
-
-	for (long x = 0; x < region->count; x++) {
-		clipping_rect &rect = region->data[x];
-		
-		if (rect.top == testRect.top && rect.bottom == testRect.bottom
-					&& rect.left == testRect.right + 1) {
-			
-			ASSERT(newCount >= 0);
-			region->data[newCount].right = rect.right;
-							
-		} else {
-			newCount++;
-			region->data[newCount] = rect;
-		}				
-		testRect = region->data[newCount];
-	}
-	region->count = newCount + 1;
-}
-
-
-// Helper method to swap two rects
-static inline void
-SwapRects(clipping_rect &rect, clipping_rect &anotherRect)
-{
-	clipping_rect tmpRect;
-	tmpRect = rect;
-	rect = anotherRect;
-	anotherRect = tmpRect;
-}
-
-
-/*!	\brief Sorts the given rects by their top value.
-	\param rects A pointer to an array of clipping_rects.
-	\param count The number of rectangles in the array.
-*/
-void
-BRegion::Support::SortRects(clipping_rect *rects, long count)
-{
-	CALLED();
+	ZeroRegion(dest);
 	
-	bool again; //flag that tells we changed rects positions
-			
-	if (count == 2) {
-		if (rects[0].top > rects[1].top)
-			SwapRects(rects[0], rects[1]);
-		
-	} else if (count > 2) {
-		do {
-			again = false;
-			for (long c = 1; c < count; c++) {
-				if (rects[c - 1].top > rects[c].top) {
-					SwapRects(rects[c - 1], rects[c]);
-					again = true;
+	// Everything above 'yLast' has already been handled. Once a band has
+	// been partially handled, its top is above yLast.
+	int32 yLast = min_c(r1->top, r2->top);
+	int32 yTop, yBottom;
+	
+	while (r1 != r1End && r2 != r2End) {
+		for (r1BandEnd = r1; r1BandEnd != r1End && r1BandEnd->top == r1->top; r1BandEnd++)
+			;
+		for (r2BandEnd = r2; r2BandEnd != r2End && r2BandEnd->top == r2->top; r2BandEnd++)
+			;
+		
+		// First the part where only one of the regions has rects
+		if (r1->top < r2->top) {
+			if (appendFirst) {
+				yTop = max_c(r1->top, yLast);
+				yBottom = min_c(r1->bottom, r2->top - 1);
+				if (yTop <= yBottom) {
+					curBand = dest->count;
+					AppendBand(dest, r1, r1BandEnd, yTop, yBottom);
+					prevBand = Coalesce(dest, prevBand, curBand);
 				}
 			}
-		} while (again); 
-	}
-}
-
-
-// Helper methods to swap transition points in two given arrays
-static inline void
-SwapTrans(long *leftPoints, long *rightPoints, long index1, long index2)
-{
-	// First, swap the left points
-	long tmp = leftPoints[index1];
-	leftPoints[index1] = leftPoints[index2];
-	leftPoints[index2] = tmp;
-	
-	// then the right points
-	tmp = rightPoints[index1];
-	rightPoints[index1] = rightPoints[index2];
-	rightPoints[index2] = tmp;	
-}
-
-
-void
-BRegion::Support::SortTrans(long *lptr1, long *lptr2, long count)
-{
-	CALLED();
-	
-	bool again; //flag that tells we changed trans positions
-			
-	if (count == 2) {
-		if (lptr1[0] > lptr1[1])
-			SwapTrans(lptr1, lptr2, 0, 1);
-		
-	} else if (count > 2) {
-		do {
-			again = false;
-			for (long c = 1; c < count; c++) {
-				if (lptr1[c - 1] > lptr1[c]) {
-					SwapTrans(lptr1, lptr2, c - 1, c);
-					again = true;
+			yTop = r2->top;
+		} else if (r2->top < r1->top) {
+			if (appendSecond) {
+				yTop = max_c(r2->top, yLast);
+				yBottom = min_c(r2->bottom, r1->top - 1);
+				if (yTop <= yBottom) {
+					curBand = dest->count;
+					AppendBand(dest, r2, r2BandEnd, yTop, yBottom);
+					prevBand = Coalesce(dest, prevBand, curBand);
 				}
 			}
-		} while (again);	
+			yTop = r1->top;
+		} else
+			yTop = r1->top;
+		
+		// then the part they have in common, if any
+		yBottom = min_c(r1->bottom, r2->bottom);
+		if (yTop <= yBottom) {
+			curBand = dest->count;
+			switch (op) {
+				case OP_AND:
+					AndBand(dest, r1, r1BandEnd, r2, r2BandEnd, yTop, yBottom);
+					break;
+				case OP_OR:
+					OrBand(dest, r1, r1BandEnd, r2, r2BandEnd, yTop, yBottom);
+					break;
+				case OP_SUB:
+					SubBand(dest, r1, r1BandEnd, r2, r2BandEnd, yTop, yBottom);
+					break;
+			}
+			prevBand = Coalesce(dest, prevBand, curBand);
+		}
+		
+		yLast = yBottom + 1;
+		
+		if (r1->bottom == yBottom)
+			r1 = r1BandEnd;
+		if (r2->bottom == yBottom)
+			r2 = r2BandEnd;
 	}
-}
-
-
-/*!	\brief Copy a region to another, allocating some additional memory in the destination region.
-	\param source The region to be copied.
-	\param dest The destination region.
-	\param count Amount of additional memory to be allocated in the destination region.
-*/
-void
-BRegion::Support::CopyRegionMore(BRegion *source, BRegion *dest, long count)
-{
-	CALLED();
-	ASSERT(source);
-	ASSERT(dest);
-	ASSERT(source != dest);
 	
-	// If there is not enough memory, allocate
-	if (dest->data_size < source->count) {
-		free(dest->data);
-		dest->data_size = source->count + count;
-		dest->data = (clipping_rect *)malloc(dest->data_size * sizeof(clipping_rect));
+	// Now only one of the regions has bands left
+	if (appendFirst) {
+		while (r1 != r1End) {
+			for (r1BandEnd = r1; r1BandEnd != r1End && r1BandEnd->top == r1->top; r1BandEnd++)
+				;
+			curBand = dest->count;
+			AppendBand(dest, r1, r1BandEnd, max_c(r1->top, yLast), r1->bottom);
+			prevBand = Coalesce(dest, prevBand, curBand);
+			r1 = r1BandEnd;
+		}
 	}
 	
-	dest->count = source->count;
-	
-	// Copy rectangles and bounds.
-	memcpy(dest->data, source->data, source->count * sizeof(clipping_rect));
-	dest->bound = source->bound;
-}
-
-
-/*!	\brief Modify the destination region to be the intersection of the two given regions.
-	\param first The first region to be intersected.
-	\param second The second region to be intersected.
-	\param dest The destination region.
-	
-	Called by and_region() when the intersection is complex.
-*/	
-void
-BRegion::Support::AndRegionComplex(BRegion *first, BRegion *second, BRegion *dest)
-{
-	CALLED();
-	ASSERT(first);
-	ASSERT(second);
-	ASSERT(dest);
-		
-	ZeroRegion(dest);
-			
-	for (long f = 0; f < first->count; f++) {
-		for (long s = 0; s < second->count; s++) {
-			clipping_rect testRect = sect_rect(first->data[f], second->data[s]);
-			if (valid_rect(testRect))
-				dest->_AddRect(testRect);
+	if (appendSecond) {
+		while (r2 != r2End) {
+			for (r2BandEnd = r2; r2BandEnd != r2End && r2BandEnd->top == r2->top; r2BandEnd++)
+				;
+			curBand = dest->count;
+			AppendBand(dest, r2, r2BandEnd, max_c(r2->top, yLast), r2->bottom);
+			prevBand = Coalesce(dest, prevBand, curBand);
+			r2 = r2BandEnd;
 		}
 	}
-	
-	if (dest->count > 1)
-		SortRects(dest->data, dest->count);
 }
 
 
-/*!	\brief Modify the destination region to be the intersection of the two given regions.
-	\param first The first region to be intersected.
-	\param second The second region to be intersected.
-	\param dest The destination region.
+/*!	\brief Adds a rect at the end of the region and updates its bounds.
 	
-	Called by and_region() when one of the two region contains just one rect.
-*/	
+	The caller has to make sure the region stays in banded form.
+*/
 void
-BRegion::Support::AndRegion1ToN(BRegion *first, BRegion *second, BRegion *dest)
+BRegion::Support::AppendRect(BRegion *region, int32 left, int32 top, int32 right, int32 bottom)
 {
-	CALLED();
-	ASSERT(first);
-	ASSERT(second);
-	ASSERT(dest);
-	
-	// The easy case first: We already know that the regions intersect,
-	// so we check if the first region contains the second.
-	// If it's the case, the intersection is exactly the second region.
-	if (first->bound.top <= second->bound.top
-			&& first->bound.bottom >= second->bound.bottom
-			&& first->bound.left <= second->bound.left
-			&& first->bound.right >= second->bound.right)
-		CopyRegion(second, dest);
-	else {
-	// Otherwise, we check the rect of the first region against the rects
-	// of the second, and we add their intersections to the destination region
-		ZeroRegion(dest);
-		for (long x = 0; x < second->count; x++) {
-			clipping_rect testRect = sect_rect(first->data[0], second->data[x]);
-			if (valid_rect(testRect))
-				dest->_AddRect(testRect);
-		}
+	if (region->count >= region->data_size)
+		region->set_size(region->data_size * 2);
+	
+	clipping_rect *rect = &region->data[region->count++];
+	rect->left = left;
+	rect->top = top;
+	rect->right = right;
+	rect->bottom = bottom;
+	
+	if (region->count == 1) {
+		region->bound = *rect;
+		return;
 	}
+	
+	region->bound.bottom = bottom;
+	
+	if (left < region->bound.left)
+		region->bound.left = left;
+	if (right > region->bound.right)
+		region->bound.right = right;
 }
 
 
-/*!	\brief Modify the destination region to be the union of the two given regions.
-	\param first The first region to be or-ed.
-	\param second The second region to be or-ed.
-	\param dest The destination region.
-	
-	This function is called by or_region when the two regions don't intersect,
-	and when the second region top coordinate is bigger than first region's bottom
-	coordinate.
-*/
+//!	Appends the horizontal spans of a band, with new vertical extents.
 void
-BRegion::Support::AppendRegion(BRegion *first, BRegion *second, BRegion *dest)
+BRegion::Support::AppendBand(BRegion *region, const clipping_rect *r, const clipping_rect *rEnd,
+	int32 top, int32 bottom)
 {
-	CALLED();
-	ASSERT(first);
-	ASSERT(second);
-	ASSERT(dest);
-	
-	CopyRegion(first, dest);
-
-	for (long c = 0; c < second->count; c++)
-		dest->_AddRect(second->data[c]);	
+	for (; r != rEnd; r++)
+		AppendRect(region, r->left, top, r->right, bottom);
 }
 
 
-void
-BRegion::Support::ROr(long top, long bottom, BRegion *first, BRegion *second, BRegion *dest, long *indexA, long *indexB)
+/*!	\brief Merges the band starting at curStart into the one above it, if possible.
+	\param region The region.
+	\param prevStart Index of the first rect of the previous band, or -1.
+	\param curStart Index of the first rect of the band just added.
+	\return The index of the band the next one should be coalesced with.
+*/
+long
+BRegion::Support::Coalesce(BRegion *region, long prevStart, long curStart)
 {
-	CALLED();
-	
-	int32 stackLefts[kMaxPoints];
-	int32 stackRights[kMaxPoints];
-
-	int32 *lefts = stackLefts;
-	int32 *rights = stackRights;
+	long curCount = region->count - curStart;
 	
-	long i1 = *indexA;
-	long i2 = *indexB;
+	// Nothing was added, the previous band stays the previous one
+	if (curCount == 0)
+		return prevStart;
 	
-	*indexA = -1;
-	*indexB = -1;
+	if (prevStart < 0 || curStart - prevStart != curCount)
+		return curStart;
 	
-	long foundCount = 0;
-	long x = 0;
+	clipping_rect *prev = &region->data[prevStart];
+	clipping_rect *cur = &region->data[curStart];
 	
-	// allocate arrays on the heap, if the ones one the stack are too small
-	int32 *allocatedBuffer = NULL;
-	int32 maxCount = first->count - i1 + second->count - i2;
+	if (prev->bottom + 1 != cur->top)
+		return curStart;
 	
-	if (maxCount > kMaxPoints) {
-		RTRACE(("Stack space isn't sufficient. Allocating %ld bytes on the heap...\n",
-				2 * maxCount));
-		lefts = allocatedBuffer = new(nothrow) int32[2 * maxCount];
-		if (!allocatedBuffer)
-			return;
-		rights = allocatedBuffer + maxCount;
-	}
-
-	// Store left and right points to the appropriate array
-	for (x = i1; x < first->count; x++) {
-		
-		// Look if this rect can be used next time we are called, 
-		// thus correctly maintaining the "index" parameters.
-		if (first->data[x].bottom >= top && *indexA == -1)
-			*indexA = x;
-			
-		if (first->data[x].top <= top && first->data[x].bottom >= bottom) {
-			lefts[foundCount] = first->data[x].left;
-			rights[foundCount] = first->data[x].right;
-			foundCount++;	
-		} else if (first->data[x].top > bottom)
-			break;	
+	for (long i = 0; i < curCount; i++) {
+		if (prev[i].left != cur[i].left || prev[i].right != cur[i].right)
+			return curStart;
 	}
 	
-	if (*indexA == -1)
-		*indexA = i1;
-					
-	for (x = i2; x < second->count; x++) {
-		if (second->data[x].bottom >= top && *indexB == -1)
-			*indexB = x;
-		
-		if (second->data[x].top <= top && second->data[x].bottom >= bottom) {
-			lefts[foundCount] = second->data[x].left;
-			rights[foundCount] = second->data[x].right;
-			foundCount++;
-		} else if (second->data[x].top > bottom)
-			break;
-	}
+	for (long i = 0; i < curCount; i++)
+		prev[i].bottom = cur[i].bottom;
 	
-	if (*indexB == -1)
-		*indexB = i2;
-		
-	if (foundCount > 1)
-		SortTrans(lefts, rights, foundCount);
-	
-	ASSERT(foundCount > 0);
-	
-	clipping_rect rect;
-	rect.top = top;
-	rect.bottom = bottom;
-	
-	// Check if a rect intersects with the next one.
-	// If so, merge the two rects, if not, just add the rect.
-	long current = 0;
-	while (current < foundCount) {
-		long next = current + 1;
-		
-		rect.left = lefts[current];
-		rect.right = rights[current];
-		
-		while (next < foundCount && rect.right >= lefts[next]) {
-			if (rect.right < rights[next])
-				rect.right = rights[next];
-			next++;
-		}
-		
-		dest->_AddRect(rect);		
-		current = next;	
-	}
+	region->count = curStart;
 	
-	if (allocatedBuffer) {
-		RTRACE(("Freeing heap...\n"));
-		delete[] allocatedBuffer;
-	}
+	return prevStart;
 }
 
 
-/*! \brief Divides the plane into horizontal bands, then passes those bands to r_or
-	which does the real work.
-	\param first The first region to be or-ed.
-	\param second The second region to be or-ed.
-	\param dest The destination region.
-*/
+//!	Appends the intersection of two bands' spans.
 void
-BRegion::Support::OrRegionComplex(BRegion *first, BRegion *second, BRegion *dest)
+BRegion::Support::AndBand(BRegion *dest, const clipping_rect *r1, const clipping_rect *r1End,
+	const clipping_rect *r2, const clipping_rect *r2End, int32 top, int32 bottom)
 {
-	CALLED();
-	long a = 0, b = 0;
-	
-	int32 top;
-	int32 bottom = min_c(first->bound.top, second->bound.top) - 1;
-	do {
-		long x;
-		top = bottom + 1;
-		bottom = kMaxVerticalExtent;
-		
-		for (x = a; x < first->count; x++) {
-			int32 n = first->data[x].top - 1;
-			if (n >= top && n < bottom)
-				bottom = n;
-			if (first->data[x].bottom >= top && first->data[x].bottom < bottom)
-				bottom = first->data[x].bottom;
-		}	
-		
-		for (x = b; x < second->count; x++) {
-			int32 n = second->data[x].top - 1;
-			if (n >= top && n < bottom)
-				bottom = n;
-			if (second->data[x].bottom >= top && second->data[x].bottom < bottom)
-				bottom = second->data[x].bottom;
+	while (r1 != r1End && r2 != r2End) {
+		int32 left = max_c(r1->left, r2->left);
+		int32 right = min_c(r1->right, r2->right);
+		
+		if (left <= right)
+			AppendRect(dest, left, top, right, bottom);
+		
+		// drop the span which ends first, it can't intersect anything else
+		if (r1->right < r2->right)
+			r1++;
+		else if (r2->right < r1->right)
+			r2++;
+		else {
+			r1++;
+			r2++;
 		}
-		
-		// We can stand a region which extends to kMaxVerticalExtent, not more
-		if (bottom >= kMaxVerticalExtent)
-			break;
-		
-		ROr(top, bottom, first, second, dest, &a, &b);
-		
-	} while (true);
-	
-	CleanupRegion(dest);
-}
-
-
-/*!	\brief Modify the destination region to be the union of the two given regions.
-	\param first The first region to be or-ed.
-	\param second The second region to be or-ed.
-	\param dest The destination region.
-	
-	This function is called by or_region when one of the two regions contains just
-	one rect.
-*/
-void
-BRegion::Support::OrRegion1ToN(BRegion *first, BRegion *second, BRegion *dest)
-{
-	CALLED();
-	ASSERT(first);
-	ASSERT(second);
-	ASSERT(dest);
-
-	// The easy case first: if the first region contains the second,
-	// the union is exactly the first region, since its bound is the 
-	// only rectangle.
-	if (first->bound.top <= second->bound.top 
-			&& first->bound.bottom >= second->bound.bottom
-			&& first->bound.left <= second->bound.left
-			&& first->bound.right >= second->bound.right)
-		CopyRegion(first, dest);
-	else
-		OrRegionComplex(first, second, dest);
-}
-
-
-/*!	\brief Modify the destination region to be the union of the two given regions.
-	\param first The first region to be or-ed.
-	\param second The second region to be or-ed.
-	\param dest The destination region.
-	
-	This function is called by or_region when the two regions don't intersect.
-*/
-void
-BRegion::Support::OrRegionNoX(BRegion *first, BRegion *second, BRegion *dest)
-{
-	CALLED();
-	ASSERT(first);
-	ASSERT(second);
-	ASSERT(dest);
-
-	ZeroRegion(dest);
-	
-	long x;
-	
-	if (first->count == 0)
-		for (x = 0; x < second->count; x++)
-			dest->_AddRect(second->data[x]);
-	
-	else if (second->count == 0)
-		for (x = 0; x < first->count; x++)
-			dest->_AddRect(first->data[x]);
-	
-	else {
-		long f = 0, s = 0;
-
-		while (f < first->count && s < second->count) {
-			
-			if (first->data[f].top < second->data[s].top) {
-				dest->_AddRect(first->data[f]);
-				f++;
-			
-			} else {
-				dest->_AddRect(second->data[s]);
-				s++;
-			}
-		} 		
-		
-		if (f == first->count)
-			for (; s < second->count; s++)
-				dest->_AddRect(second->data[s]);
-
-		else if (s == second->count)
-			for (; f < first->count; f++)
-				dest->_AddRect(first->data[f]);
 	}
 }
 
 
-/*! \brief Divides the plane into horizontal bands, then passes those bands to r_sub
-	which does the real work.
-	\param first The subtraend region.
-	\param second The minuend region.
-	\param dest The destination region.
-*/
+//!	Appends the union of two bands' spans, merging the ones which overlap or touch.
 void
-BRegion::Support::SubRegionComplex(BRegion *first, BRegion *second, BRegion *dest)
+BRegion::Support::OrBand(BRegion *dest, const clipping_rect *r1, const clipping_rect *r1End,
+	const clipping_rect *r2, const clipping_rect *r2End, int32 top, int32 bottom)
 {
-	CALLED();
-	long a = 0, b = 0;
-	
-	int32 top;
-	int32 bottom = min_c(first->bound.top, second->bound.top) - 1;
-
-	do {
-		long x;
-		top = bottom + 1;
-		bottom = kMaxVerticalExtent;
-		
-		for (x = a; x < first->count; x++) {
-			int32 n = first->data[x].top - 1;
-			if (n >= top && n < bottom)
-				bottom = n;
-			if (first->data[x].bottom >= top && first->data[x].bottom < bottom)
-				bottom = first->data[x].bottom;
-		}	
-		
-		for (x = b; x < second->count; x++) {
-			int32 n = second->data[x].top - 1;
-			if (n >= top && n < bottom)
-				bottom = n;
-			if (second->data[x].bottom >= top && second->data[x].bottom < bottom)
-				bottom = second->data[x].bottom;
+	const clipping_rect *r;
+	int32 left = 0;
+	int32 right = 0;
+	bool pending = false;
+	
+	while (r1 != r1End || r2 != r2End) {
+		if (r2 == r2End || (r1 != r1End && r1->left < r2->left))
+			r = r1++;
+		else
+			r = r2++;
+		
+		if (!pending) {
+			left = r->left;
+			right = r->right;
+			pending = true;
+		} else if (r->left <= right + 1) {
+			if (r->right > right)
+				right = r->right;
+		} else {
+			AppendRect(dest, left, top, right, bottom);
+			left = r->left;
+			right = r->right;
 		}
-		
-		if (bottom >= kMaxVerticalExtent)
-			break;
-			
-		RSub(top, bottom, first, second, dest, &a, &b);
-		
-	} while (true);
+	}
 	
-	CleanupRegion(dest);
-}
-
-
-/*! \brief Converts the empty spaces between rectangles to rectangles,
-	and the rectangles to empty spaces.
-
-	Watch out!!! We write 1 element more than count, so be sure that the passed
-	arrays have the needed space
-*/
-static void
-InvertRectangles(long *lefts, long *rights, long count)
-{
-	long tmpLeft, tmpRight = kMaxNegative;
-	
-	for (int i = 0; i <= count; i++) {	
-		tmpLeft = lefts[i] - 1;
-		
-		lefts[i] = (i == 0) ? kMaxNegative : tmpRight;
-		tmpRight = rights[i] + 1;
-		
-		rights[i] = (i == count) ? kMaxPositive : tmpLeft;				
-	}	
+	if (pending)
+		AppendRect(dest, left, top, right, bottom);
 }
 
 
+//!	Appends the spans of the first band which are not covered by the second one.
 void
-BRegion::Support::RSub(long top, long bottom, BRegion *first, BRegion *second, BRegion *dest, long *indexA, long *indexB)
+BRegion::Support::SubBand(BRegion *dest, const clipping_rect *r1, const clipping_rect *r1End,
+	const clipping_rect *r2, const clipping_rect *r2End, int32 top, int32 bottom)
 {
-	CALLED();
-	
-	// TODO: review heap management 
-	int32 stackLeftsA[kMaxPoints / 2];
-	int32 stackLeftsB[kMaxPoints / 2];
-	int32 stackRightsA[kMaxPoints / 2];
-	int32 stackRightsB[kMaxPoints / 2];
-
-	int32 *leftsA = stackLeftsA;
-	int32 *leftsB = stackLeftsB;
-	int32 *rightsA = stackRightsA;
-	int32 *rightsB = stackRightsB;
-		
-	long i1 = *indexA;
-	long i2 = *indexB;
-	
-	*indexA = -1;
-	*indexB = -1;
-	
-	long foundA = 0;
-	long foundB = 0;
-	long x = 0;
-	
-	// allocate arrays on the heap, if the ones one the stack are too small
-	int32 *allocatedBuffer = NULL;
-	int32 maxCountA = first->count - i1;
-	int32 maxCountB = second->count - i2;
-	
-	if (maxCountA + maxCountB > kMaxPoints) {
-		RTRACE(("Stack space isn't sufficient. Allocating %ld bytes on the heap...\n",
-				2 * (maxCountA + maxCountB)));
-		leftsA = allocatedBuffer = new(nothrow) int32[2 * (maxCountA + maxCountB)];
-		if (!allocatedBuffer)
-			return;
-		rightsA = allocatedBuffer + maxCountA;
-		leftsB = rightsA + maxCountA;
-		rightsB = leftsB + maxCountB; 
-	}
-
-	// Store left and right points to the appropriate array
-	for (x = i1; x < first->count; x++) {		
-		// Look if this rect can be used next time we are called, 
-		// thus correctly maintaining the "index" parameters.
-		if (first->data[x].bottom >= top && *indexA == -1)
-			*indexA = x;
-			
-		if (first->data[x].top <= top && first->data[x].bottom >= bottom) {
-			leftsA[foundA] = first->data[x].left;
-			rightsA[foundA] = first->data[x].right;
-			foundA++;	
-		} else if (first->data[x].top > bottom)
-			break;	
-	}
-					
-	for (x = i2; x < second->count; x++) {
-		if (second->data[x].bottom >= top && *indexB == -1)
-			*indexB = x;
-		
-		if (second->data[x].top <= top && second->data[x].bottom >= bottom) {
-			leftsB[foundB] = second->data[x].left;
-			rightsB[foundB] = second->data[x].right;
-			foundB++;
-		} else if (second->data[x].top > bottom)
-			break;
-	}
-	
-	if (*indexA == -1)
-		*indexA = i1;
-	if (*indexB == -1)
-		*indexB = i2;
-	
-	if (foundA > 1)
-		SortTrans(leftsA, rightsA, foundA);
-	
-	if (foundB > 1)
-		SortTrans(leftsB, rightsB, foundB);
-
-	// No minuend's rect, just add all the subtraend's rects.
-	if (foundA == 0) {
-		for (x = 0; x < foundB; x++) {
-			clipping_rect rect = { leftsB[x], top, rightsB[x], bottom };
-			dest->_AddRect(rect);
-		}
-	} else if (foundB > 0) {
-		
-		InvertRectangles(leftsA, rightsA, foundA);
-		
-		clipping_rect A, B;
-		A.top = B.top = top;
-		A.bottom = B.bottom = bottom;
-		
-		for (long f = 0; f <= foundA; f++) {
-			for (long s = 0; s < foundB; s++) {
-				A.left = leftsA[f];
-				A.right = rightsA[f];
-				
-				B.left = leftsB[s];
-				B.right = rightsB[s];
-				if (rects_intersect(A, B))
-					dest->_AddRect(sect_rect(A, B));
-			}
+	// 'left' is where the part of r1 which hasn't been handled yet starts
+	int32 left = r1->left;
+	
+	while (r1 != r1End && r2 != r2End) {
+		if (r2->right < left) {
+			// r2 is completely on the left, skip it
+			r2++;
+		} else if (r2->left <= left) {
+			// r2 covers the left part of what remains of r1
+			left = r2->right + 1;
+			if (left > r1->right) {
+				// r1 is gone; r2 might cover the next one too
+				if (++r1 != r1End)
+					left = r1->left;
+			} else
+				r2++;
+		} else if (r2->left <= r1->right) {
+			// r2 cuts a hole into r1
+			AppendRect(dest, left, top, r2->left - 1, bottom);
+			left = r2->right + 1;
+			if (left > r1->right) {
+				if (++r1 != r1End)
+					left = r1->left;
+			} else
+				r2++;
+		} else {
+			// r2 is completely on the right of r1
+			AppendRect(dest, left, top, r1->right, bottom);
+			if (++r1 != r1End)
+				left = r1->left;
 		}
 	}
-
-	if (allocatedBuffer) {
-		RTRACE(("Freeing heap...\n"));
-		delete[] allocatedBuffer;
+	
+	// whatever is left of the first band isn't covered
+	while (r1 != r1End) {
+		AppendRect(dest, left, top, r1->right, bottom);
+		if (++r1 != r1End)
+			left = r1->left;
 	}
 }
-
-
-#undef TRACE_REGION
@@ -34,6 +34,7 @@
 #include <Window.h>
 #include <Bitmap.h>
 #include <Errors.h>
+#include <InputState.h>
 
 // Project Includes ------------------------------------------------------------
 
@@ -448,13 +449,16 @@ void BSlider::MouseDown(BPoint point)
 	{
 		BPoint prevPt;
 		bool update;
+		int32 sequence = BPrivate::input_sequence();
 
 		while (buttons)
 		{
 			prevPt = pt;
 			update = false;
 
-			snooze(SnoozeAmount());
+			// the snooze amount is only the longest time between two looks
+			// at the mouse now, it's read again as soon as it moves
+			BPrivate::wait_for_input(&sequence, SnoozeAmount());
 			GetMouse(&pt, &buttons, true);
 
 			if (fOrientation == B_HORIZONTAL)
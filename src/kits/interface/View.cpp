@@ -64,6 +64,7 @@
 #include <AppServerLink.h>
 #include <PortLink.h>
 #include <ServerProtocol.h>
+#include <InputState.h>
 
 // Local Includes --------------------------------------------------------------
 #include <stdio.h>
@@ -388,8 +389,12 @@ STRACE(("BView(%s)::~BView()\n", this->Name()));
 
 	if (fPermanentState)
 		delete fPermanentState;
-	if (fState)
-		delete fState;
+	while (fState)
+	{
+		ViewAttr	*state = fState;
+		fState		= state->previous;
+		delete state;
+	}
 
 	if(pr_state)
 		free( pr_state );
@@ -400,26 +405,9 @@ STRACE(("BView(%s)::~BView()\n", this->Name()));
 
 BRect BView::Bounds() const
 {
-	// if we have the actual coordiantes
-	if (fState->flags & B_VIEW_COORD_BIT)
-	if (owner)
-	{
-		check_lock();
-
-		owner->fLink->StartMessage( AS_LAYER_GET_COORD );
-		owner->fLink->Flush();
-		
-		int32 rCode=SERVER_FALSE;
-		owner->fLink->GetNextReply(&rCode);
-		if(rCode==SERVER_TRUE)
-		{
-			owner->fLink->Read<float>( const_cast<float*>(&originX) );
-			owner->fLink->Read<float>( const_cast<float*>(&originY) );
-			owner->fLink->Read<BRect>( const_cast<BRect*>(&fBounds) );
-			fState->flags		&= ~B_VIEW_COORD_BIT;
-		}
-	}
-
+	// Moving, resizing and scrolling are all started by us, and the layout
+	// app_server does for our children is repeated by parentResizedBy(), so
+	// fBounds is always up to date.
 	return fBounds;
 }
 
@@ -714,11 +702,9 @@ BRect BView::Frame() const
 {
 	check_lock_no_pick();
 
-	if ( fState->flags & B_VIEW_COORD_BIT ){
-		Bounds();
-	}
-
-	return Bounds().OffsetToCopy( originX, originY );
+	BRect frame(fBounds);
+	frame.OffsetTo(originX, originY);
+	return frame;
 }
 
 //---------------------------------------------------------------------------
@@ -820,7 +806,7 @@ void BView::SetOrigin(float x, float y)
 {
 	// TODO: maybe app_server should do a redraw? - WRITE down into specs
 
-	if ( x==originX && y==originY )
+	if ( x==fState->coordSysOrigin.x && y==fState->coordSysOrigin.y )
 		return;
 		
 	if (do_owner_check())
@@ -830,8 +816,7 @@ void BView::SetOrigin(float x, float y)
 		owner->fLink->Attach<float>( y );
 	}
 
-	// invalidate this flag, to stay in sync with app_server
-	fState->flags			|= B_VIEW_ORIGIN_BIT;	
+	fState->coordSysOrigin.Set( x, y );
 	
 	// our local coord system origin has changed, so when archiving we'll add this too
 	fState->archivingFlags	|= B_VIEW_ORIGIN_BIT;			
@@ -841,23 +826,6 @@ void BView::SetOrigin(float x, float y)
 
 BPoint BView::Origin(void) const
 {
-	
-	if ( fState->flags & B_VIEW_ORIGIN_BIT ) 
-	{
-		do_owner_check();
-		
-		owner->fLink->StartMessage( AS_LAYER_GET_ORIGIN );
-		owner->fLink->Flush();
-		
-		int32 rCode = SERVER_FALSE;
-		owner->fLink->GetNextReply(&rCode);
-		if(rCode==SERVER_TRUE)
-		{			
-			owner->fLink->Read<BPoint>( &fState->coordSysOrigin );
-			fState->flags			&= ~B_VIEW_ORIGIN_BIT;			
-		}
-	}
-
 	return fState->coordSysOrigin;
 }
 
@@ -1224,10 +1192,12 @@ void BView::GetMouse(BPoint* location, uint32* buttons, bool checkMessageQueue)
 		BMessage		*msg;
 		int32			i = 0;
 		
+		bool			updated = false;
+		
 		mq				= Window()->MessageQueue();
 		mq->Lock();
 		
-		while( (msg = mq->FindMessage(i++)) != NULL ) 
+		while( !updated && (msg = mq->FindMessage(i++)) != NULL ) 
 		{
 			switch (msg->what) 
 			{
@@ -1235,8 +1205,10 @@ void BView::GetMouse(BPoint* location, uint32* buttons, bool checkMessageQueue)
 				{
 					msg->FindPoint("where", location);
 					msg->FindInt32("buttons", (int32*)buttons);
-					Window()->DispatchMessage( msg, Window() );
+					ConvertFromScreen( location );
 					mq->RemoveMessage( msg );
+					mq->Unlock();
+					Window()->DispatchMessage( msg, Window() );
 					delete msg;
 					return;
 					break;
@@ -1245,29 +1217,46 @@ void BView::GetMouse(BPoint* location, uint32* buttons, bool checkMessageQueue)
 				{
 					msg->FindPoint("where", location);
 					msg->FindInt32("buttons", (int32*)buttons);
-					Window()->DispatchMessage( msg, Window() );
+					ConvertFromScreen( location );
 					mq->RemoveMessage( msg );
-					delete msg;						
+					mq->Unlock();
+					Window()->DispatchMessage( msg, Window() );
+					delete msg;
 					return;
 					break;
 				}	
 				case _UPDATE_:
 				{
-					Window()->DispatchMessage( msg, Window() );
+					// handling it merges the other queued updates into it,
+					// so it has to be out of the queue first
 					mq->RemoveMessage( msg );
+					mq->Unlock();
+					Window()->DispatchMessage( msg, Window() );
 					delete msg;
-					return;
+
+					// it doesn't tell where the mouse is, though
+					updated = true;
 					break;
 				}	
 				default:
 					break;
 			}
 		}
-		mq->Unlock();
+		if (!updated)
+			mq->Unlock();
 	}
 	
 	// If B_MOUSE_UP or B_MOUSE_MOVED has not been found in the message queue,
-	// tell app_server to send us the current mouse coords and buttons.
+	// read the current mouse coords and buttons the app_server publishes.
+	input_state state;
+	if (BPrivate::get_input_state( &state ))
+	{
+		*location = ConvertFromScreen( BPoint( state.x, state.y ) );
+		*buttons = state.buttons;
+		return;
+	}
+	
+	// an app_server which doesn't publish them has to be asked
 	owner->fLink->StartMessage( AS_LAYER_GET_MOUSE_COORDS );
 	owner->fLink->Flush();
 	
@@ -1345,7 +1334,8 @@ void BView::ScrollBy(float dh, float dv)
 		owner->fLink->Attach<float>( dh );
 		owner->fLink->Attach<float>( dv );
 
-		fState->flags		|= B_VIEW_COORD_BIT;		
+		// the visible part of us has changed
+		fState->flags		|= B_VIEW_CLIP_REGION_BIT;
 	}
 	
 	// we modify our bounds rectangle by dh/dv coord units hor/ver.
@@ -1417,8 +1407,6 @@ void BView::SetLineMode(cap_mode lineCap, join_mode lineJoin,float miterLimit)
 		owner->fLink->Attach<int8>( (int8)lineCap );
 		owner->fLink->Attach<int8>( (int8)lineJoin );
 		owner->fLink->Attach<float>( miterLimit );
-
-		fState->flags		|= B_VIEW_LINE_MODES_BIT;
 	}
 
 	fState->lineCap			= lineCap;
@@ -1432,9 +1420,6 @@ void BView::SetLineMode(cap_mode lineCap, join_mode lineJoin,float miterLimit)
 
 join_mode BView::LineJoinMode() const
 {
-	if (fState->flags & B_VIEW_LINE_MODES_BIT)
-		LineMiterLimit();
-	
 	return fState->lineJoin;
 }
 
@@ -1442,9 +1427,6 @@ join_mode BView::LineJoinMode() const
 
 cap_mode BView::LineCapMode() const
 {
-	if (fState->flags & B_VIEW_LINE_MODES_BIT)
-		LineMiterLimit();
-	
 	return fState->lineCap;
 }
 
@@ -1452,25 +1434,6 @@ cap_mode BView::LineCapMode() const
 
 float BView::LineMiterLimit() const
 {
-	if ( (fState->flags & B_VIEW_LINE_MODES_BIT) && owner)
-	{
-		check_lock();
-		
-		owner->fLink->StartMessage( AS_LAYER_GET_LINE_MODE );
-		owner->fLink->Flush();
-		
-		int32 rCode = SERVER_FALSE;
-		owner->fLink->GetNextReply( &rCode );
-		if (rCode == SERVER_TRUE)
-		{
-			owner->fLink->Read<int8>( (int8*)&(fState->lineCap) );
-			owner->fLink->Read<int8>( (int8*)&(fState->lineJoin) );
-			owner->fLink->Read<float>( &(fState->miterLimit) );
-		}
-		
-		fState->flags			&= ~B_VIEW_LINE_MODES_BIT;
-	}
-	
 	return fState->miterLimit;
 }
 
@@ -1481,8 +1444,14 @@ void BView::PushState()
 	do_owner_check();
 
 	owner->fLink->StartMessage( AS_LAYER_PUSH_STATE );
+
+	// keep a copy of the state, so PopState() can restore it without
+	// asking app_server what it was
+	ViewAttr	*saved = new ViewAttr( *fState );
 	
 	initCachedState();
+
+	fState->previous	= saved;
 }
 
 //---------------------------------------------------------------------------
@@ -1493,11 +1462,17 @@ void BView::PopState()
 
 	owner->fLink->StartMessage( AS_LAYER_POP_STATE );
 
-	// this avoids a compiler warning
-	uint32 dummy	= 0xffffffffUL;
-	
-	// invalidate all flags
-	fState->flags	= dummy;
+	// app_server ignores a pop without a push, and so do we
+	ViewAttr	*saved = fState->previous;
+	if (!saved)
+		return;
+
+	*fState		= *saved;
+	delete saved;
+
+	// the clipping region is made from the visible region, which only
+	// app_server knows
+	fState->flags	|= B_VIEW_CLIP_REGION_BIT;
 }
 
 //---------------------------------------------------------------------------
@@ -1513,9 +1488,6 @@ void BView::SetScale(float scale) const
 				
 		owner->fLink->StartMessage( AS_LAYER_SET_SCALE );
 		owner->fLink->Attach<float>( scale );
-		
-		// I think that this flag won't be used after all... in 'flags' of course.
-		fState->flags		|= B_VIEW_SCALE_BIT;	
 	}
 	
 	fState->scale			= scale;
@@ -1526,24 +1498,13 @@ void BView::SetScale(float scale) const
 
 float BView::Scale() const
 {
-	if ( (fState->flags & B_VIEW_SCALE_BIT) && owner)
-	{
-		check_lock();
-		
-		owner->fLink->StartMessage( AS_LAYER_GET_SCALE );
-		owner->fLink->Flush();
-		
- 		int32 rCode = SERVER_FALSE;
- 		owner->fLink->GetNextReply( &rCode );
- 		if (rCode == SERVER_TRUE)
- 		{
-			owner->fLink->Read<float>( &(fState->scale) );
-		}
-		
-		fState->flags			&= ~B_VIEW_SCALE_BIT;
-	}
+	// like app_server, we answer with the scale of all pushed states combined
+	float		scale = fState->scale;
+
+	for (ViewAttr *state = fState->previous; state; state = state->previous)
+		scale	*= state->scale;
 
-	return fState->scale;
+	return scale;
 }
 
 //---------------------------------------------------------------------------
@@ -1559,8 +1520,6 @@ void BView::SetDrawingMode(drawing_mode mode)
 
 		owner->fLink->StartMessage( AS_LAYER_SET_DRAW_MODE );
 		owner->fLink->Attach<int8>( (int8)mode );
-		
-		fState->flags		|= B_VIEW_DRAW_MODE_BIT;	
 	}
 
 	fState->drawingMode		= mode;
@@ -1572,24 +1531,6 @@ void BView::SetDrawingMode(drawing_mode mode)
 
 drawing_mode BView::DrawingMode() const
 {
-	if ( (fState->flags & B_VIEW_DRAW_MODE_BIT) && owner)
-	{
-		check_lock();
-		int8		drawingMode;
-
-		owner->fLink->StartMessage( AS_LAYER_GET_DRAW_MODE );
-		owner->fLink->Flush();
-		
-		int32 rCode = SERVER_FALSE;
- 		owner->fLink->GetNextReply( &rCode );
- 		if (rCode == SERVER_TRUE)
-			owner->fLink->Read<int8>( &drawingMode );
-		
-		fState->drawingMode		= (drawing_mode)drawingMode;
-		
-		fState->flags			&= ~B_VIEW_DRAW_MODE_BIT;
-	}
-	
 	return fState->drawingMode;
 }
 
@@ -1607,8 +1548,6 @@ void BView::SetBlendingMode(source_alpha srcAlpha, alpha_function alphaFunc)
 		owner->fLink->StartMessage( AS_LAYER_SET_BLEND_MODE );
 		owner->fLink->Attach<int8>( (int8)srcAlpha );
 		owner->fLink->Attach<int8>( (int8)alphaFunc );		
-
-		fState->flags		|= B_VIEW_BLENDING_BIT;	
 	}
 	
 	fState->alphaSrcMode	= srcAlpha;
@@ -1621,28 +1560,6 @@ void BView::SetBlendingMode(source_alpha srcAlpha, alpha_function alphaFunc)
 
 void BView::GetBlendingMode(source_alpha* srcAlpha,	alpha_function* alphaFunc) const
 {
-	if ( (fState->flags & B_VIEW_BLENDING_BIT) && owner)
-	{
-		check_lock();
-		int8		alphaSrcMode, alphaFncMode;
-		
-		owner->fLink->StartMessage( AS_LAYER_GET_BLEND_MODE );
-		owner->fLink->Flush();
-		
-		int32 rCode = SERVER_FALSE;
- 		owner->fLink->GetNextReply( &rCode );
- 		if (rCode == SERVER_TRUE)
- 		{
-			owner->fLink->Read<int8>( &alphaSrcMode );
-			owner->fLink->Read<int8>( &alphaFncMode );
-		}
-		
-		fState->alphaSrcMode	= (source_alpha)alphaSrcMode;
-		fState->alphaFncMode	= (alpha_function)alphaFncMode;
-		
-		fState->flags			&= ~B_VIEW_BLENDING_BIT;
-	}
-	
 	if (srcAlpha)
 		*srcAlpha		= fState->alphaSrcMode;
 		
@@ -1671,8 +1588,6 @@ void BView::MovePenTo(float x, float y)
 		owner->fLink->StartMessage( AS_LAYER_SET_PEN_LOC );
 		owner->fLink->Attach<float>( x );
 		owner->fLink->Attach<float>( y );		
-		
-		fState->flags		|= B_VIEW_PEN_LOC_BIT;	
 	}
 	
 	fState->penPosition.x	= x;
@@ -1692,21 +1607,6 @@ void BView::MovePenBy(float x, float y)
 
 BPoint BView::PenLocation() const
 {
-	if ( (fState->flags & B_VIEW_PEN_LOC_BIT) && owner)
-	{
-		check_lock();
-
-		owner->fLink->StartMessage( AS_LAYER_GET_PEN_LOC );
-		owner->fLink->Flush();
-		
-		int32 rCode = SERVER_FALSE;
- 		owner->fLink->GetNextReply( &rCode );
- 		if (rCode == SERVER_TRUE)
-			owner->fLink->Read<BPoint>( &(fState->penPosition) );
-		
-		fState->flags			&= ~B_VIEW_PEN_LOC_BIT;
-	}
-
 	return fState->penPosition;
 }
 
@@ -1721,8 +1621,6 @@ void BView::SetPenSize(float size){
 
 		owner->fLink->StartMessage( AS_LAYER_SET_PEN_SIZE );
 		owner->fLink->Attach<float>( size );
-
-		fState->flags		|= B_VIEW_PEN_SIZE_BIT;	
 	}
 
 	fState->penSize			= size;
@@ -1734,24 +1632,6 @@ void BView::SetPenSize(float size){
 
 float BView::PenSize() const
 {
-	if (fState->flags & B_VIEW_PEN_SIZE_BIT)
-	{
-		if (owner)
-		{
-			check_lock();
-			
-			owner->fLink->StartMessage( AS_LAYER_GET_PEN_SIZE );
-			owner->fLink->Flush();
-			
-			int32 rCode = SERVER_FALSE;
- 			owner->fLink->GetNextReply( &rCode );
- 			if (rCode == SERVER_TRUE)
-				owner->fLink->Read<float>( &(fState->penSize) );
-			
-			fState->flags			&= ~B_VIEW_PEN_SIZE_BIT;
-		}
-	}
-	
 	return fState->penSize;
 }
 
@@ -1768,8 +1648,6 @@ void BView::SetHighColor(rgb_color a_color)
 
 		owner->fLink->StartMessage( AS_LAYER_SET_HIGH_COLOR );
 		owner->fLink->Attach<rgb_color>( a_color );
-		
-		fState->flags		|= B_VIEW_COLORS_BIT;	
 	}
 
 	_set_ptr_rgb_color( &(fState->highColor), a_color.red, a_color.green,
@@ -1782,28 +1660,6 @@ void BView::SetHighColor(rgb_color a_color)
 
 rgb_color BView::HighColor() const
 {
-	if (fState->flags & B_VIEW_COLORS_BIT)
-	{
-		if (owner)
-		{
-			check_lock();
-			
-			owner->fLink->StartMessage( AS_LAYER_GET_COLORS );
-			owner->fLink->Flush();
-			
-			int32 rCode = SERVER_FALSE;
-	 		owner->fLink->GetNextReply( &rCode );
-	 		if (rCode == SERVER_TRUE)
-	 		{
-				owner->fLink->Read<rgb_color>( &(fState->highColor) );
-				owner->fLink->Read<rgb_color>( &(fState->lowColor) );
-				owner->fLink->Read<rgb_color>( &(fState->viewColor) );				
-			}
-			
-			fState->flags			&= ~B_VIEW_COLORS_BIT;
-		}
-	}
-	
 	return fState->highColor;
 }
 
@@ -1820,8 +1676,6 @@ void BView::SetLowColor(rgb_color a_color)
 
 		owner->fLink->StartMessage( AS_LAYER_SET_LOW_COLOR );
 		owner->fLink->Attach<rgb_color>( a_color );
-		
-		fState->flags		|= B_VIEW_COLORS_BIT;	
 	}
 
 	_set_ptr_rgb_color( &(fState->lowColor), a_color.red, a_color.green,
@@ -1834,15 +1688,6 @@ void BView::SetLowColor(rgb_color a_color)
 
 rgb_color BView::LowColor() const
 {
-	if (fState->flags & B_VIEW_COLORS_BIT)
-	{
-		if (owner)
-		{
-			// HighColor() contacts app_server and gets the high, low and view colors
-			HighColor();
-		}
-	}
-	
 	return fState->lowColor;
 }
 
@@ -1859,8 +1704,6 @@ void BView::SetViewColor(rgb_color c)
 
 		owner->fLink->StartMessage( AS_LAYER_SET_VIEW_COLOR );
 		owner->fLink->Attach<rgb_color>( c );
-		
-		fState->flags		|= B_VIEW_COLORS_BIT;	
 	}
 
 	_set_ptr_rgb_color( &(fState->viewColor), c.red, c.green,
@@ -1873,15 +1716,6 @@ void BView::SetViewColor(rgb_color c)
 
 rgb_color BView::ViewColor() const
 {
-	if (fState->flags & B_VIEW_COLORS_BIT)
-	{
-		if (owner)
-		{
-			// HighColor() contacts app_server and gets the high, low and view colors
-			HighColor();
-		}
-	}
-	
 	return fState->viewColor;
 }
 
@@ -1898,9 +1732,6 @@ void BView::ForceFontAliasing(bool enable)
 
 		owner->fLink->StartMessage( AS_LAYER_PRINT_ALIASING );
 		owner->fLink->Attach<bool>( enable );
-		
-		// I think this flag won't be used...
-		fState->flags		|= B_VIEW_FONT_ALIASING_BIT;	
 	}
 
 	fState->fontAliasing	= enable;
@@ -2323,8 +2154,20 @@ void BView::DrawString(const char* aString, int32 length, BPoint location,
 		}
 		owner->fLink->AttachString( aString );		
 
-		// this modifies our pen location, so we invalidate the flag.
-		fState->flags		|= B_VIEW_PEN_LOC_BIT;
+		// the pen ends up behind the string, which we can measure ourselves
+		float		width = fState->font.StringWidth( aString, length );
+		if (delta)
+		{
+			for (int32 i = 0; i < length && aString[i]; i++)
+			{
+				if ((uint8)aString[i] <= 0x20)
+					width	+= delta->space;
+				else
+					width	+= delta->nonspace;
+			}
+		}
+
+		fState->penPosition.Set( location.x + width, location.y );
 	}
 }
 
@@ -2827,8 +2670,8 @@ void BView::StrokeLine(BPoint pt0, BPoint pt1, pattern p)
 		owner->fLink->Attach<BPoint>( pt0 );
 		owner->fLink->Attach<BPoint>( pt1 );
 		
-		// this modifies our pen location, so we invalidate the flag.
-		fState->flags		|= B_VIEW_PEN_LOC_BIT;			
+		// app_server leaves the pen at the end of the line
+		fState->penPosition	= pt1;
 	}
 }
 
@@ -3449,7 +3292,7 @@ void BView::MoveTo(float x, float y)
 		owner->fLink->Attach<float>( x );
 		owner->fLink->Attach<float>( y );
 		
-		fState->flags		|= B_VIEW_COORD_BIT;
+		fState->flags		|= B_VIEW_CLIP_REGION_BIT;
 	}
 	
 	originX		= x;
@@ -3491,11 +3334,70 @@ void BView::ResizeTo(float width, float height)
 		owner->fLink->Attach<float>( width );
 		owner->fLink->Attach<float>( height );
 		
-		fState->flags		|= B_VIEW_COORD_BIT;
+		fState->flags		|= B_VIEW_CLIP_REGION_BIT;
 	}
 	
+	float		dh = width - fBounds.Width();
+	float		dv = height - fBounds.Height();
+
 	fBounds.right	= fBounds.left + width;
 	fBounds.bottom	= fBounds.top + height;
+
+	// app_server moves and resizes our children by their resizing modes,
+	// we do the same so we don't have to ask it about their frames
+	for (BView *child = first_child; child; child = child->next_sibling)
+		child->parentResizedBy( dh, dv );
+}
+
+//---------------------------------------------------------------------------
+
+/*!
+	\brief Moves and resizes the view after its parent was resized
+	\param dh Horizontal change of the parent's size
+	\param dv Vertical change of the parent's size
+	
+	This follows Layer::ResizeOthers() in app_server, so the frame we keep
+	is the one app_server comes up with.
+*/
+void BView::parentResizedBy(float dh, float dv)
+{
+	uint32		mode = ResizingMode();
+	BPoint		offset(0.0, 0.0);
+	BPoint		resize(0.0, 0.0);
+
+	if (((mode >> 8) & 0xf) == _VIEW_LEFT_ && (mode & 0xf) == _VIEW_RIGHT_)
+		resize.x	= dh;
+	else if (((mode >> 8) & 0xf) == _VIEW_LEFT_)
+		;
+	else if ((mode & 0xf) == _VIEW_RIGHT_)
+		offset.x	= dh;
+	else if (((mode >> 8) & 0xf) == _VIEW_CENTER_)
+		offset.x	= dh / 2;
+
+	if (((mode >> 12) & 0xf) == _VIEW_TOP_ && ((mode >> 4) & 0xf) == _VIEW_BOTTOM_)
+		resize.y	= dv;
+	else if (((mode >> 12) & 0xf) == _VIEW_TOP_)
+		;
+	else if (((mode >> 4) & 0xf) == _VIEW_BOTTOM_)
+		offset.y	= dv;
+	else if (((mode >> 12) & 0xf) == _VIEW_CENTER_)
+		offset.y	= dv / 2;
+
+	if (offset.x == 0.0 && offset.y == 0.0 && resize.x == 0.0 && resize.y == 0.0)
+		return;
+
+	originX			+= offset.x;
+	originY			+= offset.y;
+	fState->flags	|= B_VIEW_CLIP_REGION_BIT;
+
+	if (resize.x == 0.0 && resize.y == 0.0)
+		return;
+
+	fBounds.right	+= resize.x;
+	fBounds.bottom	+= resize.y;
+
+	for (BView *child = first_child; child; child = child->next_sibling)
+		child->parentResizedBy( resize.x, resize.y );
 }
 
 //---------------------------------------------------------------------------
@@ -3862,8 +3764,7 @@ bool BView::removeSelf()
 	STRACE(("BView(%s)::removeSelf()...\n", this->Name() ));
 	
 /*
-	# check for dirty flags 						- by updateCachedState()
-	# check for dirty flags on 'child' children		- by updateCachedState()
+	# our state is kept here, app_server needn't be asked for it
 	# handle if in middle of Begin/EndLineArray()	- by setOwner(NULL)
 	# remove trom the main tree						- by removeFromList()
 	# handle if child is the default button			- HERE
@@ -3884,8 +3785,6 @@ bool BView::removeSelf()
 	if (owner)
 	{
 		check_lock();
-	
-		updateCachedState();
 		
 		if (owner->fDefaultButton == this)
 			owner->SetDefaultButton( NULL );
@@ -4722,6 +4621,8 @@ ViewAttr::ViewAttr(void)
 	
 	// TODO: find out what value this should have.
 	archivingFlags=B_VIEW_COORD_BIT;
+
+	previous=NULL;
 }
 
 //---------------------------------------------------------------------------
@@ -39,6 +39,7 @@
 #include <String.h>
 #include <Screen.h>
 #include <Button.h>
+#include <Region.h>
 #include <MessageQueue.h>
 #include <MessageRunner.h>
 #include <Roster.h>
@@ -885,16 +886,28 @@ void BWindow::DispatchMessage(BMessage *msg, BHandler *target)
 		case _UPDATE_:
 		{
 			STRACE(("info:BWindow handling _UPDATE_.\n"));
+			BRegion updateRegion;
 			BRect updateRect;
-			int32 token;
-			BView *view;
 			
-			msg->FindRect("_rect", &updateRect);
-			msg->FindInt32("_token",&token);
+			for(int32 i=0; msg->FindRect("_rect", i, &updateRect)==B_OK; i++)
+				updateRegion.Include(updateRect);
 			
-			view=findView(top_view,token);
-			if(view)
-				DoUpdate(top_view, updateRect);
+			// Merge the updates which are already waiting into this one, so
+			// that the views are drawn once for all of them
+			BMessageQueue *queue=MessageQueue();
+			BMessage *pending;
+			queue->Lock();
+			while((pending=queue->FindMessage(_UPDATE_, 0)))
+			{
+				for(int32 i=0; pending->FindRect("_rect", i, &updateRect)==B_OK; i++)
+					updateRegion.Include(updateRect);
+				
+				queue->RemoveMessage(pending);
+				delete pending;
+			}
+			queue->Unlock();
+			
+			DoUpdate(updateRegion);
 			break;
 		}
 		case B_VIEW_MOVED:
@@ -1295,20 +1308,22 @@ void BWindow::UpdateIfNeeded()
 	
 	queue = MessageQueue();
 
-	//process all _UPDATE_ BMessages in message queue
-	//we lock the queue because we don't want to be stuck in this
-	//function if there is a continuous stream of updates 
+	//process all _UPDATE_ BMessages in message queue. Handling the first
+	//one merges all the others into it, so the views are drawn only once.
 	queue->Lock();
-	while ((msg = queue->FindMessage(_UPDATE_, 0)))
+	msg = queue->FindMessage(_UPDATE_, 0);
+	if (msg)
+		queue->RemoveMessage( msg );
+	queue->Unlock();
+
+	if (msg)
 	{
 		Lock();
 		DispatchMessage( msg, this );
 		Unlock();
 
-		queue->RemoveMessage( msg );
 		delete msg;
 	}
-	queue->Unlock();
 }
 
 //------------------------------------------------------------------------------
@@ -3054,45 +3069,72 @@ void BWindow::drawAllViews(BView* aView)
 
 //------------------------------------------------------------------------------
 
-void BWindow::DoUpdate(BView* aView, BRect& area)
+/*!
+	\brief Draws the views which intersect a region, in one update
+	\param region Region to update, in window coordinates
+	
+	The app_server restricts drawing in each view to its part of the update 
+	for the whole pass, so the views are drawn with a single begin and end.
+*/
+void BWindow::DoUpdate(BRegion& region)
 {
- 
- 	STRACE(("info: BWindow::drawView() BRect(%f,%f,%f,%f) called.\n",
- 		area.left, area.top, area.right, area.bottom));
- 
- 	aView->check_lock();
- 	fLink->StartMessage(AS_BEGIN_UPDATE);
- 			
- 	if (aView->Flags() & B_WILL_DRAW)
- 		aView->Draw( area );
- 	else
- 	{
- 		rgb_color c = aView->HighColor();
- 		aView->SetHighColor(aView->ViewColor());
- 		aView->FillRect(aView->Bounds(), B_SOLID_HIGH);
- 		aView->SetHighColor(c);
- 	}
- 
- 	aView->check_lock();
- 	fLink->StartMessage(AS_END_UPDATE);
+	STRACE(("info: BWindow::DoUpdate() BRect(%f,%f,%f,%f) called.\n",
+		region.Frame().left, region.Frame().top, region.Frame().right,
+		region.Frame().bottom));
 	
-	BView *child;
-	if ( (child = aView->first_child) )
+	if (region.CountRects() == 0)
+		return;
+	
+	top_view->check_lock();
+	fLink->StartMessage(AS_BEGIN_UPDATE);
+	
+	updateView(top_view, region);
+	
+	top_view->check_lock();
+	fLink->StartMessage(AS_END_UPDATE);
+	fLink->Flush();
+}
+
+//------------------------------------------------------------------------------
+
+/*!
+	\brief Draws a view and those of its children which intersect a region
+	\param aView The view to draw
+	\param region The view's part of the update, in its own coordinates
+*/
+void BWindow::updateView(BView* aView, BRegion& region)
+{
+	BRect area = region.Frame();
+	
+	aView->check_lock();
+	if (aView->Flags() & B_WILL_DRAW)
+		aView->Draw( area );
+	else
 	{
-		while ( child )
-		{
-			if ( area.Intersects( child->Frame() ) )
-			{
-				BRect		newArea;
-				newArea		= area & child->Frame();
-				child->ConvertFromParent( &newArea );
-				DoUpdate( child, newArea );
-			}
-			child 		= child->next_sibling; 
-		}
+		rgb_color c = aView->HighColor();
+		aView->SetHighColor(aView->ViewColor());
+		aView->FillRect(area, B_SOLID_HIGH);
+		aView->SetHighColor(c);
+	}
+	
+	for (BView *child = aView->first_child; child; child = child->next_sibling)
+	{
+		if (child->IsHidden())
+			continue;
+		
+		BRect frame = child->Frame();
+		if (!region.Intersects(frame))
+			continue;
+		
+		BRegion childRegion(frame);
+		childRegion.IntersectWith(&region);
+		
+		BRect bounds = child->Bounds();
+		childRegion.OffsetBy((int32)(bounds.left - frame.left),
+			(int32)(bounds.top - frame.top));
+		
+		updateView(child, childRegion);
 	}
-
-	fLink->Flush();
 }
 
 //------------------------------------------------------------------------------
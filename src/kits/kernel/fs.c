@@ -23,26 +23,105 @@
 //	Authors:		Bill Hayden (hayden@haydentech.com)
 //----------------------------------------------------------------------------*/
 
+#define _GNU_SOURCE		// statx()
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#if defined(linux)
+#include <linux/fs.h>
+#endif
+
 #include <fs_attr.h>
 #include <fs_info.h>
+#include <TypeConstants.h>
 
 #include "../../config.h"
 
 #if defined(COSMOE_ATTRIBUTES)
 #include <sys/xattr.h>
 #else
-#warning Cosmoe does not support attributes on this platform
+#warning Cosmoe keeps all attributes in sidecar files on this platform
 #endif
 
+// The node monitor functions are in storage/NodeMonitorService.cpp
+
+/* Attributes are kept as extended attributes in the "user" namespace. The
+** value of each is preceded by an attr_header holding its type, so that the
+** type, the size and the value of an attribute are all read by a single
+** fgetxattr(). Values too large for an extended attribute, and all the
+** attributes of nodes on file systems without extended attributes, are
+** packed into a sidecar file per node instead; in the former case the
+** extended attribute is only a stub referring to the sidecar.
+** Sidecar files are named after the device and inode of their node. Since
+** inode numbers are reused, each starts with the inode generation and the
+** birth time of the node it was written for; a sidecar that doesn't match
+** its node belonged to a node that is gone, and is removed when found.
+** Sidecars of nodes removed through the storage kit are removed with them
+** by fs_remove_attr_sidecar().
+*/
+
+#define ATTRIBUTE_PREFIX		"user."
+#define ATTRIBUTE_MAGIC			'Catr'
+#define SIDECAR_STUB_MAGIC		'Cats'
+#define SIDECAR_MAGIC			'Catf'
+#define SIDECAR_DIRECTORY		"/boot/home/config/var/attributes"
+#define SMALL_ATTRIBUTE_SIZE	256
+#define MAX_XATTR_NAME_LENGTH	256
+
+typedef struct attr_header {
+	uint32	magic;
+	uint32	type;
+} attr_header;
+
+typedef struct sidecar_stub {
+	attr_header	header;
+	int64		size;
+} sidecar_stub;
+
+/* the start of a sidecar file, identifying the node it belongs to; a file
+** system that provides neither the generation nor the birth time leaves
+** them 0, and the check degenerates to the inode number */
+typedef struct sidecar_header {
+	uint32	magic;
+	uint32	generation;
+	int64	birth;
+} sidecar_header;
 
-status_t _kstart_watching_vnode_(dev_t device, ino_t node,
-								 uint32 flags, port_id port, int32 handlerToken);
-status_t _kstop_watching_vnode_(dev_t device, ino_t node,
-								port_id port, int32 handlerToken);
-status_t _kstop_notifying_(port_id port, int32 handlerToken);
+/* a record in a sidecar file is followed by the name of the attribute,
+** including the terminating null, and its value */
+typedef struct sidecar_record {
+	uint32	type;
+	uint32	name_length;
+	int64	size;
+} sidecar_record;
+
+typedef struct sidecar_entry {
+	uint32		type;
+	const char	*name;
+	const char	*value;
+	size_t		size;
+	size_t		offset;
+	size_t		length;
+} sidecar_entry;
+
+/* what an attribute directory DIR * really points to */
+typedef struct attr_dir {
+	int				fd;
+	char			*names;
+	size_t			size;
+	size_t			offset;
+	struct dirent	entry;
+} attr_dir;
 
 
 
@@ -75,73 +154,698 @@ int		fs_stat_dev(dev_t dev, fs_info *info)
 	return -1;
 }
 
-ssize_t	fs_write_attr(int fd, const char *attribute, uint32 type, off_t pos, const void *buffer, size_t readBytes)
+static ssize_t
+copy_value(const char *value, off_t size, off_t pos, void *buffer,
+	size_t bufferSize)
+{
+	size_t count;
+
+	if (pos >= size || buffer == NULL)
+		return 0;
+	count = size - pos;
+	if (count > bufferSize)
+		count = bufferSize;
+	memcpy(buffer, value + pos, count);
+	return count;
+}
+
+
+static int
+make_directories(const char *path)
+{
+	char directory[PATH_MAX];
+	char *slash;
+
+	if (strlen(path) >= sizeof(directory)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(directory, path);
+	for (slash = strchr(directory + 1, '/'); slash != NULL;
+		 slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		if (mkdir(directory, 0700) < 0 && errno != EEXIST)
+			return -1;
+		*slash = '/';
+	}
+	if (mkdir(directory, 0700) < 0 && errno != EEXIST)
+		return -1;
+	return 0;
+}
+
+
+static void
+sidecar_path(const struct stat *st, char *path, size_t size, int directory)
+{
+	if (directory) {
+		snprintf(path, size, "%s/%llx", SIDECAR_DIRECTORY,
+			(unsigned long long)st->st_dev);
+	} else {
+		snprintf(path, size, "%s/%llx/%llx", SIDECAR_DIRECTORY,
+			(unsigned long long)st->st_dev, (unsigned long long)st->st_ino);
+	}
+}
+
+
+/* Fills in the header of the sidecar of the node \a fd refers to. */
+static void
+sidecar_identify(int fd, sidecar_header *header)
+{
+#if defined(STATX_BTIME)
+	struct statx stx;
+#endif
+#if defined(FS_IOC_GETVERSION)
+	int generation;
+#endif
+
+	header->magic = SIDECAR_MAGIC;
+	header->generation = 0;
+	header->birth = 0;
+#if defined(FS_IOC_GETVERSION)
+	if (ioctl(fd, FS_IOC_GETVERSION, &generation) == 0)
+		header->generation = generation;
+#endif
+#if defined(STATX_BTIME)
+	if (statx(fd, "", AT_EMPTY_PATH, STATX_BTIME, &stx) == 0
+		&& (stx.stx_mask & STATX_BTIME) != 0) {
+		header->birth = (int64)stx.stx_btime.tv_sec * 1000000
+			+ stx.stx_btime.tv_nsec / 1000;
+	}
+#endif
+}
+
+
+/* Reads the records of the sidecar of the node \a fd refers to into a
+** buffer to be free()d by the caller. A missing sidecar file is the same
+** as an empty one; so is one left behind by an earlier node with the same
+** inode number, which is removed on the way. */
+static int
+sidecar_load(int fd, const char *path, char **data, size_t *size)
+{
+	sidecar_header header, expected;
+	struct stat st;
+	ssize_t length;
+	int file;
+
+	*data = NULL;
+	*size = 0;
+	file = open(path, O_RDONLY);
+	if (file < 0)
+		return (errno == ENOENT ? 0 : -1);
+	if (fstat(file, &st) < 0 || (*data = malloc(st.st_size + 1)) == NULL) {
+		close(file);
+		return -1;
+	}
+	length = read_pos(file, 0, *data, st.st_size);
+	close(file);
+	if (length < 0) {
+		free(*data);
+		*data = NULL;
+		return -1;
+	}
+
+	sidecar_identify(fd, &expected);
+	if ((size_t)length >= sizeof(header))
+		memcpy(&header, *data, sizeof(header));
+	else
+		header.magic = 0;
+	if (header.magic != SIDECAR_MAGIC
+		|| header.generation != expected.generation
+		|| header.birth != expected.birth) {
+		unlink(path);
+		return 0;
+	}
+
+	*size = length - sizeof(header);
+	memmove(*data, *data + sizeof(header), *size);
+	return 0;
+}
+
+
+/* Returns the record at \a offset and moves \a offset past it; a record
+** that doesn't fit into the file ends it. */
+static int
+sidecar_next(const char *data, size_t size, size_t *offset,
+	sidecar_entry *entry)
+{
+	sidecar_record record;
+
+	if (*offset + sizeof(record) > size)
+		return 0;
+	memcpy(&record, data + *offset, sizeof(record));
+	if (record.name_length == 0 || record.size < 0
+		|| record.name_length > size - *offset - sizeof(record)
+		|| (uint64)record.size
+			> size - *offset - sizeof(record) - record.name_length
+		|| data[*offset + sizeof(record) + record.name_length - 1] != '\0')
+		return 0;
+
+	entry->type = record.type;
+	entry->name = data + *offset + sizeof(record);
+	entry->value = entry->name + record.name_length;
+	entry->size = record.size;
+	entry->offset = *offset;
+	entry->length = sizeof(record) + record.name_length + record.size;
+	*offset += entry->length;
+	return 1;
+}
+
+
+static int
+sidecar_find(const char *data, size_t size, const char *attribute,
+	sidecar_entry *entry)
+{
+	size_t offset = 0;
+
+	while (sidecar_next(data, size, &offset, entry)) {
+		if (strcmp(entry->name, attribute) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+/* Writers of sidecars in this process, see sidecar_store(). */
+static pthread_mutex_t sSidecarLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Does the work of sidecar_store(), the caller holds sSidecarLock. */
+static int
+sidecar_rewrite(int fd, const char *attribute, uint32 type, const void *value,
+	size_t size)
+{
+	char path[PATH_MAX], tempPath[PATH_MAX + 16];
+	char *data, *newData;
+	size_t dataSize, newSize = 0;
+	sidecar_entry entry;
+	sidecar_record record;
+	struct stat st;
+	int found, result = -1, file;
+
+	if (fstat(fd, &st) < 0)
+		return -1;
+	sidecar_path(&st, path, sizeof(path), 0);
+	if (sidecar_load(fd, path, &data, &dataSize) < 0)
+		return -1;
+	found = sidecar_find(data, dataSize, attribute, &entry);
+	if (value == NULL && !found) {
+		free(data);
+		errno = ENODATA;
+		return -1;
+	}
+
+	record.type = type;
+	record.name_length = strlen(attribute) + 1;
+	record.size = size;
+	newData = malloc(sizeof(sidecar_header) + dataSize + sizeof(record)
+		+ record.name_length + size + 1);
+	if (newData == NULL) {
+		free(data);
+		errno = ENOMEM;
+		return -1;
+	}
+	sidecar_identify(fd, (sidecar_header *)newData);
+	newSize = sizeof(sidecar_header);
+	if (found) {
+		memcpy(newData + newSize, data, entry.offset);
+		memcpy(newData + newSize + entry.offset,
+			data + entry.offset + entry.length,
+			dataSize - entry.offset - entry.length);
+		newSize += dataSize - entry.length;
+	} else if (dataSize > 0) {
+		memcpy(newData + newSize, data, dataSize);
+		newSize += dataSize;
+	}
+	if (value != NULL) {
+		memcpy(newData + newSize, &record, sizeof(record));
+		newSize += sizeof(record);
+		memcpy(newData + newSize, attribute, record.name_length);
+		newSize += record.name_length;
+		memcpy(newData + newSize, value, size);
+		newSize += size;
+	}
+	free(data);
+
+	if (newSize == sizeof(sidecar_header)) {
+		result = unlink(path);
+		free(newData);
+		return result;
+	}
+
+	sidecar_path(&st, tempPath, sizeof(tempPath), 1);
+	if (make_directories(tempPath) == 0) {
+		file = -1;
+		if (snprintf(tempPath, sizeof(tempPath), "%s.%ld", path,
+				(long)getpid()) >= (int)sizeof(tempPath))
+			errno = ENAMETOOLONG;
+		else
+			file = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (file >= 0) {
+			if (write_pos(file, 0, newData, newSize) == (ssize_t)newSize
+				&& close(file) == 0)
+				result = rename(tempPath, path);
+			else
+				close(file);
+			if (result < 0)
+				unlink(tempPath);
+		}
+	}
+	free(newData);
+	return result;
+}
+
+
+/* Replaces the record of \a attribute in the sidecar of the node, or
+** removes it, if \a value is NULL. The file is rewritten and renamed over
+** the old one, so that readers never see it half written. The temporary
+** file is named after the process, and the threads of the process take
+** turns, so that neither loses the update of another. */
+static int
+sidecar_store(int fd, const char *attribute, uint32 type, const void *value,
+	size_t size)
+{
+	int result;
+
+	pthread_mutex_lock(&sSidecarLock);
+	result = sidecar_rewrite(fd, attribute, type, value, size);
+	pthread_mutex_unlock(&sSidecarLock);
+	return result;
+}
+
+
+/* Removes what a value too large for an extended attribute left in the
+** sidecar, once the attribute has been replaced or removed. */
+static void
+sidecar_drop(int fd, const char *attribute)
 {
+	char path[PATH_MAX];
+	struct stat st;
+
+	if (fstat(fd, &st) < 0)
+		return;
+	sidecar_path(&st, path, sizeof(path), 0);
+	if (access(path, F_OK) == 0)
+		sidecar_store(fd, attribute, 0, NULL, 0);
+}
+
+
+static ssize_t
+get_sidecar_attr(int fd, const char *attribute, off_t pos, void *buffer,
+	size_t bufferSize, attr_info *info)
+{
+	char path[PATH_MAX];
+	char *data;
+	size_t size;
+	sidecar_entry entry;
+	struct stat st;
+	ssize_t result;
+
+	if (fstat(fd, &st) < 0)
+		return -1;
+	sidecar_path(&st, path, sizeof(path), 0);
+	if (sidecar_load(fd, path, &data, &size) < 0)
+		return -1;
+	if (!sidecar_find(data, size, attribute, &entry)) {
+		free(data);
+		errno = ENODATA;
+		return -1;
+	}
+	info->type = entry.type;
+	info->size = entry.size;
+	result = copy_value(entry.value, entry.size, pos, buffer, bufferSize);
+	free(data);
+	return result;
+}
+
+
 #if defined(COSMOE_ATTRIBUTES)
-	return fsetxattr(fd, attribute, buffer, readBytes, 0);
+static int
+make_xattr_name(const char *attribute, char *name)
+{
+	if (strlen(ATTRIBUTE_PREFIX) + strlen(attribute) >= MAX_XATTR_NAME_LENGTH) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(name, ATTRIBUTE_PREFIX);
+	strcat(name, attribute);
+	return 0;
+}
+#endif
+
+
+/* Fills in \a info and copies the value of the attribute from \a pos on
+** into \a buffer, which may be NULL. Small attributes take a single
+** fgetxattr(). */
+static ssize_t
+get_attr(int fd, const char *attribute, off_t pos, void *buffer,
+	size_t bufferSize, attr_info *info)
+{
+#if defined(COSMOE_ATTRIBUTES)
+	char name[MAX_XATTR_NAME_LENGTH];
+	char small[SMALL_ATTRIBUTE_SIZE];
+	char *raw = small;
+	size_t rawSize = sizeof(small);
+	ssize_t length, result;
+	attr_header header;
+	sidecar_stub stub;
+
+	if (make_xattr_name(attribute, name) < 0)
+		return -1;
+	if (buffer != NULL && pos >= 0
+		&& (uint64)pos + bufferSize + sizeof(header) > rawSize
+		&& pos + bufferSize < SSIZE_MAX) {
+		rawSize = sizeof(header) + pos + bufferSize;
+		raw = malloc(rawSize);
+		if (raw == NULL)
+			return -1;
+	}
+	length = fgetxattr(fd, name, raw, rawSize);
+	while (length < 0 && errno == ERANGE) {
+		if (raw != small)
+			free(raw);
+		raw = NULL;
+		length = fgetxattr(fd, name, NULL, 0);
+		if (length < 0)
+			break;
+		rawSize = length;
+		raw = malloc(rawSize + 1);
+		if (raw == NULL)
+			return -1;
+		length = fgetxattr(fd, name, raw, rawSize);
+	}
+	if (length < 0) {
+		if (raw != small)
+			free(raw);
+		if (errno != ENOTSUP)
+			return -1;
+		return get_sidecar_attr(fd, attribute, pos, buffer, bufferSize, info);
+	}
+
+	if ((size_t)length >= sizeof(header))
+		memcpy(&header, raw, sizeof(header));
+	else
+		header.magic = 0;
+	if (header.magic == ATTRIBUTE_MAGIC) {
+		info->type = header.type;
+		info->size = length - sizeof(header);
+		result = copy_value(raw + sizeof(header), info->size, pos, buffer,
+			bufferSize);
+	} else if (header.magic == SIDECAR_STUB_MAGIC
+		&& length == sizeof(stub)) {
+		result = get_sidecar_attr(fd, attribute, pos, buffer, bufferSize,
+			info);
+		// the value went away with a stale sidecar, so does the stub
+		if (result < 0 && errno == ENODATA) {
+			fremovexattr(fd, name);
+			errno = ENODATA;
+		}
+	} else {
+		// not written by us
+		info->type = B_RAW_TYPE;
+		info->size = length;
+		result = copy_value(raw, length, pos, buffer, bufferSize);
+	}
+	if (raw != small)
+		free(raw);
+	return result;
 #else
-	printf( "Cosmoe: UNSUPPORTED: fsetxattr\n" );
-	return (ssize_t)-1;
+	return get_sidecar_attr(fd, attribute, pos, buffer, bufferSize, info);
 #endif
 }
 
-ssize_t	fs_read_attr(int fd, const char *attribute, uint32 type, off_t pos, void *buffer, size_t readBytes)
+
+/* Replaces the whole value of the attribute. */
+static int
+put_attr(int fd, const char *attribute, uint32 type, const void *value,
+	size_t size)
 {
 #if defined(COSMOE_ATTRIBUTES)
-	return fgetxattr(fd, attribute, buffer, readBytes);
-#else
-	printf( "Cosmoe: UNSUPPORTED: fs_read_attr\n" );
-	return (ssize_t)-1;
+	char name[MAX_XATTR_NAME_LENGTH];
+	char *raw;
+	attr_header header;
+	sidecar_stub stub;
+	int result;
+
+	if (make_xattr_name(attribute, name) < 0)
+		return -1;
+	raw = malloc(sizeof(header) + size);
+	if (raw == NULL)
+		return -1;
+	header.magic = ATTRIBUTE_MAGIC;
+	header.type = type;
+	memcpy(raw, &header, sizeof(header));
+	memcpy(raw + sizeof(header), value, size);
+	result = fsetxattr(fd, name, raw, sizeof(header) + size, 0);
+	free(raw);
+	if (result == 0) {
+		sidecar_drop(fd, attribute);
+		return 0;
+	}
+
+	if (errno == E2BIG || errno == ENOSPC || errno == ERANGE) {
+		// too large for an extended attribute
+		if (sidecar_store(fd, attribute, type, value, size) < 0)
+			return -1;
+		stub.header.magic = SIDECAR_STUB_MAGIC;
+		stub.header.type = type;
+		stub.size = size;
+		return fsetxattr(fd, name, &stub, sizeof(stub), 0);
+	}
+	if (errno != ENOTSUP)
+		return -1;
 #endif
+	return sidecar_store(fd, attribute, type, value, size);
+}
+
+
+ssize_t	fs_write_attr(int fd, const char *attribute, uint32 type, off_t pos, const void *buffer, size_t readBytes)
+{
+	attr_info info;
+	char *value;
+	off_t size;
+	int result;
+
+	if (attribute == NULL || buffer == NULL || pos < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// like on BFS, writing at the start replaces the attribute
+	if (pos == 0)
+		return (put_attr(fd, attribute, type, buffer, readBytes) < 0 ? -1 : (ssize_t)readBytes);
+
+	if (get_attr(fd, attribute, 0, NULL, 0, &info) < 0) {
+		if (errno != ENODATA)
+			return -1;
+		info.size = 0;
+	}
+	size = info.size;
+	if (pos + (off_t)readBytes > size)
+		size = pos + readBytes;
+	value = calloc(size, 1);
+	if (value == NULL)
+		return -1;
+	if (info.size > 0
+		&& get_attr(fd, attribute, 0, value, info.size, &info) < 0) {
+		free(value);
+		return -1;
+	}
+	memcpy(value + pos, buffer, readBytes);
+	result = put_attr(fd, attribute, type, value, size);
+	free(value);
+	return (result < 0 ? -1 : (ssize_t)readBytes);
+}
+
+ssize_t	fs_read_attr(int fd, const char *attribute, uint32 type, off_t pos, void *buffer, size_t readBytes)
+{
+	attr_info info;
+
+	if (attribute == NULL || buffer == NULL || pos < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return get_attr(fd, attribute, pos, buffer, readBytes, &info);
 }
 
 int		fs_remove_attr(int fd, const char *attribute)
 {
 #if defined(COSMOE_ATTRIBUTES)
-	return fremovexattr(fd, attribute);
-#else
-	printf( "Cosmoe: UNSUPPORTED: fs_remove_attr\n" );
-	return -1;
+	char name[MAX_XATTR_NAME_LENGTH];
 #endif
+
+	if (attribute == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+#if defined(COSMOE_ATTRIBUTES)
+	if (make_xattr_name(attribute, name) < 0)
+		return -1;
+	if (fremovexattr(fd, name) == 0) {
+		sidecar_drop(fd, attribute);
+		return 0;
+	}
+	if (errno != ENOTSUP)
+		return -1;
+#endif
+	return sidecar_store(fd, attribute, 0, NULL, 0);
 }
 
 int		fs_stat_attr(int fd, const char *attribute, struct attr_info *attrInfo)
 {
-	printf( "Cosmoe: UNIMPLEMENTED: fs_stat_attr\n" );
-	return -1;
+	if (attribute == NULL || attrInfo == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	return (get_attr(fd, attribute, 0, NULL, 0, attrInfo) < 0 ? -1 : 0);
 }
 
-status_t _kstart_watching_vnode_(dev_t device, ino_t node,
-											uint32 flags, port_id port,
-											int32 handlerToken)
+
+/* Collects the names of the attributes of the node; they're stored one
+** after the other, each terminated by a null. */
+static int
+read_attr_names(attr_dir *dir)
 {
-	return B_ERROR;
+	char path[PATH_MAX];
+	sidecar_entry entry;
+	struct stat st;
+	char *data;
+	size_t size, offset = 0;
+#if defined(COSMOE_ATTRIBUTES)
+	ssize_t length;
+	size_t prefixLength = strlen(ATTRIBUTE_PREFIX);
+	char *list, *name, *next;
+#endif
+
+	free(dir->names);
+	dir->names = NULL;
+	dir->size = 0;
+	dir->offset = 0;
+
+#if defined(COSMOE_ATTRIBUTES)
+	length = flistxattr(dir->fd, NULL, 0);
+	while (length >= 0) {
+		list = malloc(length + 1);
+		if (list == NULL)
+			return -1;
+		length = flistxattr(dir->fd, list, length);
+		if (length < 0) {
+			free(list);
+			if (errno != ERANGE)
+				return -1;
+			length = flistxattr(dir->fd, NULL, 0);
+			continue;
+		}
+
+		// keep the names in our namespace, without the prefix
+		for (name = list; name < list + length; name = next) {
+			next = name + strlen(name) + 1;
+			if (strncmp(name, ATTRIBUTE_PREFIX, prefixLength) == 0) {
+				memmove(list + dir->size, name + prefixLength,
+					next - name - prefixLength);
+				dir->size += next - name - prefixLength;
+			}
+		}
+		dir->names = list;
+		return 0;
+	}
+	if (errno != ENOTSUP)
+		return -1;
+#endif
+
+	if (fstat(dir->fd, &st) < 0)
+		return -1;
+	sidecar_path(&st, path, sizeof(path), 0);
+	if (sidecar_load(dir->fd, path, &data, &size) < 0)
+		return -1;
+	// the names are moved to the front of the buffer
+	while (sidecar_next(data, size, &offset, &entry)) {
+		memmove(data + dir->size, entry.name, strlen(entry.name) + 1);
+		dir->size += strlen(entry.name) + 1;
+	}
+	dir->names = data;
+	return 0;
 }
 
-/*!	\brief Unsubscribes a target from watching a node.
-	\param device The device the node resides on (node_ref::device).
-	\param node The node ID of the node (node_ref::device).
-	\param port The port of the target (a looper port).
-	\param handlerToken The token of the target handler. \c -2, if the
-		   preferred handler of the looper is the target.
-	\return \c B_OK, if everything went fine, another error code otherwise.
-*/
-status_t _kstop_watching_vnode_(dev_t device, ino_t node,
-										   port_id port, int32 handlerToken)
+DIR		*fs_fopen_attr_dir(int fd)
 {
-	return B_ERROR;
+	attr_dir *dir = calloc(1, sizeof(attr_dir));
+	if (dir == NULL)
+		return NULL;
+	dir->fd = dup(fd);
+	if (dir->fd < 0 || read_attr_names(dir) < 0) {
+		if (dir->fd >= 0)
+			close(dir->fd);
+		free(dir);
+		return NULL;
+	}
+	return (DIR *)dir;
 }
 
+DIR		*fs_open_attr_dir(const char *path)
+{
+	DIR *dir;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	dir = fs_fopen_attr_dir(fd);
+	close(fd);
+	return dir;
+}
 
-/*!	\brief Unsubscribes a target from node and mount monitoring.
-	\param port The port of the target (a looper port).
-	\param handlerToken The token of the target handler. \c -2, if the
-		   preferred handler of the looper is the target.
-	\return \c B_OK, if everything went fine, another error code otherwise.
-*/
-status_t _kstop_notifying_(port_id port, int32 handlerToken)
+int		fs_close_attr_dir(DIR *_dir)
+{
+	attr_dir *dir = (attr_dir *)_dir;
+	if (dir == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	close(dir->fd);
+	free(dir->names);
+	free(dir);
+	return 0;
+}
+
+struct dirent *fs_read_attr_dir(DIR *_dir)
+{
+	attr_dir *dir = (attr_dir *)_dir;
+	const char *name;
+	size_t length;
+
+	if (dir == NULL || dir->offset >= dir->size)
+		return NULL;
+	name = dir->names + dir->offset;
+	length = strlen(name);
+	dir->offset += length + 1;
+	if (length >= sizeof(dir->entry.d_name))
+		length = sizeof(dir->entry.d_name) - 1;
+	dir->entry.d_ino = 0;
+	dir->entry.d_reclen = sizeof(dir->entry);
+	memcpy(dir->entry.d_name, name, length);
+	dir->entry.d_name[length] = '\0';
+	return &dir->entry;
+}
+
+/* The names are read again, so that the attributes written in the meantime
+** show up. */
+void	fs_rewind_attr_dir(DIR *_dir)
 {
-	return B_ERROR;
+	attr_dir *dir = (attr_dir *)_dir;
+	if (dir != NULL)
+		read_attr_names(dir);
 }
 
+/* Removes the sidecar of a node, if it has one. Called when the last link
+** to the node has been removed; the attributes kept in extended attributes
+** go away with the node by themselves. */
+int		fs_remove_attr_sidecar(dev_t device, ino_t node)
+{
+	char path[PATH_MAX];
+	struct stat st;
 
+	st.st_dev = device;
+	st.st_ino = node;
+	sidecar_path(&st, path, sizeof(path), 0);
+	if (unlink(path) < 0 && errno != ENOENT)
+		return -1;
+	return 0;
+}
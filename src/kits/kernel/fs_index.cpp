@@ -0,0 +1,50 @@
+/*
+** Distributed under the terms of the OpenBeOS License.
+*/
+
+/* The index functions are forwarded to the registrar's index manager via
+** the storage kit's kernel interface.
+*/
+
+
+#include <fs_index.h>
+
+#include <errno.h>
+
+#include "kernel_interface.h"
+
+
+int
+fs_create_index(dev_t device, const char *name, uint32 type, uint32 flags)
+{
+	status_t error = BPrivate::Storage::create_index(device, name, type, flags);
+	if (error != B_OK) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+
+int
+fs_remove_index(dev_t device, const char *name)
+{
+	status_t error = BPrivate::Storage::remove_index(device, name);
+	if (error != B_OK) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+
+int
+fs_stat_index(dev_t device, const char *name, struct index_info *indexInfo)
+{
+	status_t error = BPrivate::Storage::stat_index(device, name, indexInfo);
+	if (error != B_OK) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
@@ -40,6 +40,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #if defined(linux)
 #include <sys/sysinfo.h>
@@ -185,11 +186,12 @@ bigtime_t
 system_time(void)
 {
 #if defined(linux)
-	struct sysinfo sinfo;
+	struct timespec ts;
 
-	if (sysinfo(&sinfo) == 0)
+	/* sysinfo() only counts whole seconds, which is useless for timing */
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
 	{
-		return (bigtime_t) sinfo.uptime * 1000000;
+		return (bigtime_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 	}
 #endif
 	return 0;
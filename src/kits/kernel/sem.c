@@ -249,7 +249,7 @@ status_t acquire_sem_etc(sem_id id,
 	int member = id % SEMMSL;
 	struct sembuf sem_lock = {member, -count, 0};
 	struct timespec tmout;
-	int err;
+	status_t err;
 
 	TRACE(("acquire_sem_etc(%ld): enter\n", id));
 
@@ -365,6 +365,14 @@ status_t get_sem_count(sem_id id,
 	if (semcount == SEMVMX)
 		return B_BAD_SEM_ID;
 
+	// Like on BeOS, a negative count is the number of threads waiting
+	if (semcount == 0)
+	{
+		int waiting = semctl(group, member, GETNCNT, 0);
+		if (waiting > 0)
+			semcount = -waiting;
+	}
+
 	// If thread_count is valid, set it
 	if (thread_count)
 	{
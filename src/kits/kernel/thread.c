@@ -482,16 +482,17 @@ resume_thread(thread_id id)
 			{
 				case B_THREAD_SPAWNED:
 				{
-					pthread_t tid;
-
-					if (pthread_create(&tid, NULL, (pthread_entry)thread_table[i].func,
+					/* let pthread_create() fill in the entry itself, so that */
+					/* find_thread(NULL) already works in the new thread     */
+					if (pthread_create(&thread_table[i].pth, NULL,
+										(pthread_entry)thread_table[i].func,
 										thread_table[i].data) == 0)
 					{
-						thread_table[i].pth = tid;
 						thread_table[i].state = B_THREAD_RUNNING;
 						return B_OK;
 					}
 
+					thread_table[i].pth = -1;
 					return B_ERROR;
 				}
 
@@ -624,10 +624,12 @@ BDirectory::GetNextRef(entry_ref *ref)
 			}
 		}
 		if (error == B_OK) {
-#if 0
-			*ref = entry_ref(entry.d_dev, entry.d_ino, entry.d_name);
-#endif
+			// the entry's directory is this one
+			error = BPrivate::Storage::dir_to_node(fDirFd, ref->device,
+				ref->directory);
 		}
+		if (error == B_OK)
+			error = ref->set_name(entry.d_name);
 	}
 	return error;
 }
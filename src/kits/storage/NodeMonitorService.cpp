@@ -0,0 +1,915 @@
+//----------------------------------------------------------------------
+//  This software is part of the OpenBeOS distribution and is covered
+//  by the OpenBeOS license.
+//---------------------------------------------------------------------
+/*!
+	\file NodeMonitorService.cpp
+	The node monitor, implemented with inotify.
+*/
+
+#include <errno.h>
+#include <limits.h>
+#include <new>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <Autolock.h>
+#include <List.h>
+#include <Locker.h>
+#include <Message.h>
+#include <NodeMonitor.h>
+#include <OS.h>
+
+#include <MessageUtils.h>
+#include <TokenSpace.h>
+
+#include "kernel_interface.h"
+
+/*	Every team has one inotify instance, which is created when the first node
+	is watched, and a thread reading its events. A node is watched once, no
+	matter how many targets watch it, with the union of what they are
+	interested in.
+
+	inotify only knows paths, so a node_ref is turned into a path when it
+	starts being watched; see BPrivate::Storage::node_ref_to_path(). After
+	that the watch stays with the node, even if it's moved.
+
+	inotify doesn't tell the inode numbers of entries that are removed from
+	a directory, so the entries of watched directories are kept in a list
+	sorted by name.
+
+	Events are collected for a moment after the first one arrives, and stat
+	and attribute changes of a node in that batch are sent to a target only
+	once, so writing a file doesn't flood the targets with B_STAT_CHANGED.
+
+	Mount watching is accepted, but inotify has no mount events, so nothing
+	is ever sent for it.
+*/
+
+//! Time to wait for more events after the first one of a batch
+static const int kCoalesceTimeout = 10;		// milliseconds
+//! Time a full target port may block the watcher thread
+static const bigtime_t kSendTimeout = 50000;
+//! Size of the buffer events are read into
+static const size_t kEventBufferSize = 32768;
+
+struct monitor_listener {
+	port_id	port;
+	int32	token;
+	uint32	flags;
+};
+
+struct monitor_entry {
+	ino_t	node;
+	char	*name;
+};
+
+struct node_watch {
+	dev_t	device;
+	ino_t	node;
+	ino_t	directory;		// parent directory, for B_WATCH_NAME
+	int		descriptor;		// inotify watch descriptor
+	char	*path;
+	uint32	flags;			// union of the listeners' flags
+	BList	listeners;
+	BList	*entries;		// monitor_entry, only with B_WATCH_DIRECTORY
+};
+
+struct pending_move {
+	uint32		cookie;
+	node_watch	*from;
+	ino_t		node;
+	char		name[B_FILE_NAME_LENGTH];
+};
+
+struct pending_notification {
+	port_id		port;
+	int32		token;
+	BMessage	*message;
+};
+
+class NodeMonitorService {
+public:
+	static NodeMonitorService *Default();
+
+	status_t StartWatching(dev_t device, ino_t node, uint32 flags,
+		port_id port, int32 token);
+	status_t StopWatching(dev_t device, ino_t node, port_id port, int32 token);
+	status_t StopNotifying(port_id port, int32 token);
+
+private:
+	NodeMonitorService();
+
+	node_watch *_FindWatch(dev_t device, ino_t node) const;
+	node_watch *_FindWatch(int descriptor) const;
+	status_t _UpdateWatch(node_watch *watch);
+	void _RemoveWatch(node_watch *watch);
+	void _ReadEntries(node_watch *watch);
+	void _RemoveListeners(port_id port, int32 token, bool anyToken);
+
+	static int32 _WatcherThread(void *data);
+	void _ReadEvents();
+	void _HandleEvent(const inotify_event *event, BList &moves,
+		BList &notifications);
+	void _Notify(node_watch *watch, uint32 flag, BMessage *message,
+		BList &notifications, const node_watch *skip = NULL);
+	void _Send(BList &notifications);
+
+	BLocker		fLock;
+	int			fFD;
+	thread_id	fThread;
+	BList		fWatches;
+	BList		fMountListeners;
+};
+
+static NodeMonitorService *sDefaultService = NULL;
+static BLocker sDefaultServiceLock("node monitor");
+
+
+// entry list helpers
+
+static int
+compare_entries(const void *a, const void *b)
+{
+	return strcmp((*(const monitor_entry**)a)->name,
+		(*(const monitor_entry**)b)->name);
+}
+
+// find_entry
+/*!	\brief Looks up an entry in the sorted entry list of a directory.
+	\param entries The list.
+	\param name The name of the entry.
+	\param found Set to whether the entry is in the list.
+	\return The index of the entry, or the index it would be inserted at.
+*/
+static int32
+find_entry(BList *entries, const char *name, bool *found)
+{
+	int32 lower = 0;
+	int32 upper = entries->CountItems();
+	while (lower < upper) {
+		int32 middle = (lower + upper) / 2;
+		int cmp = strcmp(((monitor_entry*)entries->ItemAt(middle))->name, name);
+		if (cmp == 0) {
+			*found = true;
+			return middle;
+		}
+		if (cmp < 0)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+	*found = false;
+	return lower;
+}
+
+static void
+add_entry(BList *entries, const char *name, ino_t node)
+{
+	bool found;
+	int32 index = find_entry(entries, name, &found);
+	if (found) {
+		((monitor_entry*)entries->ItemAt(index))->node = node;
+		return;
+	}
+	monitor_entry *entry = new(std::nothrow) monitor_entry;
+	if (entry == NULL)
+		return;
+	entry->node = node;
+	entry->name = strdup(name);
+	if (entry->name == NULL || !entries->AddItem(entry, index)) {
+		free(entry->name);
+		delete entry;
+	}
+}
+
+// remove_entry
+/*!	\return The inode number the entry had, or \c -1, if it wasn't known.
+*/
+static ino_t
+remove_entry(BList *entries, const char *name)
+{
+	bool found;
+	int32 index = find_entry(entries, name, &found);
+	if (!found)
+		return (ino_t)-1;
+	monitor_entry *entry = (monitor_entry*)entries->RemoveItem(index);
+	ino_t node = entry->node;
+	free(entry->name);
+	delete entry;
+	return node;
+}
+
+static void
+free_entries(BList *entries)
+{
+	if (entries == NULL)
+		return;
+	for (int32 i = 0; monitor_entry *entry = (monitor_entry*)entries->ItemAt(i); i++) {
+		free(entry->name);
+		delete entry;
+	}
+	delete entries;
+}
+
+// inotify_mask_for
+/*!	\brief Returns the inotify events needed for node monitor flags.
+*/
+static uint32
+inotify_mask_for(uint32 flags)
+{
+	// deletion is always watched, to drop the watch with the node
+	uint32 mask = IN_DELETE_SELF | IN_DONT_FOLLOW;
+	if (flags & B_WATCH_NAME)
+		mask |= IN_MOVE_SELF;
+	if (flags & (B_WATCH_STAT | B_WATCH_ATTR))
+		mask |= IN_ATTRIB;
+	if (flags & B_WATCH_STAT)
+		mask |= IN_MODIFY;
+	if (flags & B_WATCH_DIRECTORY)
+		mask |= IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+	return mask;
+}
+
+// parent_directory
+/*!	\brief Returns the inode number of the directory an entry is in.
+*/
+static ino_t
+parent_directory(const char *path)
+{
+	char parent[B_PATH_NAME_LENGTH];
+	strncpy(parent, path, sizeof(parent) - 1);
+	parent[sizeof(parent) - 1] = '\0';
+	char *slash = strrchr(parent, '/');
+	if (slash == NULL)
+		return (ino_t)-1;
+	if (slash == parent)
+		slash[1] = '\0';
+	else
+		*slash = '\0';
+
+	BPrivate::Storage::Stat st;
+	if (lstat(parent, &st) < 0)
+		return (ino_t)-1;
+	return st.st_ino;
+}
+
+
+// NodeMonitorService
+
+NodeMonitorService::NodeMonitorService()
+	: fLock("node monitor service"),
+	  fFD(-1),
+	  fThread(-1)
+{
+}
+
+// Default
+/*!	\brief Returns the node monitor service of this team, creating it if
+		   necessary.
+*/
+NodeMonitorService *
+NodeMonitorService::Default()
+{
+	BAutolock locker(sDefaultServiceLock);
+	if (sDefaultService == NULL)
+		sDefaultService = new(std::nothrow) NodeMonitorService;
+	return sDefaultService;
+}
+
+status_t
+NodeMonitorService::StartWatching(dev_t device, ino_t node, uint32 flags,
+	port_id port, int32 token)
+{
+	BAutolock locker(fLock);
+
+	// mount watching
+	if (flags == 0) {
+		for (int32 i = 0; monitor_listener *listener
+				= (monitor_listener*)fMountListeners.ItemAt(i); i++) {
+			if (listener->port == port && listener->token == token)
+				return B_OK;
+		}
+		monitor_listener *listener = new(std::nothrow) monitor_listener;
+		if (listener == NULL)
+			return B_NO_MEMORY;
+		listener->port = port;
+		listener->token = token;
+		listener->flags = B_WATCH_MOUNT;
+		fMountListeners.AddItem(listener);
+		return B_OK;
+	}
+
+	if (fFD < 0) {
+		fFD = inotify_init();
+		if (fFD < 0)
+			return errno;
+		fThread = spawn_thread(_WatcherThread, "node monitor",
+			B_NORMAL_PRIORITY, this);
+		if (fThread < 0 || resume_thread(fThread) != B_OK) {
+			close(fFD);
+			fFD = -1;
+			return B_ERROR;
+		}
+	}
+
+	node_watch *watch = _FindWatch(device, node);
+	bool added = false;
+	if (watch == NULL) {
+		char path[B_PATH_NAME_LENGTH];
+		status_t error = BPrivate::Storage::node_ref_to_path(device, node,
+			path, sizeof(path));
+		if (error != B_OK)
+			return error;
+
+		watch = new(std::nothrow) node_watch;
+		if (watch == NULL)
+			return B_NO_MEMORY;
+		watch->device = device;
+		watch->node = node;
+		watch->directory = parent_directory(path);
+		watch->descriptor = -1;
+		watch->path = strdup(path);
+		watch->flags = 0;
+		watch->entries = NULL;
+		fWatches.AddItem(watch);
+		added = true;
+	}
+
+	monitor_listener *listener = NULL;
+	for (int32 i = 0; monitor_listener *candidate
+			= (monitor_listener*)watch->listeners.ItemAt(i); i++) {
+		if (candidate->port == port && candidate->token == token) {
+			listener = candidate;
+			break;
+		}
+	}
+	if (listener == NULL) {
+		listener = new(std::nothrow) monitor_listener;
+		if (listener != NULL) {
+			listener->port = port;
+			listener->token = token;
+			listener->flags = 0;
+			watch->listeners.AddItem(listener);
+		}
+	}
+	if (listener == NULL) {
+		if (added)
+			_RemoveWatch(watch);
+		return B_NO_MEMORY;
+	}
+	listener->flags |= flags;
+
+	status_t error = _UpdateWatch(watch);
+	if (error != B_OK)
+		StopWatching(device, node, port, token);
+	return error;
+}
+
+status_t
+NodeMonitorService::StopWatching(dev_t device, ino_t node, port_id port,
+	int32 token)
+{
+	BAutolock locker(fLock);
+
+	node_watch *watch = _FindWatch(device, node);
+	if (watch == NULL)
+		return B_BAD_VALUE;
+
+	for (int32 i = 0; monitor_listener *listener
+			= (monitor_listener*)watch->listeners.ItemAt(i); i++) {
+		if (listener->port == port && listener->token == token) {
+			watch->listeners.RemoveItem(i);
+			delete listener;
+			if (watch->listeners.IsEmpty())
+				_RemoveWatch(watch);
+			else
+				_UpdateWatch(watch);
+			return B_OK;
+		}
+	}
+	return B_BAD_VALUE;
+}
+
+status_t
+NodeMonitorService::StopNotifying(port_id port, int32 token)
+{
+	BAutolock locker(fLock);
+	_RemoveListeners(port, token, false);
+	return B_OK;
+}
+
+node_watch *
+NodeMonitorService::_FindWatch(dev_t device, ino_t node) const
+{
+	for (int32 i = 0; node_watch *watch = (node_watch*)fWatches.ItemAt(i); i++) {
+		if (watch->device == device && watch->node == node)
+			return watch;
+	}
+	return NULL;
+}
+
+node_watch *
+NodeMonitorService::_FindWatch(int descriptor) const
+{
+	for (int32 i = 0; node_watch *watch = (node_watch*)fWatches.ItemAt(i); i++) {
+		if (watch->descriptor == descriptor)
+			return watch;
+	}
+	return NULL;
+}
+
+// _UpdateWatch
+/*!	\brief Makes the inotify watch of a node match its listeners' flags.
+*/
+status_t
+NodeMonitorService::_UpdateWatch(node_watch *watch)
+{
+	uint32 flags = 0;
+	for (int32 i = 0; monitor_listener *listener
+			= (monitor_listener*)watch->listeners.ItemAt(i); i++) {
+		flags |= listener->flags;
+	}
+	if (watch->descriptor >= 0 && flags == watch->flags)
+		return B_OK;
+
+	int descriptor = inotify_add_watch(fFD, watch->path, inotify_mask_for(flags));
+	if (descriptor < 0)
+		return errno;
+	watch->descriptor = descriptor;
+
+	if ((flags & B_WATCH_DIRECTORY) != 0 && watch->entries == NULL)
+		_ReadEntries(watch);
+	else if ((flags & B_WATCH_DIRECTORY) == 0) {
+		free_entries(watch->entries);
+		watch->entries = NULL;
+	}
+	watch->flags = flags;
+	return B_OK;
+}
+
+void
+NodeMonitorService::_RemoveWatch(node_watch *watch)
+{
+	if (watch->descriptor >= 0)
+		inotify_rm_watch(fFD, watch->descriptor);
+	fWatches.RemoveItem(watch);
+
+	for (int32 i = 0; monitor_listener *listener
+			= (monitor_listener*)watch->listeners.ItemAt(i); i++) {
+		delete listener;
+	}
+	free_entries(watch->entries);
+	free(watch->path);
+	delete watch;
+}
+
+// _ReadEntries
+/*!	\brief Reads the entries of a directory that starts being watched.
+*/
+void
+NodeMonitorService::_ReadEntries(node_watch *watch)
+{
+	watch->entries = new(std::nothrow) BList(64);
+	if (watch->entries == NULL)
+		return;
+
+	DIR *dir = opendir(watch->path);
+	if (dir == NULL)
+		return;
+	while (dirent *entry = readdir(dir)) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+		monitor_entry *item = new(std::nothrow) monitor_entry;
+		if (item == NULL)
+			break;
+		item->node = entry->d_ino;
+		item->name = strdup(entry->d_name);
+		if (item->name == NULL) {
+			delete item;
+			break;
+		}
+		watch->entries->AddItem(item);
+	}
+	closedir(dir);
+
+	watch->entries->SortItems(compare_entries);
+}
+
+// _RemoveListeners
+/*!	\brief Removes a target from every watch.
+	\param anyToken Whether to remove all targets of the port, for ports that
+		   are gone.
+*/
+void
+NodeMonitorService::_RemoveListeners(port_id port, int32 token, bool anyToken)
+{
+	for (int32 i = fWatches.CountItems() - 1; i >= 0; i--) {
+		node_watch *watch = (node_watch*)fWatches.ItemAt(i);
+		bool changed = false;
+		for (int32 k = watch->listeners.CountItems() - 1; k >= 0; k--) {
+			monitor_listener *listener
+				= (monitor_listener*)watch->listeners.ItemAt(k);
+			if (listener->port == port && (anyToken || listener->token == token)) {
+				watch->listeners.RemoveItem(k);
+				delete listener;
+				changed = true;
+			}
+		}
+		if (watch->listeners.IsEmpty())
+			_RemoveWatch(watch);
+		else if (changed)
+			_UpdateWatch(watch);
+	}
+
+	for (int32 i = fMountListeners.CountItems() - 1; i >= 0; i--) {
+		monitor_listener *listener
+			= (monitor_listener*)fMountListeners.ItemAt(i);
+		if (listener->port == port && (anyToken || listener->token == token)) {
+			fMountListeners.RemoveItem(i);
+			delete listener;
+		}
+	}
+}
+
+int32
+NodeMonitorService::_WatcherThread(void *data)
+{
+	((NodeMonitorService*)data)->_ReadEvents();
+	return 0;
+}
+
+// _ReadEvents
+/*!	\brief Reads batches of events and passes them on, for as long as the
+		   team lives.
+*/
+void
+NodeMonitorService::_ReadEvents()
+{
+	char *buffer = (char*)malloc(kEventBufferSize);
+	if (buffer == NULL)
+		return;
+
+	const size_t maxEventSize = sizeof(inotify_event) + NAME_MAX + 1;
+	while (true) {
+		ssize_t bytes = read(fFD, buffer, kEventBufferSize);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		// collect what else happens in a moment, to coalesce bursts
+		pollfd pfd;
+		pfd.fd = fFD;
+		pfd.events = POLLIN;
+		while ((size_t)bytes + maxEventSize <= kEventBufferSize
+			&& poll(&pfd, 1, kCoalesceTimeout) > 0) {
+			ssize_t more = read(fFD, buffer + bytes, kEventBufferSize - bytes);
+			if (more <= 0)
+				break;
+			bytes += more;
+		}
+
+		BList moves;
+		BList notifications;
+		if (fLock.Lock()) {
+			for (ssize_t offset = 0; offset < bytes; ) {
+				const inotify_event *event
+					= (const inotify_event*)(buffer + offset);
+				_HandleEvent(event, moves, notifications);
+				offset += sizeof(inotify_event) + event->len;
+			}
+
+			// moves whose other half happened outside of the watched
+			// directories are plain removals and creations
+			for (int32 i = 0; pending_move *move = (pending_move*)moves.ItemAt(i); i++) {
+				if (move->from != NULL) {
+					BMessage *message = new BMessage(B_NODE_MONITOR);
+					message->AddInt32("opcode", B_ENTRY_REMOVED);
+					message->AddInt32("device", move->from->device);
+					message->AddInt64("directory", move->from->node);
+					message->AddInt64("node", move->node);
+					message->AddString("name", move->name);
+					_Notify(move->from, B_WATCH_DIRECTORY, message, notifications);
+				}
+				delete move;
+			}
+			fLock.Unlock();
+		}
+
+		_Send(notifications);
+	}
+	free(buffer);
+}
+
+// _HandleEvent
+/*!	\brief Turns an inotify event into node monitor messages.
+
+	Must be called with the service locked.
+
+	\param event The event.
+	\param moves Moves out of watched directories seen in this batch.
+	\param notifications The messages to send.
+*/
+void
+NodeMonitorService::_HandleEvent(const inotify_event *event, BList &moves,
+	BList &notifications)
+{
+	if (event->mask & IN_Q_OVERFLOW) {
+		fprintf(stderr, "node monitor: event queue overflow, events were lost\n");
+		return;
+	}
+
+	node_watch *watch = _FindWatch(event->wd);
+	if (watch == NULL)
+		return;
+
+	if (event->mask & IN_IGNORED) {
+		// the node is gone, and so is the watch
+		for (int32 i = 0; pending_move *move = (pending_move*)moves.ItemAt(i); i++) {
+			if (move->from == watch)
+				move->from = NULL;
+		}
+		watch->descriptor = -1;
+		_RemoveWatch(watch);
+		return;
+	}
+
+	const char *name = event->len > 0 ? event->name : NULL;
+	BPrivate::Storage::Stat st;
+
+	if (name == NULL) {
+		// events of the node itself
+		if (event->mask & IN_DELETE_SELF) {
+			BPrivate::Storage::uncache_path(watch->path);
+			BMessage *message = new BMessage(B_NODE_MONITOR);
+			message->AddInt32("opcode", B_ENTRY_REMOVED);
+			message->AddInt32("device", watch->device);
+			message->AddInt64("directory", watch->directory);
+			message->AddInt64("node", watch->node);
+			_Notify(watch, B_WATCH_NAME, message, notifications);
+		}
+		if (event->mask & IN_MOVE_SELF) {
+			// inotify doesn't tell where it went, but an open node can be
+			// found again
+			BMessage *message = new BMessage(B_NODE_MONITOR);
+			message->AddInt32("opcode", B_ENTRY_MOVED);
+			message->AddInt32("device", watch->device);
+			message->AddInt64("from directory", watch->directory);
+			message->AddInt64("node", watch->node);
+			BPrivate::Storage::uncache_path(watch->path);
+
+			char path[B_PATH_NAME_LENGTH];
+			if (BPrivate::Storage::node_ref_to_path(watch->device,
+					watch->node, path, sizeof(path)) == B_OK) {
+				free(watch->path);
+				watch->path = strdup(path);
+				watch->directory = parent_directory(path);
+				message->AddInt64("to directory", watch->directory);
+				message->AddString("name", strrchr(path, '/') + 1);
+			}
+			_Notify(watch, B_WATCH_NAME, message, notifications);
+		}
+		if (event->mask & (IN_ATTRIB | IN_MODIFY)) {
+			BMessage *message = new BMessage(B_NODE_MONITOR);
+			message->AddInt32("opcode", B_STAT_CHANGED);
+			message->AddInt32("device", watch->device);
+			message->AddInt64("node", watch->node);
+			_Notify(watch, B_WATCH_STAT, message, notifications);
+		}
+		if (event->mask & IN_ATTRIB) {
+			// inotify doesn't tell which attribute changed
+			BMessage *message = new BMessage(B_NODE_MONITOR);
+			message->AddInt32("opcode", B_ATTR_CHANGED);
+			message->AddInt32("device", watch->device);
+			message->AddInt64("node", watch->node);
+			_Notify(watch, B_WATCH_ATTR, message, notifications);
+		}
+		return;
+	}
+
+	// events of the entries of a watched directory
+	if (watch->entries == NULL)
+		return;
+
+	char path[B_PATH_NAME_LENGTH];
+	snprintf(path, sizeof(path), "%s/%s", watch->path, name);
+
+	if (event->mask & IN_MOVED_FROM) {
+		BPrivate::Storage::uncache_path(path);
+		pending_move *move = new(std::nothrow) pending_move;
+		if (move == NULL)
+			return;
+		move->cookie = event->cookie;
+		move->from = watch;
+		move->node = remove_entry(watch->entries, name);
+		strncpy(move->name, name, sizeof(move->name) - 1);
+		move->name[sizeof(move->name) - 1] = '\0';
+		moves.AddItem(move);
+		return;
+	}
+
+	if (event->mask & IN_MOVED_TO) {
+		pending_move *move = NULL;
+		for (int32 i = 0; pending_move *candidate = (pending_move*)moves.ItemAt(i); i++) {
+			if (candidate->cookie == event->cookie) {
+				move = candidate;
+				break;
+			}
+		}
+
+		bool exists = (lstat(path, &st) == 0);
+		ino_t node = (exists ? st.st_ino : (move ? move->node : (ino_t)-1));
+		add_entry(watch->entries, name, node);
+		if (exists && S_ISDIR(st.st_mode))
+			BPrivate::Storage::cache_dir_path(watch->device, node, path);
+
+		if (move == NULL || move->from == NULL) {
+			// moved in from somewhere we don't watch
+			if (move != NULL) {
+				moves.RemoveItem(move);
+				delete move;
+			}
+			BMessage *message = new BMessage(B_NODE_MONITOR);
+			message->AddInt32("opcode", B_ENTRY_CREATED);
+			message->AddInt32("device", watch->device);
+			message->AddInt64("directory", watch->node);
+			message->AddInt64("node", node);
+			message->AddString("name", name);
+			_Notify(watch, B_WATCH_DIRECTORY, message, notifications);
+			return;
+		}
+
+		BMessage *message = new BMessage(B_NODE_MONITOR);
+		message->AddInt32("opcode", B_ENTRY_MOVED);
+		message->AddInt32("device", watch->device);
+		message->AddInt64("from directory", move->from->node);
+		message->AddInt64("to directory", watch->node);
+		message->AddInt64("node", node);
+		message->AddString("name", name);
+		if (move->from != watch) {
+			_Notify(move->from, B_WATCH_DIRECTORY, new BMessage(*message),
+				notifications);
+		}
+		_Notify(watch, B_WATCH_DIRECTORY, message, notifications, move->from);
+
+		moves.RemoveItem(move);
+		delete move;
+		return;
+	}
+
+	if (event->mask & IN_CREATE) {
+		ino_t node = (lstat(path, &st) == 0 ? st.st_ino : (ino_t)-1);
+		add_entry(watch->entries, name, node);
+
+		BMessage *message = new BMessage(B_NODE_MONITOR);
+		message->AddInt32("opcode", B_ENTRY_CREATED);
+		message->AddInt32("device", watch->device);
+		message->AddInt64("directory", watch->node);
+		message->AddInt64("node", node);
+		message->AddString("name", name);
+		_Notify(watch, B_WATCH_DIRECTORY, message, notifications);
+	}
+
+	if (event->mask & IN_DELETE) {
+		BPrivate::Storage::uncache_path(path);
+		BMessage *message = new BMessage(B_NODE_MONITOR);
+		message->AddInt32("opcode", B_ENTRY_REMOVED);
+		message->AddInt32("device", watch->device);
+		message->AddInt64("directory", watch->node);
+		message->AddInt64("node", remove_entry(watch->entries, name));
+		message->AddString("name", name);
+		_Notify(watch, B_WATCH_DIRECTORY, message, notifications);
+	}
+}
+
+// _Notify
+/*!	\brief Queues a message for the listeners of a watch interested in it.
+
+	Stat and attribute changes a listener has already been told about in
+	this batch are dropped. The message is deleted, or owned by the queue.
+
+	\param watch The watch.
+	\param flag The flag a listener must have to get the message.
+	\param message The message.
+	\param notifications The queue.
+	\param skip A watch whose listeners already got the message, or \c NULL.
+*/
+void
+NodeMonitorService::_Notify(node_watch *watch, uint32 flag, BMessage *message,
+	BList &notifications, const node_watch *skip)
+{
+	int32 opcode = message->FindInt32("opcode");
+	bool coalesce = (opcode == B_STAT_CHANGED || opcode == B_ATTR_CHANGED);
+
+	for (int32 i = 0; monitor_listener *listener
+			= (monitor_listener*)watch->listeners.ItemAt(i); i++) {
+		if ((listener->flags & flag) == 0)
+			continue;
+
+		bool duplicate = false;
+		if (skip != NULL) {
+			for (int32 k = 0; monitor_listener *other
+					= (monitor_listener*)skip->listeners.ItemAt(k); k++) {
+				if (other->port == listener->port
+					&& other->token == listener->token
+					&& (other->flags & flag) != 0) {
+					duplicate = true;
+					break;
+				}
+			}
+		}
+		for (int32 k = 0; coalesce && !duplicate && k < notifications.CountItems(); k++) {
+			pending_notification *queued
+				= (pending_notification*)notifications.ItemAt(k);
+			duplicate = queued->port == listener->port
+				&& queued->token == listener->token
+				&& queued->message->FindInt32("opcode") == opcode
+				&& queued->message->FindInt64("node") == (int64)watch->node;
+		}
+		if (duplicate)
+			continue;
+
+		pending_notification *notification
+			= new(std::nothrow) pending_notification;
+		if (notification == NULL)
+			break;
+		notification->port = listener->port;
+		notification->token = listener->token;
+		notification->message = new BMessage(*message);
+		notifications.AddItem(notification);
+	}
+	delete message;
+}
+
+// _Send
+/*!	\brief Sends queued messages to their targets, without the lock held.
+
+	Targets whose port is gone are removed.
+*/
+void
+NodeMonitorService::_Send(BList &notifications)
+{
+	for (int32 i = 0; pending_notification *notification
+			= (pending_notification*)notifications.ItemAt(i); i++) {
+		BMessage *message = notification->message;
+		_set_message_target_(message, notification->token,
+			notification->token == B_PREFERRED_TOKEN);
+
+		ssize_t size = message->FlattenedSize();
+		char *buffer = new(std::nothrow) char[size];
+		if (buffer != NULL && message->Flatten(buffer, size) == B_OK) {
+			status_t error;
+			do {
+				error = write_port_etc(notification->port, message->what,
+					buffer, size, B_RELATIVE_TIMEOUT, kSendTimeout);
+			} while (error == B_INTERRUPTED);
+
+			if (error == B_BAD_PORT_ID && fLock.Lock()) {
+				_RemoveListeners(notification->port, 0, true);
+				fLock.Unlock();
+			}
+		}
+		delete[] buffer;
+		delete message;
+		delete notification;
+	}
+	notifications.MakeEmpty();
+}
+
+
+// the private libroot functions the node monitor API is built on
+
+extern "C" status_t
+_kstart_watching_vnode_(dev_t device, ino_t node, uint32 flags, port_id port,
+	int32 handlerToken)
+{
+	NodeMonitorService *service = NodeMonitorService::Default();
+	if (service == NULL)
+		return B_NO_MEMORY;
+	return service->StartWatching(device, node, flags, port, handlerToken);
+}
+
+extern "C" status_t
+_kstop_watching_vnode_(dev_t device, ino_t node, port_id port,
+	int32 handlerToken)
+{
+	NodeMonitorService *service = NodeMonitorService::Default();
+	if (service == NULL)
+		return B_NO_MEMORY;
+	return service->StopWatching(device, node, port, handlerToken);
+}
+
+extern "C" status_t
+_kstop_notifying_(port_id port, int32 handlerToken)
+{
+	NodeMonitorService *service = NodeMonitorService::Default();
+	if (service == NULL)
+		return B_NO_MEMORY;
+	return service->StopNotifying(port, handlerToken);
+}
@@ -515,14 +515,15 @@ BQuery::Fetch()
 	_EvaluateStack();
 	if (!fPredicate || fDevice < 0)
 		return B_NO_INIT;
+	status_t error;
 	if (fLive) {
-		fQueryFd = open_live_query(fDevice, fPredicate, B_LIVE_QUERY, fPort,
+		error = open_live_query(fDevice, fPredicate, B_LIVE_QUERY, fPort,
 								fToken, fQueryFd);
 	} else
-		fQueryFd = open_query(fDevice, fPredicate, 0, fQueryFd);
-	if (fQueryFd < 0)
-		return fQueryFd;
-	return B_OK;
+		error = open_query(fDevice, fPredicate, 0, fQueryFd);
+	if (error != B_OK)
+		fQueryFd = -1;
+	return error;
 }
 
 
@@ -587,11 +588,10 @@ BQuery::GetNextRef(entry_ref *ref)
 			}
 		}
 		if (error == B_OK) {
-#if 0
-			ref->device = entry.d_pdev;
-			ref->directory = entry.d_pino;
+			// read_query() passes the directory in d_off
+			ref->device = fDevice;
+			ref->directory = entry.d_off;
 			error = ref->set_name(entry.d_name);
-#endif
 		}
 	}
 	return error;
@@ -17,15 +17,32 @@
 #include <fs_info.h>	//  File sytem information functions, structs, defines
 #include <fs_attr.h>	//  BeOS's C-based attribute functions
 #include <fs_query.h>	//  BeOS's C-based query functions
+#include <fs_index.h>	//  BeOS's C-based index functions
+#include <Autolock.h>
 #include <Entry.h>		// entry_ref
+#include <List.h>
+#include <Locker.h>
+#include <Message.h>
+#include <Messenger.h>
+#include <RegistrarDefs.h>
+#include <RosterPrivate.h>
+#include <TokenSpace.h>
 #include <dirent.h>
 
 #include <fsproto.h>
 
 #include <algorithm>
+#include <map>
 #include <new>
+#include <string>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <utime.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 // This is just for cout while developing; shouldn't need it
@@ -34,27 +51,17 @@
 
 using namespace std;
 
-// For convenience:
-//struct LongDIR : DIR { char _buffer[B_FILE_NAME_LENGTH]; };
-struct DIR_STRUCT
-{
-	int fd;
-};
-
-
-/* Open a directory stream on a fd.  */
-DIR* opendirfd(int fd)
-{
-	DIR* dir = opendir("/");
-
-	// Inject our fd into the private structure, now that the DIR*
-	// is all set up for us.  If an OS does not have an int representing
-	// the file descriptor as the first argument, things could get ugly.
-	// Any BSD (including OS X) or Linux should be OK.
-	if (dir)
-		((DIR_STRUCT*)dir)->fd = fd;
-
-	return dir;
+namespace BPrivate {
+namespace Storage {
+	static void delete_dir_stream(int dir);
+	static void cache_dir_fd(int dir);
+	static bool get_cached_dir_path(dev_t device, ino_t node,
+		std::string &path, bool verify);
+	static status_t find_entry_path(const char *dirPath, ino_t node,
+		char *result, size_t size);
+	static status_t find_node_path(dev_t device, ino_t node, char *result,
+		size_t size);
+}
 }
 
 //------------------------------------------------------------------------------
@@ -95,9 +102,10 @@ BPrivate::Storage::open( const char *path, OpenFlags flags,
 						 int &result, bool fallBackToReadOnly )
 {
 	status_t error = open(path, flags, result);
-	if (error == B_READ_ONLY_DEVICE || error == B_PERMISSION_DENIED
-		&& fallBackToReadOnly && (flags & O_RWMASK == O_RDWR)) {
-		flags = flags & ~O_RWMASK | O_RDONLY;
+	// directories can't be opened for writing on Linux at all
+	if ((error == EROFS || error == EACCES || error == EISDIR)
+		&& fallBackToReadOnly && (flags & O_RWMASK) == O_RDWR) {
+		flags = (flags & ~O_RWMASK) | O_RDONLY;
 		error = open(path, flags, result);
 	}
 	return error;
@@ -125,9 +133,10 @@ BPrivate::Storage::open( const char *path, OpenFlags flags,
 				  bool fallBackToReadOnly )
 {
 	status_t error = open(path, flags, creationFlags, result);
-	if (error == B_READ_ONLY_DEVICE || error == B_PERMISSION_DENIED
-		&& fallBackToReadOnly && (flags & O_RWMASK == O_RDWR)) {
-		flags = flags & ~O_RWMASK | O_RDONLY;
+	// directories can't be opened for writing on Linux at all
+	if ((error == EROFS || error == EACCES || error == EISDIR)
+		&& fallBackToReadOnly && (flags & O_RWMASK) == O_RDWR) {
+		flags = (flags & ~O_RWMASK) | O_RDONLY;
 		error = open(path, flags, creationFlags, result);
 	}
 	return error;
@@ -136,6 +145,8 @@ BPrivate::Storage::open( const char *path, OpenFlags flags,
 status_t
 BPrivate::Storage::close(int file)
 {
+	// in case the descriptor was read as a directory
+	delete_dir_stream(file);
 	return (::close(file) == -1) ? errno : B_OK ;
 }
 
@@ -509,6 +520,45 @@ BPrivate::Storage::set_stat(const char *file, Stat &s, StatMember what)
 // Attribute Functions
 //------------------------------------------------------------------------------
 
+namespace BPrivate {
+namespace Storage {
+
+// attribute_error
+/*!	\brief Translates the errno set by the fs_*_attr() functions.
+	read_attr() and write_attr() return a size, so they can't pass on the
+	positive errno values.
+*/
+static
+status_t
+attribute_error(int error)
+{
+	switch (error) {
+		case ENODATA:
+		case ENOENT:
+			return B_ENTRY_NOT_FOUND;
+		case ENOMEM:
+			return B_NO_MEMORY;
+		case EINVAL:
+			return B_BAD_VALUE;
+		case ENAMETOOLONG:
+			return B_NAME_TOO_LONG;
+		case ENOTSUP:
+			return B_UNSUPPORTED;
+		case EACCES:
+		case EPERM:
+			return B_PERMISSION_DENIED;
+		case EROFS:
+			return B_READ_ONLY_DEVICE;
+		case ENOSPC:
+			return B_DEVICE_FULL;
+		default:
+			return B_FILE_ERROR;
+	}
+}
+
+}	// namespace Storage
+}	// namespace BPrivate
+
 ssize_t
 BPrivate::Storage::read_attr ( int file, const char *attribute,
 						uint32 type, off_t pos, void *buf, size_t count )
@@ -517,7 +567,7 @@ BPrivate::Storage::read_attr ( int file, const char *attribute,
 		return B_BAD_VALUE;
 
 	ssize_t result = fs_read_attr ( file, attribute, type, pos, buf, count );
-	return (result == -1 ? errno : result);
+	return (result == -1 ? attribute_error(errno) : result);
 }
 
 ssize_t
@@ -529,7 +579,7 @@ BPrivate::Storage::write_attr ( int file,
 		return B_BAD_VALUE;
 
 	ssize_t result = fs_write_attr ( file, attribute, type, pos, buf, count );
-	return (result == -1 ? errno : result);
+	return (result == -1 ? attribute_error(errno) : result);
 }
 
 status_t
@@ -589,11 +639,7 @@ BPrivate::Storage::remove_attr ( int file, const char *attr )
 	if (attr == NULL)
 		return B_BAD_VALUE;	
 
-	// fs_remove_attr is supposed to set errno properly upon failure,
-	// but currently does not appear to. It isn't set consistent
-	// with what is returned by R5::BNode::RemoveAttr(), and it isn't
-	// set consistent with what the BeBook's claims it is set to either.
-	return fs_remove_attr ( file, attr ) == -1 ? errno : B_OK ;
+	return fs_remove_attr ( file, attr ) == -1 ? attribute_error(errno) : B_OK ;
 }
 
 status_t
@@ -602,7 +648,7 @@ BPrivate::Storage::stat_attr( int file, const char *name, AttrInfo *ai )
 	if (name == NULL || ai == NULL)
 		return B_BAD_VALUE;
 
-	return (fs_stat_attr( file, name, ai ) == -1) ? errno : B_OK ;
+	return (fs_stat_attr( file, name, ai ) == -1) ? attribute_error(errno) : B_OK ;
 }
 
 
@@ -610,10 +656,57 @@ BPrivate::Storage::stat_attr( int file, const char *name, AttrInfo *ai )
 // Attribute Directory Functions
 //------------------------------------------------------------------------------
 
+/*	An attribute directory descriptor refers to an attr_dir_handle, which
+	holds the DIR fs_fopen_attr_dir() returned.
+*/
+
+namespace BPrivate {
+namespace Storage {
+
+struct attr_dir_handle {
+	int		descriptor;
+	DIR		*dir;
+};
+
+static BLocker	sAttrDirLock("attribute directories");
+static BList	sAttrDirs;
+static int		sNextAttrDirDescriptor = 0;
+
+// find_attr_dir_handle
+static
+attr_dir_handle *
+find_attr_dir_handle(int descriptor)
+{
+	for (int32 i = 0;
+		 attr_dir_handle *handle = (attr_dir_handle*)sAttrDirs.ItemAt(i);
+		 i++) {
+		if (handle->descriptor == descriptor)
+			return handle;
+	}
+	return NULL;
+}
+
+}	// namespace Storage
+}	// namespace BPrivate
+
 status_t
 BPrivate::Storage::open_attr_dir( int file, int &result )
 {
-	return B_ERROR;
+	result = -1;
+	DIR *dir = fs_fopen_attr_dir(file);
+	if (dir == NULL)
+		return attribute_error(errno);
+	attr_dir_handle *handle = new(nothrow) attr_dir_handle;
+	if (handle == NULL) {
+		fs_close_attr_dir(dir);
+		return B_NO_MEMORY;
+	}
+	BAutolock _(sAttrDirLock);
+	handle->descriptor = sNextAttrDirDescriptor++;
+	handle->dir = dir;
+	sAttrDirs.AddItem(handle);
+	result = handle->descriptor;
+	return B_OK;
 }
 
 status_t
@@ -621,18 +714,29 @@ BPrivate::Storage::rewind_attr_dir( int dir )
 {
 	if (dir < 0)
 		return B_BAD_VALUE;
-	else {
-		// init a DIR structure
-
-		return B_ERROR;
-	}
+	BAutolock _(sAttrDirLock);
+	attr_dir_handle *handle = find_attr_dir_handle(dir);
+	if (handle == NULL)
+		return B_FILE_ERROR;
+	fs_rewind_attr_dir(handle->dir);
+	return B_OK;
 }
 
 // buffer must be large enough!!!
 status_t
 BPrivate::Storage::read_attr_dir( int dir, BPrivate::Storage::DirEntry& buffer )
 {
-	return B_ERROR;
+	BAutolock _(sAttrDirLock);
+	attr_dir_handle *handle = find_attr_dir_handle(dir);
+	if (handle == NULL)
+		return B_FILE_ERROR;
+	dirent *entry = fs_read_attr_dir(handle->dir);
+	if (entry == NULL)
+		return B_ENTRY_NOT_FOUND;
+	buffer.d_ino = entry->d_ino;
+	buffer.d_reclen = entry->d_reclen;
+	strcpy(buffer.d_name, entry->d_name);
+	return B_OK;
 }
 
 status_t
@@ -641,23 +745,178 @@ BPrivate::Storage::close_attr_dir ( int dir )
 	if (dir == -1)
 		return B_BAD_VALUE;
 
-	return B_NO_MEMORY;
+	attr_dir_handle *handle;
+	{
+		BAutolock _(sAttrDirLock);
+		handle = find_attr_dir_handle(dir);
+		if (handle == NULL)
+			return B_FILE_ERROR;
+		sAttrDirs.RemoveItem(handle);
+	}
+	int result = fs_close_attr_dir(handle->dir);
+	delete handle;
+	return (result == -1 ? attribute_error(errno) : B_OK);
 }
 
 
 //------------------------------------------------------------------------------
 // Directory Functions
 //------------------------------------------------------------------------------
+/*	Every directory descriptor that is read gets a dir_stream, which buffers
+	the entries getdents64() returned, so that a directory is listed with
+	few syscalls no matter how many entries are read at a time. The streams
+	are indexed by descriptor and dropped by close_dir(). The buffer starts
+	small, since most directories are, and grows with every refill.
+*/
+
+namespace BPrivate {
+namespace Storage {
+
+// the record getdents64() fills in
+struct linux_dirent64 {
+	uint64			d_ino;
+	int64			d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char			d_name[1];
+};
+
+struct dir_stream {
+	char	*buffer;
+	size_t	bufferSize;
+	size_t	size;
+	size_t	offset;
+	dev_t	device;
+	ino_t	node;
+};
+
+static const size_t kMinDirBufferSize = 8 * 1024;
+static const size_t kMaxDirBufferSize = 128 * 1024;
+
+static BLocker	sDirStreamLock("directory streams");
+static BList	sDirStreams;
+
+// get_dir_stream
+/*!	\brief Returns the stream of the given directory, creating it, if
+	\a create is \c true.
+*/
+static
+dir_stream *
+get_dir_stream(int dir, bool create)
+{
+	if (dir < 0)
+		return NULL;
+	BAutolock _(sDirStreamLock);
+	dir_stream *stream = (dir_stream*)sDirStreams.ItemAt(dir);
+	if (stream != NULL || !create)
+		return stream;
+
+	Stat st;
+	if (::fstat(dir, &st) < 0)
+		return NULL;
+	stream = new(nothrow) dir_stream;
+	if (stream == NULL)
+		return NULL;
+	while (sDirStreams.CountItems() <= dir) {
+		if (!sDirStreams.AddItem(NULL)) {
+			delete stream;
+			return NULL;
+		}
+	}
+	stream->buffer = NULL;
+	stream->bufferSize = 0;
+	stream->size = 0;
+	stream->offset = 0;
+	stream->device = st.st_dev;
+	stream->node = st.st_ino;
+	sDirStreams.ReplaceItem(dir, stream);
+	return stream;
+}
+
+// delete_dir_stream
+static
+void
+delete_dir_stream(int dir)
+{
+	if (dir < 0)
+		return;
+	dir_stream *stream;
+	{
+		BAutolock _(sDirStreamLock);
+		stream = (dir_stream*)sDirStreams.ItemAt(dir);
+		if (stream == NULL)
+			return;
+		sDirStreams.ReplaceItem(dir, NULL);
+	}
+	free(stream->buffer);
+	delete stream;
+}
+
+// fill_dir_stream
+/*!	\brief Reads the next batch of entries into the stream's buffer.
+	\return the number of bytes read, \c 0 at the end of the directory, or
+			\c -1 and errno set on error.
+*/
+static
+ssize_t
+fill_dir_stream(int dir, dir_stream *stream)
+{
+	if (stream->bufferSize < kMaxDirBufferSize) {
+		size_t newSize = (stream->bufferSize == 0 ? kMinDirBufferSize
+			: min(stream->bufferSize * 4, kMaxDirBufferSize));
+		char *buffer = (char*)realloc(stream->buffer, newSize);
+		if (buffer != NULL) {
+			stream->buffer = buffer;
+			stream->bufferSize = newSize;
+		} else if (stream->buffer == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+	stream->offset = 0;
+	stream->size = 0;
+	ssize_t size = ::syscall(SYS_getdents64, dir, stream->buffer,
+		stream->bufferSize);
+	if (size > 0)
+		stream->size = size;
+	return size;
+}
+
+// d_type_for_mode
+static
+unsigned char
+d_type_for_mode(mode_t mode)
+{
+	if (S_ISDIR(mode))
+		return DT_DIR;
+	if (S_ISREG(mode))
+		return DT_REG;
+	if (S_ISLNK(mode))
+		return DT_LNK;
+	if (S_ISFIFO(mode))
+		return DT_FIFO;
+	if (S_ISSOCK(mode))
+		return DT_SOCK;
+	if (S_ISCHR(mode))
+		return DT_CHR;
+	if (S_ISBLK(mode))
+		return DT_BLK;
+	return DT_UNKNOWN;
+}
+
+}	// namespace Storage
+}	// namespace BPrivate
 
 status_t
 BPrivate::Storage::open_dir( const char *path, int &result )
 {
-	result = -1;
-	if (DIR *dir = ::opendir(path)) {
-		result = dirfd(dir);
-		free(dir);
-	}
-	return (result < 0) ? errno : B_OK ;
+	result = (path ? ::open(path, O_RDONLY | O_DIRECTORY) : -1);
+	if (path == NULL)
+		return B_BAD_VALUE;
+	if (result < 0)
+		return errno;
+	cache_dir_fd(result);
+	return B_OK;
 }
 
 /*!	The parent directory must already exist.
@@ -692,7 +951,9 @@ BPrivate::Storage::create_dir( const char *path, int &result,
 	return error;
 }
 
-/*!	\param dir the directory
+/*!	The entries are packed one after the other; \c d_reclen is the offset
+	of the next one.
+	\param dir the directory
 	\param buffer the dirent structure to be filled
 	\param length the size of the dirent structure
 	\param count the maximal number of entries to be read
@@ -705,29 +966,64 @@ int32
 BPrivate::Storage::read_dir( int dir, DirEntry *buffer, size_t length,
 					  int32 count )
 {
-	// init a DIR structure
-	DIR* dirDir;
-	dirDir = opendirfd(dir);
 	// check parameters
-	int32 result = (buffer == NULL ? B_BAD_VALUE : 0);
-	if (result == 0 && count > 0) {
-		// read one entry and copy it into the buffer
-		if (dirent *entry = readdir(dirDir)) {
-			// Don't trust entry->d_reclen.
-			// Unlike stated in BeBook::BEntryList, the value is not the length
-			// of the whole structure, but only of the name. Some FSs count
-			// the terminating '\0', others don't.
-			// So we calculate the size ourselves (including the '\0'):
-			size_t entryLen = entry->d_name + strlen(entry->d_name) + 1
-							  - (char*)entry;
-			if (length >= entryLen) {
-				memcpy(buffer, entry, entryLen);
-				result = 1;
-			} else	// buffer too small
-				result = B_BAD_VALUE;
+	if (buffer == NULL)
+		return B_BAD_VALUE;
+	dir_stream *stream = get_dir_stream(dir, true);
+	if (stream == NULL)
+		return B_FILE_ERROR;
+
+	// the subdirectories met are added to the path cache
+	std::string dirPath;
+	int pathState = 0;		// 0: not looked up, 1: known, -1: unknown
+
+	int32 read = 0;
+	size_t offset = 0;
+	while (read < count) {
+		if (stream->offset >= stream->size) {
+			ssize_t size = fill_dir_stream(dir, stream);
+			if (size < 0)
+				return (read > 0 ? read : B_FILE_ERROR);
+			if (size == 0)
+				break;
+		}
+		const linux_dirent64 *entry
+			= (const linux_dirent64*)(stream->buffer + stream->offset);
+		// Don't trust entry->d_reclen for our records; the name length
+		// is what counts (including the '\0'):
+		size_t nameLength = strlen(entry->d_name) + 1;
+		size_t recordLength = (offsetof(DirEntry, d_name) + nameLength + 7)
+							  & ~7;
+		if (offset + recordLength > length) {
+			if (read == 0)
+				return B_BAD_VALUE;
+			break;
+		}
+		DirEntry *result = (DirEntry*)((char*)buffer + offset);
+		result->d_ino = entry->d_ino;
+		result->d_off = entry->d_off;
+		result->d_reclen = recordLength;
+		result->d_type = entry->d_type;
+		memcpy(result->d_name, entry->d_name, nameLength);
+		if (entry->d_type == DT_DIR && pathState >= 0
+			&& strcmp(entry->d_name, ".") != 0
+			&& strcmp(entry->d_name, "..") != 0) {
+			if (pathState == 0) {
+				pathState = (get_cached_dir_path(stream->device, stream->node,
+					dirPath, false) ? 1 : -1);
+				if (dirPath == "/")
+					dirPath = "";
+			}
+			if (pathState > 0) {
+				cache_dir_path(stream->device, entry->d_ino,
+					(dirPath + "/" + entry->d_name).c_str());
+			}
 		}
+		stream->offset += entry->d_reclen;
+		offset += recordLength;
+		read++;
 	}
-	return result;
+	return read;
 }
 
 status_t
@@ -735,35 +1031,41 @@ BPrivate::Storage::rewind_dir( int dir )
 {
 	if (dir < 0)
 		return B_BAD_VALUE;
-	else {
-		// init a DIR structure
-		DIR* dirDir;
-		dirDir = opendirfd(dir);
-		::rewinddir(dirDir);
-		return B_OK;
+	if (::lseek(dir, 0, SEEK_SET) < 0)
+		return errno;
+	if (dir_stream *stream = get_dir_stream(dir, false)) {
+		stream->offset = 0;
+		stream->size = 0;
 	}
+	return B_OK;
 }
 
+/*!	The entry is looked up by name, not by reading the directory, so the
+	position of \a dir isn't changed.
+*/
 status_t
 BPrivate::Storage::find_dir( int dir, const char *name,
 					  DirEntry *result, size_t length )
 {
 	if (dir < 0 || name == NULL || result == NULL)
 		return B_BAD_VALUE;
-	
-	status_t status;
-	
-	status = BPrivate::Storage::rewind_dir(dir);
-	if (status == B_OK) {
-		while (	BPrivate::Storage::read_dir(dir, result, length, 1) == 1)
-		{
-			if (strcmp(result->d_name, name) == 0)
-				return B_OK;
-		}
-		status = B_ENTRY_NOT_FOUND;
-	}
-	
-	return status;
+	if (name[0] == '\0' || strchr(name, '/') != NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	size_t nameLength = strlen(name) + 1;
+	size_t recordLength = offsetof(DirEntry, d_name) + nameLength;
+	if (recordLength > length)
+		return B_BAD_VALUE;
+
+	Stat st;
+	if (::fstatat(dir, name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+		return (errno == ENOENT ? B_ENTRY_NOT_FOUND : errno);
+	result->d_ino = st.st_ino;
+	result->d_off = 0;
+	result->d_reclen = recordLength;
+	result->d_type = d_type_for_mode(st.st_mode);
+	memcpy(result->d_name, name, nameLength);
+	return B_OK;
 }
 
 status_t
@@ -773,26 +1075,53 @@ BPrivate::Storage::find_dir( int dir, const char *name, entry_ref *result )
 	LongDirEntry entry;
 	if (status == B_OK)
 		status = BPrivate::Storage::find_dir(dir, name, &entry, sizeof(entry));
-	if (status == B_OK) {
-		//result->device = entry.d_pdev;
-		result->directory = entry.d_ino;
+	if (status == B_OK)
+		status = dir_to_node(dir, result->device, result->directory);
+	if (status == B_OK)
 		status = result->set_name(entry.d_name);
-	}
 	return status;
 }
 
+/*!	The device and inode number of a directory being read are known
+	without asking the kernel.
+*/
+status_t
+BPrivate::Storage::dir_to_node( int dir, dev_t &device, ino_t &node )
+{
+	if (dir < 0)
+		return B_BAD_VALUE;
+	if (dir_stream *stream = get_dir_stream(dir, false)) {
+		device = stream->device;
+		node = stream->node;
+		return B_OK;
+	}
+	Stat st;
+	if (::fstat(dir, &st) < 0)
+		return errno;
+	device = st.st_dev;
+	node = st.st_ino;
+	return B_OK;
+}
+
+/*!	The directory is opened anew rather than dup()ed, since duplicated
+	descriptors share their position, and the copy must be read on its own.
+*/
 status_t
 BPrivate::Storage::dup_dir( int dir, int &result )
 {
-	return BPrivate::Storage::dup(dir, result);
+	if (dir == -1) {
+		result = -1;
+		return B_OK;
+	}
+	result = ::openat(dir, ".", O_RDONLY | O_DIRECTORY);
+	return (result < 0) ? errno : B_OK;
 }
 
 status_t
 BPrivate::Storage::close_dir( int dir )
 {
-	// init a DIR structure
-	DIR* dirDir = opendirfd(dir);
-	return (::closedir(dirDir) == -1) ? errno : B_OK;
+	delete_dir_stream(dir);
+	return (::close(dir) == -1) ? errno : B_OK;
 }
 
 //------------------------------------------------------------------------------
@@ -863,8 +1192,123 @@ BPrivate::Storage::read_link( int fd, char *result, size_t size )
 
 
 //------------------------------------------------------------------------------
-// Query Functions
+// Index and Query Functions
 //------------------------------------------------------------------------------
+/*	Linux has no indices, so the registrar's index manager keeps them and
+	evaluates the queries. A query descriptor is not a file descriptor, but
+	refers to a query_handle, which holds the page of results last received
+	from the index manager; read_query() only asks for the next page, when
+	the current one has been consumed.
+*/
+
+namespace BPrivate {
+namespace Storage {
+
+struct query_handle {
+	int			descriptor;
+	int32		query;
+	BMessage	page;
+	int32		next;
+	int32		count;
+	bool		done;
+};
+
+static BLocker		sQueryLock("queries");
+static BList		sQueries;
+static int			sNextQueryDescriptor = 0;
+static BMessenger	sIndexManager;
+
+// send_to_index_manager
+/*!	\brief Sends a request to the registrar's index manager.
+	The index manager's messenger is asked from the registrar the first time
+	it is needed.
+	\param message The request.
+	\param reply The reply.
+	\return The result of the request, or an error, if it couldn't be sent.
+*/
+static
+status_t
+send_to_index_manager(BMessage *message, BMessage *reply)
+{
+	BAutolock _(sQueryLock);
+	if (!sIndexManager.IsValid()) {
+		BMessage request(B_REG_GET_INDEX_MESSENGER);
+		BMessage answer;
+		status_t error = BRoster::Private().SendTo(&request, &answer, false);
+		if (error == B_OK && answer.what != B_REG_SUCCESS)
+			error = B_ERROR;
+		if (error == B_OK)
+			error = answer.FindMessenger("messenger", &sIndexManager);
+		if (error != B_OK)
+			return error;
+	}
+	status_t error = sIndexManager.SendMessage(message, reply);
+	if (error == B_OK && reply->what != B_REG_RESULT)
+		error = B_ERROR;
+	status_t result;
+	if (error == B_OK && reply->FindInt32("result", &result) == B_OK)
+		error = result;
+	return error;
+}
+
+// find_query_handle
+static
+query_handle *
+find_query_handle(int descriptor)
+{
+	for (int32 i = 0; query_handle *handle = (query_handle*)sQueries.ItemAt(i);
+		 i++) {
+		if (handle->descriptor == descriptor)
+			return handle;
+	}
+	return NULL;
+}
+
+// open_query_handle
+static
+status_t
+open_query_handle(dev_t device, const char *query, uint32 flags, port_id port,
+				  int32 token, int &result)
+{
+	result = -1;
+	if (query == NULL)
+		return B_BAD_VALUE;
+	BMessage request(B_REG_OPEN_QUERY);
+	request.AddInt32("device", device);
+	request.AddString("predicate", query);
+	request.AddInt32("flags", flags);
+	if (flags & B_LIVE_QUERY) {
+		request.AddInt32("port", port);
+		request.AddInt32("token", token);
+	}
+	BMessage reply;
+	int32 id;
+	status_t error = send_to_index_manager(&request, &reply);
+	if (error == B_OK)
+		error = reply.FindInt32("query", &id);
+	if (error != B_OK)
+		return error;
+
+	query_handle *handle = new(nothrow) query_handle;
+	if (handle == NULL) {
+		BMessage close(B_REG_CLOSE_QUERY);
+		close.AddInt32("query", id);
+		send_to_index_manager(&close, &reply);
+		return B_NO_MEMORY;
+	}
+	BAutolock _(sQueryLock);
+	handle->descriptor = sNextQueryDescriptor++;
+	handle->query = id;
+	handle->next = 0;
+	handle->count = 0;
+	handle->done = false;
+	sQueries.AddItem(handle);
+	result = handle->descriptor;
+	return B_OK;
+}
+
+}	// namespace Storage
+}	// namespace BPrivate
 
 status_t
 BPrivate::Storage::open_query( dev_t device, const char *query, uint32 flags,
@@ -872,8 +1316,7 @@ BPrivate::Storage::open_query( dev_t device, const char *query, uint32 flags,
 {
 	if (flags & B_LIVE_QUERY)
 		return B_BAD_VALUE;
-	result = -1;
-	return (result < 0) ? errno : B_OK ;
+	return open_query_handle(device, query, flags, -1, B_NULL_TOKEN, result);
 }
 
 status_t
@@ -883,8 +1326,7 @@ BPrivate::Storage::open_live_query( dev_t device, const char *query, uint32 flag
 {
 	if (!(flags & B_LIVE_QUERY))
 		return B_BAD_VALUE;
-	result = -1;
-	return (result < 0) ? errno : B_OK ;
+	return open_query_handle(device, query, flags, port, token, result);
 }
 
 /*!	\param query the query
@@ -901,14 +1343,282 @@ BPrivate::Storage::read_query( int query, DirEntry *buffer, size_t length,
 						int32 count )
 {
 	// check parameters
-	int32 result = (buffer == NULL ? B_BAD_VALUE : 0);
-	return result;
+	if (buffer == NULL || count < 1)
+		return B_BAD_VALUE;
+
+	BAutolock _(sQueryLock);
+	query_handle *handle = find_query_handle(query);
+	if (handle == NULL)
+		return B_FILE_ERROR;
+
+	// the entries are packed like those read_dir() returns; the directory
+	// of an entry is passed in d_off, the device is the one of the query
+	int32 read = 0;
+	size_t offset = 0;
+	while (read < count) {
+		if (handle->next == handle->count) {
+			if (handle->done)
+				break;
+			BMessage request(B_REG_READ_QUERY);
+			request.AddInt32("query", handle->query);
+			status_t error = send_to_index_manager(&request, &handle->page);
+			if (error != B_OK)
+				return (read > 0 ? read : error);
+			type_code type;
+			handle->next = 0;
+			handle->count = 0;
+			if (handle->page.GetInfo("name", &type, &handle->count) != B_OK
+				|| handle->count == 0) {
+				handle->count = 0;
+				handle->done = true;
+				break;
+			}
+		}
+		const char *name;
+		int64 directory, node;
+		if (handle->page.FindString("name", handle->next, &name) != B_OK
+			|| handle->page.FindInt64("directory", handle->next, &directory)
+			   != B_OK
+			|| handle->page.FindInt64("node", handle->next, &node) != B_OK) {
+			handle->next++;
+			continue;
+		}
+		size_t recordLength = (offsetof(DirEntry, d_name) + strlen(name) + 1
+							   + 7) & ~7;
+		if (offset + recordLength > length) {
+			if (read == 0)
+				return B_BAD_VALUE;
+			break;
+		}
+		DirEntry *entry = (DirEntry*)((char*)buffer + offset);
+		entry->d_ino = node;
+		entry->d_off = directory;
+		entry->d_reclen = recordLength;
+		entry->d_type = DT_UNKNOWN;
+		strcpy(entry->d_name, name);
+		offset += recordLength;
+		handle->next++;
+		read++;
+	}
+	return read;
 }
 
 status_t
 BPrivate::Storage::close_query( int query )
 {
-	return B_NO_MEMORY;
+	query_handle *handle;
+	{
+		BAutolock _(sQueryLock);
+		handle = find_query_handle(query);
+		if (handle == NULL)
+			return B_FILE_ERROR;
+		sQueries.RemoveItem(handle);
+	}
+	BMessage request(B_REG_CLOSE_QUERY);
+	request.AddInt32("query", handle->query);
+	BMessage reply;
+	status_t error = send_to_index_manager(&request, &reply);
+	delete handle;
+	return error;
+}
+
+status_t
+BPrivate::Storage::create_index(dev_t device, const char *name, uint32 type,
+	uint32 flags)
+{
+	if (name == NULL)
+		return B_BAD_VALUE;
+	BMessage request(B_REG_CREATE_INDEX);
+	request.AddInt32("device", device);
+	request.AddString("name", name);
+	request.AddInt32("type", type);
+	BMessage reply;
+	return send_to_index_manager(&request, &reply);
+}
+
+status_t
+BPrivate::Storage::remove_index(dev_t device, const char *name)
+{
+	if (name == NULL)
+		return B_BAD_VALUE;
+	BMessage request(B_REG_REMOVE_INDEX);
+	request.AddInt32("device", device);
+	request.AddString("name", name);
+	BMessage reply;
+	return send_to_index_manager(&request, &reply);
+}
+
+status_t
+BPrivate::Storage::stat_index(dev_t device, const char *name, index_info *info)
+{
+	if (name == NULL || info == NULL)
+		return B_BAD_VALUE;
+	BMessage request(B_REG_STAT_INDEX);
+	request.AddInt32("device", device);
+	request.AddString("name", name);
+	BMessage reply;
+	int32 type;
+	status_t error = send_to_index_manager(&request, &reply);
+	if (error == B_OK)
+		error = reply.FindInt32("type", &type);
+	if (error == B_OK) {
+		// the index manager doesn't account for the size of the indices
+		info->type = type;
+		info->size = 0;
+		info->modification_time = 0;
+		info->creation_time = 0;
+		info->uid = getuid();
+		info->gid = getgid();
+	}
+	return error;
+}
+
+
+//------------------------------------------------------------------------------
+// Path Cache
+//------------------------------------------------------------------------------
+/*	An entry_ref names its directory by inode number, which Linux can't turn
+	into a path. So the paths of the directories this team opens or comes
+	across while listing a directory are remembered, keyed by node. A cached
+	path is checked with a stat() before it is used, since the directory may
+	have been moved or removed since; the node monitor service drops the
+	paths below the entries it sees moved or removed in the meantime. For
+	that, the cached paths are indexed by path as well, where a subtree is
+	a contiguous range.
+*/
+
+namespace BPrivate {
+namespace Storage {
+
+typedef std::pair<dev_t, ino_t> path_cache_key;
+typedef std::map<path_cache_key, std::string> path_cache_map;
+typedef std::map<std::string, path_cache_key> path_index_map;
+
+static const size_t kMaxCachedPaths = 16384;
+
+static BLocker			sPathCacheLock("path cache");
+static path_cache_map	sPathCache;
+static path_index_map	sPathIndex;
+
+// uncache_entry
+/*!	\brief Removes an entry from both the cache and the path index.
+	The caller must hold sPathCacheLock.
+*/
+static
+void
+uncache_entry(path_cache_map::iterator it)
+{
+	sPathIndex.erase(it->second);
+	sPathCache.erase(it);
+}
+
+// get_cached_dir_path
+/*!	\brief Returns the cached path of a directory.
+	\param verify If \c true, \c false is returned, if the path doesn't lead
+		   to the directory anymore.
+*/
+static
+bool
+get_cached_dir_path(dev_t device, ino_t node, std::string &path, bool verify)
+{
+	path_cache_key key(device, node);
+	{
+		BAutolock _(sPathCacheLock);
+		path_cache_map::iterator it = sPathCache.find(key);
+		if (it == sPathCache.end())
+			return false;
+		path = it->second;
+	}
+	if (!verify)
+		return true;
+
+	Stat st;
+	if (::stat(path.c_str(), &st) == 0 && st.st_dev == device
+		&& st.st_ino == node) {
+		return true;
+	}
+	// the stale path is left in \a path, it's a hint where to look
+	BAutolock _(sPathCacheLock);
+	path_cache_map::iterator it = sPathCache.find(key);
+	if (it != sPathCache.end() && it->second == path)
+		uncache_entry(it);
+	return false;
+}
+
+// cache_dir_fd
+/*!	\brief Caches the path of an opened directory, unless it's known.
+*/
+static
+void
+cache_dir_fd(int dir)
+{
+	Stat st;
+	if (::fstat(dir, &st) < 0)
+		return;
+	{
+		BAutolock _(sPathCacheLock);
+		if (sPathCache.find(path_cache_key(st.st_dev, st.st_ino))
+				!= sPathCache.end()) {
+			return;
+		}
+	}
+	char link[32];
+	char path[B_PATH_NAME_LENGTH];
+	sprintf(link, "/proc/self/fd/%d", dir);
+	ssize_t length = ::readlink(link, path, sizeof(path) - 1);
+	if (length <= 0 || path[0] != '/')
+		return;
+	path[length] = '\0';
+	cache_dir_path(st.st_dev, st.st_ino, path);
+}
+
+}	// namespace Storage
+}	// namespace BPrivate
+
+void
+BPrivate::Storage::cache_dir_path(dev_t device, ino_t node, const char *path)
+{
+	if (path == NULL || path[0] != '/')
+		return;
+	path_cache_key key(device, node);
+	BAutolock _(sPathCacheLock);
+	// a path names one node, a node has one cached path
+	path_index_map::iterator indexIt = sPathIndex.find(path);
+	if (indexIt != sPathIndex.end()) {
+		if (indexIt->second == key)
+			return;
+		uncache_entry(sPathCache.find(indexIt->second));
+	}
+	path_cache_map::iterator it = sPathCache.find(key);
+	if (it != sPathCache.end())
+		uncache_entry(it);
+	else if (sPathCache.size() >= kMaxCachedPaths) {
+		// make room; which one goes doesn't matter much
+		uncache_entry(sPathCache.begin());
+	}
+	sPathCache[key] = path;
+	sPathIndex[path] = key;
+}
+
+void
+BPrivate::Storage::uncache_path(const char *path)
+{
+	if (path == NULL)
+		return;
+	std::string directory(path);
+	BAutolock _(sPathCacheLock);
+	// the path itself, then everything from "path/" up to "path0", '0'
+	// being the character following '/'
+	path_index_map::iterator it = sPathIndex.find(directory);
+	if (it != sPathIndex.end()) {
+		sPathCache.erase(it->second);
+		sPathIndex.erase(it);
+	}
+	path_index_map::iterator first = sPathIndex.lower_bound(directory + '/');
+	path_index_map::iterator last = sPathIndex.lower_bound(directory + '0');
+	for (it = first; it != last; ++it)
+		sPathCache.erase(it->second);
+	sPathIndex.erase(first, last);
 }
 
 
@@ -932,19 +1642,155 @@ status_t
 BPrivate::Storage::entry_ref_to_path(dev_t device, ino_t directory, const char *name,
 	char *path, size_t size)
 {
-	//status_t status = _kern_dir_node_ref_to_path(device, directory, path, size);
-	//if (status < B_OK)
-	//	return status;
+	if (path == NULL || name == NULL)
+		return B_BAD_VALUE;
 
-	if (path)
-	{
-		strcpy(path, "/");
-		if (name)
-			strncat(path, name, size);
+	status_t error = node_ref_to_path(device, directory, path, size);
+	if (error != B_OK)
+		return error;
+
+	// the ref of a directory itself is its "." entry
+	if (strcmp(name, ".") == 0)
+		return B_OK;
+	size_t length = strlen(path);
+	if ((size_t)snprintf(path + length, size - length, "%s%s",
+			(length > 1 ? "/" : ""), name) >= size - length) {
+		return B_NAME_TOO_LONG;
 	}
 	return B_OK;
 }
 
+// node_ref_to_path
+/*!	Linux can't look up a node by its inode number. Directories are looked
+	up in the path cache first. Otherwise, since Linux shows the path of
+	every open file descriptor in /proc/self/fd, the node is looked for
+	among the descriptors of this team, and then among the entries of the
+	directories it has open, which covers BEntry, which only keeps its
+	directory open. Directories found that way are added to the cache.
+
+	\param device The device the node resides on.
+	\param node The inode number of the node.
+	\param result A buffer the path is written into.
+	\param size The size of the buffer.
+	\return \c B_OK, if the node was found, \c B_ENTRY_NOT_FOUND otherwise.
+*/
+status_t
+BPrivate::Storage::node_ref_to_path(dev_t device, ino_t node, char *result,
+	size_t size)
+{
+	if (result == NULL || size < 2)
+		return B_BAD_VALUE;
+
+	std::string cached;
+	if (get_cached_dir_path(device, node, cached, true)) {
+		if (cached.length() >= size)
+			return B_NAME_TOO_LONG;
+		strcpy(result, cached.c_str());
+		return B_OK;
+	}
+
+	status_t error = B_ENTRY_NOT_FOUND;
+	Stat st;
+	if (::stat("/", &st) == 0 && st.st_dev == device && st.st_ino == node) {
+		strcpy(result, "/");
+		return B_OK;
+	}
+	// a directory that has been renamed has most likely stayed where it was
+	if (!cached.empty()) {
+		std::string parent(cached, 0, cached.rfind('/'));
+		error = find_entry_path(parent.empty() ? "/" : parent.c_str(), node,
+			result, size);
+	}
+	if (error != B_OK)
+		error = find_node_path(device, node, result, size);
+	if (error == B_OK && ::stat(result, &st) == 0 && S_ISDIR(st.st_mode)
+		&& st.st_dev == device && st.st_ino == node) {
+		cache_dir_path(device, node, result);
+	}
+	return error;
+}
+
+// find_entry_path
+/*!	\brief Looks for the node among the entries of the given directory.
+*/
+status_t
+BPrivate::Storage::find_entry_path(const char *dirPath, ino_t node,
+	char *result, size_t size)
+{
+	DIR *dir = ::opendir(dirPath);
+	if (dir == NULL)
+		return B_ENTRY_NOT_FOUND;
+	status_t error = B_ENTRY_NOT_FOUND;
+	while (dirent *entry = ::readdir(dir)) {
+		if (entry->d_ino != node || strcmp(entry->d_name, ".") == 0
+			|| strcmp(entry->d_name, "..") == 0) {
+			continue;
+		}
+		if ((size_t)snprintf(result, size, "%s%s%s", dirPath,
+				(dirPath[1] != '\0' ? "/" : ""), entry->d_name) < size) {
+			error = B_OK;
+		}
+		break;
+	}
+	::closedir(dir);
+	return error;
+}
+
+// find_node_path
+/*!	\brief Looks for the node among the open descriptors of this team and
+	the entries of the directories it has open.
+*/
+status_t
+BPrivate::Storage::find_node_path(dev_t device, ino_t node, char *result,
+	size_t size)
+{
+	DIR *fds = ::opendir("/proc/self/fd");
+	if (fds == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	// the descriptors are read first, because opening the directories to
+	// look at their entries adds descriptors to the list
+	int32 fdCount = 0;
+	int fdList[256];
+	while (dirent *fdEntry = ::readdir(fds)) {
+		if (fdEntry->d_name[0] != '.' && fdCount < 256)
+			fdList[fdCount++] = atoi(fdEntry->d_name);
+	}
+	::closedir(fds);
+
+	char link[32];
+	Stat st;
+	status_t error = B_ENTRY_NOT_FOUND;
+	for (int32 i = 0; error != B_OK && i < fdCount; i++) {
+		if (::fstat(fdList[i], &st) < 0 || st.st_dev != device
+			|| st.st_ino != node) {
+			continue;
+		}
+		sprintf(link, "/proc/self/fd/%d", fdList[i]);
+		ssize_t length = ::readlink(link, result, size - 1);
+		if (length > 0 && result[0] == '/') {
+			result[length] = '\0';
+			error = B_OK;
+		}
+	}
+
+	for (int32 i = 0; error != B_OK && i < fdCount; i++) {
+		if (::fstat(fdList[i], &st) < 0 || !S_ISDIR(st.st_mode)
+			|| st.st_dev != device) {
+			continue;
+		}
+		sprintf(link, "/proc/self/fd/%d", fdList[i]);
+		char dirPath[B_PATH_NAME_LENGTH];
+		ssize_t length = ::readlink(link, dirPath, sizeof(dirPath) - 1);
+		if (length <= 0 || dirPath[0] != '/')
+			continue;
+		dirPath[length] = '\0';
+
+		error = find_entry_path(dirPath, node, result, size);
+	}
+	return error;
+}
+
 status_t
 BPrivate::Storage::dir_to_self_entry_ref( int dir, entry_ref *result )
 {
@@ -1107,8 +1953,19 @@ BPrivate::Storage::rename(const char *oldPath, const char *newPath)
 {
 	if (oldPath == NULL || newPath == NULL)
 		return B_BAD_VALUE;
-	
-	return (::rename(oldPath, newPath) == -1) ? errno : B_OK ;
+
+	// a node replaced by the rename loses its last link
+	struct stat oldSt, newSt;
+	bool replaces = ::lstat(newPath, &newSt) == 0
+		&& ::lstat(oldPath, &oldSt) == 0
+		&& (oldSt.st_dev != newSt.st_dev || oldSt.st_ino != newSt.st_ino)
+		&& (S_ISDIR(newSt.st_mode) || newSt.st_nlink <= 1);
+
+	if (::rename(oldPath, newPath) == -1)
+		return errno;
+	if (replaces)
+		fs_remove_attr_sidecar(newSt.st_dev, newSt.st_ino);
+	return B_OK;
 }
 
 /*! Removes path from the filesystem. */
@@ -1117,8 +1974,16 @@ BPrivate::Storage::remove(const char *path)
 {
 	if (path == NULL)
 		return B_BAD_VALUE;
-	
-	return (::remove(path) == -1) ? errno : B_OK ;
+
+	struct stat st;
+	bool lastLink = ::lstat(path, &st) == 0
+		&& (S_ISDIR(st.st_mode) || st.st_nlink <= 1);
+
+	if (::remove(path) == -1)
+		return errno;
+	if (lastLink)
+		fs_remove_attr_sidecar(st.st_dev, st.st_ino);
+	return B_OK;
 }
 
 
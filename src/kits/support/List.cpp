@@ -266,7 +266,7 @@ BList::MoveItem(int32 fromIndex, int32 toIndex)
 	if (fromIndex < toIndex)
 	{
 		void * tmp_mover = fObjectList[fromIndex];
-		memmove(fObjectList + fromIndex + 1, fObjectList + fromIndex, (toIndex - fromIndex) * sizeof(void *));
+		memmove(fObjectList + fromIndex, fObjectList + fromIndex + 1, (toIndex - fromIndex) * sizeof(void *));
 		fObjectList[toIndex] = tmp_mover;
 	} 
 	else if (fromIndex > toIndex)
@@ -59,6 +59,9 @@
 #include "Utils.h"
 #include "FontServer.h"
 #include "Desktop.h"
+#include "ServerConfig.h"
+#include "SystemPalette.h"
+#include "WinBorder.h"
 
 //#define DEBUG_KEYHANDLING
 //#define DEBUG_SERVER
@@ -138,6 +141,10 @@ AppServer::AppServer(void)
 
 	InitDecorators();
 
+	// The color map is needed by the drivers for 8-bit modes and by the clients,
+	// so it has to exist before the first screen is set up
+	InitSystemColorMap();
+
 	// Set up the Desktop
 	desktop= new Desktop();
 	desktop->Init();
@@ -221,17 +228,85 @@ int32 AppServer::PollerThread(void *data)
 	int32 code=0;
 	status_t err=B_OK;
 	
+	// Mouse moves are not handled right away. They are collapsed into one
+	// until something else arrives, the buttons change or it's time for the
+	// next frame - whatever comes first.
+	PointerEvent move;
+	bool movePending=false;
+	bigtime_t nextMove=0;
+	
 	for(;;)
 	{
+		bigtime_t timeout=B_INFINITE_TIMEOUT;
+		if(movePending)
+		{
+			timeout=nextMove-system_time();
+			if(timeout<0)
+				timeout=0;
+		}
+		
 		STRACE(("info: AppServer::PollerThread listening on port %ld.\n", appserver->fMousePort));
-		err=mousequeue.GetNextReply(&code);
+		err=mousequeue.GetNextReply(&code,timeout);
 		
 		if(err<B_OK)
 		{
-			STRACE(("PollerThread:mousequeue.GetNextReply failed\n"));
+			if(movePending)
+			{
+				// nothing more is queued: hand over the latest position
+				desktop->MouseMovedHandler(move);
+				movePending=false;
+				nextMove=system_time()+MOUSE_MOVE_INTERVAL;
+			}
+			else
+				STRACE(("PollerThread:mousequeue.GetNextReply failed\n"));
+			continue;
+		}
+		
+		if(code==B_MOUSE_MOVED)
+		{
+			PointerEvent latest;
+			if(Desktop::ReadMouseMoved(mousequeue,&latest)<B_OK)
+				continue;
+			
+			// Clients polling the mouse get every position, not just the ones 
+			// which are handed over
+			desktop->PublishInput(latest);
+			
+			if(movePending && latest.buttons==move.buttons
+				&& latest.modifiers==move.modifiers)
+			{
+				latest.history=move.history+1;
+			}
+			else if(movePending)
+			{
+				// a drag started or ended in between, don't lose it
+				desktop->MouseMovedHandler(move);
+				nextMove=system_time()+MOUSE_MOVE_INTERVAL;
+			}
+			
+			move=latest;
+			movePending=true;
+
+			// A steady stream of moves never lets GetNextReply() time out, so
+			// the frame has to be checked here as well
+			bigtime_t now=system_time();
+			if(now>=nextMove)
+			{
+				desktop->MouseMovedHandler(move);
+				movePending=false;
+				nextMove=now+MOUSE_MOVE_INTERVAL;
+			}
 			continue;
 		}
 		
+		// Everything else must be seen after the moves which came before it
+		if(movePending)
+		{
+			desktop->MouseMovedHandler(move);
+			movePending=false;
+			nextMove=system_time()+MOUSE_MOVE_INTERVAL;
+		}
+		
 		switch(code)
 		{
 			// We don't need to do anything with these two, so just pass them
@@ -240,7 +315,6 @@ int32 AppServer::PollerThread(void *data)
 			case B_MOUSE_DOWN:
 			case B_MOUSE_UP:
 			case B_MOUSE_WHEEL_CHANGED:
-			case B_MOUSE_MOVED:
 				desktop->MouseEventHandler(code,mousequeue);
 				break;
 
@@ -876,6 +950,14 @@ int main( int argc, char** argv )
 
 	STRACE(("There can be only one... app_server, that is.  We're it.\n"));
 
+	// --headless renders into memory instead of onto the display. The Desktop
+	// picks its driver while the AppServer is constructed, so pass it on now.
+	for(int i=1; i<argc; i++)
+	{
+		if(strcmp(argv[i],"--headless")==0)
+			setenv("COSMOE_HEADLESS","1",1);
+	}
+
 	AppServer	app_server;
 	app_server.Run();
 	return 0;
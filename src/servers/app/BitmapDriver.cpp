@@ -693,6 +693,24 @@ void BitmapDriver::FillSolidRect(const BRect &rect, const RGBColor &color)
 				uint8 *fb = (uint8 *)fTarget->Bits() + top*bytes_per_row;
 				uint8 color8 = col.GetColor8();
 				int x,y;
+#ifdef DITHER_8BIT
+				// colors which aren't in the palette are drawn as a dither
+				// pattern of the palette colors around them
+				const color_map *map = SystemColorMap();
+				rgb_color fill_color = col.GetColor32();
+				rgb_color closest = system_palette[color8];
+				if (map && (closest.red != fill_color.red
+					|| closest.green != fill_color.green || closest.blue != fill_color.blue))
+				{
+					for (y=top; y<=bottom; y++)
+					{
+						for (x=left; x<=right; x++)
+							fb[x] = IndexForColorDithered(map, fill_color, x, y);
+						fb += bytes_per_row;
+					}
+					break;
+				}
+#endif
 				for (y=top; y<=bottom; y++)
 				{
 					for (x=left; x<=right; x++)
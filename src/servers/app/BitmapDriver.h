@@ -26,7 +26,7 @@
 //  
 //------------------------------------------------------------------------------
 #ifndef _BITMAPDRIVER_H_
-#define _BITMAPNDRIVER_H_
+#define _BITMAPDRIVER_H_
 
 #include <Application.h>
 #include <View.h>
@@ -22,62 +22,147 @@
 //	File Name:		BitmapManager.cpp
 //	Author:			DarkWyrm <bpmagic@columbus.rr.com>
 //	Description:	Handler for allocating and freeing area memory for BBitmaps 
-//					on the server side. Utilizes the BGET pool allocator.
+//					on the server side.
 //------------------------------------------------------------------------------
 #include "BitmapManager.h"
 #include "ServerBitmap.h"
+#include "ServerConfig.h"
+#include "WinBorder.h"
 #include <stdio.h>
-#include "BGet++.h"
+#include <string.h>
 
 //! The bitmap allocator for the server. Memory is allocated/freed by the AppServer class
 BitmapManager *bitmapmanager=NULL;
 
-//! Number of bytes to allocate to each area used for bitmap storage
-#define BITMAP_AREA_SIZE	B_PAGE_SIZE * 2
+//! Chunk sizes of the slab size classes. Each one is about 1.5 times the previous one.
+static const uint32 kSizeClasses[BITMAP_SIZE_CLASSES]=
+{
+	256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192,
+	12288, 16384, 24576, 32768, 49152, BITMAP_SLAB_SIZE / 4
+};
+
+//! Initial number of buckets in the token hash table. Must be a power of two.
+#define INITIAL_TABLE_SIZE 64
+
+//! An area split into equally sized chunks
+struct bitmap_slab
+{
+	area_id area;
+	uint8 *address;
+	uint32 chunkSize;
+	int32 chunkCount;
+	int32 freeCount;
+	int32 *freeChunks;	// stack of the indices of the free chunks
+};
+
+//! Bookkeeping for a ServerBitmap allocated by the manager
+struct bitmap_entry
+{
+	ServerBitmap *bitmap;
+	bitmap_owner *owner;
+	bitmap_slab *slab;	// NULL if the bitmap has an area of its own
+	int32 chunk;
+	uint32 size;		// bytes charged to the owner
+	
+	bitmap_entry *hashNext;
+	bitmap_entry *ownerPrev, *ownerNext;
+};
+
+//! Memory accounting for a ServerApp
+struct bitmap_owner
+{
+	ServerApp *app;
+	uint32 memory;
+	int32 count;
+	bitmap_entry *entries;
+};
+
+//! Bookkeeping for a window backing store. The list of these is kept in LRU order.
+typedef struct
+{
+	WinBorder *owner;
+	UtilityBitmap *bitmap;
+} backing_store_entry;
+
+//! Returns the index of the smallest size class the given size fits in or -1
+static int32 size_class_for(uint32 size)
+{
+	for(int32 i=0; i<BITMAP_SIZE_CLASSES; i++)
+	{
+		if(size<=kSizeClasses[i])
+			return i;
+	}
+	return -1;
+}
+
+//! Rounds a size up to a whole number of pages
+static uint32 round_to_pages(uint32 size)
+{
+	return (size+B_PAGE_SIZE-1) & ~(B_PAGE_SIZE-1);
+}
 
 //! Sets up stuff to be ready to allocate space for bitmaps
 BitmapManager::BitmapManager(void)
+ :	fOwners(0),
+ 	fBackingStores(0),
+ 	fBackingStoreMemory(0),
+ 	fEvictedBackingStores(0)
 {
-	fMemPool=new AreaPool;
-	bmplist=new BList(0);
-
-	// When create_area is passed the B_ANY_ADDRESS flag, the address of the area
-	// is stored in the pointer to a pointer.
-	bmparea=create_area("bitmap_area",(void**)&buffer,B_ANY_ADDRESS,BITMAP_AREA_SIZE,
-			B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
-	if(bmparea==B_BAD_VALUE ||
-	   bmparea==B_NO_MEMORY ||
-	   bmparea==B_ERROR)
-	   	printf("PANIC: BitmapManager couldn't allocate area!!\n");
+	fTableSize=INITIAL_TABLE_SIZE;
+	fTable=new bitmap_entry*[fTableSize];
+	memset(fTable,0,fTableSize*sizeof(bitmap_entry*));
+	fBitmapCount=0;
 	
 	lock=create_sem(1,"bmpmanager_lock");
 	if(lock<0)
 		printf("PANIC: BitmapManager couldn't allocate locking semaphore!!\n");
-	
-	fMemPool->AddToPool(buffer,BITMAP_AREA_SIZE);
 }
 
 //! Deallocates everything associated with the manager
 BitmapManager::~BitmapManager(void)
 {
-	if(bmplist->CountItems()>0)
+	for(int32 i=0; i<fTableSize; i++)
 	{
-		ServerBitmap *tbmp=NULL;
-		int32 itemcount=bmplist->CountItems();
-		for(int32 i=0; i<itemcount; i++)
+		while(fTable[i])
+			_DeleteEntry(fTable[i]);
+	}
+	delete [] fTable;
+	
+	// only empty slabs are left
+	for(int32 i=0; i<BITMAP_SIZE_CLASSES; i++)
+	{
+		for(int32 j=0; j<fSlabs[i].CountItems(); j++)
 		{
-			tbmp=(ServerBitmap*)bmplist->RemoveItem(0L);
-			if(tbmp)
-			{
-				fMemPool->ReleaseBuffer(tbmp->fBuffer);
-				delete tbmp;
-				tbmp=NULL;
-			}
+			bitmap_slab *slab=(bitmap_slab*)fSlabs[i].ItemAt(j);
+			delete_area(slab->area);
+			delete [] slab->freeChunks;
+			delete slab;
 		}
+		fSlabs[i].MakeEmpty();
+	}
+	
+	for(int32 i=0; i<fOwners.CountItems(); i++)
+		delete (bitmap_owner*)fOwners.ItemAt(i);
+	fOwners.MakeEmpty();
+	
+	for(int32 i=0; i<fBackingStores.CountItems(); i++)
+	{
+		backing_store_entry *entry=(backing_store_entry*)fBackingStores.ItemAt(i);
+		entry->owner->ForgetBackingStore();
+		delete entry->bitmap;
+		delete entry;
+	}
+	fBackingStores.MakeEmpty();
+	
+	for(int32 i=0; i<fEvictedBackingStores.CountItems(); i++)
+	{
+		backing_store_entry *entry=(backing_store_entry*)fEvictedBackingStores.ItemAt(i);
+		entry->owner->ForgetBackingStore();
+		delete entry->bitmap;
+		delete entry;
 	}
-	delete fMemPool;
-	delete bmplist;
-	delete_area(bmparea);
+	fEvictedBackingStores.MakeEmpty();
+	
 	delete_sem(lock);
 }
 
@@ -88,34 +173,56 @@ BitmapManager::~BitmapManager(void)
 	\param flags Bitmap flags as defined in Bitmap.h
 	\param bytes_per_row Number of bytes per row.
 	\param screen Screen id of the screen associated with it. Unused.
+	\param owner The ServerApp the memory is charged to. NULL for the server itself, 
+	which has no quota.
 	\return A new ServerBitmap or NULL if unable to allocate one.
 */
 ServerBitmap * BitmapManager::CreateBitmap(BRect bounds, color_space space, int32 flags,
-	int32 bytes_per_row, screen_id screen)
+	int32 bytes_per_row, screen_id screen, ServerApp *owner)
 {
 	acquire_sem(lock);
 	ServerBitmap *bmp=new ServerBitmap(bounds, space, flags, bytes_per_row);
 	
+	uint32 length=bmp->BitsLength();
+	int32 sizeClass=size_class_for(length);
+	uint32 size=(sizeClass>=0) ? kSizeClasses[sizeClass] : round_to_pages(length);
+	
+	bitmap_owner *bmpowner=_FindOwner(owner,true);
+	if(length==0 || (owner && bmpowner->memory+size > BITMAP_MEMORY_QUOTA))
+	{
+		delete bmp;
+		release_sem(lock);
+		return NULL;
+	}
+	
+	bitmap_entry *entry=new bitmap_entry;
+	entry->bitmap=bmp;
+	entry->owner=bmpowner;
+	entry->size=size;
+	
 	// Server version of this code will also need to handle such things as
 	// bitmaps which accept child views by checking the flags.
-	uint8 *bmpbuffer=(uint8 *)fMemPool->GetBuffer(bmp->BitsLength());
-
-	if(!bmpbuffer)
+	if(!_AllocateChunk(entry,length))
 	{
+		delete entry;
 		delete bmp;
+		release_sem(lock);
 		return NULL;
 	}
-	bmp->fArea=area_for(bmpbuffer);
-	bmp->fBuffer=bmpbuffer;
+	
 	bmp->fToken=tokenizer.GetToken();
 	bmp->fInitialized=true;
 	
-	// calculate area offset
-	area_info ai;
-	get_area_info(bmp->fArea,&ai);
-	bmp->fOffset=bmpbuffer-(uint8*)ai.address;
+	_AddEntry(entry);
+	
+	entry->ownerPrev=NULL;
+	entry->ownerNext=bmpowner->entries;
+	if(bmpowner->entries)
+		bmpowner->entries->ownerPrev=entry;
+	bmpowner->entries=entry;
+	bmpowner->memory+=size;
+	bmpowner->count++;
 	
-	bmplist->AddItem(bmp);
 	release_sem(lock);
 	return bmp;
 }
@@ -126,18 +233,540 @@ ServerBitmap * BitmapManager::CreateBitmap(BRect bounds, color_space space, int3
 */
 void BitmapManager::DeleteBitmap(ServerBitmap *bitmap)
 {
+	if(!bitmap)
+		return;
+	
 	acquire_sem(lock);
-	ServerBitmap *tbmp=(ServerBitmap*)bmplist->RemoveItem(bmplist->IndexOf(bitmap));
+	
+	bitmap_entry *entry=_FindEntry(bitmap->Token());
+	if(entry && entry->bitmap==bitmap)
+		_DeleteEntry(entry);
+	
+	release_sem(lock);
+}
 
-	if(!tbmp)
+/*!
+	\brief Deletes all bitmaps of an application
+	\param owner The ServerApp whose bitmaps are deleted
+*/
+void BitmapManager::DeleteBitmapsOf(ServerApp *owner)
+{
+	acquire_sem(lock);
+	
+	bitmap_owner *bmpowner=_FindOwner(owner,false);
+	if(bmpowner)
 	{
-		release_sem(lock);
+		while(bmpowner->entries)
+			_DeleteEntry(bmpowner->entries);
+		
+		fOwners.RemoveItem(bmpowner);
+		delete bmpowner;
+	}
+	
+	release_sem(lock);
+}
+
+/*!
+	\brief Looks up a bitmap by its token
+	\param token ID token of the bitmap to find
+	\param owner The ServerApp which has to own the bitmap
+	\return The bitmap having that ID or NULL if there is none or it belongs to 
+	someone else.
+*/
+ServerBitmap *BitmapManager::FindBitmap(int32 token, ServerApp *owner)
+{
+	ServerBitmap *bitmap=NULL;
+	
+	acquire_sem(lock);
+	
+	bitmap_entry *entry=_FindEntry(token);
+	if(entry && entry->owner->app==owner)
+		bitmap=entry->bitmap;
+	
+	release_sem(lock);
+	return bitmap;
+}
+
+/*!
+	\brief Returns the number of bytes of bitmap memory an application uses
+	\param owner The ServerApp to check
+	
+	This is what counts against BITMAP_MEMORY_QUOTA: the size of the chunks and 
+	areas of its bitmaps, not the size of the bitmaps themselves.
+*/
+uint32 BitmapManager::MemoryUsedBy(ServerApp *owner)
+{
+	acquire_sem(lock);
+	bitmap_owner *bmpowner=_FindOwner(owner,false);
+	uint32 memory=bmpowner ? bmpowner->memory : 0;
+	release_sem(lock);
+	return memory;
+}
+
+/*!
+	\brief Collects statistics about the bitmap memory
+	\param stats Receives the numbers
+*/
+void BitmapManager::GetStats(bitmap_manager_stats *stats)
+{
+	if(!stats)
+		return;
+	
+	memset(stats,0,sizeof(bitmap_manager_stats));
+	
+	acquire_sem(lock);
+	
+	for(int32 i=0; i<fTableSize; i++)
+	{
+		for(bitmap_entry *entry=fTable[i]; entry; entry=entry->hashNext)
+		{
+			stats->bitmaps++;
+			stats->requested+=entry->bitmap->BitsLength();
+			stats->allocated+=entry->size;
+			if(!entry->slab)
+			{
+				stats->large_bitmaps++;
+				stats->reserved+=entry->size;
+			}
+		}
+	}
+	
+	for(int32 i=0; i<BITMAP_SIZE_CLASSES; i++)
+	{
+		for(int32 j=0; j<fSlabs[i].CountItems(); j++)
+		{
+			bitmap_slab *slab=(bitmap_slab*)fSlabs[i].ItemAt(j);
+			stats->slabs++;
+			stats->reserved+=BITMAP_SLAB_SIZE;
+			if(slab->freeCount==slab->chunkCount)
+				stats->empty_slabs++;
+		}
+	}
+	
+	release_sem(lock);
+}
+
+/*!
+	\brief Prints how the bitmap memory is used
+	
+	Internal fragmentation is the part of the handed out memory which the bitmaps 
+	don't use, because they were rounded up to their size class. External 
+	fragmentation is the part of the areas which isn't handed out at all.
+*/
+void BitmapManager::PrintStats(void)
+{
+	bitmap_manager_stats stats;
+	GetStats(&stats);
+	
+	printf("BitmapManager: %ld bitmaps (%ld large), %ld slabs (%ld empty)\n",
+		stats.bitmaps,stats.large_bitmaps,stats.slabs,stats.empty_slabs);
+	printf("\t%lu bytes requested, %lu allocated, %lu reserved\n",
+		stats.requested,stats.allocated,stats.reserved);
+	if(stats.allocated>0 && stats.reserved>0)
+	{
+		printf("\tinternal fragmentation %.1f%%, external fragmentation %.1f%%\n",
+			100.0-100.0*stats.requested/stats.allocated,
+			100.0-100.0*stats.allocated/stats.reserved);
+	}
+	
+	acquire_sem(lock);
+	
+	for(int32 i=0; i<BITMAP_SIZE_CLASSES; i++)
+	{
+		int32 slabs=fSlabs[i].CountItems();
+		if(slabs==0)
+			continue;
+		
+		int32 used=0, total=0;
+		for(int32 j=0; j<slabs; j++)
+		{
+			bitmap_slab *slab=(bitmap_slab*)fSlabs[i].ItemAt(j);
+			used+=slab->chunkCount-slab->freeCount;
+			total+=slab->chunkCount;
+		}
+		printf("\t%6lu byte chunks: %ld of %ld used in %ld slabs\n",
+			kSizeClasses[i],used,total,slabs);
+	}
+	
+	for(int32 i=0; i<fOwners.CountItems(); i++)
+	{
+		bitmap_owner *owner=(bitmap_owner*)fOwners.ItemAt(i);
+		printf("\tapp %p: %ld bitmaps, %lu bytes\n",owner->app,owner->count,owner->memory);
+	}
+	
+	release_sem(lock);
+}
+
+/*!
+	\brief Finds memory for a bitmap and sets its area, buffer and offset
+	\param entry The entry of the bitmap. Its size must already be set.
+	\param length Number of bytes the bitmap needs
+	\return false if out of memory
+	
+	Chunks are taken from the fullest slab of their size class which has room, 
+	so that the emptier slabs drain and can be given back. Must be called with 
+	the lock held.
+*/
+bool BitmapManager::_AllocateChunk(bitmap_entry *entry, uint32 length)
+{
+	ServerBitmap *bmp=entry->bitmap;
+	int32 sizeClass=size_class_for(length);
+	
+	if(sizeClass<0)
+	{
+		// too large for a slab
+		uint8 *address;
+		area_id area=create_area("bitmap_area",(void**)&address,B_ANY_ADDRESS,
+			entry->size,B_NO_LOCK,B_READ_AREA | B_WRITE_AREA);
+		if(area<0)
+			return false;
+		
+		entry->slab=NULL;
+		entry->chunk=0;
+		bmp->fArea=area;
+		bmp->fBuffer=address;
+		bmp->fOffset=0;
+		return true;
+	}
+	
+	BList *slabs=&fSlabs[sizeClass];
+	bitmap_slab *slab=NULL;
+	for(int32 i=0; i<slabs->CountItems(); i++)
+	{
+		bitmap_slab *candidate=(bitmap_slab*)slabs->ItemAt(i);
+		if(candidate->freeCount>0 && (!slab || candidate->freeCount<slab->freeCount))
+			slab=candidate;
+	}
+	
+	if(!slab)
+	{
+		char name[B_OS_NAME_LENGTH];
+		sprintf(name,"bitmap_slab_%lu",kSizeClasses[sizeClass]);
+		
+		uint8 *address;
+		area_id area=create_area(name,(void**)&address,B_ANY_ADDRESS,
+			BITMAP_SLAB_SIZE,B_NO_LOCK,B_READ_AREA | B_WRITE_AREA);
+		if(area<0)
+		{
+			printf("PANIC: BitmapManager couldn't allocate area!!\n");
+			return false;
+		}
+		
+		slab=new bitmap_slab;
+		slab->area=area;
+		slab->address=address;
+		slab->chunkSize=kSizeClasses[sizeClass];
+		slab->chunkCount=BITMAP_SLAB_SIZE/slab->chunkSize;
+		slab->freeCount=slab->chunkCount;
+		slab->freeChunks=new int32[slab->chunkCount];
+		
+		// hand out the chunks from the start of the area
+		for(int32 i=0; i<slab->chunkCount; i++)
+			slab->freeChunks[i]=slab->chunkCount-1-i;
+		
+		slabs->AddItem(slab);
+	}
+	
+	entry->slab=slab;
+	entry->chunk=slab->freeChunks[--slab->freeCount];
+	bmp->fArea=slab->area;
+	bmp->fOffset=entry->chunk*slab->chunkSize;
+	bmp->fBuffer=slab->address+bmp->fOffset;
+	return true;
+}
+
+/*!
+	\brief Gives the memory of a bitmap back
+	\param entry The entry of the bitmap
+	
+	One empty slab per size class is kept, so that a bitmap which is created and 
+	deleted over and over again doesn't create a new area every time. Any other 
+	slab is released as soon as it is empty. Must be called with the lock held.
+*/
+void BitmapManager::_FreeChunk(bitmap_entry *entry)
+{
+	bitmap_slab *slab=entry->slab;
+	
+	if(!slab)
+	{
+		delete_area(entry->bitmap->fArea);
 		return;
 	}
+	
+	slab->freeChunks[slab->freeCount++]=entry->chunk;
+	if(slab->freeCount<slab->chunkCount)
+		return;
+	
+	BList *slabs=&fSlabs[size_class_for(slab->chunkSize)];
+	for(int32 i=0; i<slabs->CountItems(); i++)
+	{
+		bitmap_slab *other=(bitmap_slab*)slabs->ItemAt(i);
+		if(other!=slab && other->freeCount==other->chunkCount)
+		{
+			slabs->RemoveItem(slab);
+			delete_area(slab->area);
+			delete [] slab->freeChunks;
+			delete slab;
+			return;
+		}
+	}
+}
+
+//! Frees a bitmap and removes every trace of it. Must be called with the lock held.
+void BitmapManager::_DeleteEntry(bitmap_entry *entry)
+{
+	bitmap_owner *owner=entry->owner;
+	
+	if(entry->ownerPrev)
+		entry->ownerPrev->ownerNext=entry->ownerNext;
+	else
+		owner->entries=entry->ownerNext;
+	if(entry->ownerNext)
+		entry->ownerNext->ownerPrev=entry->ownerPrev;
+	owner->memory-=entry->size;
+	owner->count--;
+	
+	_RemoveEntry(entry);
+	_FreeChunk(entry);
+	
+	delete entry->bitmap;
+	delete entry;
+}
+
+//! Returns the entry of the bitmap with the given token or NULL. Must be called with the lock held.
+bitmap_entry *BitmapManager::_FindEntry(int32 token) const
+{
+	bitmap_entry *entry=fTable[token & (fTableSize-1)];
+	while(entry && entry->bitmap->Token()!=token)
+		entry=entry->hashNext;
+	return entry;
+}
+
+/*!
+	\brief Adds an entry to the hash table
+	
+	Tokens are handed out in sequence, so they spread evenly over the buckets and 
+	the table is simply doubled when there are more bitmaps than buckets. Must be 
+	called with the lock held.
+*/
+void BitmapManager::_AddEntry(bitmap_entry *entry)
+{
+	if(fBitmapCount>=fTableSize)
+	{
+		int32 size=fTableSize*2;
+		bitmap_entry **table=new bitmap_entry*[size];
+		memset(table,0,size*sizeof(bitmap_entry*));
+		
+		for(int32 i=0; i<fTableSize; i++)
+		{
+			bitmap_entry *next;
+			for(bitmap_entry *old=fTable[i]; old; old=next)
+			{
+				next=old->hashNext;
+				int32 index=old->bitmap->Token() & (size-1);
+				old->hashNext=table[index];
+				table[index]=old;
+			}
+		}
+		
+		delete [] fTable;
+		fTable=table;
+		fTableSize=size;
+	}
+	
+	int32 index=entry->bitmap->Token() & (fTableSize-1);
+	entry->hashNext=fTable[index];
+	fTable[index]=entry;
+	fBitmapCount++;
+}
+
+//! Removes an entry from the hash table. Must be called with the lock held.
+void BitmapManager::_RemoveEntry(bitmap_entry *entry)
+{
+	bitmap_entry **link=&fTable[entry->bitmap->Token() & (fTableSize-1)];
+	while(*link && *link!=entry)
+		link=&(*link)->hashNext;
+	
+	if(*link)
+	{
+		*link=entry->hashNext;
+		fBitmapCount--;
+	}
+}
+
+/*!
+	\brief Returns the accounting record of an application
+	\param owner The ServerApp. NULL is the server itself.
+	\param create true to create the record if there is none yet
+	
+	Must be called with the lock held.
+*/
+bitmap_owner *BitmapManager::_FindOwner(ServerApp *owner, bool create)
+{
+	for(int32 i=0; i<fOwners.CountItems(); i++)
+	{
+		bitmap_owner *bmpowner=(bitmap_owner*)fOwners.ItemAt(i);
+		if(bmpowner->app==owner)
+			return bmpowner;
+	}
+	
+	if(!create)
+		return NULL;
+	
+	bitmap_owner *bmpowner=new bitmap_owner;
+	bmpowner->app=owner;
+	bmpowner->memory=0;
+	bmpowner->count=0;
+	bmpowner->entries=NULL;
+	fOwners.AddItem(bmpowner);
+	return bmpowner;
+}
+
+/*!
+	\brief Allocates the backing store for a window
+	\param owner The WinBorder which will own the backing store
+	\param bounds Size of the bitmap
+	\param space Color space of the bitmap. This should match the screen.
+	\return The new bitmap or NULL if it would not fit under the memory limit.
+	
+	Backing stores are not shared with the client, so they are allocated from the
+	heap instead of the bitmap area. Any previous backing store of the owner is
+	freed. If the new one does not fit under BACKING_STORE_MEMORY_LIMIT, the least
+	recently used backing stores of other windows are thrown away until it does. 
+	Their owners are told so via WinBorder::BackingStoreEvicted().
+*/
+ServerBitmap *BitmapManager::CreateBackingStore(WinBorder *owner, BRect bounds, color_space space)
+{
+	if(!owner)
+		return NULL;
+	
+	DeleteBackingStore(owner);
+	
+	acquire_sem(lock);
+	
+	UtilityBitmap *bmp=new UtilityBitmap(bounds,space,0);
+	if(!bmp->Bits() || bmp->BitsLength() > BACKING_STORE_MEMORY_LIMIT)
+	{
+		delete bmp;
+		release_sem(lock);
+		return NULL;
+	}
+	
+	_EvictBackingStores(bmp->BitsLength());
+	
+	backing_store_entry *entry=new backing_store_entry;
+	entry->owner=owner;
+	entry->bitmap=bmp;
+	fBackingStores.AddItem(entry);
+	fBackingStoreMemory+=bmp->BitsLength();
+	
+	release_sem(lock);
+	return bmp;
+}
+
+/*!
+	\brief Frees the backing store of a window, if it has one
+	\param owner The WinBorder owning the backing store
+	
+	The owner is not notified, so this is intended to be called by the owner itself.
+	A backing store which has been evicted but not yet released is freed as well.
+*/
+void BitmapManager::DeleteBackingStore(WinBorder *owner)
+{
+	acquire_sem(lock);
+	
+	int32 index=_FindBackingStore(owner);
+	if(index>=0)
+	{
+		backing_store_entry *entry=(backing_store_entry*)fBackingStores.RemoveItem(index);
+		fBackingStoreMemory-=entry->bitmap->BitsLength();
+		delete entry->bitmap;
+		delete entry;
+	}
+	_FreeEvictedBackingStore(owner);
+	
+	release_sem(lock);
+}
 
-	// Server code will require a check to ensure bitmap doesn't have its own area		
-	fMemPool->ReleaseBuffer(tbmp->fBuffer);
-	delete tbmp;
+/*!
+	\brief Frees a window's backing store after it has been evicted
+	\param owner The WinBorder which owned the backing store
+	\return true if the owner had an evicted backing store. It must not use its 
+	backing store bitmap anymore in that case.
+	
+	This is called by the owner itself, with the desktop locked, after it has
+	been told about the eviction.
+*/
+bool BitmapManager::FreeEvictedBackingStore(WinBorder *owner)
+{
+	acquire_sem(lock);
+	bool freed=_FreeEvictedBackingStore(owner);
+	release_sem(lock);
+	return freed;
+}
 
+/*!
+	\brief Marks the backing store of a window as most recently used
+	\param owner The WinBorder owning the backing store
+*/
+void BitmapManager::TouchBackingStore(WinBorder *owner)
+{
+	acquire_sem(lock);
+	
+	int32 index=_FindBackingStore(owner);
+	if(index>=0 && index!=fBackingStores.CountItems()-1)
+		fBackingStores.MoveItem(index,fBackingStores.CountItems()-1);
+	
 	release_sem(lock);
 }
+
+//! Returns the index of the owner's entry in the backing store list or -1. Must be called with the lock held.
+int32 BitmapManager::_FindBackingStore(WinBorder *owner) const
+{
+	for(int32 i=0; i<fBackingStores.CountItems(); i++)
+	{
+		if(((backing_store_entry*)fBackingStores.ItemAt(i))->owner==owner)
+			return i;
+	}
+	return -1;
+}
+
+//! Frees the owner's evicted backing store, if any. Must be called with the lock held.
+bool BitmapManager::_FreeEvictedBackingStore(WinBorder *owner)
+{
+	for(int32 i=0; i<fEvictedBackingStores.CountItems(); i++)
+	{
+		backing_store_entry *entry=(backing_store_entry*)fEvictedBackingStores.ItemAt(i);
+		if(entry->owner==owner)
+		{
+			fEvictedBackingStores.RemoveItem(i);
+			delete entry->bitmap;
+			delete entry;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*!
+	\brief Throws away backing stores, oldest first, until there is room for more
+	\param needed Number of bytes which need to fit under the memory limit
+	
+	Must be called with the lock held.
+	
+	The windows owning the evicted backing stores are usually not locked by the
+	caller, so their bitmaps are not freed here. They no longer count against 
+	the limit, but stay around until the owner has dropped its pointer to them
+	and calls FreeEvictedBackingStore().
+*/
+void BitmapManager::_EvictBackingStores(uint32 needed)
+{
+	while(fBackingStores.CountItems()>0 && 
+		fBackingStoreMemory+needed > BACKING_STORE_MEMORY_LIMIT)
+	{
+		backing_store_entry *entry=(backing_store_entry*)fBackingStores.RemoveItem(0L);
+		fBackingStoreMemory-=entry->bitmap->BitsLength();
+		fEvictedBackingStores.AddItem(entry);
+		entry->owner->BackingStoreEvicted();
+	}
+}
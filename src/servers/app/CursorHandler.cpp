@@ -38,7 +38,9 @@ CursorHandler::CursorHandler(DisplayDriver *driver)
 	fHideLevel(0),
 	fDriverHidden(false),
 	fIsObscured(false),
-	fValidSaveData(false)
+	fValidSaveData(false),
+	fComposited(false),
+	fComposite(NULL)
 {
 }
 
@@ -46,6 +48,7 @@ CursorHandler::CursorHandler(DisplayDriver *driver)
 CursorHandler::~CursorHandler(void)
 {
 	delete fSavedData;
+	delete fComposite;
 }
 
 /*!
@@ -55,6 +58,10 @@ CursorHandler::~CursorHandler(void)
 */
 bool CursorHandler::IntersectsCursor(const BRect &r)
 {
+	// drawing can't damage a cursor which isn't in the frame buffer
+	if(fComposited)
+		return false;
+	
 	return TestRectIntersection(r, fPosition);
 }
 
@@ -99,6 +106,25 @@ void CursorHandler::MoveTo(const BPoint &pt)
 		return;
 	
 	fCursorPos=pt;
+	
+	if(fComposited)
+	{
+		// Moving the cursor shows it again if it was obscured
+		fIsObscured=false;
+		
+		BRect old=fPosition;
+		fPosition.OffsetTo(fCursorPos.x-fCursor->GetHotSpot().x,
+				fCursorPos.y-fCursor->GetHotSpot().y);
+		fOldPosition=fPosition;
+		
+		if(fHideLevel==0)
+		{
+			fDriver->Invalidate(old);
+			fDriver->Invalidate(fPosition);
+		}
+		return;
+	}
+	
 	fDriver->CopyBitmap(fSavedData,fSavedData->Bounds(),fOldPosition,&(fDriver->fDrawData));
 	fPosition.OffsetTo(fCursorPos.x-fCursor->GetHotSpot().x,
 			fCursorPos.y-fCursor->GetHotSpot().y);
@@ -133,6 +159,12 @@ void CursorHandler::Show(void)
 	if(!fCursor)
 		return;
 	
+	if(fComposited)
+	{
+		fDriver->Invalidate(fPosition);
+		return;
+	}
+	
 	fValidSaveData=true;
 	
 	if(!fSavedData)
@@ -167,6 +199,12 @@ void CursorHandler::Hide(void)
 	if(!fCursor)
 		return;
 	
+	if(fComposited)
+	{
+		fDriver->Invalidate(fPosition);
+		return;
+	}
+	
 	if(!fSavedData)
 		fSavedData=new UtilityBitmap(fCursor);
 	
@@ -191,13 +229,19 @@ void CursorHandler::Obscure(void)
 		return;
 	}
 	
+	if(fComposited)
+	{
+		fDriver->Invalidate(fPosition);
+		return;
+	}
+	
 	fDriver->CopyBitmap(fSavedData,fSavedData->Bounds(),fOldPosition,&(fDriver->fDrawData));
 	fDriver->Invalidate(fPosition);
 }
 
 void CursorHandler::DriverHide(void)
 {
-	if(fDriverHidden)
+	if(fDriverHidden || fComposited)
 		return;
 		
 	fDriverHidden=true;
@@ -237,3 +281,88 @@ void CursorHandler::DriverShow(void)
 	fDriver->fDrawData.draw_mode=B_OP_COPY;
 	fDriver->Invalidate(fPosition);
 }
+
+/*!
+	\brief Switches between drawing the cursor into the frame buffer and compositing it
+	\param value true if the driver composites the cursor when updating the screen
+	
+	Drivers which keep the screen contents in a buffer of their own and copy
+	them to the screen in Invalidate() should turn this on and call Composite()
+	from there. Drawing calls then don't need to hide and show the cursor.
+	Only 32-bit frame buffers are supported.
+*/
+void CursorHandler::SetComposited(bool value)
+{
+	if(value==fComposited)
+		return;
+	
+	// take the cursor out of the frame buffer before switching
+	Hide();
+	fComposited=value;
+	fValidSaveData=false;
+	Show();
+}
+
+/*!
+	\brief Returns the area the cursor has to be composited into
+	\param frame Receives the cursor's screen footprint
+	\return false if the cursor doesn't need to be composited at all
+*/
+bool CursorHandler::GetCompositeFrame(BRect *frame) const
+{
+	if(!fComposited || !fCursor || fHideLevel>0 || fIsObscured)
+		return false;
+	
+	*frame=fPosition;
+	return true;
+}
+
+/*!
+	\brief Blends the cursor over a part of the screen
+	\param source The frame buffer, which doesn't contain the cursor
+	\param area The part to compose. Must be within the cursor's footprint and
+	the frame buffer.
+	\return A bitmap whose top left corner holds the composed area. It belongs
+	to the CursorHandler and is valid until the next call.
+*/
+UtilityBitmap *CursorHandler::Composite(ServerBitmap *source, const BRect &area)
+{
+	if(source->BitsPerPixel()!=32 || fCursor->BitsPerPixel()!=32)
+		return NULL;
+	
+	if(fComposite && (fComposite->Width()<fCursor->Width()
+		|| fComposite->Height()<fCursor->Height()
+		|| fComposite->ColorSpace()!=source->ColorSpace()))
+	{
+		delete fComposite;
+		fComposite=NULL;
+	}
+	
+	if(!fComposite)
+		fComposite=new UtilityBitmap(fCursor->Bounds(),source->ColorSpace(),0);
+	
+	int32 left=(int32)area.left, top=(int32)area.top;
+	int32 width=area.IntegerWidth()+1, height=area.IntegerHeight()+1;
+	int32 cursorX=left-(int32)fPosition.left, cursorY=top-(int32)fPosition.top;
+	bool hasAlpha=(fCursor->ColorSpace()==B_RGBA32);
+	
+	for(int32 y=0; y<height; y++)
+	{
+		uint8 *dest=fComposite->Bits()+y*fComposite->BytesPerRow();
+		uint8 *screen=source->Bits()+(top+y)*source->BytesPerRow()+left*4;
+		uint8 *cursor=fCursor->Bits()+(cursorY+y)*fCursor->BytesPerRow()+cursorX*4;
+		
+		for(int32 x=0; x<width; x++, dest+=4, screen+=4, cursor+=4)
+		{
+			uint16 alpha=hasAlpha ? cursor[3] : 255;
+			uint16 inverse=255-alpha;
+			
+			dest[0]=(cursor[0]*alpha+screen[0]*inverse)/255;
+			dest[1]=(cursor[1]*alpha+screen[1]*inverse)/255;
+			dest[2]=(cursor[2]*alpha+screen[2]*inverse)/255;
+			dest[3]=screen[3];
+		}
+	}
+	
+	return fComposite;
+}
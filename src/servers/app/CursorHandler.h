@@ -58,6 +58,11 @@ public:
 	
 	void DriverHide(void);
 	void DriverShow(void);
+	
+	void SetComposited(bool value);
+	bool IsComposited(void) const { return fComposited; }
+	bool GetCompositeFrame(BRect *frame) const;
+	UtilityBitmap *Composite(ServerBitmap *source, const BRect &area);
 private:
 	
 	DisplayDriver *fDriver;
@@ -73,6 +78,11 @@ private:
 	bool fDriverHidden;
 	bool fIsObscured;
 	bool fValidSaveData;
+	
+	// In composited mode the cursor is never drawn into the frame buffer. The
+	// driver blends it over the screen contents when it puts them on screen.
+	bool fComposited;
+	UtilityBitmap *fComposite;
 };
 
 #endif
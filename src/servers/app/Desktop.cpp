@@ -25,6 +25,8 @@
 //
 //------------------------------------------------------------------------------
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <Entry.h>
 #include <Region.h>
 #include <Message.h>
@@ -41,6 +43,7 @@
 #include "WinBorder.h"
 #include "Workspace.h"
 #include <PortLink.h>
+#include <InputState.h>
 
 //#define REAL_MODE
 #include "ServerBitmap.h"
@@ -58,12 +61,20 @@
 #define DRIVER_NAME "SDL Driver"
 #endif
 
-#if !defined(COSMOE_DIRECTFB) && !defined(COSMOE_SDL)
+#ifdef COSMOE_HEADLESS
+#define DRIVER_CLASS HeadlessDriver
+#define DRIVER_NAME "Headless Driver"
+#endif
+
+#if !defined(COSMOE_DIRECTFB) && !defined(COSMOE_SDL) && !defined(COSMOE_HEADLESS)
 #include "x11driver.h"
 #define DRIVER_CLASS X11Driver
 #define DRIVER_NAME "X11 Driver"
 #endif
 
+// The headless driver is always there, so it can be picked at run time, too
+#include "headlessdriver.h"
+
 #define DEBUG_DESKTOP
 #define DEBUG_KEYHANDLING
 
@@ -80,6 +91,8 @@ Desktop::Desktop(void)
 	fMouseTarget		= NULL;
 	fActiveScreen		= NULL;
 	fScreenShotIndex	= 1;
+	fInputArea			= -1;
+	fInputState			= NULL;
 }
 
 Desktop::~Desktop(void)
@@ -96,6 +109,12 @@ Desktop::~Desktop(void)
 
 	for(int32 i=0; (ptr=fWinBorderList.ItemAt(i)); i++)
 		delete (WinBorder*)ptr;
+	
+	if (fInputState)
+	{
+		delete_sem(fInputState->changed);
+		delete_area(fInputArea);
+	}
 }
 
 void Desktop::Init(void)
@@ -104,16 +123,34 @@ STRACE(("Desktop: InitDesktop\n"));
 	DisplayDriver	*driver = NULL;
 	int32 driverCount = 0;
 	bool initDrivers = true;
+	bool headless = (getenv("COSMOE_HEADLESS") != NULL);
+	const char *driverName = headless ? "Headless Driver" : DRIVER_NAME;
+
+	// Publish the input state before any client can look for it
+	void *address;
+	fInputArea = create_area(INPUT_STATE_AREA, &address, B_ANY_ADDRESS,
+		B_PAGE_SIZE, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+	if (fInputArea >= 0)
+	{
+		fInputState = (input_state*)address;
+		memset(fInputState, 0, sizeof(input_state));
+		fInputState->changed = create_sem(0, "input state changed");
+	}
+	else
+		printf("Couldn't create the input state area: %s\n", strerror(fInputArea));
 
 	while(initDrivers)
 	{
 
-		driver = new DRIVER_CLASS;
-		STRACE(( "Loading " DRIVER_NAME "...\n" ));
+		if (headless)
+			driver = new HeadlessDriver;
+		else
+			driver = new DRIVER_CLASS;
+		STRACE(( "Loading %s...\n", driverName ));
 
 		if(driver->Initialize())
 		{
-			STRACE(( DRIVER_NAME " succesfully initialized\n" ));
+			STRACE(( "%s succesfully initialized\n", driverName ));
 			driverCount++;
 
 			Screen		*sc = new Screen(driver, BPoint(800, 600), B_RGB32, driverCount);
@@ -127,7 +164,7 @@ STRACE(("Desktop: InitDesktop\n"));
 		}
 		else
 		{
-			STRACE(( DRIVER_NAME "FAILED initialization - game over\n" ));
+			STRACE(( "%s FAILED initialization - game over\n", driverName ));
 			driver->Shutdown();
 			delete	driver;
 			driver	= NULL;
@@ -322,6 +359,7 @@ void Desktop::MouseEventHandler(int32 code, BPortLink& msg)
 			msg.Read<int32>(&evt.modifiers);
 			msg.Read<int32>(&evt.buttons);
 			msg.Read<int32>(&evt.clicks);
+			PublishInput(evt);
 			
 			// printf("MOUSE DOWN: at (%f, %f)\n", evt.where.x, evt.where.y);
 			
@@ -419,6 +457,8 @@ printf("2Focus: %s\n", ws->FocusLayer()->GetName());
 			msg.Read<float>(&evt.where.x);
 			msg.Read<float>(&evt.where.y);
 			msg.Read<int32>(&evt.modifiers);
+			evt.buttons = 0;
+			PublishInput(evt);
 
 			if (fMouseTarget)
 			{
@@ -444,42 +484,9 @@ printf("2Focus: %s\n", ws->FocusLayer()->GetName());
 		}
 		case B_MOUSE_MOVED:
 		{
-			// Attached data:
-			// 1) int64 - time of mouse click
-			// 2) float - x coordinate of mouse click
-			// 3) float - y coordinate of mouse click
-			// 4) int32 - buttons down
-			
-			PointerEvent evt;	
-			evt.code = B_MOUSE_MOVED;
-			msg.Read<int64>(&evt.when);
-			msg.Read<float>(&evt.where.x);
-			msg.Read<float>(&evt.where.y);
-			msg.Read<int32>(&evt.buttons);
-
-			if (fMouseTarget)
-			{
-				fActiveScreen->DDriver()->HideCursor();
-				fActiveScreen->DDriver()->MoveCursorTo(evt.where.x, evt.where.y);
-
-				fMouseTarget->Window()->Lock();
-				fMouseTarget->MouseMoved(evt);
-				fMouseTarget->Window()->Unlock();
-
-				fActiveScreen->DDriver()->ShowCursor();
-			}
-			else
-			{
-				WinBorder *target = ActiveRootLayer()->WinBorderAt(BPoint(evt.where.x, evt.where.y));
-				if(target){
-					target->Window()->Lock();
-					target->MouseMoved(evt);
-					target->Window()->Unlock();
-				}
-
-				fActiveScreen->DDriver()->MoveCursorTo(evt.where.x, evt.where.y);
-			}
-
+			PointerEvent evt;
+			ReadMouseMoved(msg, &evt);
+			MouseMovedHandler(evt);
 			break;
 		}
 		case B_MOUSE_WHEEL_CHANGED:
@@ -504,6 +511,90 @@ printf("2Focus: %s\n", ws->FocusLayer()->GetName());
 	}
 }
 
+/*!
+	\brief Reads the data attached to a B_MOUSE_MOVED message
+	\param link The link the message was received on
+	\param evt The event to fill in
+	\return B_OK or the error of the last read
+*/
+status_t Desktop::ReadMouseMoved(BPortLink& link, PointerEvent *evt)
+{
+	// Attached data:
+	// 1) int64 - time of mouse move
+	// 2) float - x coordinate of mouse
+	// 3) float - y coordinate of mouse
+	// 4) int32 - buttons down
+	
+	evt->code = B_MOUSE_MOVED;
+	evt->modifiers = 0;
+	evt->clicks = 0;
+	evt->history = 0;
+	
+	link.Read<int64>(&evt->when);
+	link.Read<float>(&evt->where.x);
+	link.Read<float>(&evt->where.y);
+	return link.Read<int32>(&evt->buttons);
+}
+
+/*!
+	\brief Moves the cursor and passes a mouse move on to the window concerned
+	\param evt The move. It may stand for several moves collapsed by the poller
+	thread, in which case it holds the most recent position.
+*/
+void Desktop::MouseMovedHandler(PointerEvent &evt)
+{
+	if (fMouseTarget)
+	{
+		fActiveScreen->DDriver()->HideCursor();
+		fActiveScreen->DDriver()->MoveCursorTo(evt.where.x, evt.where.y);
+
+		fMouseTarget->Window()->Lock();
+		fMouseTarget->MouseMoved(evt);
+		fMouseTarget->Window()->Unlock();
+
+		fActiveScreen->DDriver()->ShowCursor();
+	}
+	else
+	{
+		WinBorder *target = ActiveRootLayer()->WinBorderAt(evt.where);
+		if(target){
+			target->Window()->Lock();
+			target->MouseMoved(evt);
+			target->Window()->Unlock();
+		}
+
+		fActiveScreen->DDriver()->MoveCursorTo(evt.where.x, evt.where.y);
+	}
+}
+
+/*!
+	\brief Publishes a mouse event in the shared input state
+	\param evt The event. Moves don't carry the modifiers, so they keep the 
+	ones of the last click.
+	
+	All input is read by the poller thread, which is the only writer of the 
+	state. Clients read it with BPrivate::get_input_state().
+*/
+void Desktop::PublishInput(const PointerEvent &evt)
+{
+	if (!fInputState)
+		return;
+	
+	atomic_add(&fInputState->sequence, 1);
+	fInputState->x = evt.where.x;
+	fInputState->y = evt.where.y;
+	fInputState->buttons = evt.buttons;
+	if (evt.code != B_MOUSE_MOVED)
+		fInputState->modifiers = evt.modifiers;
+	fInputState->when = evt.when;
+	atomic_add(&fInputState->sequence, 1);
+	
+	// wake up every thread waiting for a change
+	int32 count;
+	if (get_sem_count(fInputState->changed, &count) == B_OK && count < 0)
+		release_sem_etc(fInputState->changed, -count, 0);
+}
+
 void Desktop::KeyboardEventHandler(int32 code, BPortLink& msg)
 {
 
@@ -39,6 +39,8 @@ class BMessage;
 class WinBorder;
 class DisplayDriver;
 class BPortLink;
+class PointerEvent;
+struct input_state;
 
 class Desktop
 {
@@ -71,7 +73,10 @@ public:
 
 	// Input related methods
 	void MouseEventHandler(int32 code, BPortLink& link);
+	void MouseMovedHandler(PointerEvent &evt);
+	static status_t ReadMouseMoved(BPortLink& link, PointerEvent *evt);
 	void KeyboardEventHandler(int32 code, BPortLink& link);
+	void PublishInput(const PointerEvent &evt);
 	
 	void SetDragMessage(BMessage *msg);
 	BMessage *DragMessage(void) const;
@@ -109,6 +114,9 @@ private:
 
 	WinBorder *fMouseTarget;
 	
+	area_id fInputArea;
+	input_state *fInputState;
+	
 	BList fScreenList;
 	Screen *fActiveScreen;
 	
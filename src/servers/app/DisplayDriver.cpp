@@ -30,7 +30,11 @@
 #include <Accelerant.h>
 #include "Angle.h"
 #include "FontFamily.h"
+#include "FontServer.h"
+#include <FontEscapements.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "DisplayDriver.h"
 #include "RectUtils.h"
 #include "Utils.h"
@@ -120,10 +124,145 @@ void DisplayDriver::CopyBits(const BRect &src, const BRect &dest, const DrawData
 	\brief A screen-to-screen blit (of sorts) which copies a BRegion
 	\param src Source region
 	\param lefttop Offset to which the region will be copied
+	
+	The top left corner of the region's frame ends up at lefttop. Source and 
+	destination may overlap.
 */
 void DisplayDriver::CopyRegion(BRegion *src, const BPoint &lefttop)
 {
-	// TODO: Implement DisplayDriver;:CopyRegion
+	if(!src || src->CountRects()==0)
+		return;
+	
+	BRect frame(src->Frame());
+	int32 dx=(int32)(lefttop.x-frame.left);
+	int32 dy=(int32)(lefttop.y-frame.top);
+	
+	if(dx==0 && dy==0)
+		return;
+	
+	Lock();
+	
+	FBBitmap frameBuffer;
+	if(!AcquireBuffer(&frameBuffer))
+	{
+		Unlock();
+		return;
+	}
+	
+	if(fCursorHandler->IntersectsCursor(frame | frame.OffsetByCopy(dx,dy)))
+		fCursorHandler->DriverHide();
+	
+	BRect inval=_CopyRegionOrdered(&frameBuffer,src,dx,dy);
+	
+	fCursorHandler->DriverShow();
+	ReleaseBuffer();
+	Unlock();
+	
+	if(inval.IsValid())
+		Invalidate(inval);
+}
+
+//! Sort key for ordering the rectangles of a region in _CopyRegionOrdered()
+typedef struct
+{
+	float y;
+	float x;
+	int32 index;
+} copy_order;
+
+static int compare_copy_order(const void *a, const void *b)
+{
+	const copy_order *first=(const copy_order*)a;
+	const copy_order *second=(const copy_order*)b;
+	
+	if(first->y!=second->y)
+		return (first->y < second->y) ? -1 : 1;
+	if(first->x!=second->x)
+		return (first->x < second->x) ? -1 : 1;
+	return 0;
+}
+
+/*!
+	\brief Moves the contents of a region within the framebuffer
+	\param fb The acquired framebuffer
+	\param region Source area in screen coordinates
+	\param dx Horizontal offset
+	\param dy Vertical offset
+	\return The area which has changed on screen
+	
+	No temporary copy is made. Instead the rectangles are copied in an order
+	which never overwrites pixels that still have to be read: bands are walked 
+	from the bottom when moving down and rectangles within a band from the right
+	when moving right, just like rows within a rectangle. This relies on the 
+	rectangles of a BRegion being sorted into y-x bands. The caller must hold the
+	driver lock and take care of the cursor.
+*/
+BRect DisplayDriver::_CopyRegionOrdered(FBBitmap *fb, BRegion *region, int32 dx, int32 dy)
+{
+	BRect inval;
+	int32 count=region->CountRects();
+	
+	if(count==0 || (dx==0 && dy==0))
+		return inval;
+	
+	BRect screen(fb->Bounds());
+	BRect clip(screen & screen.OffsetByCopy(-dx,-dy));
+	
+	int32 bytesPerPixel=(fb->BitsPerPixel()+7)/8;
+	int32 bytesPerRow=fb->BytesPerRow();
+	uint8 *bits=(uint8*)fb->Bits();
+	
+	copy_order *order=new copy_order[count];
+	for(int32 i=0; i<count; i++)
+	{
+		BRect r(region->RectAt(i));
+		order[i].y=(dy>0) ? -r.top : r.top;
+		order[i].x=(dx>0) ? -r.left : r.left;
+		order[i].index=i;
+	}
+	qsort(order,count,sizeof(copy_order),compare_copy_order);
+	
+	for(int32 i=0; i<count; i++)
+	{
+		BRect r(region->RectAt(order[i].index) & clip);
+		if(!r.IsValid())
+			continue;
+		
+		int32 left=(int32)r.left;
+		int32 top=(int32)r.top;
+		int32 rows=(int32)r.bottom-top+1;
+		int32 length=((int32)r.right-left+1)*bytesPerPixel;
+		
+		uint8 *src=bits+top*bytesPerRow+left*bytesPerPixel;
+		uint8 *dest=src+dy*bytesPerRow+dx*bytesPerPixel;
+		int32 step=bytesPerRow;
+		
+		if(dy>0)
+		{
+			// bottom row first
+			src+=(rows-1)*bytesPerRow;
+			dest+=(rows-1)*bytesPerRow;
+			step=-bytesPerRow;
+		}
+		
+		if(dy==0)
+		{
+			// source and destination may share a row
+			for(int32 j=0; j<rows; j++, src+=step, dest+=step)
+				memmove(dest,src,length);
+		}
+		else
+		{
+			for(int32 j=0; j<rows; j++, src+=step, dest+=step)
+				memcpy(dest,src,length);
+		}
+		
+		r.OffsetBy(dx,dy);
+		inval=inval.IsValid() ? (inval | r) : r;
+	}
+	
+	delete [] order;
+	return inval;
 }
 
 /*!
@@ -297,12 +436,21 @@ void DisplayDriver::DrawBitmap(ServerBitmap *bmp, const BRect &src, const BRect
 */
 }
 
+/*!
+	\brief Copies several screen regions, each by its own offset
+	\param list List of BRegion pointers, in screen coordinates
+	\param pList List of BPoint pointers. Region k is moved by point k.
+	\param rCount Number of regions in the list
+	\param clipReg Unused
+	
+	Regions are moved in place unless one region's destination covers another
+	region's source. Only then are the rectangles staged in temporary buffers.
+*/
 void DisplayDriver::CopyRegionList(BList* list, BList* pList, int32 rCount, BRegion* clipReg)
 {
 	Lock();
 
 	FBBitmap		frameBuffer;
-	FBBitmap		*bmp = &frameBuffer;
 	
 	if(!AcquireBuffer(&frameBuffer))
 	{
@@ -312,7 +460,58 @@ void DisplayDriver::CopyRegionList(BList* list, BList* pList, int32 rCount, BReg
 	
 	fCursorHandler->DriverHide();
 	
+	BRect		inval;
+	int32		k;
 	
+	if(_RegionListOverlaps(list, pList, rCount))
+	{
+		_CopyRegionListStaged(&frameBuffer, list, pList, rCount);
+		inval = frameBuffer.Bounds();
+	}
+	else
+	{
+		for(k=0; k < rCount; k++)
+		{
+			BRegion		*reg = (BRegion*)list->ItemAt(k);
+			BPoint		*pt = (BPoint*)pList->ItemAt(k);
+			
+			BRect		r = _CopyRegionOrdered(&frameBuffer, reg, (int32)pt->x, (int32)pt->y);
+			if(r.IsValid())
+				inval = inval.IsValid() ? (inval | r) : r;
+		}
+	}
+
+	fCursorHandler->DriverShow();
+	
+	ReleaseBuffer();
+	Unlock();
+
+//	ConstrainClippingRegion(clipReg);
+	if(inval.IsValid())
+		Invalidate(inval);
+//	ConstrainClippingRegion(NULL);
+}
+
+//! Returns true if moving one region of the list would overwrite the source of another
+bool DisplayDriver::_RegionListOverlaps(BList* list, BList* pList, int32 rCount)
+{
+	for(int32 k=0; k < rCount; k++)
+	{
+		BPoint		*pt = (BPoint*)pList->ItemAt(k);
+		BRect		dest = ((BRegion*)list->ItemAt(k))->Frame().OffsetByCopy(*pt);
+		
+		for(int32 j=0; j < rCount; j++)
+		{
+			if(j != k && ((BRegion*)list->ItemAt(j))->Intersects(dest))
+				return true;
+		}
+	}
+	return false;
+}
+
+//! Copies a list of regions by first saving all sources to temporary buffers
+void DisplayDriver::_CopyRegionListStaged(FBBitmap *bmp, BList* list, BList* pList, int32 rCount)
+{
 	uint32		bytesPerPixel	= bmp->BytesPerRow() / bmp->Bounds().IntegerWidth();
 	BList		rectList;
 	int32		i, k;
@@ -418,16 +617,112 @@ void DisplayDriver::CopyRegionList(BList* list, BList* pList, int32 rCount, BReg
 			free(rectCopy);
 	}
 	rectList.MakeEmpty();
+}
 
-	fCursorHandler->DriverShow();
+/*!
+	\brief Copies the contents of a screen region into a bitmap
+	\param region Area to save, in screen coordinates
+	\param bitmap Target bitmap. It must have the same depth as the framebuffer.
+	\param lefttop Screen position of the bitmap's top left pixel
+	\return false if the framebuffer could not be accessed or the depths differ
+
+	This is used by window backing store to keep the contents of a window when
+	it becomes obscured. Parts of the region which fall outside either the screen
+	or the bitmap are skipped.
+*/
+bool DisplayDriver::SaveRegionToBitmap(BRegion *region, ServerBitmap *bitmap, const BPoint &lefttop)
+{
+	return _CopyRegionBitmap(region, bitmap, lefttop, true);
+}
+
+/*!
+	\brief Copies the contents of a bitmap back to a screen region
+	\param region Area to restore, in screen coordinates
+	\param bitmap Source bitmap. It must have the same depth as the framebuffer.
+	\param lefttop Screen position of the bitmap's top left pixel
+	\return false if the framebuffer could not be accessed or the depths differ
+*/
+bool DisplayDriver::RestoreRegionFromBitmap(BRegion *region, ServerBitmap *bitmap, const BPoint &lefttop)
+{
+	return _CopyRegionBitmap(region, bitmap, lefttop, false);
+}
+
+bool DisplayDriver::_CopyRegionBitmap(BRegion *region, ServerBitmap *bitmap, const BPoint &lefttop, bool save)
+{
+	if(!region || !bitmap || !bitmap->Bits())
+		return false;
+	
+	Lock();
+
+	FBBitmap		frameBuffer;
+	
+	if(!AcquireBuffer(&frameBuffer))
+	{
+		Unlock();
+		return false;
+	}
+	
+	if(frameBuffer.BitsPerPixel() != bitmap->BitsPerPixel())
+	{
+		ReleaseBuffer();
+		Unlock();
+		return false;
+	}
+	
+	BRect		screenframe(frameBuffer.Bounds());
+	BRect		bitmapframe(bitmap->Bounds());
+	bitmapframe.OffsetTo(lefttop);
+	
+	BRect		inval;
+	
+	int32		bytesPerPixel	= (frameBuffer.BitsPerPixel() + 7) / 8;
+	int32		fbRow			= frameBuffer.BytesPerRow();
+	int32		bmpRow			= bitmap->BytesPerRow();
+	uint8		*fbBits			= (uint8*)frameBuffer.Bits();
+	uint8		*bmpBits		= (uint8*)bitmap->Bits();
+	int32		xoffset			= (int32)lefttop.x;
+	int32		yoffset			= (int32)lefttop.y;
+	
+	if(fCursorHandler->IntersectsCursor(region->Frame()))
+		fCursorHandler->DriverHide();
+	
+	int32 count = region->CountRects();
+	for(int32 i=0; i < count; i++)
+	{
+		BRect r = region->RectAt(i) & screenframe & bitmapframe;
+		if(!r.IsValid())
+			continue;
+		
+		inval = inval.IsValid() ? (inval | r) : r;
+		
+		int32		left		= (int32)r.left;
+		int32		top			= (int32)r.top;
+		int32		length		= ((int32)r.right - left + 1) * bytesPerPixel;
+		int32		rows		= (int32)r.bottom - top + 1;
+		
+		uint8		*fbAddress	= fbBits + top * fbRow + left * bytesPerPixel;
+		uint8		*bmpAddress	= bmpBits + (top - yoffset) * bmpRow + (left - xoffset) * bytesPerPixel;
+		
+		for(int32 j=0; j < rows; j++)
+		{
+			if(save)
+				memcpy(bmpAddress, fbAddress, length);
+			else
+				memcpy(fbAddress, bmpAddress, length);
+			
+			fbAddress += fbRow;
+			bmpAddress += bmpRow;
+		}
+	}
 	
-	BRect		inval(bmp->Bounds());
+	fCursorHandler->DriverShow();
 	ReleaseBuffer();
 	Unlock();
-
-//	ConstrainClippingRegion(clipReg);
-	Invalidate(inval);
-//	ConstrainClippingRegion(NULL);
+	
+	if(!save && inval.IsValid())
+		Invalidate(inval);
+	
+	return true;
 }
 
 void DisplayDriver::DrawString(const char *string, const int32 &length, const BPoint &pt, const RGBColor &color, escapement_delta *delta)
@@ -559,6 +854,7 @@ void DisplayDriver::DrawString(const char *string, const int32 &length, const BP
 	for(i=0;i<strlength;i++)
 	{
 		FT_Set_Transform(face,&smatrix,&pen);
+		glyph_index=FT_Get_Char_Index(face,(uint8)string[i]);
 
 		// Handle escapement padding option
 		if((uint8)string[i]<=0x20)
@@ -581,7 +877,7 @@ void DisplayDriver::DrawString(const char *string, const int32 &length, const BP
 			pen.y+=delta.y;
 		}
 
-		error=FT_Load_Char(face,string[i],
+		error=FT_Load_Char(face,(uint8)string[i],
 			((antialias)?FT_LOAD_RENDER:FT_LOAD_RENDER | FT_LOAD_MONOCHROME) );
 
 		if(!error)
@@ -592,11 +888,11 @@ void DisplayDriver::DrawString(const char *string, const int32 &length, const BP
 			else
 				BlitMono2RGB32(&slot->bitmap,
 					BPoint(slot->bitmap_left,point.y-(slot->bitmap_top-point.y)), d);
-		}
 
-		// increment pen position
-		pen.x+=slot->advance.x;
-		pen.y+=slot->advance.y;
+			// increment pen position
+			pen.x+=slot->advance.x;
+			pen.y+=slot->advance.y;
+		}
 		previous=glyph_index;
 	}
 
@@ -3720,7 +4016,6 @@ float DisplayDriver::StringWidth(const char *string, int32 length, const DrawDat
 {
 	if(!string || !d)
 		return 0.0;
-	Lock();
 
 	const ServerFont *font=&(d->font);
 	FontStyle *style=font->Style();
@@ -3728,62 +4023,35 @@ float DisplayDriver::StringWidth(const char *string, int32 length, const DrawDat
 	if(!style)
 		return 0.0;
 
-	FT_Face face;
-	FT_GlyphSlot slot;
-	FT_UInt glyph_index=0, previous=0;
-	FT_Vector pen,delta;
-	int16 error=0;
-	int32 strlength,i;
-	float returnval;
+	// The escapement table holds the same advances and kerning DrawString()
+	// gets from FreeType, and it is what BFont measures with on the client side
+	fontserver->Lock();
+	const escapement_table *table=fontserver->GetEscapements(style,int32(font->Size()));
+	fontserver->Unlock();
 
-	error=FT_New_Face(ftlib, style->GetPath(), 0, &face);
-	if(error)
-	{
-		Unlock();
+	if(!table)
 		return 0.0;
-	}
-
-	slot=face->glyph;
 
-	bool use_kerning=FT_HAS_KERNING(face) && font->Spacing()==B_STRING_SPACING;
-	
-	error=FT_Set_Char_Size(face, 0,int32(font->Size())*64,72,72);
-	if(error)
-	{
-		Unlock();
-		return 0.0;
-	}
+	bool use_kerning=font->Spacing()==B_STRING_SPACING;
+	int32 strlength,i;
+	int32 pen=0;
+	uint8 previous=0;
 
-	// set the pen position in 26.6 cartesian space coordinates
-	pen.x=0;
-	
-	slot=face->glyph;
-	
 	strlength=strlen(string);
 	if(length<strlength)
 		strlength=length;
 
 	for(i=0;i<strlength;i++)
 	{
-		// get kerning and move pen
-		if(use_kerning && previous && glyph_index)
-		{
-			FT_Get_Kerning(face, previous, glyph_index,ft_kerning_default, &delta);
-			pen.x+=delta.x;
-		}
-
-		error=FT_Load_Char(face,string[i],FT_LOAD_MONOCHROME);
-
-		// increment pen position
-		pen.x+=slot->advance.x;
-		previous=glyph_index;
+		uint8 c=(uint8)string[i];
+		if(use_kerning && i>0)
+			pen+=EscapementKerning(table,previous,c);
+		pen+=table->glyphs[c].advance;
+		previous=c;
 	}
 
-	FT_Done_Face(face);
-	Unlock();
-
-	returnval=pen.x>>6;
-	return returnval;
+	// to the nearest pixel, the way BFont::StringWidth() rounds
+	return (pen+32)>>6;
 }
 
 /*!
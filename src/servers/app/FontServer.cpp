@@ -35,9 +35,11 @@
 #include <FontServer.h>
 #include <FontFamily.h>
 #include <ServerFont.h>
+#include <FontEscapements.h>
 #include "ServerConfig.h"
 
 #include <errno.h>
+#include <string.h>
 #include <Debug.h>
 
 void pathcat( char* pzPath, const char* pzName );
@@ -48,6 +50,16 @@ FontServer *fontserver=NULL;
 
 //#define PRINT_FONT_LIST
 
+//! An escapement table in the shared area and what it was built for
+struct escapement_entry
+{
+	BString path;
+	int32 size;
+	area_id area;
+	int32 offset;
+	escapement_table *table;
+};
+
 /*!
 	\brief Access function to request a face via the FreeType font cache
 */
@@ -83,6 +95,9 @@ FontServer::FontServer(void)
 	plain=NULL;
 	bold=NULL;
 	fixed=NULL;
+
+	escapementareas=new BList(0);
+	escapementtables=new BList(0);
 }
 
 //! Frees items allocated in the constructor and shuts down FreeType
@@ -90,6 +105,14 @@ FontServer::~FontServer(void)
 {
 	delete_sem(lock);
 	delete families;
+
+	for(int32 i=0; i<escapementtables->CountItems(); i++)
+		delete (escapement_entry*)escapementtables->ItemAt(i);
+	delete escapementtables;
+	for(int32 i=0; i<escapementareas->CountItems(); i++)
+		delete_area(((escapement_area_header*)escapementareas->ItemAt(i))->area);
+	delete escapementareas;
+
 	FTC_Manager_Done(ftmanager);
 	FT_Done_FreeType(ftlib);
 }
@@ -533,3 +556,193 @@ bool FontServer::SetSystemFixed(const char *family, const char *style, float siz
 	return true;
 }
 
+/*!
+	\brief Returns the escapement table of a font style at a size
+	\param style The style to get the table for
+	\param size Integer size in pixels, the way the style is drawn
+	\param area If non-NULL, receives the area the table is in
+	\param offset If non-NULL, receives the offset of the table in the area
+	\return The table or NULL if it couldn't be built
+	
+	Tables live in areas named FONT_ESCAPEMENT_AREA, which clients clone 
+	read-only so that BFont can measure text without asking the server. A table 
+	is built the first time it is asked for and then kept for as long as the 
+	server runs, so pointers to it stay valid. The font server must be locked.
+*/
+const escapement_table *FontServer::GetEscapements(FontStyle *style, int32 size,
+	area_id *area, int32 *offset)
+{
+	if(!style || size<1)
+		return NULL;
+	
+	escapement_entry *entry=NULL;
+	for(int32 i=0; i<escapementtables->CountItems(); i++)
+	{
+		escapement_entry *item=(escapement_entry*)escapementtables->ItemAt(i);
+		if(item->size==size && item->path==style->GetPath())
+		{
+			entry=item;
+			break;
+		}
+	}
+	
+	if(!entry)
+	{
+		escapement_table *table=_BuildEscapements(style,size);
+		if(!table)
+			return NULL;
+		
+		// the table was put into the newest area
+		escapement_area_header *header=(escapement_area_header*)
+			escapementareas->LastItem();
+		
+		entry=new escapement_entry;
+		entry->path=style->GetPath();
+		entry->size=size;
+		entry->area=header->area;
+		entry->offset=(uint8*)table-(uint8*)header;
+		entry->table=table;
+		escapementtables->AddItem(entry);
+	}
+	
+	if(area)
+		*area=entry->area;
+	if(offset)
+		*offset=entry->offset;
+	return entry->table;
+}
+
+/*!
+	\brief Measures a font style at a size and stores the result in the shared area
+	\param style The style to measure
+	\param size Integer size in pixels
+	\return The new table or NULL if the style can't be loaded or there's no memory
+	
+	The advances and kerning are read with the same FreeType calls that 
+	DisplayDriver::DrawString() makes, so text measured with the table is 
+	exactly as wide as it is drawn. The table goes into the newest escapement 
+	area; if it doesn't fit there, a new area is started.
+*/
+escapement_table *FontServer::_BuildEscapements(FontStyle *style, int32 size)
+{
+	FT_Face face;
+	if(FT_New_Face(ftlib,style->GetPath(),0,&face)!=0)
+		return NULL;
+	if(FT_Set_Char_Size(face,0,size*64,72,72)!=0)
+	{
+		FT_Done_Face(face);
+		return NULL;
+	}
+	
+	FT_UInt glyphs[256];
+	int32 pairs=0;
+	bool kerning=FT_HAS_KERNING(face);
+	int32 c;
+	
+	for(c=0; c<256; c++)
+		glyphs[c]=FT_Get_Char_Index(face,c);
+	
+	// Count the kerned pairs first, so that the table can be allocated in one piece
+	if(kerning)
+	{
+		for(int32 left=0; left<256; left++)
+			for(int32 right=0; right<256 && glyphs[left]; right++)
+			{
+				FT_Vector delta;
+				if(glyphs[right] && FT_Get_Kerning(face,glyphs[left],glyphs[right],
+						ft_kerning_default,&delta)==0 && delta.x!=0)
+					pairs++;
+			}
+	}
+	
+	int32 tablesize=(sizeof(escapement_table)+pairs*sizeof(escapement_kerning_pair)+7) & ~7;
+	escapement_area_header *header=(escapement_area_header*)escapementareas->LastItem();
+	if(!header || header->used+tablesize>header->size)
+	{
+		header=_AddEscapementArea(tablesize);
+		if(!header)
+		{
+			FT_Done_Face(face);
+			return NULL;
+		}
+	}
+	
+	escapement_table *table=(escapement_table*)((uint8*)header+header->used);
+	escapement_kerning_pair *pair=(escapement_kerning_pair*)(table+1);
+	
+	table->size=size;
+	table->height.ascent=face->size->metrics.ascender/64.0;
+	table->height.descent=-face->size->metrics.descender/64.0;
+	table->height.leading=(face->size->metrics.height-face->size->metrics.ascender
+		+face->size->metrics.descender)/64.0;
+	
+	for(c=0; c<256; c++)
+	{
+		escapement_glyph *glyph=&table->glyphs[c];
+		if(FT_Load_Char(face,c,FT_LOAD_DEFAULT)==0)
+		{
+			FT_Glyph_Metrics *metrics=&face->glyph->metrics;
+			glyph->advance=face->glyph->advance.x;
+			glyph->left=metrics->horiBearingX;
+			glyph->top=-metrics->horiBearingY;
+			glyph->right=metrics->horiBearingX+metrics->width;
+			glyph->bottom=metrics->height-metrics->horiBearingY;
+		}
+		else
+			memset(glyph,0,sizeof(escapement_glyph));
+	}
+	
+	int32 index=0;
+	for(int32 left=0; left<256; left++)
+	{
+		table->kerning[left]=index;
+		for(int32 right=0; right<256 && kerning && glyphs[left]; right++)
+		{
+			FT_Vector delta;
+			if(glyphs[right] && FT_Get_Kerning(face,glyphs[left],glyphs[right],
+					ft_kerning_default,&delta)==0 && delta.x!=0 && index<pairs)
+			{
+				pair[index].right=right;
+				pair[index]._reserved=0;
+				pair[index].delta=(int16)max_c(-32768,min_c(32767,delta.x));
+				index++;
+			}
+		}
+	}
+	table->kerning[256]=index;
+	
+	FT_Done_Face(face);
+	
+	header->used+=tablesize;
+	return table;
+}
+
+/*!
+	\brief Starts a new escapement area
+	\param tablesize Size of the table which has to fit into it
+	\return The header of the new area or NULL if it couldn't be created
+	
+	The areas which are full are kept, clients may still be using their tables.
+*/
+escapement_area_header *FontServer::_AddEscapementArea(int32 tablesize)
+{
+	int32 headersize=(sizeof(escapement_area_header)+7) & ~7;
+	int32 areasize=max_c(FONT_ESCAPEMENT_AREA_SIZE,
+		(headersize+tablesize+B_PAGE_SIZE-1) & ~(B_PAGE_SIZE-1));
+	
+	void *address;
+	area_id area=create_area(FONT_ESCAPEMENT_AREA,&address,B_ANY_ADDRESS,
+		areasize,B_NO_LOCK,B_READ_AREA | B_WRITE_AREA);
+	if(area<0)
+	{
+		printf("Couldn't create a font escapement area: %s\n",strerror(area));
+		return NULL;
+	}
+	
+	escapement_area_header *header=(escapement_area_header*)address;
+	header->area=area;
+	header->size=areasize;
+	header->used=headersize;
+	escapementareas->AddItem(header);
+	return header;
+}
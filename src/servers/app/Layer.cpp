@@ -60,6 +60,22 @@ BRegion	gRedrawReg;
 BList gCopyRegList;
 BList gCopyList;
 
+//! Compares two regions rectangle by rectangle
+static bool regions_equal(BRegion &a, BRegion &b)
+{
+	int32 count = a.CountRects();
+	if (count != b.CountRects())
+		return false;
+	
+	for (int32 i = 0; i < count; i++)
+	{
+		if (a.RectAt(i) != b.RectAt(i))
+			return false;
+	}
+	
+	return true;
+}
+
 Layer::Layer(BRect frame, const char *name, int32 token, uint32 resize,
 				uint32 flags, DisplayDriver *driver)
 {
@@ -99,6 +115,7 @@ Layer::Layer(BRect frame, const char *name, int32 token, uint32 resize,
 	fInUpdate		= false;
 	fIsTopLayer		= false;
 	fLevel			= 0;
+	fFrameAction	= B_LAYER_NONE;
 	
 	fViewToken		= token;
 	fServerWin		= NULL;
@@ -157,6 +174,8 @@ void Layer::AddChild(Layer *layer, ServerWindow *serverWin)
 		return;
 	}
 	
+	InvalidateRegionCache();
+	
 	// 1) attach layer to the tree structure
 	layer->fParent = this;
 	
@@ -260,6 +279,8 @@ void Layer::RemoveChild(Layer *layer)
 		return;
 	}
 
+	InvalidateRegionCache();
+	
 	// 1) remove this layer from the main tree.
 	
 	// Take care of fParent
@@ -541,6 +562,10 @@ void Layer::RequestDraw(const BRegion &reg, Layer *startFrom)
 	if (!startFrom)
 		redraw = true;
 
+	// B_FULL_UPDATE_ON_RESIZE only matters if we were really resized. A move
+	// or a scroll only needs the exposed parts to be drawn.
+	bool fullUpdate = (fFlags & B_FULL_UPDATE_ON_RESIZE) && fFrameAction == B_LAYER_RESIZE;
+
 	if (fVisible.CountRects() > 0)
 	{
 		// client side drawing. Send only one UPDATE message!
@@ -548,43 +573,41 @@ void Layer::RequestDraw(const BRegion &reg, Layer *startFrom)
 		{
 			if (IsTopLayer())
 			{
-				// calculate the minimum region/rectangle to be updated with
+				// calculate the minimum region to be updated with
 				// a single message to the client.
-				fUpdateReg = fFullVisible;
-				if (fFlags & B_FULL_UPDATE_ON_RESIZE)
-				{
-					// do nothing
-				}
-				else
-				{
-					fUpdateReg.IntersectWith(&reg);
-				}
+				BRegion windowReg(fFullVisible);
+				if (!fullUpdate)
+					windowReg.IntersectWith(&reg);
 
-				if (fUpdateReg.CountRects() > 0)
-				{
-					SendUpdateMsg();
-				}
+				if (windowReg.CountRects() > 0)
+					SendUpdateMsg(windowReg);
 				
 				// we're not that different than other. We too have an
 				// update region to which our drawing is restrincted.
 			}
 
 			// calculate the update region, then...
-			fUpdateReg = fVisible;
-			if (fFlags & B_FULL_UPDATE_ON_RESIZE)
-			{
-				// do nothing
-			}
-			else
-			{
-				fUpdateReg.IntersectWith(&reg);
-			}
+			BRegion updateReg(fVisible);
+			if (!fullUpdate)
+				updateReg.IntersectWith(&reg);
 
-			if (fUpdateReg.CountRects() > 0)
+			if (updateReg.CountRects() > 0)
 			{
+				// Add it to what the client already owes us. An update which
+				// is being drawn right now was asked for without this area,
+				// so it goes into the next one.
+				if (fInUpdate)
+					fNextUpdateReg.Include(&updateReg);
+				else
+					fUpdateReg.Include(&updateReg);
+
+				// the client owes us this area, so it must not be saved as its contents
+				if (fServerWin && fServerWin->fWinBorder)
+					fServerWin->fWinBorder->AddPendingUpdate(updateReg);
+				
 				// clear background with viewColor.
-				fDriver->ConstrainClippingRegion(&fUpdateReg);
-				fDriver->FillRect(fUpdateReg.Frame(), fLayerData->viewcolor);
+				fDriver->ConstrainClippingRegion(&updateReg);
+				fDriver->FillRect(updateReg.Frame(), fLayerData->viewcolor);
 				fDriver->ConstrainClippingRegion(NULL);
 			}
 		}
@@ -594,7 +617,7 @@ void Layer::RequestDraw(const BRegion &reg, Layer *startFrom)
 			// No IPC is needed so this is done in place.
 			
 			fUpdateReg = fVisible;
-			if (fFlags & B_FULL_UPDATE_ON_RESIZE)
+			if (fullUpdate)
 			{
 				// do nothing
 			}
@@ -611,6 +634,8 @@ void Layer::RequestDraw(const BRegion &reg, Layer *startFrom)
 				fUpdateReg.MakeEmpty();
 			}
 		}
+		
+		fFrameAction = B_LAYER_NONE;
 	}
 
 	for (Layer *lay = VirtualBottomChild(); lay != NULL; lay = VirtualUpperSibling())
@@ -629,10 +654,20 @@ void Layer::RequestDraw(const BRegion &reg, Layer *startFrom)
 			{
 				// lock/unlock if we are a winborder
 				if (lay->fClassID == AS_WINBORDER_CLASS)
+				{
 					lay->Window()->Lock();
-				lay->RequestDraw(reg, NULL);
-				if (lay->fClassID == AS_WINBORDER_CLASS)
+					
+					// whatever the backing store has is restored by us, the
+					// client is only asked for the rest.
+					BRegion remaining(reg);
+					((WinBorder*)lay)->RestoreFromBackingStore(remaining);
+					if (remaining.CountRects() > 0)
+						lay->RequestDraw(remaining, NULL);
+					
 					lay->Window()->Unlock();
+				}
+				else
+					lay->RequestDraw(reg, NULL);
 			}
 		}
 	}
@@ -652,19 +687,48 @@ void Layer::Draw(const BRect &r)
 	// empty HOOK function.
 }
 
+/*!
+	\brief Starts an update of the layer and its children
+	
+	A client window draws all of its views in one update, so until UpdateEnd() 
+	is called, drawing in each layer is restricted to its own update region.
+*/
 void Layer::UpdateStart()
 {
-	// During updates we only want to draw what's in the update region
+	// During updates we only want to draw what's in the update region. It may
+	// have been asked for before something was moved over the layer.
 	fInUpdate = true;
+	fUpdateReg.IntersectWith(&fVisible);
 	fClipReg = &fUpdateReg;
+
+	for (Layer *child = fTopChild; child != NULL; child = child->fLowerSibling)
+		child->UpdateStart();
 }
 
+/*!
+	\brief Ends an update of the layer and its children
+	
+	Whatever was invalidated while the update was being drawn is still owed 
+	by the client and becomes the next update region.
+*/
 void Layer::UpdateEnd()
 {
 	// The usual case. Drawing is permitted in the whole visible area.
 	fInUpdate = false;
 	fClipReg = &fVisible;
-	fUpdateReg.MakeEmpty();
+	
+	if (fServerWin && fServerWin->fWinBorder)
+	{
+		fServerWin->fWinBorder->RemovePendingUpdate(fUpdateReg);
+		if (fNextUpdateReg.CountRects() > 0)
+			fServerWin->fWinBorder->AddPendingUpdate(fNextUpdateReg);
+	}
+	
+	fUpdateReg = fNextUpdateReg;
+	fNextUpdateReg.MakeEmpty();
+
+	for (Layer *child = fTopChild; child != NULL; child = child->fLowerSibling)
+		child->UpdateEnd();
 }
 
 /*!
@@ -678,6 +742,7 @@ void Layer::Show(bool invalidate)
 		return;
 	
 	fHidden	= false;
+	InvalidateRegionCache();
 	
 	if(invalidate)
 	{
@@ -699,6 +764,7 @@ void Layer::Hide(bool invalidate)
 		return;
 	
 	fHidden	= true;
+	InvalidateRegionCache();
 	
 	if(invalidate)
 	{
@@ -741,6 +807,8 @@ void Layer::RebuildFullRegion(void)
 {
 	STRACE(("Layer(%s)::RebuildFullRegion()\n", GetName()));
 	
+	InvalidateRegionCache();
+	
 	if (fParent)
 		fFull.Set( fParent->ConvertToTop( fFrame ) );
 	else
@@ -769,6 +837,45 @@ void Layer::RebuildFullRegion(void)
 	}
 }
 
+//! Returns the bounding box of the full regions of this layer and all its descendants
+BRect Layer::TreeFootprint(void) const
+{
+	BRect frame(fFull.Frame());
+	
+	for(Layer *lay = fTopChild; lay != NULL; lay = lay->fLowerSibling)
+	{
+		BRect childFrame(lay->TreeFootprint());
+		if (!childFrame.IsValid())
+			continue;
+		
+		if (frame.IsValid())
+			frame = frame | childFrame;
+		else
+			frame = childFrame;
+	}
+	
+	return frame;
+}
+
+/*!
+	\brief Makes the next RebuildRegions() recalculate the window containing this layer
+	
+	Must be called whenever something changes which is not visible from the
+	window's clipping in its parent: a full region, the hidden state or the
+	layer tree itself.
+*/
+void Layer::InvalidateRegionCache(void)
+{
+	for(Layer *lay = this; lay != NULL; lay = lay->fParent)
+	{
+		if (lay->fClassID == AS_WINBORDER_CLASS)
+		{
+			((WinBorder*)lay)->fClipKeyValid = false;
+			return;
+		}
+	}
+}
+
 void Layer::RebuildRegions( const BRegion& reg, uint32 action, BPoint pt, BPoint ptOffset)
 {
 	STRACE(("Layer(%s)::RebuildRegions() START\n", GetName()));
@@ -790,6 +897,48 @@ void Layer::RebuildRegions( const BRegion& reg, uint32 action, BPoint pt, BPoint
 	BPoint newOffset = ptOffset; // used for resizing only
 	
 	BPoint dummyNewLocation;
+	
+	// a window keeping a backing store saves what it loses from the screen
+	WinBorder *backed = NULL;
+	BRegion oldFullVisible;
+	BPoint oldOrigin;
+	if (fClassID == AS_WINBORDER_CLASS && !IsHidden()
+		&& (action == B_LAYER_NONE || action == B_LAYER_MOVE)
+		&& ((WinBorder*)this)->UsesBackingStore())
+	{
+		backed = (WinBorder*)this;
+		oldFullVisible = fFullVisible;
+		oldOrigin = backed->ClientFrame().LeftTop();
+	}
+
+	// A window whose layers did not change and which sees the same part of the
+	// screen as last time ends up with the same regions, so skip its subtree.
+	WinBorder *memo = NULL;
+	BRegion clipKey;
+	if (fClassID == AS_WINBORDER_CLASS && fParent)
+	{
+		memo = (WinBorder*)this;
+		if (action == B_LAYER_NONE && !IsHidden())
+		{
+			// Anything which changes the footprint also invalidates the clip
+			// key, so the tree is only walked when the key is stale anyway.
+			if (!memo->fClipKeyValid)
+				memo->fFootprint = TreeFootprint();
+			clipKey.Set(memo->fFootprint);
+			clipKey.IntersectWith(&(fParent->fVisible));
+			
+			if (memo->fClipKeyValid && regions_equal(clipKey, memo->fClipKey))
+			{
+				if (fFullVisible.CountRects() > 0)
+					fParent->fVisible.Exclude(&fFullVisible);
+				
+				STRACE(("Layer(%s)::RebuildRegions() END (unchanged)\n", GetName()));
+				return;
+			}
+		}
+		else
+			memo->fClipKeyValid = false;
+	}
 
 	RRLabel1:
 	switch(action)
@@ -807,6 +956,10 @@ void Layer::RebuildRegions( const BRegion& reg, uint32 action, BPoint pt, BPoint
 			fFrame.OffsetBy(pt.x, pt.y);
 			fFull.OffsetBy(pt.x, pt.y);
 			
+			// what the client still owes us moves along
+			fUpdateReg.OffsetBy(pt.x, pt.y);
+			fNextUpdateReg.OffsetBy(pt.x, pt.y);
+			
 			// TODO: uncomment later when you'll implement a queue in ServerWindow::SendMessgeToClient()
 			//SendViewMovedMsg();
 
@@ -817,6 +970,8 @@ void Layer::RebuildRegions( const BRegion& reg, uint32 action, BPoint pt, BPoint
 		{
 			RBTRACE(("1) Action B_LAYER_SIMPLE_MOVE\n"));
 			fFull.OffsetBy(pt.x, pt.y);
+			fUpdateReg.OffsetBy(pt.x, pt.y);
+			fNextUpdateReg.OffsetBy(pt.x, pt.y);
 			
 			break;
 		}
@@ -828,6 +983,7 @@ void Layer::RebuildRegions( const BRegion& reg, uint32 action, BPoint pt, BPoint
 			fFrame.right	+= pt.x;
 			fFrame.bottom	+= pt.y;
 			RebuildFullRegion();
+			fFrameAction	= B_LAYER_RESIZE;
 			
 			// TODO: uncomment later when you'll implement a queue in ServerWindow::SendMessgeToClient()
 			//SendViewResizedMsg();
@@ -854,6 +1010,7 @@ void Layer::RebuildRegions( const BRegion& reg, uint32 action, BPoint pt, BPoint
 				fFrame.right += rSize.x;
 				fFrame.bottom += rSize.y;
 				RebuildFullRegion();
+				fFrameAction = B_LAYER_RESIZE;
 				
 				// TODO: uncomment later when you'll implement a queue in ServerWindow::SendMessgeToClient()
 				//SendViewResizedMsg();
@@ -977,6 +1134,26 @@ void Layer::RebuildRegions( const BRegion& reg, uint32 action, BPoint pt, BPoint
 	for(Layer *lay = VirtualBottomChild(); lay != NULL; lay = VirtualUpperSibling())
 		lay->RebuildRegions(reg, newAction, newPt, newOffset);
 	
+	if (memo && action == B_LAYER_NONE && !IsHidden())
+	{
+		memo->fClipKey = clipKey;
+		memo->fClipKeyValid = true;
+	}
+	
+	if (backed && oldFullVisible.CountRects() > 0)
+	{
+		// the screen still shows the old contents at this point
+		BPoint newOrigin = backed->ClientFrame().LeftTop();
+		BRegion kept(fFullVisible);
+		kept.OffsetBy((int32)(oldOrigin.x - newOrigin.x), (int32)(oldOrigin.y - newOrigin.y));
+		
+		BRegion lost(oldFullVisible);
+		lost.Exclude(&kept);
+		
+		if (lost.CountRects() > 0)
+			backed->SaveToBackingStore(lost, oldOrigin);
+	}
+	
 	if(!IsHidden())
 	{
 		switch(action)
@@ -1092,6 +1269,8 @@ void Layer::StartRebuildRegions( const BRegion& reg, Layer *target, uint32 actio
 	STRACE(("Layer(%s)::StartRebuildRegions() START\n", GetName()));
 	if(!fParent)
 		fFullVisible = fFull;
+	else
+		InvalidateRegionCache();
 	
 	BRegion oldVisible = fVisible;
 	
@@ -1139,6 +1318,9 @@ void Layer::StartRebuildRegions( const BRegion& reg, Layer *target, uint32 actio
 	printf("\n");
 	#endif
 
+	if (fRootLayer)
+		fRootLayer->RegionsChanged();
+
 	STRACE(("Layer(%s)::StartRebuildRegions() END\n", GetName()));
 }
 
@@ -1164,6 +1346,92 @@ void Layer::MoveBy(float x, float y)
 	STRACE(("Layer(%s)::MoveBy() END\n", GetName()));
 }
 
+/*!
+	\brief Scrolls the layer's contents, complete with redraw
+	\param x Horizontal offset of the bounds rectangle
+	\param y Vertical offset of the bounds rectangle
+	
+	Pixels which stay visible are blitted to their new place on screen, so the
+	client is only asked to draw the strip which scrolled into view.
+*/
+void Layer::ScrollBy(float x, float y)
+{
+	STRACE(("Layer(%s)::ScrollBy() START\n", GetName()));
+	if(!fParent)
+	{
+		debugger("ERROR: in Layer::ScrollBy()! - No parent!\n");
+		return;
+	}
+	
+	if (x == 0.0f && y == 0.0f)
+		return;
+	
+	fBoundsLeftTop.x += x;
+	fBoundsLeftTop.y += y;
+	
+	// children are placed in our bounds, so they move along with the contents
+	RebuildChildrenFullRegion();
+	
+	BPoint pt(0.0f, 0.0f);
+	fRootLayer->StartRebuildRegions(BRegion(fFull), NULL, B_LAYER_NONE, pt);
+	
+	// we do our own bookkeeping of what needs to be drawn
+	EmptyGlobals();
+	
+	int32 dx = -(int32)x;
+	int32 dy = -(int32)y;
+	
+	// what the client still owes us scrolls along with the contents
+	fUpdateReg.OffsetBy(dx, dy);
+	fNextUpdateReg.OffsetBy(dx, dy);
+	
+	if (!IsHidden() && fFullVisible.CountRects() > 0)
+	{
+		
+		// the part of our area which still shows valid contents after the move
+		BRegion kept(fFullVisible);
+		kept.OffsetBy(dx, dy);
+		kept.IntersectWith(&fFullVisible);
+		
+		if (kept.CountRects() > 0)
+		{
+			BRegion source(kept);
+			source.OffsetBy(-dx, -dy);
+			fDriver->CopyRegion(&source, source.Frame().LeftTop() + BPoint(dx, dy));
+		}
+		
+		gRedrawReg = fFullVisible;
+		gRedrawReg.Exclude(&kept);
+		
+		// owed pixels were blitted along as they were, so they still need drawing
+		BRegion owed(fUpdateReg);
+		owed.Include(&fNextUpdateReg);
+		owed.IntersectWith(&kept);
+		gRedrawReg.Include(&owed);
+		
+		// update messages are sent by the top layer of a window
+		Layer *top = this;
+		while (top->fParent && !top->IsTopLayer() && top->fParent->HasClient())
+			top = top->fParent;
+		
+		top->Redraw(gRedrawReg);
+		
+		EmptyGlobals();
+	}
+	
+	STRACE(("Layer(%s)::ScrollBy() END\n", GetName()));
+}
+
+//! Recalculates the "completely visible" regions of all children after they changed place on screen
+void Layer::RebuildChildrenFullRegion(void)
+{
+	for(Layer *lay = VirtualBottomChild(); lay != NULL; lay = VirtualUpperSibling())
+	{
+		lay->RebuildFullRegion();
+		lay->RebuildChildrenFullRegion();
+	}
+}
+
 void Layer::EmptyGlobals()
 {
 	void *item;
@@ -1362,11 +1630,12 @@ BRegion Layer::ConvertFromParent(BRegion *reg)
 	return newreg;
 }
 
+//! Converts the passed point, given in the layer's bounds coordinates, to screen coordinates
 BPoint Layer::ConvertToTop(BPoint pt)
 {
 	if (fParent!=NULL)
 	{
-		return(fParent->ConvertToTop(pt+fFrame.LeftTop()));
+		return(fParent->ConvertToTop(pt+fFrame.LeftTop()-fBoundsLeftTop));
 	}
 	else
 		return(pt);
@@ -1385,16 +1654,17 @@ BRegion Layer::ConvertToTop(BRegion *reg)
 BRect Layer::ConvertToTop(BRect rect)
 {
 	if (fParent!=NULL)
-		return(fParent->ConvertToTop(rect.OffsetByCopy(fFrame.LeftTop())) );
+		return(fParent->ConvertToTop(rect.OffsetByCopy(fFrame.LeftTop()-fBoundsLeftTop)) );
 	else
 		return(rect);
 }
 
+//! Converts the passed point from screen coordinates to the layer's bounds coordinates
 BPoint Layer::ConvertFromTop(BPoint pt)
 {
 	if (fParent!=NULL)
 	{
-		return(fParent->ConvertFromTop(pt-fFrame.LeftTop()));
+		return(fParent->ConvertFromTop(pt-fFrame.LeftTop()+fBoundsLeftTop));
 	}
 	else
 		return(pt);
@@ -1415,8 +1685,8 @@ BRegion Layer::ConvertFromTop(BRegion *reg)
 BRect Layer::ConvertFromTop(BRect rect)
 {
 	if (fParent!=NULL)
-		return(fParent->ConvertFromTop(rect.OffsetByCopy(fFrame.LeftTop().x*-1,
-			fFrame.LeftTop().y*-1)) );
+		return(fParent->ConvertFromTop(rect.OffsetByCopy(fBoundsLeftTop.x-fFrame.left,
+			fBoundsLeftTop.y-fFrame.top)) );
 	else
 		return(rect);
 }
@@ -1455,15 +1725,23 @@ void Layer::SendViewMovedMsg()
 	}
 }
 
-//! Sends an _UPDATE_ message to the client BWindow
-void Layer::SendUpdateMsg()
+/*!
+	\brief Sends an _UPDATE_ message to the client BWindow
+	\param reg Region to update, in screen coordinates
+	
+	The message holds each rect of the region, so the client can merge it 
+	with other updates it hasn't handled yet without losing its shape.
+*/
+void Layer::SendUpdateMsg(const BRegion &reg)
 {
 	if( fServerWin )
 	{
 		BMessage msg;
 		msg.what = _UPDATE_;
-		msg.AddRect("_rect", ConvertFromTop(fUpdateReg.Frame()) );
-		msg.AddRect("debug_rect", fUpdateReg.Frame() );
+		BRegion copy(reg);
+		for (int32 i = 0; i < copy.CountRects(); i++)
+			msg.AddRect("_rect", ConvertFromTop(copy.RectAt(i)) );
+		msg.AddRect("debug_rect", copy.Frame() );
 		msg.AddInt32("_token",fViewToken);
 		
 		fServerWin->SendMessageToClient( &msg );
@@ -115,6 +115,7 @@ public:
 	
 	virtual	void MoveBy(float x, float y);
 	virtual	void ResizeBy(float x, float y);
+	void ScrollBy(float x, float y);
 	
 	BRect ConvertToParent(BRect rect);
 	BRegion ConvertToParent(BRegion *reg);
@@ -172,6 +173,7 @@ protected:
 	BRegion	fFullVisible;
 	BRegion	fFull;
 	BRegion	fUpdateReg;
+	BRegion	fNextUpdateReg;
 	BRegion *fClipReg;
 	
 	BRegion *clipToPicture;
@@ -199,8 +201,11 @@ protected:
 private:
 	void RequestDraw(const BRegion &reg, Layer *startFrom);
 	ServerWindow *SearchForServerWindow(void);
+	void RebuildChildrenFullRegion(void);
+	BRect TreeFootprint(void) const;
+	void InvalidateRegionCache(void);
 
-	void SendUpdateMsg();
+	void SendUpdateMsg(const BRegion &reg);
 	void SendViewMovedMsg(void);
 	void SendViewResizedMsg(void);
 
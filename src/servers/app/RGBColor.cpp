@@ -92,8 +92,10 @@ RGBColor::RGBColor(const RGBColor &col)
 {
 	color32=col.color32;
 	color16=col.color16;
+	color15=col.color15;
 	color8=col.color8;
 	update8=col.update8;
+	update15=col.update15;
 	update16=col.update16;
 }
 
@@ -114,7 +116,11 @@ uint8 RGBColor::GetColor8(void)
 {
 	if(update8)
 	{
-		color8=FindClosestColor(system_palette, color32);
+		const color_map *map=SystemColorMap();
+		if(map)
+			color8=IndexForColor(map, color32);
+		else
+			color8=FindClosestColor(system_palette, color32);
 		update8=false;
 	}
 
@@ -174,7 +180,7 @@ void RGBColor::SetColor(uint8 r, uint8 g, uint8 b, uint8 a)
 	color32.blue=b;
 	color32.alpha=a;
 	
-	update8=update16=true;
+	update8=update15=update16=true;
 }
 
 /*!
@@ -191,7 +197,7 @@ void RGBColor::SetColor(int r, int g, int b, int a)
 	color32.blue=(uint8)b;
 	color32.alpha=(uint8)a;
 
-	update8=update16=true;
+	update8=update15=update16=true;
 }
 
 /*!
@@ -204,6 +210,7 @@ void RGBColor::SetColor(uint16 col16)
 	SetRGBColor(&color32,col16);
 
 	update8=true;
+	update15=true;
 	update16=false;
 }
 
@@ -217,6 +224,7 @@ void RGBColor::SetColor(uint8 col8)
 	color32=system_palette[col8];
 	
 	update8=false;
+	update15=true;
 	update16=true;
 }
 
@@ -227,7 +235,7 @@ void RGBColor::SetColor(uint8 col8)
 void RGBColor::SetColor(const rgb_color &color)
 {
 	color32=color;
-	update8=update16=true;
+	update8=update15=update16=true;
 }
 
 /*!
@@ -238,8 +246,10 @@ void RGBColor::SetColor(const RGBColor &col)
 {
 	color32=col.color32;
 	color16=col.color16;
+	color15=col.color15;
 	color8=col.color8;
 	update8=col.update8;
+	update15=col.update15;
 	update16=col.update16;
 }
 
@@ -251,8 +261,10 @@ const RGBColor & RGBColor::operator=(const RGBColor &col)
 {
 	color32=col.color32;
 	color16=col.color16;
+	color15=col.color15;
 	color8=col.color8;
 	update8=col.update8;
+	update15=col.update15;
 	update16=col.update16;
 	return *this;
 }
@@ -264,7 +276,7 @@ const RGBColor & RGBColor::operator=(const RGBColor &col)
 const RGBColor & RGBColor::operator=(const rgb_color &col)
 {
 	color32=col;
-	update8=update16=true;
+	update8=update15=update16=true;
 
 	return *this;
 }
@@ -66,6 +66,7 @@ RootLayer::RootLayer(const char *name, int32 workspaceCount,
 	//NOTE: be careful about this one.
 	fRootLayer = this;
 	fActiveWorkspace = NULL;
+	fRegionGeneration = 0;
 	fRows = 0;
 	fColumns = 0;
 	
@@ -368,19 +369,19 @@ void RootLayer::RemoveWinBorder(WinBorder* winBorder)
 	desktop->fGeneralLock.Unlock();
 }
 
-WinBorder* RootLayer::WinBorderAt(const BPoint& pt){
-	WinBorder		*target = NULL;
-	WinBorder		*wb = NULL;
-
-	for( wb = fActiveWorkspace->GoToBottomItem(); wb; wb = fActiveWorkspace->GoToUpperItem())
-	{
-		if(!wb->IsHidden() && wb->HasPoint(pt))
-		{
-			target	= wb;
-			break;
-		}
-	}
-	return target;
+/*!
+	\brief Returns the window under the given point in the active workspace
+	
+	The workspace may have to rebuild its index from the visible regions, so 
+	they must not change while it does.
+*/
+WinBorder* RootLayer::WinBorderAt(const BPoint& pt)
+{
+	fMainLock.Lock();
+	WinBorder *winBorder = fActiveWorkspace->WinBorderAt(pt, fRegionGeneration);
+	fMainLock.Unlock();
+	
+	return winBorder;
 }
 
 void RootLayer::ChangeWorkspacesFor(WinBorder* winBorder, uint32 newWorkspaces)
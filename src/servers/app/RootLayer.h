@@ -99,6 +99,7 @@ public:
 	
 	// "Private" to app_server :-) - they should not be used
 	void RemoveAppWindow(WinBorder *wb);
+	void RegionsChanged(void) { fRegionGeneration++; }
 	
 	FMWList fMainFMWList;
 	BLocker fMainLock;
@@ -115,6 +116,9 @@ private:
 	
 	BList fWorkspaceList;
 	Workspace *fActiveWorkspace;
+	
+	// bumped every time visible regions are rebuilt
+	uint32 fRegionGeneration;
 };
 
 #endif
@@ -32,6 +32,7 @@
 #include <ColorSet.h>
 #include <RGBColor.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ScrollBar.h>
 #include <ServerProtocol.h>
@@ -41,6 +42,7 @@
 #include "CursorManager.h"
 #include "Desktop.h"
 #include "FontServer.h"
+#include "ServerFont.h"
 #include "RootLayer.h"
 #include "ServerApp.h"
 #include "ServerWindow.h"
@@ -93,7 +95,6 @@ ServerApp::ServerApp(port_id sendport, port_id rcvport, port_id clientLooperPort
 	fAppLink = new BPortLink(fClientAppPort, fMessagePort);
 
 	fSWindowList=new BList(0);
-	fBitmapList=new BList(0);
 	fPictureList=new BList(0);
 	fIsActive=false;
 
@@ -121,22 +122,17 @@ ServerApp::~ServerApp(void)
 	STRACE(("*ServerApp %s:~ServerApp()\n",fSignature.String()));
 	int32 i;
 	
-	ServerBitmap *tempbmp;
-	for(i=0;i<fBitmapList->CountItems();i++)
-	{
-		tempbmp=(ServerBitmap*)fBitmapList->ItemAt(i);
-		if(tempbmp)
-			delete tempbmp;
-	}
-	fBitmapList->MakeEmpty();
-	delete fBitmapList;
+	bitmapmanager->DeleteBitmapsOf(this);
+#ifdef DEBUG_SERVERAPP
+	bitmapmanager->PrintStats();
+#endif
 
 	ServerPicture *temppic;
 	for(i=0;i<fPictureList->CountItems();i++)
 	{
 		temppic=(ServerPicture*)fPictureList->ItemAt(i);
 		if(temppic)
-			delete temppic;
+			temppic->Release();
 	}
 	fPictureList->MakeEmpty();
 	delete fPictureList;
@@ -367,6 +363,66 @@ void ServerApp::_DispatchMessage(int32 code, BPortLink& msg)
 			fontserver->Unlock();
 			break;
 		}
+		case AS_GET_ESCAPEMENTS:
+		{
+			STRACE(("ServerApp %s: Get escapements\n",fSignature.String()));
+			
+			// Attached Data:
+			// 1) uint32 family and style code of the font
+			// 2) uint16 face of the font
+			// 3) int32 size in pixels
+			// 4) port_id reply port - synchronous message
+			
+			// Reply: SERVER_TRUE, the area_id of the FONT_ESCAPEMENT_AREA area
+			// the table is in and the int32 offset of the table in it, or
+			// SERVER_FALSE
+			
+			uint32 code;
+			uint16 face;
+			int32 size;
+			port_id replyport=-1;
+			
+			msg.Read<uint32>(&code);
+			msg.Read<uint16>(&face);
+			msg.Read<int32>(&size);
+			if(msg.Read<port_id>(&replyport)<B_OK)
+				break;
+			
+			// The server hands out no family and style IDs yet, so the only
+			// fonts a client can name are the system fonts, with code 0, and
+			// the face picks the plain or the bold one. Underscored, struck out
+			// and negative text has the glyphs of the regular face. Any other
+			// font gets no table rather than the metrics of a different style.
+			ServerFont *font=NULL;
+			area_id area=-1;
+			int32 offset=-1;
+			fontserver->Lock();
+			if(code==0 && !(face & (B_ITALIC_FACE | B_OUTLINED_FACE)))
+			{
+				if(face & B_BOLD_FACE)
+					font=fontserver->GetSystemBold();
+				else
+					font=fontserver->GetSystemPlain();
+			}
+			if(font)
+			{
+				fontserver->GetEscapements(font->Style(),size,&area,&offset);
+				delete font;
+			}
+			fontserver->Unlock();
+			
+			BPortLink replylink(replyport);
+			if(area>=0)
+			{
+				replylink.StartMessage(SERVER_TRUE);
+				replylink.Attach<area_id>(area);
+				replylink.Attach<int32>(offset);
+			}
+			else
+				replylink.StartMessage(SERVER_FALSE);
+			replylink.Flush();
+			break;
+		}
 		case AS_UPDATE_COLORS:
 		{
 			// NOTE: R2: Eventually we will have windows which will notify their children of changes in 
@@ -504,7 +560,7 @@ void ServerApp::_DispatchMessage(int32 code, BPortLink& msg)
 			msg.Read<screen_id>(&s);
 			msg.Read<int32>(&replyport);
 			
-			ServerBitmap *sbmp=bitmapmanager->CreateBitmap(r,cs,f,bpr,s);
+			ServerBitmap *sbmp=bitmapmanager->CreateBitmap(r,cs,f,bpr,s,this);
 
 			STRACE(("ServerApp %s: Create Bitmap (%.1f,%.1f,%.1f,%.1f)\n",
 						fSignature.String(),r.left,r.top,r.right,r.bottom));
@@ -512,7 +568,6 @@ void ServerApp::_DispatchMessage(int32 code, BPortLink& msg)
 			BPortLink replylink(replyport);
 			if(sbmp)
 			{
-				fBitmapList->AddItem(sbmp);
 				replylink.StartMessage(SERVER_TRUE);
 				replylink.Attach<int32>(sbmp->Token());
 				replylink.Attach<int32>(sbmp->Area());
@@ -550,7 +605,6 @@ void ServerApp::_DispatchMessage(int32 code, BPortLink& msg)
 			{
 				STRACE(("ServerApp %s: Deleting Bitmap %ld\n",fSignature.String(),bmp_id));
 
-				fBitmapList->RemoveItem(sbmp);
 				bitmapmanager->DeleteBitmap(sbmp);
 				replylink.StartMessage(SERVER_TRUE);
 			}
@@ -559,18 +613,164 @@ void ServerApp::_DispatchMessage(int32 code, BPortLink& msg)
 			replylink.Flush();	
 			break;
 		}
-		case AS_CREATE_PICTURE:
+		case AS_CREATE_BITMAPS:
+		{
+			STRACE(("ServerApp %s: Received request for a batch of bitmaps\n",fSignature.String()));
+			// Allocate several bitmaps of the same kind, which the client keeps in 
+			// a pool to create BBitmaps without asking us each time
+			
+			// Attached Data: 
+			// 1) BRect bounds
+			// 2) color_space space
+			// 3) int32 bitmap_flags
+			// 4) int32 bytes_per_row
+			// 5) int32 screen_id::id
+			// 6) int32 number of bitmaps
+			// 7) port_id reply port
+			
+			// Reply Code: SERVER_TRUE
+			// Reply Data:
+			//	1) int32 number of bitmaps created
+			//	2) for each of them the server token, area_id and area offset as 
+			//	   with AS_CREATE_BITMAP
+			
+			// Reply Code: SERVER_FALSE if not even one could be created
+			port_id replyport = -1;
+			BRect r;
+			color_space cs;
+			int32 f,bpr,count;
+			screen_id s;
+
+			msg.Read<BRect>(&r);
+			msg.Read<color_space>(&cs);
+			msg.Read<int32>(&f);
+			msg.Read<int32>(&bpr);
+			msg.Read<screen_id>(&s);
+			msg.Read<int32>(&count);
+			msg.Read<int32>(&replyport);
+			
+			BList bitmaps(count>0 ? count : 1);
+			for(int32 i=0; i<count; i++)
+			{
+				ServerBitmap *sbmp=bitmapmanager->CreateBitmap(r,cs,f,bpr,s,this);
+				if(!sbmp)
+					break;
+				bitmaps.AddItem(sbmp);
+			}
+			
+			BPortLink replylink(replyport);
+			if(bitmaps.CountItems()>0)
+			{
+				replylink.StartMessage(SERVER_TRUE);
+				replylink.Attach<int32>(bitmaps.CountItems());
+				for(int32 i=0; i<bitmaps.CountItems(); i++)
+				{
+					ServerBitmap *sbmp=(ServerBitmap*)bitmaps.ItemAt(i);
+					replylink.Attach<int32>(sbmp->Token());
+					replylink.Attach<int32>(sbmp->Area());
+					replylink.Attach<int32>(sbmp->AreaOffset());
+				}
+			}
+			else
+				replylink.StartMessage(SERVER_FALSE);
+			replylink.Flush();
+			
+			break;
+		}
+		case AS_DELETE_BITMAPS:
 		{
-			// TODO: Implement AS_CREATE_PICTURE
-			STRACE(("ServerApp %s: Create Picture unimplemented\n",fSignature.String()));
+			STRACE(("ServerApp %s: received request to delete bitmaps\n",fSignature.String()));
+			// Delete bitmaps the client doesn't use anymore. There is no reply, so 
+			// clients can queue these up.
 
+			// Attached Data:
+			// 1) int32 number of bitmaps
+			// 2) int32 token of each of them
+			int32 count;
+			msg.Read<int32>(&count);
+			
+			for(int32 i=0; i<count; i++)
+			{
+				int32 bmp_id;
+				msg.Read<int32>(&bmp_id);
+				
+				ServerBitmap *sbmp=FindBitmap(bmp_id);
+				if(sbmp)
+				{
+					STRACE(("ServerApp %s: Deleting Bitmap %ld\n",fSignature.String(),bmp_id));
+					bitmapmanager->DeleteBitmap(sbmp);
+				}
+			}
+			break;
+		}
+		case AS_CREATE_PICTURE:
+		{
+			STRACE(("ServerApp %s: Create Picture\n",fSignature.String()));
+			
+			// Attached Data:
+			// 1) int32 number of nested pictures
+			// 2) int32 token of each nested picture
+			// 3) int32 size of the picture data
+			// 4) picture data
+			// 5) port_id reply port
+			
+			// Reply Code: SERVER_TRUE
+			// Reply Data:
+			//	1) int32 server token
+			port_id replyport = -1;
+			int32 subcount, subtoken, size;
+			
+			ServerPicture *picture=new ServerPicture();
+			
+			msg.Read<int32>(&subcount);
+			for(int32 i=0; i<subcount; i++)
+			{
+				msg.Read<int32>(&subtoken);
+				picture->AddSubPicture(FindPicture(subtoken));
+			}
+			
+			msg.Read<int32>(&size);
+			if(size>0)
+			{
+				void *data=malloc(size);
+				msg.Read(data,size);
+				picture->SetData(data,size);
+				free(data);
+			}
+			msg.Read<int32>(&replyport);
+			
+			BPortLink replylink(replyport);
+			if(picture->InitCheck())
+			{
+				fPictureList->AddItem(picture);
+				replylink.StartMessage(SERVER_TRUE);
+				replylink.Attach<int32>(picture->GetToken());
+			}
+			else
+			{
+				picture->Release();
+				replylink.StartMessage(SERVER_FALSE);
+			}
+			replylink.Flush();
 			break;
 		}
 		case AS_DELETE_PICTURE:
 		{
-			// TODO: Implement AS_DELETE_PICTURE
-			STRACE(("ServerApp %s: Delete Picture unimplemented\n",fSignature.String()));
-
+			STRACE(("ServerApp %s: Delete Picture\n",fSignature.String()));
+			
+			// Attached Data:
+			// 1) int32 token
+			int32 token;
+			msg.Read<int32>(&token);
+			
+			ServerPicture *picture=FindPicture(token);
+			if(picture)
+			{
+				// Only the client's reference goes away here. Pictures which
+				// nest this one keep it alive for as long as they need it.
+				fPictureList->RemoveItem(picture);
+				picture->Release();
+			}
 			break;
 		}
 		case AS_CLONE_PICTURE:
@@ -871,17 +1071,22 @@ void ServerApp::_DispatchMessage(int32 code, BPortLink& msg)
 }
 
 /*!
-	\brief Looks up a ServerApp's ServerBitmap in its list
+	\brief Looks up one of the ServerApp's ServerBitmaps
 	\param token ID token of the bitmap to find
 	\return The bitmap having that ID or NULL if not found
 */
 ServerBitmap *ServerApp::FindBitmap(int32 token)
 {
-	ServerBitmap *temp;
-	for(int32 i=0; i<fBitmapList->CountItems();i++)
+	return bitmapmanager->FindBitmap(token,this);
+}
+
+ServerPicture *ServerApp::FindPicture(int32 token)
+{
+	ServerPicture *temp;
+	for(int32 i=0; i<fPictureList->CountItems();i++)
 	{
-		temp=(ServerBitmap*)fBitmapList->ItemAt(i);
-		if(temp && temp->Token()==token)
+		temp=(ServerPicture*)fPictureList->ItemAt(i);
+		if(temp && temp->GetToken()==token)
 			return temp;
 	}
 	return NULL;
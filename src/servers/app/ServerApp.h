@@ -39,6 +39,7 @@ class BList;
 class DisplayDriver;
 class ServerCursor;
 class ServerBitmap;
+class ServerPicture;
 
 /*!
 	\class ServerApp ServerApp.h
@@ -71,6 +72,7 @@ public:
 	void SendMessageToClient( const BMessage* msg ) const;
 	void SetAppCursor(void);
 	ServerBitmap *FindBitmap(int32 token);
+	ServerPicture *FindPicture(int32 token);
 	
 	team_id	ClientTeamID();
 	
@@ -96,7 +98,6 @@ protected:
 	
 	BPortLink *fAppLink;
 	BList *fSWindowList,
-		  *fBitmapList,
 		  *fPictureList;
 	ServerCursor *fAppCursor;
 	sem_id fLockSem;
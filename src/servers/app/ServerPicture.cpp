@@ -24,14 +24,157 @@
 //	Description:	Server-side counterpart to BPicture
 //  
 //------------------------------------------------------------------------------
+#include <Region.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "DisplayDriver.h"
+#include "LayerData.h"
+#include "PictureProtocol.h"
+#include "ServerBitmap.h"
 #include "TokenHandler.h"
 #include "ServerPicture.h"
 
 TokenHandler picture_token_handler;
 
+/*!
+	\brief A single entry of a compiled picture
+	
+	Coordinates are kept in screen space for the offset the picture was last
+	played at, so replaying a picture at the same place touches no geometry.
+	Radii and angles live in values[] so that translation only ever has to
+	touch rect, points[], pointlist, region and bounds.
+*/
+typedef struct
+{
+	int16 code;
+	DrawData *state;
+	BRect bounds;
+	bool unbounded;
+	
+	BRect rect;
+	BRect source;
+	BPoint points[4];
+	float values[2];
+	
+	BPoint *pointlist;
+	int32 pointcount;
+	bool closed;
+	
+	char *string;
+	int32 length;
+	
+	BRegion *region;
+	UtilityBitmap *bitmap;
+	ServerPicture *picture;
+} picture_op;
+
+/*!
+	\brief State saved by B_PIC_PUSH_STATE while compiling
+*/
+typedef struct
+{
+	DrawData data;
+	BPoint origin;
+} picture_state;
+
+/*!
+	\brief Bounds-checked reader for the arguments of a single opcode
+*/
+class PictureOpReader
+{
+public:
+	PictureOpReader(const int8 *data, int32 size)
+	 :	fData(data), fSize(size), fPos(0) {}
+	
+	bool Read(void *dest, int32 size)
+	{
+		if(size<0 || fPos+size>fSize)
+		{
+			memset(dest,0,size>0 ? size : 0);
+			fPos=fSize;
+			return false;
+		}
+		memcpy(dest,fData+fPos,size);
+		fPos+=size;
+		return true;
+	}
+	
+	template <class T> T Read(void)
+	{
+		T data;
+		Read(&data,sizeof(T));
+		return data;
+	}
+	
+	int32 Remaining(void) const { return fSize-fPos; }
+	
+private:
+	const int8 *fData;
+	int32 fSize;
+	int32 fPos;
+};
+
+static picture_op *
+new_op(int16 code, DrawData *state)
+{
+	picture_op *op=new picture_op;
+	op->code=code;
+	op->state=state;
+	op->unbounded=false;
+	op->values[0]=op->values[1]=0;
+	op->pointlist=NULL;
+	op->pointcount=0;
+	op->closed=false;
+	op->string=NULL;
+	op->length=0;
+	op->region=NULL;
+	op->bitmap=NULL;
+	op->picture=NULL;
+	return op;
+}
+
+static void
+delete_op(picture_op *op)
+{
+	delete [] op->pointlist;
+	delete [] op->string;
+	delete op->region;
+	delete op->bitmap;
+	delete op;
+}
+
+static BRect
+point_bounds(const BPoint *pts, int32 count)
+{
+	BRect r(pts[0],pts[0]);
+	for(int32 i=1; i<count; i++)
+	{
+		if(pts[i].x<r.left)
+			r.left=pts[i].x;
+		if(pts[i].x>r.right)
+			r.right=pts[i].x;
+		if(pts[i].y<r.top)
+			r.top=pts[i].y;
+		if(pts[i].y>r.bottom)
+			r.bottom=pts[i].y;
+	}
+	return r;
+}
+
+static inline BRect
+stroke_bounds(BRect r, const DrawData *d)
+{
+	float inset=-(d->pensize/2)-1;
+	r.InsetBy(inset,inset);
+	return r;
+}
+
 ServerPicture::ServerPicture(void)
 {
 	_token=picture_token_handler.GetToken();
+	_refcount=1;
 	
 	_initialized=false;
 	
@@ -41,8 +184,747 @@ ServerPicture::ServerPicture(void)
 	
 	if(_area!=B_BAD_VALUE && _area!=B_NO_MEMORY && _area!=B_ERROR)
 		_initialized=true;
+	
+	_data=NULL;
+	_datasize=0;
+	_compiled=false;
+	_compiledspace=B_NO_COLOR_SPACE;
+	_nesting=0;
 }
 
 ServerPicture::~ServerPicture(void)
 {
+	_MakeEmpty();
+	free(_data);
+	if(_initialized)
+		delete_area(_area);
+	
+	for(int32 i=0; i<_subpictures.CountItems(); i++)
+		((ServerPicture*)_subpictures.ItemAtFast(i))->Release();
+}
+
+/*!
+	\brief Adds a reference to the picture
+*/
+void ServerPicture::Acquire(void)
+{
+	atomic_add(&_refcount,1);
+}
+
+/*!
+	\brief Drops a reference to the picture, deleting it with the last one
+*/
+void ServerPicture::Release(void)
+{
+	if(atomic_add(&_refcount,-1)==1)
+		delete this;
+}
+
+/*!
+	\brief Replaces the picture's opcode stream
+	\param data The flattened picture data as sent by BPicture
+	\param size Size of the data in bytes
+	
+	The display list is thrown away and rebuilt the next time the picture is played.
+*/
+void ServerPicture::SetData(const void *data, int32 size)
+{
+	_MakeEmpty();
+	free(_data);
+	_data=NULL;
+	_datasize=0;
+	
+	if(!data || size<=0)
+		return;
+	
+	_data=malloc(size);
+	if(!_data)
+		return;
+	
+	memcpy(_data,data,size);
+	_datasize=size;
+}
+
+/*!
+	\brief Adds a picture which can be drawn by B_PIC_DRAW_PICTURE
+	\param picture The nested picture. This picture holds a reference to it
+	until it is removed again or this picture is deleted.
+*/
+void ServerPicture::AddSubPicture(ServerPicture *picture)
+{
+	if(!picture || picture==this)
+		return;
+	
+	picture->Acquire();
+	_subpictures.AddItem(picture);
+	_MakeEmpty();
+}
+
+/*!
+	\brief Forgets a nested picture and drops the reference held to it
+	\param picture The nested picture to remove
+*/
+void ServerPicture::RemoveSubPicture(ServerPicture *picture)
+{
+	if(_subpictures.RemoveItem(picture))
+	{
+		_MakeEmpty();
+		picture->Release();
+	}
+}
+
+/*!
+	\brief Returns the area touched by the picture when played at (0,0)
+	\param driver The driver the picture will be played on
+	\return The bounds, or an invalid rectangle if they cannot be determined
+*/
+BRect ServerPicture::Bounds(DisplayDriver *driver)
+{
+	if(!driver)
+		return BRect();
+	
+	if(_nesting>0)
+		return BRect();
+	
+	display_mode mode;
+	driver->GetMode(&mode);
+	if(!_compiled || _compiledspace!=(color_space)mode.space)
+		_Compile(driver);
+	
+	return _bounds;
+}
+
+/*!
+	\brief Draws the picture
+	\param driver The driver to draw with
+	\param where Screen location of the picture's origin
+	\param clip Region outside of which nothing needs to be drawn. May be NULL.
+	
+	The picture is compiled on first use and again only if the color space of the
+	driver changes.
+*/
+void ServerPicture::Play(DisplayDriver *driver, const BPoint &where, const BRegion *clip)
+{
+	if(!driver || _datasize==0)
+		return;
+	
+	// A picture which (indirectly) contains itself would never finish drawing
+	if(_nesting>0)
+		return;
+	
+	display_mode mode;
+	driver->GetMode(&mode);
+	if(!_compiled || _compiledspace!=(color_space)mode.space)
+		_Compile(driver);
+	
+	if(clip && _bounds.IsValid() && !clip->Intersects(_bounds.OffsetByCopy(where)))
+		return;
+	
+	if(where!=_offset)
+		_Translate(where-_offset);
+	
+	_nesting++;
+	
+	picture_op *op;
+	for(int32 i=0; i<_ops.CountItems(); i++)
+	{
+		op=(picture_op*)_ops.ItemAtFast(i);
+		
+		if(clip && !op->unbounded && !clip->Intersects(op->bounds))
+			continue;
+		
+		switch(op->code)
+		{
+			case B_PIC_STROKE_LINE:
+				driver->StrokeLine(op->points[0],op->points[1],op->state);
+				break;
+			case B_PIC_STROKE_RECT:
+				driver->StrokeRect(op->rect,op->state);
+				break;
+			case B_PIC_FILL_RECT:
+			{
+				if(op->region)
+					driver->FillRegion(*op->region,op->state);
+				else
+					driver->FillRect(op->rect,op->state);
+				break;
+			}
+			case B_PIC_STROKE_ROUND_RECT:
+				driver->StrokeRoundRect(op->rect,op->values[0],op->values[1],op->state);
+				break;
+			case B_PIC_FILL_ROUND_RECT:
+				driver->FillRoundRect(op->rect,op->values[0],op->values[1],op->state);
+				break;
+			case B_PIC_STROKE_BEZIER:
+				driver->StrokeBezier(op->points,op->state);
+				break;
+			case B_PIC_FILL_BEZIER:
+				driver->FillBezier(op->points,op->state);
+				break;
+			case B_PIC_STROKE_POLYGON:
+				driver->StrokePolygon(op->pointlist,op->pointcount,op->rect,op->state,op->closed);
+				break;
+			case B_PIC_FILL_POLYGON:
+				driver->FillPolygon(op->pointlist,op->pointcount,op->rect,op->state);
+				break;
+			case B_PIC_DRAW_STRING:
+				driver->DrawString(op->string,op->length,op->points[0],op->state);
+				break;
+			case B_PIC_DRAW_PIXELS:
+				driver->DrawBitmap(op->bitmap,op->source,op->rect,op->state);
+				break;
+			case B_PIC_DRAW_PICTURE:
+				op->picture->Play(driver,op->points[0],clip);
+				break;
+			case B_PIC_STROKE_ARC:
+				driver->StrokeArc(op->rect,op->values[0],op->values[1],op->state);
+				break;
+			case B_PIC_FILL_ARC:
+				driver->FillArc(op->rect,op->values[0],op->values[1],op->state);
+				break;
+			case B_PIC_STROKE_ELLIPSE:
+				driver->StrokeEllipse(op->rect,op->state);
+				break;
+			case B_PIC_FILL_ELLIPSE:
+				driver->FillEllipse(op->rect,op->state);
+				break;
+			default:
+				break;
+		}
+	}
+	
+	_nesting--;
+}
+
+/*!
+	\brief Frees the display list, but not the opcode stream
+*/
+void ServerPicture::_MakeEmpty(void)
+{
+	for(int32 i=0; i<_ops.CountItems(); i++)
+		delete_op((picture_op*)_ops.ItemAtFast(i));
+	_ops.MakeEmpty();
+	
+	for(int32 i=0; i<_states.CountItems(); i++)
+		delete (DrawData*)_states.ItemAtFast(i);
+	_states.MakeEmpty();
+	
+	_bounds=BRect();
+	_offset.Set(0,0);
+	_compiled=false;
+}
+
+/*!
+	\brief Copies the current state into the display list
+	\param state The state to copy
+	\return The copy, owned by the picture
+	
+	The colors of the copy are resolved to the compiled color space so that
+	the driver finds them already converted.
+*/
+DrawData *ServerPicture::_Snapshot(const DrawData &state)
+{
+	DrawData *data=new DrawData;
+	*data=state;
+	
+	switch(_compiledspace)
+	{
+		case B_CMAP8:
+		{
+			data->highcolor.GetColor8();
+			data->lowcolor.GetColor8();
+			break;
+		}
+		case B_RGB15:
+		case B_RGBA15:
+		case B_RGB15_BIG:
+		case B_RGBA15_BIG:
+		{
+			data->highcolor.GetColor15();
+			data->lowcolor.GetColor15();
+			break;
+		}
+		case B_RGB16:
+		case B_RGB16_BIG:
+		{
+			data->highcolor.GetColor16();
+			data->lowcolor.GetColor16();
+			break;
+		}
+		default:
+			break;
+	}
+	
+	_states.AddItem(data);
+	return data;
+}
+
+ServerPicture *ServerPicture::_FindSubPicture(int32 token)
+{
+	ServerPicture *picture;
+	for(int32 i=0; i<_subpictures.CountItems(); i++)
+	{
+		picture=(ServerPicture*)_subpictures.ItemAtFast(i);
+		if(picture->GetToken()==token)
+			return picture;
+	}
+	
+	// Older streams refer to nested pictures by their index
+	return (ServerPicture*)_subpictures.ItemAt(token);
+}
+
+/*!
+	\brief Moves every entry of the display list by the given amount
+	\param delta Offset to move by
+*/
+void ServerPicture::_Translate(const BPoint &delta)
+{
+	// Regions only move by whole pixels, so they follow the rounded total
+	// offset instead of adding up the rounding of each step
+	BPoint offset=_offset+delta;
+	int32 dh=(int32)floorf(offset.x+0.5)-(int32)floorf(_offset.x+0.5);
+	int32 dv=(int32)floorf(offset.y+0.5)-(int32)floorf(_offset.y+0.5);
+	
+	picture_op *op;
+	for(int32 i=0; i<_ops.CountItems(); i++)
+	{
+		op=(picture_op*)_ops.ItemAtFast(i);
+		
+		op->bounds.OffsetBy(delta);
+		op->rect.OffsetBy(delta);
+		for(int32 j=0; j<4; j++)
+			op->points[j]+=delta;
+		for(int32 j=0; j<op->pointcount; j++)
+			op->pointlist[j]+=delta;
+		if(op->region)
+			op->region->OffsetBy(dh,dv);
+	}
+	_offset=offset;
+}
+
+/*!
+	\brief Builds the display list from the opcode stream
+	\param driver The driver the picture is going to be played on
+	
+	Pictures are compiled against a default drawing state, the same state a
+	BPicture starts recording with, so the result can be reused no matter which
+	view draws the picture.
+*/
+void ServerPicture::_Compile(DisplayDriver *driver)
+{
+	_MakeEmpty();
+	
+	display_mode mode;
+	driver->GetMode(&mode);
+	_compiledspace=(color_space)mode.space;
+	_compiled=true;
+	
+	DrawData state;
+	BPoint origin(0,0);
+	BList stack;
+	DrawData *snapshot=NULL;
+	picture_op *last=NULL;
+	bool unbounded=false;
+	
+	const int8 *ptr=(const int8*)_data;
+	const int8 *end=ptr+_datasize;
+	
+	while(end-ptr>=(int32)(sizeof(int16)+sizeof(int32)))
+	{
+		int16 code;
+		int32 size;
+		memcpy(&code,ptr,sizeof(int16));
+		memcpy(&size,ptr+sizeof(int16),sizeof(int32));
+		ptr+=sizeof(int16)+sizeof(int32);
+		
+		if(size<0 || size>end-ptr)
+			break;
+		
+		PictureOpReader reader(ptr,size);
+		ptr+=size;
+		
+		picture_op *op=NULL;
+		
+		// Drawing opcodes share the most recent snapshot of the state. State
+		// opcodes drop it so that the next drawing opcode takes a new one.
+		switch(code)
+		{
+			case B_PIC_STROKE_LINE:
+			case B_PIC_STROKE_RECT:
+			case B_PIC_FILL_RECT:
+			case B_PIC_STROKE_ROUND_RECT:
+			case B_PIC_FILL_ROUND_RECT:
+			case B_PIC_STROKE_BEZIER:
+			case B_PIC_FILL_BEZIER:
+			case B_PIC_STROKE_POLYGON:
+			case B_PIC_FILL_POLYGON:
+			case B_PIC_DRAW_PIXELS:
+			case B_PIC_STROKE_ARC:
+			case B_PIC_FILL_ARC:
+			case B_PIC_STROKE_ELLIPSE:
+			case B_PIC_FILL_ELLIPSE:
+			{
+				if(!snapshot)
+					snapshot=_Snapshot(state);
+				break;
+			}
+			case B_PIC_MOVE_PEN_BY:
+			case B_PIC_DRAW_STRING:
+			case B_PIC_DRAW_PICTURE:
+			case B_PIC_ENTER_STATE_CHANGE:
+			case B_PIC_ENTER_FONT_STATE:
+			case B_PIC_SET_PEN_LOCATION:
+			case B_PIC_SET_ORIGIN:
+				break;
+			default:
+				snapshot=NULL;
+				break;
+		}
+		
+		switch(code)
+		{
+			case B_PIC_MOVE_PEN_BY:
+			{
+				state.penlocation+=reader.Read<BPoint>();
+				break;
+			}
+			case B_PIC_STROKE_LINE:
+			{
+				op=new_op(code,snapshot);
+				op->points[0]=reader.Read<BPoint>()+origin;
+				op->points[1]=reader.Read<BPoint>()+origin;
+				op->bounds=stroke_bounds(point_bounds(op->points,2),snapshot);
+				state.penlocation=op->points[1]-origin;
+				break;
+			}
+			case B_PIC_STROKE_RECT:
+			{
+				op=new_op(code,snapshot);
+				op->rect=reader.Read<BRect>().OffsetByCopy(origin);
+				op->bounds=stroke_bounds(op->rect,snapshot);
+				break;
+			}
+			case B_PIC_FILL_RECT:
+			{
+				BRect rect=reader.Read<BRect>().OffsetByCopy(origin);
+				
+				// Runs of fills with the same state become one region fill.
+				// Where the rects overlap, the region fills those pixels only
+				// once, which is only the same for modes that don't depend on
+				// what is already there.
+				if(last && last->code==B_PIC_FILL_RECT && last->state==snapshot
+					&& (snapshot->draw_mode==B_OP_COPY || snapshot->draw_mode==B_OP_OVER
+						|| !(last->region ? last->region->Intersects(rect) : last->rect.Intersects(rect))))
+				{
+					if(!last->region)
+						last->region=new BRegion(last->rect);
+					last->region->Include(rect);
+					last->bounds=last->bounds | rect;
+					_bounds=_bounds.IsValid() ? (_bounds | rect) : rect;
+					break;
+				}
+				
+				op=new_op(code,snapshot);
+				op->rect=rect;
+				op->bounds=rect;
+				break;
+			}
+			case B_PIC_STROKE_ROUND_RECT:
+			case B_PIC_FILL_ROUND_RECT:
+			{
+				op=new_op(code,snapshot);
+				op->rect=reader.Read<BRect>().OffsetByCopy(origin);
+				BPoint radii=reader.Read<BPoint>();
+				op->values[0]=radii.x;
+				op->values[1]=radii.y;
+				op->bounds=(code==B_PIC_STROKE_ROUND_RECT) ? stroke_bounds(op->rect,snapshot) : op->rect;
+				break;
+			}
+			case B_PIC_STROKE_BEZIER:
+			case B_PIC_FILL_BEZIER:
+			{
+				op=new_op(code,snapshot);
+				reader.Read(op->points,sizeof(op->points));
+				for(int32 i=0; i<4; i++)
+					op->points[i]+=origin;
+				op->bounds=stroke_bounds(point_bounds(op->points,4),snapshot);
+				break;
+			}
+			case B_PIC_STROKE_POLYGON:
+			case B_PIC_FILL_POLYGON:
+			{
+				int32 count=reader.Read<int32>();
+				if(count<=0 || count>reader.Remaining()/(int32)sizeof(BPoint))
+					break;
+				
+				op=new_op(code,snapshot);
+				op->pointcount=count;
+				op->pointlist=new BPoint[count];
+				reader.Read(op->pointlist,count*sizeof(BPoint));
+				for(int32 i=0; i<count; i++)
+					op->pointlist[i]+=origin;
+				if(code==B_PIC_STROKE_POLYGON)
+					op->closed=reader.Read<bool>();
+				
+				op->rect=point_bounds(op->pointlist,count);
+				op->bounds=(code==B_PIC_STROKE_POLYGON) ? stroke_bounds(op->rect,snapshot) : op->rect;
+				break;
+			}
+			case B_PIC_STROKE_SHAPE:
+			case B_PIC_FILL_SHAPE:
+				break;
+			case B_PIC_DRAW_STRING:
+			{
+				int32 length=reader.Read<int32>();
+				if(length<0 || length>reader.Remaining())
+					break;
+				
+				char *string=new char[length+1];
+				reader.Read(string,length);
+				string[length]='\0';
+				
+				// TODO: The deltas given are escapements. They seem to be called deltax and deltay
+				// despite the fact that they are space and non-space escapements. Find out which is which when possible.
+				// My best guess is that deltax corresponds to escapement_delta.nonspace.
+				float deltax=reader.Read<float>();
+				float deltay=reader.Read<float>();
+				if(state.edelta.nonspace!=deltax || state.edelta.space!=deltay || !snapshot)
+				{
+					state.edelta.nonspace=deltax;
+					state.edelta.space=deltay;
+					snapshot=_Snapshot(state);
+				}
+				
+				op=new_op(code,snapshot);
+				op->string=string;
+				op->length=length;
+				op->points[0]=state.penlocation+origin;
+				
+				float width=driver->StringWidth(string,length,&state);
+				float size=state.font.Size();
+				
+				if(state.font.Rotation()!=0.0)
+					op->unbounded=true;
+				else
+				{
+					op->bounds.Set(op->points[0].x-1,op->points[0].y-size-1,
+						op->points[0].x+width+1,op->points[0].y+(size/2)+1);
+				}
+				
+				state.penlocation.x+=width;
+				break;
+			}
+			case B_PIC_DRAW_PIXELS:
+			{
+				BRect src=reader.Read<BRect>();
+				BRect dest=reader.Read<BRect>().OffsetByCopy(origin);
+				int32 width=reader.Read<int32>();
+				int32 height=reader.Read<int32>();
+				int32 bytesPerRow=reader.Read<int32>();
+				int32 pixelFormat=reader.Read<int32>();
+				int32 flags=reader.Read<int32>();
+				
+				if(width<=0 || height<=0)
+					break;
+				
+				UtilityBitmap *bitmap=new UtilityBitmap(BRect(0,0,width-1,height-1),
+					(color_space)pixelFormat,flags,bytesPerRow);
+				if(!bitmap->Bits())
+				{
+					delete bitmap;
+					break;
+				}
+				
+				int32 length=reader.Remaining();
+				if((uint32)length>bitmap->BitsLength())
+					length=bitmap->BitsLength();
+				reader.Read(bitmap->Bits(),length);
+				
+				op=new_op(code,snapshot);
+				op->bitmap=bitmap;
+				op->source=src;
+				op->rect=dest;
+				op->bounds=dest;
+				break;
+			}
+			case B_PIC_DRAW_PICTURE:
+			{
+				BPoint where=reader.Read<BPoint>()+origin;
+				ServerPicture *picture=_FindSubPicture(reader.Read<int32>());
+				if(!picture)
+					break;
+				
+				op=new_op(code,NULL);
+				op->picture=picture;
+				op->points[0]=where;
+				
+				_nesting++;
+				BRect bounds=picture->Bounds(driver);
+				_nesting--;
+				
+				if(bounds.IsValid())
+					op->bounds=bounds.OffsetByCopy(where);
+				else
+					op->unbounded=true;
+				break;
+			}
+			case B_PIC_STROKE_ARC:
+			case B_PIC_FILL_ARC:
+			{
+				BPoint center=reader.Read<BPoint>()+origin;
+				BPoint radii=reader.Read<BPoint>();
+				
+				op=new_op(code,snapshot);
+				op->rect.Set(center.x-radii.x,center.y-radii.y,center.x+radii.x,center.y+radii.y);
+				op->values[0]=reader.Read<float>();
+				op->values[1]=reader.Read<float>();
+				op->bounds=(code==B_PIC_STROKE_ARC) ? stroke_bounds(op->rect,snapshot) : op->rect;
+				break;
+			}
+			case B_PIC_STROKE_ELLIPSE:
+			case B_PIC_FILL_ELLIPSE:
+			{
+				op=new_op(code,snapshot);
+				op->rect=reader.Read<BRect>().OffsetByCopy(origin);
+				op->bounds=(code==B_PIC_STROKE_ELLIPSE) ? stroke_bounds(op->rect,snapshot) : op->rect;
+				break;
+			}
+			case B_PIC_PUSH_STATE:
+			{
+				picture_state *saved=new picture_state;
+				saved->data=state;
+				saved->origin=origin;
+				stack.AddItem(saved);
+				break;
+			}
+			case B_PIC_POP_STATE:
+			{
+				picture_state *saved=(picture_state*)stack.RemoveItem(stack.CountItems()-1);
+				if(saved)
+				{
+					state=saved->data;
+					origin=saved->origin;
+					delete saved;
+				}
+				break;
+			}
+			case B_PIC_CLIP_TO_PICTURE:
+			case B_PIC_SET_CLIPPING_RECTS:
+			case B_PIC_CLEAR_CLIPPING_RECTS:
+			{
+				// TODO: Find out how the data will be stored and implement
+				break;
+			}
+			case B_PIC_SET_ORIGIN:
+			{
+				origin=reader.Read<BPoint>();
+				break;
+			}
+			case B_PIC_SET_PEN_LOCATION:
+			{
+				state.penlocation=reader.Read<BPoint>();
+				break;
+			}
+			case B_PIC_SET_DRAWING_MODE:
+			{
+				state.draw_mode=(drawing_mode)reader.Read<int16>();
+				break;
+			}
+			case B_PIC_SET_LINE_MODE:
+			{
+				reader.Read(&state.lineCap,sizeof(cap_mode));
+				reader.Read(&state.lineJoin,sizeof(join_mode));
+				state.miterLimit=reader.Read<float>();
+				break;
+			}
+			case B_PIC_SET_PEN_SIZE:
+			{
+				state.pensize=reader.Read<float>();
+				break;
+			}
+			case B_PIC_SET_SCALE:
+			{
+				state.scale=reader.Read<float>();
+				break;
+			}
+			case B_PIC_SET_FORE_COLOR:
+			{
+				state.highcolor=reader.Read<rgb_color>();
+				break;
+			}
+			case B_PIC_SET_BACK_COLOR:
+			{
+				state.lowcolor=reader.Read<rgb_color>();
+				break;
+			}
+			case B_PIC_SET_STIPLE_PATTERN:
+			{
+				pattern p=reader.Read<pattern>();
+				state.patt.Set(*((uint64*)p.data));
+				break;
+			}
+			case B_PIC_SET_BLENDING_MODE:
+			{
+				state.alphaSrcMode=(source_alpha)reader.Read<int16>();
+				state.alphaFncMode=(alpha_function)reader.Read<int16>();
+				break;
+			}
+			case B_PIC_SET_FONT_SPACING:
+			{
+				state.font.SetSpacing(reader.Read<int32>());
+				break;
+			}
+			case B_PIC_SET_FONT_ENCODING:
+			{
+				state.font.SetEncoding(reader.Read<int32>());
+				break;
+			}
+			case B_PIC_SET_FONT_FLAGS:
+			{
+				state.font.SetFlags(reader.Read<int32>());
+				break;
+			}
+			case B_PIC_SET_FONT_SIZE:
+			{
+				state.font.SetSize(reader.Read<float>());
+				break;
+			}
+			case B_PIC_SET_FONT_ROTATE:
+			{
+				state.font.SetRotation(reader.Read<float>());
+				break;
+			}
+			case B_PIC_SET_FONT_SHEAR:
+			{
+				state.font.SetShear(reader.Read<float>());
+				break;
+			}
+			case B_PIC_SET_FONT_FACE:
+			{
+				state.font.SetFace(reader.Read<int32>());
+				break;
+			}
+			default:
+				break;
+		}
+		
+		if(op)
+		{
+			_ops.AddItem(op);
+			if(op->unbounded)
+				unbounded=true;
+			else
+				_bounds=_bounds.IsValid() ? (_bounds | op->bounds) : op->bounds;
+			last=op;
+		}
+		else if(snapshot==NULL)
+			last=NULL;
+	}
+	
+	for(int32 i=0; i<stack.CountItems(); i++)
+		delete (picture_state*)stack.ItemAtFast(i);
+	
+	// Anything we could not bound makes the whole picture unbounded
+	if(unbounded)
+		_bounds=BRect();
 }
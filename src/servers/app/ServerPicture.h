@@ -28,24 +28,83 @@
 #define SERVER_PICTURE_H
 
 #include <OS.h>
+#include <List.h>
+#include <Rect.h>
+#include <GraphicsDefs.h>
 
 class AreaLink;
+class BRegion;
+class DisplayDriver;
+class DrawData;
 
+/*!
+	\class ServerPicture ServerPicture.h
+	\brief Server-side storage and playback of a flattened BPicture
+	
+	The opcode stream sent by the client is kept around unchanged, but playback
+	does not interpret it. The first time a picture is drawn, the stream is
+	compiled into a display list of typed operations which share snapshots of
+	the drawing state. Colors in those snapshots are resolved to the pixel
+	format of the target driver, runs of rectangle fills done with the same
+	state are merged into a single region fill, and every operation keeps its
+	bounds so that playback can skip anything outside the clipping region.
+	
+	Pictures are reference counted. The client owns one reference, which is
+	dropped by AS_DELETE_PICTURE, and every picture nesting this one owns
+	another, so a sub-picture keeps playing after the client has deleted it.
+*/
 class ServerPicture
 {
 public:
 	ServerPicture(void);
-	~ServerPicture(void);
 
+	void Acquire(void);
+	void Release(void);
+	
 	bool InitCheck(void) { return _initialized; }
 	area_id Area(void) { return _area; }
 	int32 GetToken(void) { return _token; }
+	
+	void SetData(const void *data, int32 size);
+	const void *Data(void) const { return _data; }
+	int32 DataSize(void) const { return _datasize; }
+	
+	void AddSubPicture(ServerPicture *picture);
+	void RemoveSubPicture(ServerPicture *picture);
+	int32 CountSubPictures(void) const { return _subpictures.CountItems(); }
+	ServerPicture *SubPictureAt(int32 index) const
+		{ return (ServerPicture*)_subpictures.ItemAt(index); }
+	
+	BRect Bounds(DisplayDriver *driver);
+	void Play(DisplayDriver *driver, const BPoint &where, const BRegion *clip);
+	
 private:
+	~ServerPicture(void);
+	
+	void _Compile(DisplayDriver *driver);
+	void _MakeEmpty(void);
+	void _Translate(const BPoint &delta);
+	DrawData *_Snapshot(const DrawData &state);
+	ServerPicture *_FindSubPicture(int32 token);
 	
 	AreaLink *arealink;
 	bool _initialized;
 	area_id _area;
 	int32 _token;
+	int32 _refcount;
+	
+	void *_data;
+	int32 _datasize;
+	BList _subpictures;
+	
+	// The compiled display list
+	BList _ops;
+	BList _states;
+	BRect _bounds;
+	bool _compiled;
+	color_space _compiledspace;
+	BPoint _offset;
+	int32 _nesting;
 };
 
 #endif
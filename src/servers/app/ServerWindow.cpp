@@ -669,6 +669,43 @@ Layer * ServerWindow::CreateLayerTree(Layer *localRoot, LinkMsgReader &link)
 	return newLayer;
 }
 //------------------------------------------------------------------------------
+//! Returns true for messages which change the contents of the current layer
+static bool is_drawing_code(int32 code)
+{
+	switch(code)
+	{
+		case AS_LAYER_DRAW_BITMAP_SYNC_AT_POINT:
+		case AS_LAYER_DRAW_BITMAP_ASYNC_AT_POINT:
+		case AS_LAYER_DRAW_BITMAP_SYNC_IN_RECT:
+		case AS_LAYER_DRAW_BITMAP_ASYNC_IN_RECT:
+		case AS_LAYER_DRAW_PICTURE:
+		case AS_STROKE_LINE:
+		case AS_STROKE_RECT:
+		case AS_FILL_RECT:
+		case AS_STROKE_ARC:
+		case AS_FILL_ARC:
+		case AS_STROKE_BEZIER:
+		case AS_FILL_BEZIER:
+		case AS_STROKE_ELLIPSE:
+		case AS_FILL_ELLIPSE:
+		case AS_STROKE_ROUNDRECT:
+		case AS_FILL_ROUNDRECT:
+		case AS_STROKE_TRIANGLE:
+		case AS_FILL_TRIANGLE:
+		case AS_STROKE_POLYGON:
+		case AS_FILL_POLYGON:
+		case AS_STROKE_SHAPE:
+		case AS_FILL_SHAPE:
+		case AS_FILL_REGION:
+		case AS_STROKE_LINEARRAY:
+		case AS_DRAW_STRING:
+		case AS_LAYER_SCROLL:
+			return true;
+		default:
+			return false;
+	}
+}
+//------------------------------------------------------------------------------
 void ServerWindow::DispatchMessage(int32 code, LinkMsgReader &link)
 {
 	if (cl == NULL && code != AS_LAYER_CREATE_ROOT)
@@ -676,6 +713,11 @@ void ServerWindow::DispatchMessage(int32 code, LinkMsgReader &link)
 		printf("ServerWindow %s received unexpected code - message offset %lx before top_view attached.\n",fTitle.String(), code - SERVER_TRUE);
 		return;
 	}
+	
+	// Drawing outside of an update is clipped to what is visible, so the saved
+	// contents of obscured parts may not match what the client has drawn anymore.
+	if (cl && !cl->InUpdate() && is_drawing_code(code))
+		fWinBorder->InvalidateBackingStore();
 
 	switch(code)
 	{
@@ -774,6 +816,20 @@ void ServerWindow::DispatchMessage(int32 code, LinkMsgReader &link)
 			}
 			break;
 		}
+		case AS_LAYER_DRAW_PICTURE:
+		{
+			STRACE(("ServerWindow %s: Message AS_LAYER_DRAW_PICTURE: Layer: %s\n",fTitle.String(), cl->fName->String()));
+			int32 pictureToken;
+			BPoint where;
+			
+			link.Read<int32>(&pictureToken);
+			link.Read<BPoint>(&where);
+			
+			ServerPicture *picture = fServerApp->FindPicture(pictureToken);
+			if(picture)
+				picture->Play(desktop->GetDisplayDriver(), cl->ConvertToTop(where), &(cl->fVisible));
+			break;
+		}
 		case AS_SET_CURRENT_LAYER:
 		{
 			STRACE(("ServerWindow %s: Message AS_SET_CURRENT_LAYER: Layer name: %s\n", fTitle.String(), cl->fName->String()));
@@ -961,6 +1017,18 @@ void ServerWindow::DispatchMessage(int32 code, LinkMsgReader &link)
 			
 			break;
 		}
+		case AS_LAYER_SCROLL:
+		{
+			STRACE(("ServerWindow %s: Message AS_LAYER_SCROLL: Layer name: %s\n", fTitle.String(), cl->fName->String()));
+			float dh, dv;
+			
+			link.Read<float>(&dh);
+			link.Read<float>(&dv);
+			
+			cl->ScrollBy(dh, dv);
+			
+			break;
+		}
 		case AS_LAYER_GET_COORD:
 		{
 			STRACE(("ServerWindow %s: Message AS_LAYER_GET_COORD: Layer: %s\n",fTitle.String(), cl->fName->String()));
@@ -1418,7 +1486,9 @@ void ServerWindow::DispatchMessage(int32 code, LinkMsgReader &link)
 			
 			link.Read<BRect>(&invalRect);
 			
-			cl->Invalidate(invalRect);
+			BRegion invalReg(invalRect);
+			fWinBorder->InvalidateBackingStore(invalReg);
+			cl->Invalidate(invalReg);
 			
 			break;
 		}
@@ -1439,6 +1509,7 @@ void ServerWindow::DispatchMessage(int32 code, LinkMsgReader &link)
 				invalReg.Include(rect);
 			}
 			
+			fWinBorder->InvalidateBackingStore(invalReg);
 			cl->Invalidate(invalReg);
 
 			break;
@@ -1446,13 +1517,35 @@ void ServerWindow::DispatchMessage(int32 code, LinkMsgReader &link)
 		case AS_BEGIN_UPDATE:
 		{
 			STRACE(("ServerWindowo %s: AS_BEGIN_UPDATE\n",fTitle.String()));
-			cl->UpdateStart();
+			
+			// The client draws all of its views that need it in one update
+			if(fWinBorder->fTopLayer)
+				fWinBorder->fTopLayer->UpdateStart();
 			break;
 		}
 		case AS_END_UPDATE:
 		{
 			STRACE(("ServerWindowo %s: AS_END_UPDATE\n",fTitle.String()));
-			cl->UpdateEnd();
+			if(fWinBorder->fTopLayer)
+				fWinBorder->fTopLayer->UpdateEnd();
+			break;
+		}
+		case AS_BACKING_STORE_EVICTED:
+		{
+			STRACE(("ServerWindow %s: AS_BACKING_STORE_EVICTED\n",fTitle.String()));
+			
+			// Region rebuilds use the backing store, so lock them out
+			RootLayer	*rl = fWinBorder->GetRootLayer();
+			
+			desktop->fGeneralLock.Lock();
+			if (rl)
+				rl->fMainLock.Lock();
+			
+			fWinBorder->ReleaseEvictedBackingStore();
+			
+			if (rl)
+				rl->fMainLock.Unlock();
+			desktop->fGeneralLock.Unlock();
 			break;
 		}
 
@@ -2282,4 +2375,18 @@ void ServerWindow::SendMessageToClient(const BMessage* msg) const
 	delete buffer;
 }
 //------------------------------------------------------------------------------
+/*!
+	\brief Sends a message with no attachments to the window's own thread
+	\param code ID code of the message to post
+	\param timeout How long to wait if the port is full
+	
+	Unlike most methods this doesn't require the ServerWindow to be locked.
+*/
+status_t ServerWindow::PostMessage(int32 code, bigtime_t timeout)
+{
+	BPortLink	link(fMessagePort);
+	link.StartMessage(code);
+	return link.Flush(timeout);
+}
+//------------------------------------------------------------------------------
 
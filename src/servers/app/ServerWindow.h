@@ -97,6 +97,7 @@ public:
 	// util methods.	
 	Layer *FindLayer(const Layer *start, int32 token) const;
 	void SendMessageToClient( const BMessage *msg ) const;
+	status_t PostMessage(int32 code, bigtime_t timeout = B_INFINITE_TIMEOUT);
 
 	// a few, not that important methods returning some internal settings.	
 	int32 Look(void) const { return fLook; }
@@ -28,6 +28,13 @@
 
 // Local Includes --------------------------------------------------------------
 #include "SystemPalette.h"
+#include <ColorUtils.h>
+#include <OS.h>
+#include <stdio.h>
+#include <string.h>
+
+//! The color map for the system palette, shared with all teams in an area
+static color_map *sSystemColorMap=NULL;
 
 /*!
 	\var rgb_color system_palette[256]
@@ -124,6 +131,57 @@ const rgb_color system_palette[] = {
  { 255, 255, 255, 255 }
 };
 
+/*!
+	\brief Creates the system color map and publishes it to client teams
+	
+	The map lives in an area named SYSTEM_COLOR_MAP_AREA, which clients clone 
+	read-only with CloneSystemColorMap(), so that BScreen::ColorMap() and 
+	conversions to B_CMAP8 don't have to build their own tables. Building the 
+	map takes a search through the palette for each of the 32768 15-bit colors, 
+	so it is done once here and not every time a color is looked up.
+*/
+void InitSystemColorMap(void)
+{
+	if(sSystemColorMap)
+		return;
+	
+	size_t size=(sizeof(color_map)+B_PAGE_SIZE-1) & ~(B_PAGE_SIZE-1);
+	void *address;
+	area_id area=create_area(SYSTEM_COLOR_MAP_AREA,&address,B_ANY_ADDRESS,size,
+		B_NO_LOCK,B_READ_AREA | B_WRITE_AREA);
+	if(area<0)
+	{
+		printf("Couldn't create the system color map: %s\n",strerror(area));
+		return;
+	}
+	
+	sSystemColorMap=(color_map*)address;
+	sSystemColorMap->id=0;
+	BuildColorMap(sSystemColorMap,system_palette);
+}
+
+/*!
+	\brief Rebuilds the system color map for a new palette
+	\param palette 256-element rgb_color array
+	
+	The map is changed in place, so clients which already cloned it see the 
+	new colors, and its id changes.
+*/
+void UpdateSystemColorMap(const rgb_color *palette)
+{
+	if(sSystemColorMap && palette)
+		BuildColorMap(sSystemColorMap,palette);
+}
+
+/*!
+	\brief Returns the system color map
+	\return The map or NULL if InitSystemColorMap() hasn't been called or failed
+*/
+const color_map *SystemColorMap(void)
+{
+	return sSystemColorMap;
+}
+
 /*!
 	\brief Takes a palette array and places the BeOS System	palette in it.
 	\param palette 256-element rgb_color array
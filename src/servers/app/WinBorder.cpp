@@ -30,6 +30,7 @@
 #include <Locker.h>
 #include <Debug.h>
 #include "PortLink.h"
+#include "ServerProtocol.h"
 #include "View.h"	// for mouse button defines
 #include "ServerWindow.h"
 #include "Decorator.h"
@@ -41,6 +42,9 @@
 #include "Globals.h"
 #include "RootLayer.h"
 #include "Workspace.h"
+#include "ServerBitmap.h"
+#include "BitmapManager.h"
+#include "ServerConfig.h"
 
 // Toggle general function call output
 #define DEBUG_WINBORDER
@@ -100,6 +104,10 @@ WinBorder::WinBorder(const BRect &r, const char *name, const int32 look, const i
 	fIsMinimizing	= false;
 	fIsZooming		= false;
 
+	fBackingStore	= NULL;
+	fBackingStoreEvicted = 0;
+	fClipKeyValid	= false;
+
 	fLastMousePosition.Set(-1,-1);
 	SetLevel();
 
@@ -114,6 +122,9 @@ WinBorder::WinBorder(const BRect &r, const char *name, const int32 look, const i
 WinBorder::~WinBorder(void)
 {
 	STRACE(("WinBorder(%s)::~WinBorder()\n",GetName()));
+	if (fBackingStore)
+		bitmapmanager->DeleteBackingStore(this);
+
 	if (fTopLayer){
 		delete fTopLayer;
 		fTopLayer = NULL;
@@ -131,6 +142,7 @@ void WinBorder::RebuildFullRegion(void)
 {
 	STRACE(("WinBorder(%s)::RebuildFullRegion()\n",GetName()));
 
+	fClipKeyValid = false;
 	fFull.MakeEmpty();
 
 	// Winborder holds Decorator's full regions. if any...
@@ -375,6 +387,14 @@ void WinBorder::ResizeBy(float x, float y)
 	// TODO: account for size limits
 	
 	STRACE(("WinBorder(%s)::ResizeBy()\n", GetName()));
+	
+	// the saved contents would no longer match the client area
+	if(fBackingStore)
+	{
+		bitmapmanager->DeleteBackingStore(this);
+		ForgetBackingStore();
+	}
+	
 	if(fDecorator)
 		fDecorator->ResizeBy(x,y);
 
@@ -393,11 +413,212 @@ bool WinBorder::IsHidden() const
 void WinBorder::ServerHide()
 {
 	fServerHidden = true;
+	fClipKeyValid = false;
 }
 
 void WinBorder::ServerUnhide()
 {
 	fServerHidden = false;
+	fClipKeyValid = false;
+}
+
+//! Returns true if the contents of the client area are kept when obscured
+bool WinBorder::UsesBackingStore(void) const
+{
+	if(!fTopLayer || !fServerWin)
+		return false;
+	
+#ifdef BACKING_STORE_FOR_ALL_WINDOWS
+	return true;
+#else
+	return (fServerWin->Flags() & B_BACKING_STORE) != 0;
+#endif
+}
+
+/*!
+	\brief Saves the part of the client area which is about to be lost from the screen
+	\param lost Area no longer visible, in screen coordinates before the change
+	\param oldOrigin Screen position of the client area before the change
+	
+	This is called while rebuilding regions, before anything new is drawn, so the
+	screen still holds the window's old pixels. Areas for which the client has 
+	not yet answered an update are skipped because they do not contain its drawing.
+*/
+void WinBorder::SaveToBackingStore(const BRegion &lost, const BPoint &oldOrigin)
+{
+	if(!UsesBackingStore())
+		return;
+	
+	// in case the window thread has not got around to it yet
+	ReleaseEvictedBackingStore();
+	
+	BRect bounds(0, 0, fTopLayer->fFrame.Width(), fTopLayer->fFrame.Height());
+	
+	BRegion save(bounds.OffsetByCopy(oldOrigin));
+	save.IntersectWith(&lost);
+	
+	if(fPendingUpdate.CountRects() > 0)
+	{
+		BRegion pending(fPendingUpdate);
+		pending.OffsetBy((int32)oldOrigin.x, (int32)oldOrigin.y);
+		save.Exclude(&pending);
+	}
+	
+	if(save.CountRects() == 0)
+		return;
+	
+	if(!fBackingStore)
+	{
+		fBackingValid.MakeEmpty();
+		fBackingStore = bitmapmanager->CreateBackingStore(this, bounds,
+				(color_space)fDriver->fDisplayMode.space);
+		if(!fBackingStore)
+			return;
+	}
+	else
+		bitmapmanager->TouchBackingStore(this);
+	
+	if(!fDriver->SaveRegionToBitmap(&save, fBackingStore, oldOrigin))
+	{
+		// the driver can't read back in our depth. Don't keep memory we can't use.
+		if(fBackingValid.CountRects() == 0)
+		{
+			bitmapmanager->DeleteBackingStore(this);
+			ForgetBackingStore();
+		}
+		return;
+	}
+	
+	save.OffsetBy(-(int32)oldOrigin.x, -(int32)oldOrigin.y);
+	fBackingValid.Include(&save);
+	
+	STRACE(("WinBorder(%s)::SaveToBackingStore()\n", GetName()));
+}
+
+/*!
+	\brief Restores as much of a region as possible from the backing store
+	\param region Area to redraw, in screen coordinates. The restored parts are
+	removed from it, so what remains still has to be drawn the usual way.
+*/
+void WinBorder::RestoreFromBackingStore(BRegion &region)
+{
+	if(!fBackingStore || fBackingValid.CountRects() == 0)
+		return;
+	
+	BPoint origin(ClientFrame().LeftTop());
+	
+	BRegion restore(fBackingValid);
+	restore.OffsetBy((int32)origin.x, (int32)origin.y);
+	restore.IntersectWith(&region);
+	restore.IntersectWith(&(fTopLayer->fFullVisible));
+	
+	if(restore.CountRects() == 0)
+		return;
+	
+	if(!fDriver->RestoreRegionFromBitmap(&restore, fBackingStore, origin))
+		return;
+	
+	bitmapmanager->TouchBackingStore(this);
+	region.Exclude(&restore);
+	
+	// what is on screen now is no longer kept up to date in the backing store
+	restore.OffsetBy(-(int32)origin.x, -(int32)origin.y);
+	fBackingValid.Exclude(&restore);
+	
+	STRACE(("WinBorder(%s)::RestoreFromBackingStore()\n", GetName()));
+}
+
+/*!
+	\brief Throws away the saved contents without freeing the bitmap
+	
+	Called when the client draws outside of an update. Its drawing is clipped to
+	the visible area, so saved contents of obscured parts may be out of date.
+*/
+void WinBorder::InvalidateBackingStore(void)
+{
+	fBackingValid.MakeEmpty();
+}
+
+/*!
+	\brief Throws away the saved contents of a region the client has invalidated
+	\param region Area the client will redraw, in screen coordinates
+	
+	Otherwise uncovering the window would put back what was there before.
+*/
+void WinBorder::InvalidateBackingStore(const BRegion &region)
+{
+	if(fBackingValid.CountRects() == 0)
+		return;
+	
+	BPoint origin(ClientFrame().LeftTop());
+	BRegion invalid(region);
+	invalid.OffsetBy(-(int32)origin.x, -(int32)origin.y);
+	fBackingValid.Exclude(&invalid);
+}
+
+//! Drops the pointer to the backing store and its saved contents
+void WinBorder::ForgetBackingStore(void)
+{
+	fBackingStore = NULL;
+	fBackingValid.MakeEmpty();
+}
+
+/*!
+	\brief Called by the BitmapManager when it takes the backing store away
+	
+	This happens while some other window is being handled, so we can't touch 
+	our state here. The bitmap stays valid until ReleaseEvictedBackingStore() 
+	is called from our own window thread.
+*/
+void WinBorder::BackingStoreEvicted(void)
+{
+	atomic_or(&fBackingStoreEvicted, 1);
+	
+	if (fServerWin)
+		fServerWin->PostMessage(AS_BACKING_STORE_EVICTED, 0);
+}
+
+//! Frees the backing store if the BitmapManager has evicted it. The desktop must be locked.
+void WinBorder::ReleaseEvictedBackingStore(void)
+{
+	if (atomic_and(&fBackingStoreEvicted, 0) == 0)
+		return;
+	
+	if (bitmapmanager->FreeEvictedBackingStore(this))
+		ForgetBackingStore();
+}
+
+//! Marks a screen region as waiting for the client to redraw it
+void WinBorder::AddPendingUpdate(const BRegion &region)
+{
+	if(!UsesBackingStore())
+		return;
+	
+	BPoint origin(ClientFrame().LeftTop());
+	BRegion pending(region);
+	pending.OffsetBy(-(int32)origin.x, -(int32)origin.y);
+	fPendingUpdate.Include(&pending);
+}
+
+//! Marks a screen region as redrawn by the client
+void WinBorder::RemovePendingUpdate(const BRegion &region)
+{
+	if(fPendingUpdate.CountRects() == 0)
+		return;
+	
+	BPoint origin(ClientFrame().LeftTop());
+	BRegion done(region);
+	done.OffsetBy(-(int32)origin.x, -(int32)origin.y);
+	fPendingUpdate.Exclude(&done);
+}
+
+//! Returns the frame of the client area in screen coordinates
+BRect WinBorder::ClientFrame(void)
+{
+	if(!fTopLayer)
+		return Frame();
+	
+	return ConvertToTop(fTopLayer->fFrame);
 }
 
 //! Sets the minimum and maximum sizes of the window
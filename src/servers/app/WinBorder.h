@@ -33,6 +33,7 @@
 #include "Layer.h"
 
 class ServerWindow;
+class ServerBitmap;
 class Decorator;
 class DisplayDriver;
 class Desktop;
@@ -50,6 +51,8 @@ class PointerEvent
 	int32 buttons;	//B_PRIMARY_MOUSE_BUTTON, B_SECONDARY_MOUSE_BUTTON
 			//B_TERTIARY_MOUSE_BUTTON
 	int32 clicks;
+	int32 history;	//number of B_MOUSE_MOVED events collapsed into
+			//this one
 };
 
 class WinBorder : public Layer
@@ -97,11 +100,24 @@ public:
 	
 	// Server "private" :-) - should not be used
 	void SetMainWinBorder(WinBorder *newMain);	
+	
+	bool UsesBackingStore(void) const;
+	void SaveToBackingStore(const BRegion &lost, const BPoint &oldOrigin);
+	void RestoreFromBackingStore(BRegion &region);
+	void InvalidateBackingStore(void);
+	void InvalidateBackingStore(const BRegion &region);
+	void ForgetBackingStore(void);
+	void BackingStoreEvicted(void);
+	void ReleaseEvictedBackingStore(void);
+	void AddPendingUpdate(const BRegion &region);
+	void RemovePendingUpdate(const BRegion &region);
+	BRect ClientFrame(void);
 
 protected:
 	friend class Layer;
 	friend class ServerWindow;
 	friend class Desktop;
+	friend class WinBorderIndex;
 
 	Decorator *fDecorator;
 	Layer *fTopLayer;
@@ -120,6 +136,21 @@ protected:
 	
 	float fMinWidth, fMaxWidth;
 	float fMinHeight, fMaxHeight;
+	
+	// Backing store. Both regions are in the coordinates of the client area,
+	// so they remain valid when the window is moved.
+	ServerBitmap *fBackingStore;
+	int32 fBackingStoreEvicted;
+	BRegion fBackingValid;
+	BRegion fPendingUpdate;
+	
+	// The part of the parent's visible region our last region rebuild depended
+	// on. If it comes out the same again, our regions are still up to date.
+	BRegion fClipKey;
+	bool fClipKeyValid;
+	
+	// TreeFootprint() as of when fClipKey was taken
+	BRect fFootprint;
 };
 
 #endif
@@ -0,0 +1,259 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, Haiku, Inc.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		WinBorderIndex.cpp
+//	Author:			Cosmoe Project
+//	Description:	Spatial index over the visible windows of a workspace
+//  
+//------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <Region.h>
+#include "WinBorder.h"
+#include "WinBorderIndex.h"
+
+//! A node of the interval tree
+struct index_node
+{
+	//! Row at which the node splits its entries
+	float center;
+	
+	//! Entries spanning center, sorted by ascending top
+	int32 *byTop;
+	
+	//! The same entries, sorted by descending bottom
+	int32 *byBottom;
+	
+	int32 count;
+	
+	//! Entries which end above center
+	index_node *above;
+	
+	//! Entries which start below center
+	index_node *below;
+};
+
+static int compare_floats(const void *a, const void *b)
+{
+	float first=*(const float*)a;
+	float second=*(const float*)b;
+	
+	if(first < second)
+		return -1;
+	return (first > second) ? 1 : 0;
+}
+
+WinBorderIndex::WinBorderIndex(void)
+{
+	fWinBorders=NULL;
+	fFrames=NULL;
+	fCount=0;
+	fCapacity=0;
+	fRoot=NULL;
+}
+
+WinBorderIndex::~WinBorderIndex(void)
+{
+	MakeEmpty();
+	delete [] fWinBorders;
+	delete [] fFrames;
+}
+
+//! Removes all windows from the index
+void WinBorderIndex::MakeEmpty(void)
+{
+	_Delete(fRoot);
+	fRoot=NULL;
+	fCount=0;
+}
+
+/*!
+	\brief Adds a window to the index
+	\param winBorder The window. Its current visible region is used.
+	
+	Build() has to be called after all windows have been added.
+*/
+void WinBorderIndex::AddWinBorder(WinBorder *winBorder)
+{
+	BRect frame(winBorder->fFullVisible.Frame());
+	if(!frame.IsValid())
+		return;
+	
+	if(fCount==fCapacity)
+	{
+		int32 capacity=fCapacity ? fCapacity*2 : 16;
+		WinBorder **winBorders=new WinBorder*[capacity];
+		BRect *frames=new BRect[capacity];
+		for(int32 i=0; i<fCount; i++)
+		{
+			winBorders[i]=fWinBorders[i];
+			frames[i]=fFrames[i];
+		}
+		delete [] fWinBorders;
+		delete [] fFrames;
+		fWinBorders=winBorders;
+		fFrames=frames;
+		fCapacity=capacity;
+	}
+	
+	fWinBorders[fCount]=winBorder;
+	fFrames[fCount]=frame;
+	fCount++;
+}
+
+//! Builds the interval tree over all windows added since the last MakeEmpty()
+void WinBorderIndex::Build(void)
+{
+	_Delete(fRoot);
+	fRoot=NULL;
+	
+	if(fCount==0)
+		return;
+	
+	int32 *entries=new int32[fCount];
+	for(int32 i=0; i<fCount; i++)
+		entries[i]=i;
+	
+	fRoot=_Build(entries,fCount);
+	
+	delete [] entries;
+}
+
+/*!
+	\brief Returns the window whose visible region contains a point
+	\param pt The point in screen coordinates
+	\return The window or NULL if the point is on the desktop
+*/
+WinBorder *WinBorderIndex::WinBorderAt(const BPoint &pt) const
+{
+	index_node *node=fRoot;
+	WinBorder *winBorder;
+	int32 i;
+	
+	while(node)
+	{
+		if(pt.y < node->center)
+		{
+			for(i=0; i<node->count && fFrames[node->byTop[i]].top <= pt.y; i++)
+			{
+				if((winBorder=_Check(node->byTop[i],pt)))
+					return winBorder;
+			}
+			node=node->above;
+		}
+		else if(pt.y > node->center)
+		{
+			for(i=0; i<node->count && fFrames[node->byBottom[i]].bottom >= pt.y; i++)
+			{
+				if((winBorder=_Check(node->byBottom[i],pt)))
+					return winBorder;
+			}
+			node=node->below;
+		}
+		else
+		{
+			for(i=0; i<node->count; i++)
+			{
+				if((winBorder=_Check(node->byTop[i],pt)))
+					return winBorder;
+			}
+			break;
+		}
+	}
+	return NULL;
+}
+
+index_node *WinBorderIndex::_Build(int32 *entries, int32 count)
+{
+	if(count==0)
+		return NULL;
+	
+	// split at the median of the midpoints so the tree stays balanced
+	float *mids=new float[count];
+	int32 i, j;
+	for(i=0; i<count; i++)
+		mids[i]=(fFrames[entries[i]].top+fFrames[entries[i]].bottom)/2;
+	qsort(mids,count,sizeof(float),compare_floats);
+	
+	index_node *node=new index_node;
+	node->center=mids[count/2];
+	delete [] mids;
+	
+	int32 *above=new int32[count];
+	int32 *below=new int32[count];
+	int32 aboveCount=0, belowCount=0;
+	
+	node->byTop=new int32[count];
+	node->count=0;
+	
+	for(i=0; i<count; i++)
+	{
+		BRect &frame=fFrames[entries[i]];
+		if(frame.bottom < node->center)
+			above[aboveCount++]=entries[i];
+		else if(frame.top > node->center)
+			below[belowCount++]=entries[i];
+		else
+			node->byTop[node->count++]=entries[i];
+	}
+	
+	// The lists are short in practice, so a plain insertion sort is fine
+	node->byBottom=new int32[node->count];
+	for(i=0; i<node->count; i++)
+	{
+		int32 entry=node->byTop[i];
+		for(j=i; j>0 && fFrames[node->byTop[j-1]].top > fFrames[entry].top; j--)
+			node->byTop[j]=node->byTop[j-1];
+		node->byTop[j]=entry;
+		
+		for(j=i; j>0 && fFrames[node->byBottom[j-1]].bottom < fFrames[entry].bottom; j--)
+			node->byBottom[j]=node->byBottom[j-1];
+		node->byBottom[j]=entry;
+	}
+	
+	node->above=_Build(above,aboveCount);
+	node->below=_Build(below,belowCount);
+	
+	delete [] above;
+	delete [] below;
+	
+	return node;
+}
+
+void WinBorderIndex::_Delete(index_node *node)
+{
+	if(!node)
+		return;
+	
+	_Delete(node->above);
+	_Delete(node->below);
+	delete [] node->byTop;
+	delete [] node->byBottom;
+	delete node;
+}
+
+WinBorder *WinBorderIndex::_Check(int32 entry, const BPoint &pt) const
+{
+	WinBorder *winBorder=fWinBorders[entry];
+	
+	if(fFrames[entry].Contains(pt) && !winBorder->IsHidden() && winBorder->HasPoint(pt))
+		return winBorder;
+	return NULL;
+}
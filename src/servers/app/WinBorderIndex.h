@@ -0,0 +1,73 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, Haiku, Inc.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		WinBorderIndex.h
+//	Author:			Cosmoe Project
+//	Description:	Spatial index over the visible windows of a workspace
+//  
+//------------------------------------------------------------------------------
+#ifndef _WINBORDER_INDEX_H_
+#define _WINBORDER_INDEX_H_
+
+#include <Rect.h>
+#include <SupportDefs.h>
+
+class WinBorder;
+struct index_node;
+
+/*!
+	\class WinBorderIndex WinBorderIndex.h
+	\brief Interval tree over the vertical extent of window visible regions
+	
+	The visible regions of windows never overlap, so finding the window under a
+	point does not depend on stacking order. The index keeps the frame of every
+	visible region in a centered interval tree keyed on y, so only the windows
+	whose frame spans the point's row have to be looked at.
+	
+	The index is a snapshot. It has to be rebuilt whenever visible regions change.
+*/
+class WinBorderIndex
+{
+public:
+	WinBorderIndex(void);
+	~WinBorderIndex(void);
+	
+	void MakeEmpty(void);
+	void AddWinBorder(WinBorder *winBorder);
+	void Build(void);
+	
+	WinBorder *WinBorderAt(const BPoint &pt) const;
+	int32 CountWinBorders(void) const { return fCount; }
+
+private:
+	index_node *_Build(int32 *entries, int32 count);
+	void _Delete(index_node *node);
+	WinBorder *_Check(int32 entry, const BPoint &pt) const;
+	
+	WinBorder **fWinBorders;
+	BRect *fFrames;
+	int32 fCount;
+	int32 fCapacity;
+	
+	index_node *fRoot;
+};
+
+#endif
@@ -70,6 +70,9 @@ Workspace::Workspace(const uint32 colorspace, int32 ID, const RGBColor& BGColor)
 	fFocusItem	= NULL;
 	fFrontItem	= NULL;
 	
+	fIndexGeneration = 0;
+	fIndexValid	= false;
+	
 	fVirtualWidth=-1;
 	fVirtualHeight=-1;
 }
@@ -325,6 +328,32 @@ bool Workspace::GoToItem(WinBorder *layer)
 	return false;
 }
 
+//----------------------------------------------------------------------------------
+/*
+	Returns the WinBorder whose visible region contains pt, or NULL. The index is
+	rebuilt first if windows were added or removed, or if visible regions were
+	recalculated since it was last built, as told by 'generation'. The RootLayer's
+	fMainLock must be held.
+*/
+WinBorder *Workspace::WinBorderAt(const BPoint &pt, uint32 generation)
+{
+	if(!fIndexValid || fIndexGeneration != generation)
+	{
+		fIndex.MakeEmpty();
+		for(ListData *item = fBottomItem; item != NULL; item = item->upperItem)
+		{
+			if(!item->layerPtr->IsHidden())
+				fIndex.AddWinBorder(item->layerPtr);
+		}
+		fIndex.Build();
+		
+		fIndexGeneration	= generation;
+		fIndexValid			= true;
+	}
+	
+	return fIndex.WinBorderAt(pt);
+}
+
 //----------------------------------------------------------------------------------
 
 ListData *Workspace::HasItem(ListData *item)
@@ -1451,6 +1480,8 @@ void Workspace::PrintItem(ListData *item) const
 
 void Workspace::InsertItem(ListData *item, ListData *before)
 {
+	fIndexValid = false;
+
 	// insert before one other item;
 	if(before)
 	{
@@ -1485,6 +1516,8 @@ void Workspace::RemoveItem(ListData *item)
 	if(!item)
 		return;
 
+	fIndexValid = false;
+
 	if(fBottomItem == item)
 		fBottomItem = item->upperItem;
 	else
@@ -35,6 +35,7 @@
 #include <Locker.h>
 
 #include "RGBColor.h"
+#include "WinBorderIndex.h"
 
 class WinBorder;
 
@@ -65,6 +66,8 @@ public:
 	WinBorder *GoToTopItem(void);
 	WinBorder *GoToLowerItem(void);
 	bool GoToItem(WinBorder *layer);
+	
+	WinBorder *WinBorderAt(const BPoint &pt, uint32 generation);
 
 	void SetLocalSpace(const uint32 colorspace);
 	uint32 LocalSpace(void) const;
@@ -117,6 +120,12 @@ private:
 	 // the item that is the target of mouse operations
 	ListData *fFrontItem;
 	
+	// index of the visible regions for hit testing. Built on demand when the
+	// RootLayer's region generation no longer matches.
+	WinBorderIndex fIndex;
+	uint32 fIndexGeneration;
+	bool fIndexValid;
+	
 	// settings for each workspace -- example taken from R5's app_server_settings file
 	int16 fVirtualWidth;
 	int16 fVirtualHeight;
@@ -108,7 +108,7 @@ void DFBEventTranslator(void *arg)
 						y=(float)event.axisabs;
 
 					uint32 buttons = 0;
-					int64 time = (int64)real_time_clock();
+					int64 time = system_time();
 
 					driver->serverlink->StartMessage(B_MOUSE_MOVED);
 					driver->serverlink->Attach<int64>(time);
@@ -142,7 +142,7 @@ void DFBEventTranslator(void *arg)
 					uint32 buttons = 1;
 					uint32 clicks = 1;		// can't get the # of clicks without a *lot* of extra work :(
 					uint32 mod = 0;
-					int64 time = (int64)real_time_clock();
+					int64 time = system_time();
 
 					driver->serverlink->StartMessage(B_MOUSE_DOWN);
 					driver->serverlink->Attach<int64>(time);
@@ -158,7 +158,7 @@ void DFBEventTranslator(void *arg)
 				case DIET_BUTTONRELEASE:{
 					STRACE("MouseUp\n");
 					uint32 mod = 0;
-					int64 time = (int64)real_time_clock();
+					int64 time = system_time();
 
 					driver->serverlink->StartMessage(B_MOUSE_UP);
 					driver->serverlink->Attach<int64>(time);
@@ -0,0 +1,323 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, Haiku, Inc.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		headlessdriver.cpp
+//	Author:			Cosmoe Project
+//	Description:	Display driver which renders into memory only
+//
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "headlessdriver.h"
+#include "ServerBitmap.h"
+#include "PNGDump.h"
+
+//#define DEBUG_HEADLESS_DRIVER
+
+#ifdef DEBUG_HEADLESS_DRIVER
+	#define STRACE(a) printf a
+#else
+	#define STRACE(a) /* nothing */
+#endif
+
+// Same size as the X11 driver, which is what the Desktop expects for now
+#define HEADLESS_WIDTH		800
+#define HEADLESS_HEIGHT		600
+
+//! Microseconds between two timing reports
+#define HEADLESS_REPORT_INTERVAL	5000000
+
+static const char *sOpNames[HEADLESS_OP_COUNT]=
+{
+	"FillSolidRect",
+	"FillPatternRect",
+	"StrokeSolidLine",
+	"StrokePatternLine",
+	"StrokeSolidRect",
+	"InvertRect",
+	"Blit",
+	"CopyBitmap",
+	"CopyToBitmap",
+	"DrawBitmap",
+	"buffer access"
+};
+
+//! Returns the number of pixels in a rectangle
+static int64 rect_pixels(const BRect &r)
+{
+	if(!r.IsValid())
+		return 0;
+	return (int64)(r.IntegerWidth()+1)*(int64)(r.IntegerHeight()+1);
+}
+
+HeadlessDriver::HeadlessDriver(void) : BitmapDriver()
+{
+	STRACE(("HeadlessDriver::HeadlessDriver\n"));
+	
+	fScreen=NULL;
+	fReporterThread=-1;
+	fQuitting=false;
+	fDumpIndex=1;
+	fBufferStart=0;
+	ResetStats();
+}
+
+HeadlessDriver::~HeadlessDriver(void)
+{
+	STRACE(("HeadlessDriver::~HeadlessDriver\n"));
+	Shutdown();
+}
+
+/*!
+	\brief Allocates the screen bitmap and starts the reporter thread
+	\return true if successful, false if not
+*/
+bool HeadlessDriver::Initialize(void)
+{
+	STRACE(("HeadlessDriver::Initialize\n"));
+	
+	fScreen=new UtilityBitmap(BRect(0,0,HEADLESS_WIDTH-1,HEADLESS_HEIGHT-1),B_RGBA32,0);
+	if(!fScreen->Bits())
+	{
+		delete fScreen;
+		fScreen=NULL;
+		return false;
+	}
+	
+	SetTarget(fScreen);
+	
+	fReporterThread=spawn_thread(ReporterThread,"headless reporter",B_LOW_PRIORITY,this);
+	if(fReporterThread>=0)
+		resume_thread(fReporterThread);
+	
+	return true;
+}
+
+//! Stops the reporter thread, prints the final report and frees the screen
+void HeadlessDriver::Shutdown(void)
+{
+	STRACE(("HeadlessDriver::Shutdown\n"));
+	
+	if(fReporterThread>=0)
+	{
+		status_t result;
+		fQuitting=true;
+		wait_for_thread(fReporterThread,&result);
+		fReporterThread=-1;
+		
+		PrintStats();
+	}
+	
+	if(fScreen)
+	{
+		SetTarget(NULL);
+		delete fScreen;
+		fScreen=NULL;
+	}
+}
+
+/*!
+	\brief Saves the screen as a PNG file
+	\param path Name of the file to write
+	\return true if successful, false if there is no screen
+*/
+bool HeadlessDriver::DumpToFile(const char *path)
+{
+	if(!path || !fScreen)
+		return false;
+	
+	Lock();
+	SaveToPNG(path,fScreen->Bounds(),fScreen->ColorSpace(),fScreen->Bits(),
+		fScreen->BitsLength(),fScreen->BytesPerRow());
+	Unlock();
+	return true;
+}
+
+/*!
+	\brief Prints how many times each primitive was called and how long it took
+	
+	Pixels per second only mean something for the primitives which fill areas. 
+	For lines the number of pixels is the length of the line.
+*/
+void HeadlessDriver::PrintStats(void)
+{
+	Lock();
+	
+	printf("HeadlessDriver: %-18s %8s %10s %10s %10s\n","primitive","calls",
+		"us total","us/call","Mpixel/s");
+	for(int32 i=0; i<HEADLESS_OP_COUNT; i++)
+	{
+		if(fCount[i]==0)
+			continue;
+		
+		printf("HeadlessDriver: %-18s %8ld %10lld %10.2f %10.2f\n",sOpNames[i],fCount[i],
+			fTime[i],(double)fTime[i]/fCount[i],
+			fTime[i]>0 ? (double)fPixels[i]/fTime[i] : 0.0);
+	}
+	
+	Unlock();
+}
+
+//! Starts a new measurement
+void HeadlessDriver::ResetStats(void)
+{
+	for(int32 i=0; i<HEADLESS_OP_COUNT; i++)
+	{
+		fCount[i]=0;
+		fTime[i]=0;
+		fPixels[i]=0;
+	}
+}
+
+/*!
+	\brief Prints a report whenever something has been drawn for a while
+	\param data The HeadlessDriver
+*/
+int32 HeadlessDriver::ReporterThread(void *data)
+{
+	HeadlessDriver *driver=(HeadlessDriver*)data;
+	const char *dumpdir=getenv("COSMOE_HEADLESS_DUMP");
+	bigtime_t next=system_time()+HEADLESS_REPORT_INTERVAL;
+	
+	while(!driver->fQuitting)
+	{
+		// wake up often enough to quit quickly
+		snooze(100000);
+		if(system_time()<next)
+			continue;
+		next+=HEADLESS_REPORT_INTERVAL;
+		
+		bool drawn=false;
+		driver->Lock();
+		for(int32 i=0; i<HEADLESS_OP_COUNT; i++)
+			drawn|=(driver->fCount[i]>0);
+		driver->Unlock();
+		
+		if(!drawn)
+			continue;
+		
+		driver->PrintStats();
+		driver->Lock();
+		driver->ResetStats();
+		driver->Unlock();
+		
+		if(dumpdir)
+		{
+			char path[B_PATH_NAME_LENGTH];
+			snprintf(path,sizeof(path),"%s/frame%04ld.png",dumpdir,driver->fDumpIndex++);
+			driver->DumpToFile(path);
+		}
+	}
+	
+	return 0;
+}
+
+//! Adds the time since start to the statistics of a primitive. Called with the lock held.
+void HeadlessDriver::_Count(int32 op, bigtime_t start, const BRect &rect)
+{
+	fTime[op]+=system_time()-start;
+	fPixels[op]+=rect_pixels(rect);
+	fCount[op]++;
+}
+
+void HeadlessDriver::InvertRect(const BRect &r)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::InvertRect(r);
+	_Count(HEADLESS_OP_INVERT_RECT,start,r);
+}
+
+void HeadlessDriver::DrawBitmap(ServerBitmap *bmp, const BRect &src, const BRect &dest, DrawData *d)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::DrawBitmap(bmp,src,dest,d);
+	_Count(HEADLESS_OP_DRAW_BITMAP,start,dest);
+}
+
+bool HeadlessDriver::AcquireBuffer(FBBitmap *bmp)
+{
+	fBufferStart=system_time();
+	return BitmapDriver::AcquireBuffer(bmp);
+}
+
+void HeadlessDriver::ReleaseBuffer(void)
+{
+	BitmapDriver::ReleaseBuffer();
+	_Count(HEADLESS_OP_BUFFER_ACCESS,fBufferStart,BRect());
+}
+
+void HeadlessDriver::Blit(const BRect &src, const BRect &dest, const DrawData *d)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::Blit(src,dest,d);
+	_Count(HEADLESS_OP_BLIT,start,dest);
+}
+
+void HeadlessDriver::FillSolidRect(const BRect &rect, const RGBColor &color)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::FillSolidRect(rect,color);
+	_Count(HEADLESS_OP_FILL_RECT,start,rect);
+}
+
+void HeadlessDriver::FillPatternRect(const BRect &rect, const DrawData *d)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::FillPatternRect(rect,d);
+	_Count(HEADLESS_OP_FILL_PATTERN,start,rect);
+}
+
+void HeadlessDriver::StrokeSolidLine(int32 x1, int32 y1, int32 x2, int32 y2, const RGBColor &color)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::StrokeSolidLine(x1,y1,x2,y2,color);
+	_Count(HEADLESS_OP_STROKE_LINE,start,BRect(0,0,max_c(abs(x2-x1),abs(y2-y1)),0));
+}
+
+void HeadlessDriver::StrokePatternLine(int32 x1, int32 y1, int32 x2, int32 y2, const DrawData *d)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::StrokePatternLine(x1,y1,x2,y2,d);
+	_Count(HEADLESS_OP_STROKE_PATTERN,start,BRect(0,0,max_c(abs(x2-x1),abs(y2-y1)),0));
+}
+
+void HeadlessDriver::StrokeSolidRect(const BRect &rect, const RGBColor &color)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::StrokeSolidRect(rect,color);
+	_Count(HEADLESS_OP_STROKE_RECT,start,BRect(0,0,2*(rect.IntegerWidth()+rect.IntegerHeight()),0));
+}
+
+void HeadlessDriver::CopyBitmap(ServerBitmap *bitmap, const BRect &source, const BRect &dest, const DrawData *d)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::CopyBitmap(bitmap,source,dest,d);
+	_Count(HEADLESS_OP_COPY_BITMAP,start,source);
+}
+
+void HeadlessDriver::CopyToBitmap(ServerBitmap *target, const BRect &source)
+{
+	bigtime_t start=system_time();
+	BitmapDriver::CopyToBitmap(target,source);
+	_Count(HEADLESS_OP_COPY_TO_BITMAP,start,source);
+}
@@ -0,0 +1,108 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, Haiku, Inc.
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		headlessdriver.h
+//	Author:			Cosmoe Project
+//	Description:	Display driver which renders into memory only
+//
+//------------------------------------------------------------------------------
+
+#ifndef __HEADLESSDRIVER_H__
+#define __HEADLESSDRIVER_H__
+
+#include "BitmapDriver.h"
+
+//! The primitives whose time is measured by the HeadlessDriver
+enum
+{
+	HEADLESS_OP_FILL_RECT=0,
+	HEADLESS_OP_FILL_PATTERN,
+	HEADLESS_OP_STROKE_LINE,
+	HEADLESS_OP_STROKE_PATTERN,
+	HEADLESS_OP_STROKE_RECT,
+	HEADLESS_OP_INVERT_RECT,
+	HEADLESS_OP_BLIT,
+	HEADLESS_OP_COPY_BITMAP,
+	HEADLESS_OP_COPY_TO_BITMAP,
+	HEADLESS_OP_DRAW_BITMAP,
+	HEADLESS_OP_BUFFER_ACCESS,
+	HEADLESS_OP_COUNT
+};
+
+/*!
+	\class HeadlessDriver headlessdriver.h
+	\brief Display driver which renders into memory only
+	
+	The screen is a UtilityBitmap which is never shown anywhere, so the server 
+	can run without a display. There is no input either. The driver measures 
+	how long each primitive takes and prints a report every 
+	HEADLESS_REPORT_INTERVAL microseconds in which something was drawn. If the 
+	COSMOE_HEADLESS_DUMP environment variable names a directory, a PNG of the 
+	screen is saved there with every report.
+	
+	The driver is picked when Cosmoe is configured with --enable-headless, or 
+	when the app_server is started with --headless.
+*/
+class HeadlessDriver : public BitmapDriver
+{
+public:
+					HeadlessDriver(void);
+	virtual			~HeadlessDriver(void);
+
+	bool			Initialize(void);
+	void			Shutdown(void);
+
+	virtual void	InvertRect(const BRect &r);
+	virtual void	DrawBitmap(ServerBitmap *bmp, const BRect &src, const BRect &dest, DrawData *d);
+	virtual bool	DumpToFile(const char *path);
+	
+	void			PrintStats(void);
+	void			ResetStats(void);
+
+protected:
+	virtual bool AcquireBuffer(FBBitmap *bmp);
+	virtual void ReleaseBuffer(void);
+
+	virtual void Blit(const BRect &src, const BRect &dest, const DrawData *d);
+	virtual void FillSolidRect(const BRect &rect, const RGBColor &color);
+	virtual void FillPatternRect(const BRect &rect, const DrawData *d);
+	virtual void StrokeSolidLine(int32 x1, int32 y1, int32 x2, int32 y2, const RGBColor &color);
+	virtual void StrokePatternLine(int32 x1, int32 y1, int32 x2, int32 y2, const DrawData *d);
+	virtual void StrokeSolidRect(const BRect &rect, const RGBColor &color);
+	virtual void CopyBitmap(ServerBitmap *bitmap, const BRect &source, const BRect &dest, const DrawData *d);
+	virtual void CopyToBitmap(ServerBitmap *target, const BRect &source);
+
+private:
+	static int32	ReporterThread(void *data);
+	void			_Count(int32 op, bigtime_t start, const BRect &rect);
+
+	int32			fCount[HEADLESS_OP_COUNT];
+	bigtime_t		fTime[HEADLESS_OP_COUNT];
+	int64			fPixels[HEADLESS_OP_COUNT];
+	bigtime_t		fBufferStart;
+	
+	UtilityBitmap	*fScreen;
+	thread_id		fReporterThread;
+	volatile bool	fQuitting;
+	int32			fDumpIndex;
+};
+
+#endif // __HEADLESSDRIVER_H__
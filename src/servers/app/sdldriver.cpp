@@ -106,7 +106,7 @@ void SDLEventTranslator(void *arg)
 					//STRACE("SDLDriver::MouseMoved\n");
 
 					uint32 buttons = 0;
-					int64 time = (int64)real_time_clock();
+					int64 time = system_time();
 
 					driver->serverlink->StartMessage(B_MOUSE_MOVED);
 					driver->serverlink->Attach<int64>(time);
@@ -122,7 +122,7 @@ void SDLEventTranslator(void *arg)
 					uint32 buttons = event.button.button;
 					uint32 clicks = 1;		// can't get the # of clicks without a *lot* of extra work :(
 					uint32 mod = 0;
-					int64 time = (int64)real_time_clock();
+					int64 time = system_time();
 
 					driver->serverlink->StartMessage(B_MOUSE_DOWN);
 					driver->serverlink->Attach<int64>(time);
@@ -138,7 +138,7 @@ void SDLEventTranslator(void *arg)
 				case SDL_MOUSEBUTTONUP:{
 					STRACE("MouseUp\n");
 					uint32 mod = 0;
-					int64 time = (int64)real_time_clock();
+					int64 time = system_time();
 
 					driver->serverlink->StartMessage(B_MOUSE_UP);
 					driver->serverlink->Attach<int64>(time);
@@ -156,7 +156,7 @@ void SDLEventTranslator(void *arg)
 
 					int32 scancode, repeatcount,modifiers;
 					modifiers = event.key.keysym.mod;
-					int64 time = (int64)real_time_clock();
+					int64 time = system_time();
 					
 					repeatcount = 1;
 					scancode = event.key.keysym.sym;
@@ -183,7 +183,7 @@ void SDLEventTranslator(void *arg)
 					modifiers = event.key.keysym.mod;
 					repeatcount = 1;
 					scancode = event.key.keysym.sym;
-					int64 time = (int64)real_time_clock();
+					int64 time = system_time();
 					
 					driver->serverlink->StartMessage(B_KEY_DOWN);
 					driver->serverlink->Attach<int64>(time);
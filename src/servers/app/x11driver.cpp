@@ -69,6 +69,9 @@ X11Driver::X11Driver(void) : BitmapDriver()
 	STRACE("X11Driver::X11Driver\n");
 
 	drawsem = create_sem(1, "X11 draw semaphore");
+	
+	cursorimage = NULL;
+	cursorimagebits = NULL;
 }
 
 
@@ -76,6 +79,13 @@ X11Driver::~X11Driver()
 {
 	STRACE("X11Driver::~X11Driver\n");
 	delete serverlink;
+	
+	if (cursorimage)
+	{
+		// the bits belong to the CursorHandler
+		cursorimage->data = NULL;
+		XDestroyImage(cursorimage);
+	}
 }
 
 /*!
@@ -105,7 +115,7 @@ void XEventTranslator(void *arg)
 
 				//STRACE("X11Driver::MouseMoved\n");
 				uint32 buttons = 0;
-				int64 time = (int64)real_time_clock();
+				int64 time = system_time();
 
 				driver->serverlink->StartMessage(B_MOUSE_MOVED);
 				driver->serverlink->Attach<int64>(time);
@@ -134,7 +144,7 @@ void XEventTranslator(void *arg)
 				repeatcount = 1;
 				scancode = ((XKeyEvent *)&x_event)->keycode;
 
-				systime=(int64)real_time_clock();
+				systime=system_time();
 				driver->serverlink->StartMessage(B_KEY_DOWN);
 				driver->serverlink->Attach(&systime,sizeof(bigtime_t));
 				driver->serverlink->Attach(scancode);
@@ -160,7 +170,7 @@ void XEventTranslator(void *arg)
 				uint32 buttons = ((XButtonEvent *) &x_event)->button;
 				uint32 clicks = 1;		// can't get the # of clicks without a *lot* of extra work :(
 				uint32 mod = 0;
-				int64 time = (int64)real_time_clock();
+				int64 time = system_time();
 
 				driver->serverlink->StartMessage(B_MOUSE_DOWN);
 				driver->serverlink->Attach<int64>(time);
@@ -176,7 +186,7 @@ void XEventTranslator(void *arg)
 			case ButtonRelease:{
 				STRACE("MouseUp\n");
 				uint32 mod = 0;
-				int64 time = (int64)real_time_clock();
+				int64 time = system_time();
 
 				driver->serverlink->StartMessage(B_MOUSE_UP);
 				driver->serverlink->Attach<int64>(time);
@@ -272,6 +282,10 @@ bool X11Driver::Initialize(void)
 				X11DRIVER_WIDTH, X11DRIVER_HEIGHT);
 	XFlush(display);
 
+	// The cursor is blended in by Invalidate(), so drawing never has to
+	// take it out of the frame buffer and put it back.
+	fCursorHandler->SetComposited(true);
+
 	return true;
 }
 
@@ -389,15 +403,78 @@ void X11Driver::CopyBitmap(ServerBitmap *bitmap, const BRect &sourcerect, const
 void X11Driver::Invalidate(const BRect &r)
 {
 	BRect damage = (r & fTarget->Bounds());
+	BRect cursor;
 
 	STRACE("X11Driver::Invalidate()\n");
 	
+	if (!damage.IsValid())
+		return;
+	
+	Lock();
 	acquire_sem(drawsem);
-	XPutImage(display, xcanvas, image_gc, ximage, damage.left, damage.top,
+	
+	if (fCursorHandler->GetCompositeFrame(&cursor) && damage.Intersects(cursor))
+	{
+		// Put everything but the cursor's area straight from the frame buffer,
+		// and that area from a copy with the cursor blended in. This way the
+		// screen never shows the area without the cursor.
+		BRegion rest(damage);
+		rest.Exclude(cursor);
+		
+		for (int32 i = 0; i < rest.CountRects(); i++)
+		{
+			BRect rect = rest.RectAt(i);
+			XPutImage(display, xcanvas, image_gc, ximage, rect.left, rect.top,
+				rect.left, rect.top, rect.IntegerWidth() + 1, rect.IntegerHeight() + 1);
+		}
+		
+		PutCursor(damage & cursor);
+	}
+	else
+	{
+		XPutImage(display, xcanvas, image_gc, ximage, damage.left, damage.top,
 												  damage.left, damage.top,
 												  damage.IntegerWidth() + 1,
 												  damage.IntegerHeight() + 1);
+	}
+	
 	release_sem(drawsem);
+	Unlock();
+}
+
+/*!
+	\brief Puts a part of the screen with the cursor blended in
+	\param r The area to put. Must be within the cursor's footprint.
+	\note The draw semaphore must be held when you call this
+*/
+void X11Driver::PutCursor(const BRect &r)
+{
+	UtilityBitmap *composite = fCursorHandler->Composite(fTarget, r);
+	
+	if (!composite)
+	{
+		XPutImage(display, xcanvas, image_gc, ximage, r.left, r.top,
+			r.left, r.top, r.IntegerWidth() + 1, r.IntegerHeight() + 1);
+		return;
+	}
+	
+	// The composite bitmap only changes along with the cursor
+	if (composite->Bits() != cursorimagebits)
+	{
+		if (cursorimage)
+		{
+			cursorimage->data = NULL;
+			XDestroyImage(cursorimage);
+		}
+		
+		cursorimagebits = composite->Bits();
+		cursorimage = XCreateImage(display, CopyFromParent, depth, ZPixmap, 0,
+			(char*)cursorimagebits, composite->Width(), composite->Height(),
+			X11DRIVER_DEPTH, composite->BytesPerRow());
+	}
+	
+	XPutImage(display, xcanvas, image_gc, cursorimage, 0, 0, r.left, r.top,
+		r.IntegerWidth() + 1, r.IntegerHeight() + 1);
 }
 
 /*!
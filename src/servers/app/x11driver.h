@@ -68,6 +68,7 @@ private:
 	// This is for drivers which are internally double buffered and calling this will cause the real
 	// framebuffer to be updated
 	virtual void Invalidate(const BRect &r);
+	void PutCursor(const BRect &r);
 	void DrawPixel(int x, int y, const RGBColor &color);
 
 	int							screen;
@@ -83,6 +84,10 @@ private:
 	X11::XSetWindowAttributes	window_attributes;
 	X11::XSizeHints				window_hints;
 	X11::Pixmap					xpixmap;
+	
+	// wraps the CursorHandler's composite bitmap
+	X11::XImage*				cursorimage;
+	uint8*						cursorimagebits;
 
 	sem_id						drawsem;
 
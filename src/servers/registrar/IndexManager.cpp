@@ -0,0 +1,604 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		IndexManager.cpp
+//	Description:	Keeps the indices of the volumes and answers queries.
+//------------------------------------------------------------------------------
+
+#include <errno.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <AppDefs.h>
+#include <fs_query.h>
+#include <Message.h>
+#include <MessageUtils.h>
+#include <NodeMonitor.h>
+#include <RegistrarDefs.h>
+#include <TokenSpace.h>
+
+#include "Debug.h"
+#include "IndexManager.h"
+#include "IndexQuery.h"
+
+/*	Every volume with a directory listed in the roots file is indexed from
+	that directory down; if there's no roots file, the home directory is.
+
+	A query is evaluated when it's opened, and its results are handed out a
+	page at a time, since a message sent through a port can't be larger than
+	a few KB. A live query keeps its predicate, and every change of an entry
+	of its volume is checked against it. An entry that is changed is first
+	removed and then added again, so the removals are held back until the
+	end of a batch of changes, and only those that aren't added again are
+	sent.
+*/
+
+//! Directory the indices and the roots file are kept in
+static const char *kIndexSettingsDirectory
+	= "/boot/home/config/settings/Index";
+//! Results of queries that haven't been read for this long are dropped
+static const bigtime_t kQueryIdleTimeout = 300000000LL;
+//! Bytes of results sent in one reply
+static const size_t kMaxResultPageSize = 2048;
+//! Time a full target port may block the index manager
+static const bigtime_t kSendTimeout = 50000;
+
+//! Message to the index manager to load the indices
+static const uint32 kMsgInit = 'init';
+
+struct query_result {
+	ino_t		directory;
+	ino_t		node;
+	std::string	name;
+};
+
+struct open_query {
+	int32		id;
+	VolumeIndex	*volume;
+	std::vector<query_result> results;
+	size_t		next;
+	bigtime_t	last_used;
+
+	// live queries only
+	IndexQuery	*live;
+	std::string	predicate;
+	port_id		port;
+	int32		token;
+};
+
+/*!
+	\class IndexManager
+	\brief Keeps the indices of the volumes and answers queries.
+
+	The index manager is the registrar side of fs_create_index() and
+	friends, and of BQuery.
+*/
+
+// constructor
+/*!	\brief Creates the index manager. The indices are loaded as soon as it
+		   runs.
+*/
+IndexManager::IndexManager()
+	: BLooper("main_index"),
+	  fVolumes(),
+	  fQueries(),
+	  fNextQueryID(0),
+	  fPendingRemovals()
+{
+	PostMessage(kMsgInit);
+}
+
+// destructor
+/*!	\brief Frees all resources associated with this object.
+*/
+IndexManager::~IndexManager()
+{
+	while (open_query *query = (open_query*)fQueries.ItemAt(0))
+		_DeleteQuery(query);
+	for (int32 i = 0; VolumeIndex *volume = (VolumeIndex*)fVolumes.ItemAt(i);
+			i++)
+		delete volume;
+}
+
+// MessageReceived
+/*!	\brief Overrides the super class version to handle the index specific
+		   messages.
+	\param message The message to be handled
+*/
+void
+IndexManager::MessageReceived(BMessage *message)
+{
+	switch (message->what) {
+		case kMsgInit:
+			_Init();
+			break;
+		case B_REG_CREATE_INDEX:
+			_HandleCreateIndex(message);
+			break;
+		case B_REG_REMOVE_INDEX:
+			_HandleRemoveIndex(message);
+			break;
+		case B_REG_STAT_INDEX:
+			_HandleStatIndex(message);
+			break;
+		case B_REG_OPEN_QUERY:
+			_HandleOpenQuery(message);
+			break;
+		case B_REG_READ_QUERY:
+			_HandleReadQuery(message);
+			break;
+		case B_REG_CLOSE_QUERY:
+			_HandleCloseQuery(message);
+			break;
+		default:
+			BLooper::MessageReceived(message);
+			break;
+	}
+}
+
+// _Init
+/*!	\brief Creates the indices of the volumes listed in the roots file.
+*/
+void
+IndexManager::_Init()
+{
+	std::vector<std::string> roots;
+	std::string rootsPath = std::string(kIndexSettingsDirectory) + "/roots";
+	if (FILE *file = fopen(rootsPath.c_str(), "r")) {
+		char line[B_PATH_NAME_LENGTH];
+		while (fgets(line, sizeof(line), file)) {
+			line[strcspn(line, "\n")] = '\0';
+			if (line[0] == '/')
+				roots.push_back(line);
+		}
+		fclose(file);
+	} else {
+		const char *home = getenv("HOME");
+		roots.push_back(home ? home : "/boot/home");
+	}
+
+	for (size_t i = 0; i < roots.size(); i++) {
+		struct stat st;
+		if (stat(roots[i].c_str(), &st) != 0 || _FindVolume(st.st_dev))
+			continue;
+
+		char storage[B_PATH_NAME_LENGTH];
+		snprintf(storage, sizeof(storage), "%s/%ld", kIndexSettingsDirectory,
+			(long)st.st_dev);
+		VolumeIndex *volume = new VolumeIndex(st.st_dev, roots[i].c_str(),
+			storage, this, this);
+		status_t error = volume->Init();
+		if (error != B_OK) {
+			PRINT(("IndexManager: indexing %s failed: %s\n", roots[i].c_str(),
+				strerror(error)));
+			delete volume;
+			continue;
+		}
+		fVolumes.AddItem(volume);
+	}
+}
+
+// _FindVolume
+//! Returns the index of a volume, \c NULL if it isn't indexed.
+VolumeIndex *
+IndexManager::_FindVolume(dev_t device) const
+{
+	for (int32 i = 0; VolumeIndex *volume = (VolumeIndex*)fVolumes.ItemAt(i);
+			i++) {
+		if (volume->Device() == device)
+			return volume;
+	}
+	return NULL;
+}
+
+// _FindQuery
+//! Returns the open query with the given ID, \c NULL if there's none.
+open_query *
+IndexManager::_FindQuery(int32 id) const
+{
+	for (int32 i = 0; open_query *query = (open_query*)fQueries.ItemAt(i);
+			i++) {
+		if (query->id == id)
+			return query;
+	}
+	return NULL;
+}
+
+// _DeleteQuery
+//! Closes a query.
+void
+IndexManager::_DeleteQuery(open_query *query)
+{
+	for (size_t i = fPendingRemovals.size(); i-- > 0; ) {
+		if (fPendingRemovals[i].query == query)
+			fPendingRemovals.erase(fPendingRemovals.begin() + i);
+	}
+	fQueries.RemoveItem(query);
+	delete query->live;
+	delete query;
+}
+
+// _RemoveIdleQueries
+/*!	\brief Closes the queries whose team has gone without closing them.
+
+	Live queries are closed, when their target port is gone, other queries
+	when they haven't been read for a while.
+*/
+void
+IndexManager::_RemoveIdleQueries()
+{
+	bigtime_t now = system_time();
+	for (int32 i = fQueries.CountItems() - 1; i >= 0; i--) {
+		open_query *query = (open_query*)fQueries.ItemAt(i);
+		port_info info;
+		if (query->live ? get_port_info(query->port, &info) != B_OK
+				: now - query->last_used > kQueryIdleTimeout)
+			_DeleteQuery(query);
+	}
+}
+
+// _ResolveLiveQueries
+/*!	\brief Parses the predicates of the live queries of a volume again,
+		   after its indices have changed.
+
+	Live queries that use an index that's gone stop being live.
+*/
+void
+IndexManager::_ResolveLiveQueries(VolumeIndex *volume)
+{
+	for (int32 i = 0; open_query *query = (open_query*)fQueries.ItemAt(i);
+			i++) {
+		if (query->volume == volume && query->live
+			&& query->live->SetTo(query->predicate.c_str(), volume) != B_OK) {
+			delete query->live;
+			query->live = NULL;
+		}
+	}
+}
+
+// _HandleCreateIndex
+void
+IndexManager::_HandleCreateIndex(BMessage *message)
+{
+	int32 device;
+	const char *name;
+	int32 type;
+	status_t error = B_OK;
+	if (message->FindInt32("device", &device) != B_OK
+		|| message->FindString("name", &name) != B_OK
+		|| message->FindInt32("type", &type) != B_OK)
+		error = B_BAD_VALUE;
+
+	VolumeIndex *volume = NULL;
+	if (error == B_OK) {
+		volume = _FindVolume(device);
+		if (!volume)
+			error = B_UNSUPPORTED;
+	}
+	if (error == B_OK)
+		error = volume->CreateIndex(name, type);
+
+	BMessage reply(B_REG_RESULT);
+	reply.AddInt32("result", error);
+	message->SendReply(&reply);
+}
+
+// _HandleRemoveIndex
+void
+IndexManager::_HandleRemoveIndex(BMessage *message)
+{
+	int32 device;
+	const char *name;
+	status_t error = B_OK;
+	if (message->FindInt32("device", &device) != B_OK
+		|| message->FindString("name", &name) != B_OK)
+		error = B_BAD_VALUE;
+
+	VolumeIndex *volume = NULL;
+	if (error == B_OK) {
+		volume = _FindVolume(device);
+		if (!volume)
+			error = B_UNSUPPORTED;
+	}
+	if (error == B_OK) {
+		error = volume->RemoveIndex(name);
+		if (error == B_OK)
+			_ResolveLiveQueries(volume);
+	}
+
+	BMessage reply(B_REG_RESULT);
+	reply.AddInt32("result", error);
+	message->SendReply(&reply);
+}
+
+// _HandleStatIndex
+void
+IndexManager::_HandleStatIndex(BMessage *message)
+{
+	int32 device;
+	const char *name;
+	status_t error = B_OK;
+	if (message->FindInt32("device", &device) != B_OK
+		|| message->FindString("name", &name) != B_OK)
+		error = B_BAD_VALUE;
+
+	VolumeIndex *volume = NULL;
+	if (error == B_OK) {
+		volume = _FindVolume(device);
+		if (!volume)
+			error = B_UNSUPPORTED;
+	}
+	AttributeIndex *index = NULL;
+	if (error == B_OK) {
+		index = volume->FindIndex(name);
+		if (!index)
+			error = B_ENTRY_NOT_FOUND;
+	}
+
+	BMessage reply(B_REG_RESULT);
+	reply.AddInt32("result", error);
+	if (error == B_OK)
+		reply.AddInt32("type", index->Type());
+	message->SendReply(&reply);
+}
+
+// _HandleOpenQuery
+/*!	\brief Evaluates a query and keeps its results for the client to read.
+*/
+void
+IndexManager::_HandleOpenQuery(BMessage *message)
+{
+	_RemoveIdleQueries();
+
+	int32 device;
+	const char *predicate;
+	int32 flags;
+	status_t error = B_OK;
+	if (message->FindInt32("device", &device) != B_OK
+		|| message->FindString("predicate", &predicate) != B_OK
+		|| message->FindInt32("flags", &flags) != B_OK)
+		error = B_BAD_VALUE;
+
+	VolumeIndex *volume = NULL;
+	if (error == B_OK) {
+		volume = _FindVolume(device);
+		if (!volume)
+			error = B_UNSUPPORTED;
+	}
+
+	IndexQuery *indexQuery = NULL;
+	if (error == B_OK) {
+		indexQuery = new IndexQuery;
+		error = indexQuery->SetTo(predicate, volume);
+	}
+
+	open_query *query = NULL;
+	if (error == B_OK) {
+		query = new open_query;
+		query->id = fNextQueryID++;
+		query->volume = volume;
+		query->next = 0;
+		query->last_used = system_time();
+		query->live = NULL;
+		query->port = -1;
+		query->token = B_NULL_TOKEN;
+
+		std::set<const index_entry*> entries;
+		indexQuery->GetEntries(entries);
+		query->results.reserve(entries.size());
+		for (std::set<const index_entry*>::iterator it = entries.begin();
+				it != entries.end(); ++it) {
+			query_result result;
+			result.directory = (*it)->directory;
+			result.node = (*it)->node;
+			result.name = (*it)->name;
+			query->results.push_back(result);
+		}
+
+		if ((flags & B_LIVE_QUERY)
+			&& message->FindInt32("port", &query->port) == B_OK
+			&& message->FindInt32("token", &query->token) == B_OK) {
+			query->live = indexQuery;
+			query->predicate = predicate;
+			indexQuery = NULL;
+		}
+		fQueries.AddItem(query);
+	}
+	delete indexQuery;
+
+	BMessage reply(B_REG_RESULT);
+	reply.AddInt32("result", error);
+	if (error == B_OK)
+		reply.AddInt32("query", query->id);
+	message->SendReply(&reply);
+}
+
+// _HandleReadQuery
+/*!	\brief Sends the next page of results of a query.
+
+	An empty page means the query has no more results.
+*/
+void
+IndexManager::_HandleReadQuery(BMessage *message)
+{
+	int32 id;
+	open_query *query = NULL;
+	status_t error = B_OK;
+	if (message->FindInt32("query", &id) != B_OK)
+		error = B_BAD_VALUE;
+	if (error == B_OK) {
+		query = _FindQuery(id);
+		if (!query)
+			error = B_BAD_VALUE;
+	}
+
+	BMessage reply(B_REG_RESULT);
+	reply.AddInt32("result", error);
+	if (error == B_OK) {
+		query->last_used = system_time();
+		size_t size = 0;
+		while (query->next < query->results.size()
+			&& size < kMaxResultPageSize) {
+			const query_result &result = query->results[query->next++];
+			reply.AddInt64("directory", result.directory);
+			reply.AddInt64("node", result.node);
+			reply.AddString("name", result.name.c_str());
+			size += 2 * sizeof(int64) + result.name.length() + 1;
+		}
+	}
+	message->SendReply(&reply);
+}
+
+// _HandleCloseQuery
+void
+IndexManager::_HandleCloseQuery(BMessage *message)
+{
+	int32 id;
+	open_query *query = NULL;
+	status_t error = B_OK;
+	if (message->FindInt32("query", &id) != B_OK)
+		error = B_BAD_VALUE;
+	if (error == B_OK) {
+		query = _FindQuery(id);
+		if (!query)
+			error = B_BAD_VALUE;
+	}
+	if (error == B_OK)
+		_DeleteQuery(query);
+
+	BMessage reply(B_REG_RESULT);
+	reply.AddInt32("result", error);
+	message->SendReply(&reply);
+}
+
+// EntryAdded
+/*!	\brief Tells the live queries an entry now satisfies about it, unless
+		   it did so before it was changed.
+*/
+void
+IndexManager::EntryAdded(VolumeIndex *volume, const index_entry *entry)
+{
+	for (int32 i = 0; open_query *query = (open_query*)fQueries.ItemAt(i);
+			i++) {
+		if (query->volume != volume || !query->live
+			|| !query->live->Matches(entry))
+			continue;
+
+		bool unchanged = false;
+		for (size_t k = 0; k < fPendingRemovals.size(); k++) {
+			pending_removal &removal = fPendingRemovals[k];
+			if (removal.query == query && removal.node == entry->node
+				&& removal.directory == entry->directory
+				&& removal.name == entry->name) {
+				fPendingRemovals.erase(fPendingRemovals.begin() + k);
+				unchanged = true;
+				break;
+			}
+		}
+		if (!unchanged) {
+			_SendUpdate(query, B_ENTRY_CREATED, entry->directory, entry->node,
+				entry->name.c_str());
+		}
+	}
+}
+
+// EntryRemoved
+/*!	\brief Remembers the live queries an entry that's removed or changed
+		   satisfied.
+*/
+void
+IndexManager::EntryRemoved(VolumeIndex *volume, const index_entry *entry)
+{
+	for (int32 i = 0; open_query *query = (open_query*)fQueries.ItemAt(i);
+			i++) {
+		if (query->volume != volume || !query->live
+			|| !query->live->Matches(entry))
+			continue;
+
+		pending_removal removal;
+		removal.query = query;
+		removal.directory = entry->directory;
+		removal.node = entry->node;
+		removal.name = entry->name;
+		fPendingRemovals.push_back(removal);
+	}
+}
+
+// EntriesChanged
+/*!	\brief Tells the live queries about the entries that no longer satisfy
+		   them.
+*/
+void
+IndexManager::EntriesChanged(VolumeIndex *volume)
+{
+	// _SendUpdate() may close queries, which drops their removals
+	while (!fPendingRemovals.empty()) {
+		pending_removal removal = fPendingRemovals.front();
+		fPendingRemovals.erase(fPendingRemovals.begin());
+		_SendUpdate(removal.query, B_ENTRY_REMOVED, removal.directory,
+			removal.node, NULL);
+	}
+}
+
+// _SendUpdate
+/*!	\brief Sends a B_QUERY_UPDATE message to the target of a live query.
+
+	If the target is gone, the query stops being live.
+*/
+void
+IndexManager::_SendUpdate(open_query *query, int32 opcode, ino_t directory,
+	ino_t node, const char *name)
+{
+	BMessage message(B_QUERY_UPDATE);
+	message.AddInt32("opcode", opcode);
+	message.AddInt32("device", query->volume->Device());
+	message.AddInt64("directory", directory);
+	message.AddInt64("node", node);
+	if (name)
+		message.AddString("name", name);
+	_set_message_target_(&message, query->token,
+		query->token == B_PREFERRED_TOKEN);
+
+	ssize_t size = message.FlattenedSize();
+	char *buffer = new(std::nothrow) char[size];
+	if (!buffer || message.Flatten(buffer, size) != B_OK) {
+		delete[] buffer;
+		return;
+	}
+	status_t error;
+	do {
+		error = write_port_etc(query->port, message.what, buffer, size,
+			B_RELATIVE_TIMEOUT, kSendTimeout);
+	} while (error == B_INTERRUPTED);
+	delete[] buffer;
+
+	if (error == B_BAD_PORT_ID) {
+		for (size_t i = fPendingRemovals.size(); i-- > 0; ) {
+			if (fPendingRemovals[i].query == query)
+				fPendingRemovals.erase(fPendingRemovals.begin() + i);
+		}
+		delete query->live;
+		query->live = NULL;
+	}
+}
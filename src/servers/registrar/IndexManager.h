@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		IndexManager.h
+//	Description:	Keeps the indices of the volumes and answers queries.
+//------------------------------------------------------------------------------
+
+#ifndef INDEX_MANAGER_H
+#define INDEX_MANAGER_H
+
+#include <string>
+#include <vector>
+
+#include <List.h>
+#include <Looper.h>
+
+#include "VolumeIndex.h"
+
+struct open_query;
+
+class IndexManager : public BLooper, private IndexListener {
+public:
+	IndexManager();
+	virtual ~IndexManager();
+
+	virtual void MessageReceived(BMessage *message);
+
+private:
+	struct pending_removal {
+		open_query	*query;
+		ino_t		directory;
+		ino_t		node;
+		std::string	name;
+	};
+
+	void _Init();
+	VolumeIndex *_FindVolume(dev_t device) const;
+	open_query *_FindQuery(int32 id) const;
+	void _DeleteQuery(open_query *query);
+	void _RemoveIdleQueries();
+	void _ResolveLiveQueries(VolumeIndex *volume);
+
+	void _HandleCreateIndex(BMessage *message);
+	void _HandleRemoveIndex(BMessage *message);
+	void _HandleStatIndex(BMessage *message);
+	void _HandleOpenQuery(BMessage *message);
+	void _HandleReadQuery(BMessage *message);
+	void _HandleCloseQuery(BMessage *message);
+
+	virtual void EntryAdded(VolumeIndex *volume, const index_entry *entry);
+	virtual void EntryRemoved(VolumeIndex *volume, const index_entry *entry);
+	virtual void EntriesChanged(VolumeIndex *volume);
+	void _SendUpdate(open_query *query, int32 opcode, ino_t directory,
+		ino_t node, const char *name);
+
+	BList		fVolumes;
+	BList		fQueries;
+	int32		fNextQueryID;
+	std::vector<pending_removal> fPendingRemovals;
+};
+
+#endif	// INDEX_MANAGER_H
@@ -0,0 +1,671 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		IndexQuery.cpp
+//	Description:	A query predicate, parsed and evaluated against the
+//					indices of a volume.
+//------------------------------------------------------------------------------
+
+#include <ctype.h>
+#include <parsedate.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "IndexQuery.h"
+
+/*	The predicates are those BQuery builds (see QueryPredicate.cpp), or that
+	are written by hand in the same syntax: comparisons of an attribute with
+	a value, combined with "&&", "||" and "!", and grouped by parentheses.
+	String values may be patterns with "*", "?" and "[...]", dates are
+	enclosed in "%", and float and double values may be given as the hex
+	representation of their bits.
+
+	Every attribute in a predicate must be indexed. The entries a query has
+	to look at are taken from the ranges of the indices its comparisons
+	select: of the operands of an "&&" the one with the smaller range is
+	used, of an "||" both. Only if a "!" is in the way, the whole volume is
+	looked at. Every candidate is then checked against the full predicate.
+*/
+
+enum {
+	TERM_AND,
+	TERM_OR,
+	TERM_NOT,
+	TERM_COMPARE,
+};
+
+enum {
+	OP_EQUAL,
+	OP_NOT_EQUAL,
+	OP_LESS,
+	OP_LESS_OR_EQUAL,
+	OP_GREATER,
+	OP_GREATER_OR_EQUAL,
+};
+
+// the cost of looking at the range of a comparison
+enum {
+	COST_EXACT,
+	COST_PREFIX,
+	COST_RANGE,
+	COST_FULL,
+};
+
+struct query_term {
+	query_term(uint32 type)
+		: type(type), left(NULL), right(NULL), op(OP_EQUAL), date(false),
+		  index(NULL), pattern(false) {}
+	~query_term() { delete left; delete right; }
+
+	uint32			type;
+	query_term		*left;
+	query_term		*right;
+
+	std::string		attribute;
+	uint32			op;
+	std::string		raw;		// the value as written
+	bool			date;
+	AttributeIndex	*index;
+	index_value		value;
+	bool			pattern;
+	std::string		prefix;		// the literal start of a pattern
+};
+
+
+// #pragma mark - helper functions
+
+static void
+skip_white_space(const char *&string)
+{
+	while (isspace(*string))
+		string++;
+}
+
+static bool
+is_wildcard(char c)
+{
+	return c == '*' || c == '?' || c == '[';
+}
+
+/*!	\brief Returns whether a string contains unescaped wildcards, and its
+		   literal part before the first of them.
+*/
+static bool
+analyze_pattern(const std::string &pattern, std::string &prefix)
+{
+	prefix.erase();
+	for (size_t i = 0; i < pattern.length(); i++) {
+		if (pattern[i] == '\\' && i + 1 < pattern.length())
+			prefix += pattern[++i];
+		else if (is_wildcard(pattern[i]))
+			return true;
+		else
+			prefix += pattern[i];
+	}
+	return false;
+}
+
+//! Returns a pattern with its escapes removed.
+static std::string
+unescape_pattern(const std::string &pattern)
+{
+	std::string string;
+	for (size_t i = 0; i < pattern.length(); i++) {
+		if (pattern[i] == '\\' && i + 1 < pattern.length())
+			i++;
+		string += pattern[i];
+	}
+	return string;
+}
+
+/*!	\brief Matches a string against a pattern.
+
+	"*" matches any number of characters, "?" exactly one, "[...]" one of
+	the listed characters or ranges ("[^...]" or "[!...]" one that isn't
+	listed), and a backslash takes the following character literally.
+*/
+static bool
+match_pattern(const char *pattern, const char *string)
+{
+	const char *starPattern = NULL;
+	const char *starString = NULL;
+	while (*string) {
+		bool matched = false;
+		switch (*pattern) {
+			case '*':
+				starPattern = ++pattern;
+				starString = string;
+				continue;
+			case '?':
+				matched = true;
+				break;
+			case '[':
+			{
+				const char *p = pattern + 1;
+				bool negate = (*p == '^' || *p == '!');
+				if (negate)
+					p++;
+				bool inSet = false;
+				while (*p && (*p != ']' || p == pattern + 1 + negate)) {
+					char low = *p;
+					if (low == '\\' && p[1])
+						low = *++p;
+					char high = low;
+					if (p[1] == '-' && p[2] && p[2] != ']') {
+						high = p[2];
+						if (high == '\\' && p[3]) {
+							high = p[3];
+							p++;
+						}
+						p += 2;
+					}
+					if (*string >= low && *string <= high)
+						inSet = true;
+					p++;
+				}
+				if (*p != ']')
+					return false;
+				if (inSet != negate) {
+					pattern = p;
+					matched = true;
+				}
+				break;
+			}
+			case '\\':
+				if (pattern[1]) {
+					pattern++;
+					matched = (*pattern == *string);
+					break;
+				}
+				// fall through
+			default:
+				matched = (*pattern == *string);
+				break;
+		}
+		if (matched) {
+			pattern++;
+			string++;
+		} else if (starPattern) {
+			// let the last "*" eat one more character
+			pattern = starPattern;
+			string = ++starString;
+		} else
+			return false;
+	}
+	while (*pattern == '*')
+		pattern++;
+	return *pattern == '\0';
+}
+
+
+// #pragma mark - IndexQuery
+
+/*!
+	\class IndexQuery
+	\brief A query predicate, parsed and evaluated against the indices of a
+		   volume.
+*/
+
+// constructor
+/*!	\brief Creates an uninitialized query.
+*/
+IndexQuery::IndexQuery()
+	: fVolume(NULL),
+	  fRoot(NULL)
+{
+}
+
+// destructor
+/*!	\brief Frees all resources associated with the object.
+*/
+IndexQuery::~IndexQuery()
+{
+	delete fRoot;
+}
+
+// SetTo
+/*!	\brief Parses a predicate.
+
+	The query must be deleted before the volume, or any of the indices
+	used in the predicate are.
+
+	\param predicate The predicate
+	\param volume The volume to evaluate the predicate against
+	\return
+	- \c B_OK: Everything went fine.
+	- \c B_BAD_VALUE: The predicate is invalid, or includes unindexed
+	  attributes.
+*/
+status_t
+IndexQuery::SetTo(const char *predicate, const VolumeIndex *volume)
+{
+	delete fRoot;
+	fRoot = NULL;
+	fVolume = volume;
+	if (!predicate || !volume)
+		return B_BAD_VALUE;
+
+	const char *string = predicate;
+	fRoot = _ParseOr(string);
+	skip_white_space(string);
+	status_t error = (fRoot && *string == '\0' ? B_OK : B_BAD_VALUE);
+	if (error == B_OK)
+		error = _Resolve(fRoot);
+	if (error != B_OK) {
+		delete fRoot;
+		fRoot = NULL;
+	}
+	return error;
+}
+
+// Matches
+/*!	\brief Returns whether an entry satisfies the predicate.
+*/
+bool
+IndexQuery::Matches(const index_entry *entry) const
+{
+	return fRoot && _Matches(fRoot, entry);
+}
+
+// GetEntries
+/*!	\brief Adds the entries of the volume that satisfy the predicate to a set.
+*/
+void
+IndexQuery::GetEntries(std::set<const index_entry*> &entries) const
+{
+	if (!fRoot)
+		return;
+
+	std::set<const query_term*> terms;
+	int32 cost;
+	std::set<const index_entry*> candidates;
+	if (_Plan(fRoot, terms, cost)) {
+		for (std::set<const query_term*>::iterator it = terms.begin();
+				it != terms.end(); ++it)
+			_Collect(*it, candidates);
+	} else {
+		AttributeIndex *index = fVolume->NameIndex();
+		for (AttributeIndex::iterator it = index->Begin(); it != index->End();
+				++it)
+			candidates.insert(*it);
+	}
+
+	for (std::set<const index_entry*>::iterator it = candidates.begin();
+			it != candidates.end(); ++it) {
+		if (_Matches(fRoot, *it))
+			entries.insert(*it);
+	}
+}
+
+// _ParseOr
+query_term *
+IndexQuery::_ParseOr(const char *&string)
+{
+	query_term *term = _ParseAnd(string);
+	while (term) {
+		skip_white_space(string);
+		if (string[0] != '|' || string[1] != '|')
+			break;
+		string += 2;
+		query_term *right = _ParseAnd(string);
+		if (!right) {
+			delete term;
+			return NULL;
+		}
+		query_term *orTerm = new query_term(TERM_OR);
+		orTerm->left = term;
+		orTerm->right = right;
+		term = orTerm;
+	}
+	return term;
+}
+
+// _ParseAnd
+query_term *
+IndexQuery::_ParseAnd(const char *&string)
+{
+	query_term *term = _ParseUnary(string);
+	while (term) {
+		skip_white_space(string);
+		if (string[0] != '&' || string[1] != '&')
+			break;
+		string += 2;
+		query_term *right = _ParseUnary(string);
+		if (!right) {
+			delete term;
+			return NULL;
+		}
+		query_term *andTerm = new query_term(TERM_AND);
+		andTerm->left = term;
+		andTerm->right = right;
+		term = andTerm;
+	}
+	return term;
+}
+
+// _ParseUnary
+query_term *
+IndexQuery::_ParseUnary(const char *&string)
+{
+	skip_white_space(string);
+	if (*string == '!') {
+		string++;
+		query_term *child = _ParseUnary(string);
+		if (!child)
+			return NULL;
+		query_term *notTerm = new query_term(TERM_NOT);
+		notTerm->left = child;
+		return notTerm;
+	}
+	if (*string == '(') {
+		string++;
+		query_term *term = _ParseOr(string);
+		skip_white_space(string);
+		if (term && *string != ')') {
+			delete term;
+			return NULL;
+		}
+		string++;
+		return term;
+	}
+	return _ParseComparison(string);
+}
+
+// _ParseComparison
+query_term *
+IndexQuery::_ParseComparison(const char *&string)
+{
+	query_term *term = new query_term(TERM_COMPARE);
+
+	// attribute
+	while (*string && !isspace(*string) && !strchr("=!<>()", *string)) {
+		if (*string == '\\' && string[1])
+			string++;
+		term->attribute += *string++;
+	}
+	skip_white_space(string);
+
+	// operator
+	if (string[0] == '=') {
+		term->op = OP_EQUAL;
+		string += (string[1] == '=' ? 2 : 1);
+	} else if (string[0] == '!' && string[1] == '=') {
+		term->op = OP_NOT_EQUAL;
+		string += 2;
+	} else if (string[0] == '<') {
+		term->op = (string[1] == '=' ? OP_LESS_OR_EQUAL : OP_LESS);
+		string += (string[1] == '=' ? 2 : 1);
+	} else if (string[0] == '>') {
+		term->op = (string[1] == '=' ? OP_GREATER_OR_EQUAL : OP_GREATER);
+		string += (string[1] == '=' ? 2 : 1);
+	} else {
+		delete term;
+		return NULL;
+	}
+	skip_white_space(string);
+
+	// value
+	if (*string == '"' || *string == '\'' || *string == '%') {
+		char quote = *string++;
+		term->date = (quote == '%');
+		while (*string && *string != quote) {
+			if (*string == '\\' && string[1])
+				string++;
+			term->raw += *string++;
+		}
+		if (*string != quote) {
+			delete term;
+			return NULL;
+		}
+		string++;
+	} else {
+		while (*string && !isspace(*string) && !strchr(")&|", *string))
+			term->raw += *string++;
+		if (term->raw.empty()) {
+			delete term;
+			return NULL;
+		}
+	}
+
+	if (term->attribute.empty()) {
+		delete term;
+		return NULL;
+	}
+	return term;
+}
+
+// _Resolve
+/*!	\brief Looks up the indices of the comparisons and converts their values.
+*/
+status_t
+IndexQuery::_Resolve(query_term *term)
+{
+	if (term->type != TERM_COMPARE) {
+		status_t error = _Resolve(term->left);
+		if (error == B_OK && term->right)
+			error = _Resolve(term->right);
+		return error;
+	}
+
+	term->index = fVolume->FindIndex(term->attribute.c_str());
+	if (!term->index)
+		return B_BAD_VALUE;
+
+	const char *raw = term->raw.c_str();
+	char *end = NULL;
+	index_value &value = term->value;
+	value.kind = term->index->Kind();
+	switch (value.kind) {
+		case INDEX_STRING_VALUE:
+		{
+			// patterns are matched as they are, anything else is compared
+			// without the escapes
+			term->pattern = analyze_pattern(term->raw, term->prefix)
+				&& (term->op == OP_EQUAL || term->op == OP_NOT_EQUAL);
+			value.string_value = term->pattern ? term->raw
+				: unescape_pattern(term->raw);
+			return B_OK;
+		}
+		case INDEX_INT_VALUE:
+			if (term->date) {
+				value.int_value = parsedate(raw, time(NULL));
+				return value.int_value == -1 ? B_BAD_VALUE : B_OK;
+			}
+			value.int_value = strtoll(raw, &end, 0);
+			break;
+		case INDEX_UINT_VALUE:
+			value.uint_value = strtoull(raw, &end, 0);
+			break;
+		case INDEX_FLOAT_VALUE:
+			if (raw[0] == '0' && (raw[1] == 'x' || raw[1] == 'X')) {
+				// the bits of a float or a double, as BQuery sends them
+				uint64 bits = strtoull(raw, &end, 16);
+				if (strlen(raw) <= 10) {
+					uint32 floatBits = bits;
+					float floatValue;
+					memcpy(&floatValue, &floatBits, sizeof(floatValue));
+					value.float_value = floatValue;
+				} else
+					memcpy(&value.float_value, &bits, sizeof(bits));
+			} else
+				value.float_value = strtod(raw, &end);
+			break;
+		default:
+			return B_BAD_VALUE;
+	}
+	return (end && *end == '\0') ? B_OK : B_BAD_VALUE;
+}
+
+// _Matches
+bool
+IndexQuery::_Matches(const query_term *term, const index_entry *entry) const
+{
+	switch (term->type) {
+		case TERM_AND:
+			return _Matches(term->left, entry) && _Matches(term->right, entry);
+		case TERM_OR:
+			return _Matches(term->left, entry) || _Matches(term->right, entry);
+		case TERM_NOT:
+			return !_Matches(term->left, entry);
+	}
+
+	// entries without the attribute never match, like on BFS
+	index_value value;
+	if (!term->index->GetValue(entry, value))
+		return false;
+
+	if (term->pattern) {
+		bool matches = match_pattern(term->value.string_value.c_str(),
+			value.string_value.c_str());
+		return term->op == OP_EQUAL ? matches : !matches;
+	}
+
+	int compare = compare_index_values(value, term->value);
+	switch (term->op) {
+		case OP_EQUAL:
+			return compare == 0;
+		case OP_NOT_EQUAL:
+			return compare != 0;
+		case OP_LESS:
+			return compare < 0;
+		case OP_LESS_OR_EQUAL:
+			return compare <= 0;
+		case OP_GREATER:
+			return compare > 0;
+		case OP_GREATER_OR_EQUAL:
+			return compare >= 0;
+	}
+	return false;
+}
+
+// _Plan
+/*!	\brief Finds the comparisons whose index ranges together cover all
+		   entries that can satisfy a term.
+	\param term The term
+	\param terms Set to the comparisons
+	\param cost Set to the cost of looking at their ranges
+	\return \c false, if there are no such comparisons.
+*/
+bool
+IndexQuery::_Plan(const query_term *term, std::set<const query_term*> &terms,
+	int32 &cost) const
+{
+	switch (term->type) {
+		case TERM_AND:
+		{
+			std::set<const query_term*> leftTerms, rightTerms;
+			int32 leftCost, rightCost;
+			bool left = _Plan(term->left, leftTerms, leftCost);
+			bool right = _Plan(term->right, rightTerms, rightCost);
+			if (left && (!right || leftCost <= rightCost)) {
+				terms = leftTerms;
+				cost = leftCost;
+				return true;
+			}
+			if (right) {
+				terms = rightTerms;
+				cost = rightCost;
+				return true;
+			}
+			return false;
+		}
+		case TERM_OR:
+		{
+			std::set<const query_term*> rightTerms;
+			int32 rightCost;
+			if (!_Plan(term->left, terms, cost)
+				|| !_Plan(term->right, rightTerms, rightCost))
+				return false;
+			terms.insert(rightTerms.begin(), rightTerms.end());
+			cost = max_c(cost, rightCost);
+			return true;
+		}
+		case TERM_NOT:
+			return false;
+	}
+
+	terms.clear();
+	terms.insert(term);
+	switch (term->op) {
+		case OP_EQUAL:
+			if (!term->pattern)
+				cost = COST_EXACT;
+			else
+				cost = term->prefix.empty() ? COST_FULL : COST_PREFIX;
+			break;
+		case OP_NOT_EQUAL:
+			cost = COST_FULL;
+			break;
+		default:
+			cost = COST_RANGE;
+			break;
+	}
+	return true;
+}
+
+// _Collect
+/*!	\brief Adds the entries in the index range of a comparison to a set.
+*/
+void
+IndexQuery::_Collect(const query_term *term,
+	std::set<const index_entry*> &entries) const
+{
+	const AttributeIndex *index = term->index;
+	AttributeIndex::iterator first = index->Begin();
+	AttributeIndex::iterator last = index->End();
+	switch (term->op) {
+		case OP_EQUAL:
+			if (!term->pattern) {
+				first = index->LowerBound(term->value);
+				last = index->UpperBound(term->value);
+			} else if (!term->prefix.empty()) {
+				index_value prefix;
+				prefix.kind = INDEX_STRING_VALUE;
+				prefix.string_value = term->prefix;
+				index_value value;
+				for (first = index->LowerBound(prefix); first != last;
+						++first) {
+					index->GetValue(*first, value);
+					if (value.string_value.compare(0, term->prefix.length(),
+							term->prefix) != 0)
+						break;
+					entries.insert(*first);
+				}
+				return;
+			}
+			break;
+		case OP_LESS:
+			last = index->LowerBound(term->value);
+			break;
+		case OP_LESS_OR_EQUAL:
+			last = index->UpperBound(term->value);
+			break;
+		case OP_GREATER:
+			first = index->UpperBound(term->value);
+			break;
+		case OP_GREATER_OR_EQUAL:
+			first = index->LowerBound(term->value);
+			break;
+	}
+	for (; first != last; ++first)
+		entries.insert(*first);
+}
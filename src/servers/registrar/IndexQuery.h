@@ -0,0 +1,66 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		IndexQuery.h
+//	Description:	A query predicate, parsed and evaluated against the
+//					indices of a volume.
+//------------------------------------------------------------------------------
+
+#ifndef INDEX_QUERY_H
+#define INDEX_QUERY_H
+
+#include <set>
+#include <string>
+
+#include <SupportDefs.h>
+
+#include "VolumeIndex.h"
+
+struct query_term;
+
+class IndexQuery {
+public:
+	IndexQuery();
+	~IndexQuery();
+
+	status_t SetTo(const char *predicate, const VolumeIndex *volume);
+
+	bool Matches(const index_entry *entry) const;
+	void GetEntries(std::set<const index_entry*> &entries) const;
+
+private:
+	query_term *_ParseOr(const char *&string);
+	query_term *_ParseAnd(const char *&string);
+	query_term *_ParseUnary(const char *&string);
+	query_term *_ParseComparison(const char *&string);
+	status_t _Resolve(query_term *term);
+
+	bool _Matches(const query_term *term, const index_entry *entry) const;
+	bool _Plan(const query_term *term, std::set<const query_term*> &terms,
+		int32 &cost) const;
+	void _Collect(const query_term *term,
+		std::set<const index_entry*> &entries) const;
+
+	const VolumeIndex	*fVolume;
+	query_term			*fRoot;
+};
+
+#endif	// INDEX_QUERY_H
@@ -10,6 +10,7 @@
 
 #include "ClipboardHandler.h"
 #include "EventQueue.h"
+#include "IndexManager.h"
 #include "MessageEvent.h"
 #include "MessageRunnerManager.h"
 #include "MIMEManager.h"
@@ -37,6 +38,7 @@ Registrar::Registrar()
 		   fRoster(NULL),
 		   fClipboardHandler(NULL),
 		   fMIMEManager(NULL),
+		   fIndexManager(NULL),
 		   fEventQueue(NULL),
 		   fMessageRunnerManager(NULL),
 		   fSanityEvent(NULL)
@@ -60,6 +62,8 @@ Registrar::~Registrar()
 	delete fSanityEvent;
 	fMIMEManager->Lock();
 	fMIMEManager->Quit();
+	fIndexManager->Lock();
+	fIndexManager->Quit();
 	RemoveHandler(fClipboardHandler);
 	delete fClipboardHandler;
 	delete fRoster;
@@ -89,6 +93,15 @@ Registrar::MessageReceived(BMessage *message)
 			message->SendReply(&reply);
 			break;
 		}
+		case B_REG_GET_INDEX_MESSENGER:
+		{
+			PRINT(("B_REG_GET_INDEX_MESSENGER\n"));
+			BMessenger messenger(NULL, fIndexManager);
+			BMessage reply(B_REG_SUCCESS);
+			reply.AddMessenger("messenger", messenger);
+			message->SendReply(&reply);
+			break;
+		}
 		case B_REG_GET_CLIPBOARD_MESSENGER:
 		{
 			PRINT(("B_REG_GET_CLIPBOARD_MESSENGER\n"));
@@ -216,6 +229,9 @@ Registrar::ReadyToRun()
 	// create MIME manager
 	fMIMEManager = new MIMEManager;
 	fMIMEManager->Run();
+	// create index manager
+	fIndexManager = new IndexManager;
+	fIndexManager->Run();
 	// create message runner manager
 	fMessageRunnerManager = new MessageRunnerManager(fEventQueue);
 	// init the global be_roster
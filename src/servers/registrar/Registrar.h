@@ -31,6 +31,7 @@
 class ClipboardHandler;
 class DiskDeviceManager;
 class EventQueue;
+class IndexManager;
 class MessageEvent;
 class MessageRunnerManager;
 class MIMEManager;
@@ -56,6 +57,7 @@ private:
 	BPrivate::TRoster		*fRoster;
 	ClipboardHandler		*fClipboardHandler;
 	MIMEManager				*fMIMEManager;
+	IndexManager			*fIndexManager;
 	EventQueue				*fEventQueue;
 	MessageRunnerManager	*fMessageRunnerManager;
 	MessageEvent			*fSanityEvent;
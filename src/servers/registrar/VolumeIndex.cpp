@@ -0,0 +1,1482 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		VolumeIndex.cpp
+//	Description:	The entries of an indexed volume and the attribute indices
+//					on them.
+//------------------------------------------------------------------------------
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include <Directory.h>
+#include <fs_attr.h>
+#include <Looper.h>
+#include <Mime.h>
+#include <TypeConstants.h>
+
+#include "Debug.h"
+#include "VolumeIndex.h"
+
+/*	A volume is indexed from a root directory down, without crossing into
+	other volumes. Every entry below the root is kept in memory with its
+	name, size, modification time and the values of the attributes that are
+	indexed, and every index is a set of those entries ordered by its value,
+	so a query can walk the part of an index it's interested in instead of
+	the volume.
+
+	On disk, the entries of a volume are kept in a sorted base file and a
+	journal of the changes made since it was written, which is merged into
+	a new base file once it has grown to a fair share of it. When the
+	registrar starts, only directories whose modification time differs from
+	the one they were last read at are read again; the other entries are
+	just checked for a changed ctime.
+
+	While the registrar runs, every directory is watched with inotify, and
+	a thread of the index feeds the changes into it with the owner locked.
+	If a directory can't be watched, usually because the inotify watches of
+	the user are used up, the thread checks the whole volume every few
+	seconds instead, until all directories are watched again.
+*/
+
+//! Magic of the base file of a volume index
+static const uint32 kIndexMagic = 'CQIX';
+//! Version of the base file format
+static const uint32 kIndexVersion = 1;
+//! The journal is merged into the base file when it has more records than
+//! this and more than a quarter of the entries
+static const int32 kMinCompactRecords = 4096;
+//! Size of the buffer events are read into
+static const size_t kEventBufferSize = 32768;
+//! Time to wait for more events after the first one of a batch
+static const int kCoalesceTimeout = 50;		// milliseconds
+//! How often the volume is scanned while some directories aren't watched
+static const bigtime_t kRescanInterval = 10000000;
+//! The events of a directory the index is interested in
+static const uint32 kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM
+	| IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE | IN_ONLYDIR | IN_DONT_FOLLOW;
+//! Attribute values are indexed up to this length, like on BFS
+static const size_t kMaxIndexKeyLength = 255;
+
+// journal operations
+enum {
+	JOURNAL_ADD		= '+',
+	JOURNAL_REMOVE	= '-',
+};
+
+// built-in index fields
+enum {
+	FIELD_NONE = -1,
+	FIELD_NAME,
+	FIELD_SIZE,
+	FIELD_LAST_MODIFIED,
+};
+
+
+// #pragma mark - helper functions
+
+static bigtime_t
+nanoseconds(const struct timespec &time)
+{
+	return (bigtime_t)time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+static void
+write_data(std::string &buffer, const void *data, size_t size)
+{
+	buffer.append((const char*)data, size);
+}
+
+static void
+write_int64(std::string &buffer, int64 value)
+{
+	write_data(buffer, &value, sizeof(value));
+}
+
+static void
+write_uint32(std::string &buffer, uint32 value)
+{
+	write_data(buffer, &value, sizeof(value));
+}
+
+static void
+write_string(std::string &buffer, const std::string &string)
+{
+	uint16 length = string.length();
+	write_data(buffer, &length, sizeof(length));
+	buffer.append(string, 0, length);
+}
+
+static void
+write_value(std::string &buffer, const index_value &value)
+{
+	write_uint32(buffer, value.kind);
+	switch (value.kind) {
+		case INDEX_STRING_VALUE:
+			write_string(buffer, value.string_value);
+			break;
+		case INDEX_INT_VALUE:
+			write_int64(buffer, value.int_value);
+			break;
+		case INDEX_UINT_VALUE:
+			write_data(buffer, &value.uint_value, sizeof(value.uint_value));
+			break;
+		case INDEX_FLOAT_VALUE:
+			write_data(buffer, &value.float_value, sizeof(value.float_value));
+			break;
+	}
+}
+
+static void
+write_entry(std::string &buffer, const index_entry *entry)
+{
+	write_int64(buffer, entry->node);
+	write_int64(buffer, entry->directory);
+	write_int64(buffer, entry->size);
+	write_int64(buffer, entry->modified);
+	write_int64(buffer, entry->changed);
+	write_int64(buffer, entry->listed);
+	buffer += (char)entry->is_directory;
+	write_string(buffer, entry->name);
+	write_uint32(buffer, entry->attributes.size());
+	for (std::map<std::string, index_value>::const_iterator it
+			= entry->attributes.begin(); it != entry->attributes.end(); ++it) {
+		write_string(buffer, it->first);
+		write_value(buffer, it->second);
+	}
+}
+
+/*!	\brief Reads the records of a base or journal file.
+
+	Reading past the end of the data sets the failed flag, and all further
+	reads return nothing, so a torn record at the end of a journal just ends
+	it.
+*/
+struct record_reader {
+	record_reader(const std::string &data)
+		: data(data), offset(0), failed(false) {}
+
+	bool Read(void *buffer, size_t size)
+	{
+		if (failed || data.length() - offset < size) {
+			failed = true;
+			memset(buffer, 0, size);
+			return false;
+		}
+		memcpy(buffer, data.data() + offset, size);
+		offset += size;
+		return true;
+	}
+
+	bool AtEnd() const { return failed || offset >= data.length(); }
+
+	int64 Int64() { int64 value; Read(&value, sizeof(value)); return value; }
+	uint32 UInt32() { uint32 value; Read(&value, sizeof(value)); return value; }
+	uint8 UInt8() { uint8 value; Read(&value, sizeof(value)); return value; }
+
+	std::string String()
+	{
+		uint16 length;
+		if (!Read(&length, sizeof(length)) || data.length() - offset < length) {
+			failed = true;
+			return std::string();
+		}
+		offset += length;
+		return data.substr(offset - length, length);
+	}
+
+	bool Value(index_value &value)
+	{
+		value.kind = UInt32();
+		switch (value.kind) {
+			case INDEX_STRING_VALUE:
+				value.string_value = String();
+				break;
+			case INDEX_INT_VALUE:
+				value.int_value = Int64();
+				break;
+			case INDEX_UINT_VALUE:
+				Read(&value.uint_value, sizeof(value.uint_value));
+				break;
+			case INDEX_FLOAT_VALUE:
+				Read(&value.float_value, sizeof(value.float_value));
+				break;
+			default:
+				failed = true;
+				break;
+		}
+		return !failed;
+	}
+
+	index_entry *Entry()
+	{
+		index_entry *entry = new index_entry;
+		entry->node = Int64();
+		entry->directory = Int64();
+		entry->size = Int64();
+		entry->modified = Int64();
+		entry->changed = Int64();
+		entry->listed = Int64();
+		entry->is_directory = UInt8() != 0;
+		entry->name = String();
+		uint32 count = UInt32();
+		for (uint32 i = 0; i < count && !failed; i++) {
+			std::string name = String();
+			Value(entry->attributes[name]);
+		}
+		if (failed) {
+			delete entry;
+			return NULL;
+		}
+		return entry;
+	}
+
+	const std::string	&data;
+	size_t				offset;
+	bool				failed;
+};
+
+static status_t
+read_file(const std::string &path, std::string &data)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return errno;
+	char buffer[65536];
+	ssize_t bytes;
+	while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
+		data.append(buffer, bytes);
+	close(fd);
+	return bytes < 0 ? errno : B_OK;
+}
+
+static status_t
+write_file(const std::string &path, const std::string &data, int flags)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | flags, 0644);
+	if (fd < 0)
+		return errno;
+	status_t error = B_OK;
+	size_t written = 0;
+	while (written < data.length()) {
+		ssize_t bytes = write(fd, data.data() + written,
+			data.length() - written);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+			error = errno;
+			break;
+		}
+		written += bytes;
+	}
+	close(fd);
+	return error;
+}
+
+// index_value_kind
+/*!	\brief Returns the kind of index values an attribute type maps to.
+	\param type The attribute type
+	\return The kind, \c INDEX_INVALID_VALUE if the type can't be indexed.
+*/
+uint32
+index_value_kind(uint32 type)
+{
+	switch (type) {
+		case B_STRING_TYPE:
+		case B_MIME_STRING_TYPE:
+			return INDEX_STRING_VALUE;
+		case B_INT8_TYPE:
+		case B_INT16_TYPE:
+		case B_INT32_TYPE:
+		case B_INT64_TYPE:
+		case B_OFF_T_TYPE:
+		case B_SSIZE_T_TYPE:
+		case B_TIME_TYPE:
+			return INDEX_INT_VALUE;
+		case B_UINT8_TYPE:
+		case B_UINT16_TYPE:
+		case B_UINT32_TYPE:
+		case B_UINT64_TYPE:
+		case B_SIZE_T_TYPE:
+		case B_BOOL_TYPE:
+			return INDEX_UINT_VALUE;
+		case B_FLOAT_TYPE:
+		case B_DOUBLE_TYPE:
+			return INDEX_FLOAT_VALUE;
+	}
+	return INDEX_INVALID_VALUE;
+}
+
+// compare_index_values
+/*!	\brief Compares two index values of the same kind.
+	\return A negative number, 0, or a positive number, if \a a is less
+			than, equal to, or greater than \a b.
+*/
+int
+compare_index_values(const index_value &a, const index_value &b)
+{
+	switch (a.kind) {
+		case INDEX_STRING_VALUE:
+			return a.string_value.compare(b.string_value);
+		case INDEX_INT_VALUE:
+			return a.int_value < b.int_value ? -1
+				: (a.int_value > b.int_value ? 1 : 0);
+		case INDEX_UINT_VALUE:
+			return a.uint_value < b.uint_value ? -1
+				: (a.uint_value > b.uint_value ? 1 : 0);
+		case INDEX_FLOAT_VALUE:
+			return a.float_value < b.float_value ? -1
+				: (a.float_value > b.float_value ? 1 : 0);
+	}
+	return 0;
+}
+
+/*!	\brief Turns the raw value of an attribute into an index value.
+	\return \c true, if the attribute has the size its type calls for.
+*/
+static bool
+convert_attribute(uint32 type, const char *buffer, ssize_t size,
+	index_value &value)
+{
+	value.kind = index_value_kind(type);
+	switch (type) {
+		case B_STRING_TYPE:
+		case B_MIME_STRING_TYPE:
+			value.string_value.assign(buffer, strnlen(buffer, size));
+			return true;
+		case B_INT8_TYPE:
+			value.int_value = *(const int8*)buffer;
+			return size == sizeof(int8);
+		case B_INT16_TYPE:
+			value.int_value = *(const int16*)buffer;
+			return size == sizeof(int16);
+		case B_INT32_TYPE:
+			value.int_value = *(const int32*)buffer;
+			return size == sizeof(int32);
+		case B_INT64_TYPE:
+		case B_OFF_T_TYPE:
+			value.int_value = *(const int64*)buffer;
+			return size == sizeof(int64);
+		case B_SSIZE_T_TYPE:
+			value.int_value = *(const ssize_t*)buffer;
+			return size == sizeof(ssize_t);
+		case B_TIME_TYPE:
+			value.int_value = *(const time_t*)buffer;
+			return size == sizeof(time_t);
+		case B_UINT8_TYPE:
+		case B_BOOL_TYPE:
+			value.uint_value = *(const uint8*)buffer;
+			return size == sizeof(uint8);
+		case B_UINT16_TYPE:
+			value.uint_value = *(const uint16*)buffer;
+			return size == sizeof(uint16);
+		case B_UINT32_TYPE:
+			value.uint_value = *(const uint32*)buffer;
+			return size == sizeof(uint32);
+		case B_UINT64_TYPE:
+			value.uint_value = *(const uint64*)buffer;
+			return size == sizeof(uint64);
+		case B_SIZE_T_TYPE:
+			value.uint_value = *(const size_t*)buffer;
+			return size == sizeof(size_t);
+		case B_FLOAT_TYPE:
+			value.float_value = *(const float*)buffer;
+			return size == sizeof(float);
+		case B_DOUBLE_TYPE:
+			value.float_value = *(const double*)buffer;
+			return size == sizeof(double);
+	}
+	return false;
+}
+
+
+// #pragma mark - AttributeIndex
+
+/*!
+	\class AttributeIndex
+	\brief The entries of a volume that have a value for an attribute,
+		   ordered by it.
+
+	"name", "size" and "last_modified" are built into every volume, and
+	are taken from the entries themselves; other indices are declared with
+	fs_create_index() and take their values from the entries' attributes.
+*/
+
+// constructor
+/*!	\brief Creates an empty index.
+	\param name The name of the attribute
+	\param type The type of the attribute
+*/
+AttributeIndex::AttributeIndex(const char *name, uint32 type)
+	: fName(name),
+	  fType(type),
+	  fKind(index_value_kind(type)),
+	  fField(FIELD_NONE),
+	  fEntries(value_less(this))
+{
+	if (fName == "name")
+		fField = FIELD_NAME;
+	else if (fName == "size")
+		fField = FIELD_SIZE;
+	else if (fName == "last_modified")
+		fField = FIELD_LAST_MODIFIED;
+}
+
+// Name
+//! Returns the name of the indexed attribute.
+const char *
+AttributeIndex::Name() const
+{
+	return fName.c_str();
+}
+
+// Type
+//! Returns the type of the indexed attribute.
+uint32
+AttributeIndex::Type() const
+{
+	return fType;
+}
+
+// Kind
+//! Returns the kind of values the index is ordered by.
+uint32
+AttributeIndex::Kind() const
+{
+	return fKind;
+}
+
+// IsBuiltIn
+//! Returns whether the index is one every volume has.
+bool
+AttributeIndex::IsBuiltIn() const
+{
+	return fField != FIELD_NONE;
+}
+
+// GetValue
+/*!	\brief Returns the value of an entry in this index.
+	\param entry The entry
+	\param value Set to the entry's value
+	\return \c true, if the entry has a value, \c false otherwise.
+*/
+bool
+AttributeIndex::GetValue(const index_entry *entry, index_value &value) const
+{
+	switch (fField) {
+		case FIELD_NAME:
+			value.kind = INDEX_STRING_VALUE;
+			value.string_value = entry->name;
+			return true;
+		case FIELD_SIZE:
+			value.kind = INDEX_INT_VALUE;
+			value.int_value = entry->size;
+			return true;
+		case FIELD_LAST_MODIFIED:
+			value.kind = INDEX_INT_VALUE;
+			value.int_value = entry->modified;
+			return true;
+	}
+
+	std::map<std::string, index_value>::const_iterator it
+		= entry->attributes.find(fName);
+	if (it == entry->attributes.end() || it->second.kind != fKind)
+		return false;
+	value = it->second;
+	return true;
+}
+
+// value_less
+bool
+AttributeIndex::value_less::operator()(const index_entry *a,
+	const index_entry *b) const
+{
+	// the built-in fields are compared without copying them
+	switch (index->fField) {
+		case FIELD_NAME:
+			return a->name < b->name;
+		case FIELD_SIZE:
+			return a->size < b->size;
+		case FIELD_LAST_MODIFIED:
+			return a->modified < b->modified;
+	}
+	std::map<std::string, index_value>::const_iterator valueA
+		= a->attributes.find(index->fName);
+	std::map<std::string, index_value>::const_iterator valueB
+		= b->attributes.find(index->fName);
+	return compare_index_values(valueA->second, valueB->second) < 0;
+}
+
+// Insert
+/*!	\brief Adds an entry to the index, if it has a value for it.
+	\param entry The entry
+*/
+void
+AttributeIndex::Insert(index_entry *entry)
+{
+	index_value value;
+	if (GetValue(entry, value))
+		fEntries.insert(entry);
+}
+
+// Remove
+/*!	\brief Removes an entry from the index.
+
+	The entry must still have the value it was inserted with.
+
+	\param entry The entry
+*/
+void
+AttributeIndex::Remove(index_entry *entry)
+{
+	index_value value;
+	if (!GetValue(entry, value))
+		return;
+	std::pair<entry_set::iterator, entry_set::iterator> range
+		= fEntries.equal_range(entry);
+	for (entry_set::iterator it = range.first; it != range.second; ++it) {
+		if (*it == entry) {
+			fEntries.erase(it);
+			break;
+		}
+	}
+}
+
+// Begin
+//! Returns an iterator to the entry with the lowest value.
+AttributeIndex::iterator
+AttributeIndex::Begin() const
+{
+	return fEntries.begin();
+}
+
+// End
+//! Returns an iterator past the entry with the highest value.
+AttributeIndex::iterator
+AttributeIndex::End() const
+{
+	return fEntries.end();
+}
+
+// LowerBound
+/*!	\brief Returns an iterator to the first entry whose value is not less
+		   than the given one.
+*/
+AttributeIndex::iterator
+AttributeIndex::LowerBound(const index_value &value) const
+{
+	_SetProbe(value);
+	return fEntries.lower_bound(&fProbe);
+}
+
+// UpperBound
+/*!	\brief Returns an iterator to the first entry whose value is greater
+		   than the given one.
+*/
+AttributeIndex::iterator
+AttributeIndex::UpperBound(const index_value &value) const
+{
+	_SetProbe(value);
+	return fEntries.upper_bound(&fProbe);
+}
+
+// _SetProbe
+//! Sets up the entry the index is searched with.
+void
+AttributeIndex::_SetProbe(const index_value &value) const
+{
+	switch (fField) {
+		case FIELD_NAME:
+			fProbe.name = value.string_value;
+			break;
+		case FIELD_SIZE:
+			fProbe.size = value.int_value;
+			break;
+		case FIELD_LAST_MODIFIED:
+			fProbe.modified = value.int_value;
+			break;
+		default:
+			fProbe.attributes[fName] = value;
+			break;
+	}
+}
+
+
+// #pragma mark - IndexListener
+
+/*!
+	\class IndexListener
+	\brief Is told about the entries of a volume index that change.
+
+	EntryRemoved() is called before an entry is removed or replaced,
+	EntryAdded() after an entry has been added or replaced, and
+	EntriesChanged() after a batch of changes. The owner of the index is
+	locked during all of them.
+*/
+
+// destructor
+IndexListener::~IndexListener()
+{
+}
+
+
+// #pragma mark - VolumeIndex
+
+/*!
+	\class VolumeIndex
+	\brief The indexed entries of a volume.
+*/
+
+// constructor
+/*!	\brief Creates a volume index. Init() has to be called before it's used.
+	\param device The volume
+	\param root The directory the volume is indexed from
+	\param storage The directory the index is stored in
+	\param owner The looper locked while the index is changed
+	\param listener The object to tell about changed entries
+*/
+VolumeIndex::VolumeIndex(dev_t device, const char *root, const char *storage,
+	BLooper *owner, IndexListener *listener)
+	: fDevice(device),
+	  fRoot(root),
+	  fRootNode(-1),
+	  fRootListed(0),
+	  fStorage(storage),
+	  fStorageNode(-1),
+	  fOwner(owner),
+	  fListener(listener),
+	  fIndices(),
+	  fNameIndex(NULL),
+	  fEntries(),
+	  fDirectories(),
+	  fWatches(),
+	  fFD(-1),
+	  fThread(-1),
+	  fQuitting(false),
+	  fLoading(false),
+	  fUnwatched(false),
+	  fNextRescan(0),
+	  fJournal(),
+	  fJournalRecords(0)
+{
+	while (fRoot.length() > 1 && fRoot[fRoot.length() - 1] == '/')
+		fRoot.erase(fRoot.length() - 1);
+	fNameIndex = new AttributeIndex("name", B_STRING_TYPE);
+	fIndices.AddItem(fNameIndex);
+	fIndices.AddItem(new AttributeIndex("size", B_INT64_TYPE));
+	fIndices.AddItem(new AttributeIndex("last_modified", B_INT32_TYPE));
+}
+
+// destructor
+/*!	\brief Stops watching the volume, writes the journal and frees the
+		   index. The owner must be locked.
+*/
+VolumeIndex::~VolumeIndex()
+{
+	fQuitting = true;
+	if (fThread >= 0) {
+		status_t result;
+		wait_for_thread(fThread, &result);
+	}
+	if (fFD >= 0)
+		close(fFD);
+	_FlushJournal();
+
+	for (entry_map::iterator it = fEntries.begin(); it != fEntries.end(); ++it)
+		delete it->second;
+	for (int32 i = 0; AttributeIndex *index = IndexAt(i); i++)
+		delete index;
+}
+
+// Init
+/*!	\brief Loads the stored index, brings it up to date and starts watching
+		   the volume.
+	\return \c B_OK, if everything went fine, another error code otherwise.
+*/
+status_t
+VolumeIndex::Init()
+{
+	struct stat st;
+	if (lstat(fRoot.c_str(), &st) != 0)
+		return errno;
+	if (!S_ISDIR(st.st_mode) || st.st_dev != fDevice)
+		return B_BAD_VALUE;
+
+	status_t error = create_directory(fStorage.c_str(), 0755);
+	if (error != B_OK)
+		return error;
+	// the index must not watch itself being written
+	struct stat storageStat;
+	if (stat(fStorage.c_str(), &storageStat) == 0)
+		fStorageNode = storageStat.st_ino;
+
+	fFD = inotify_init();
+	if (fFD < 0)
+		return errno;
+
+	_LoadIndices();
+
+	fLoading = true;
+	if (_Load() != B_OK || fRootNode != st.st_ino) {
+		// start over
+		for (entry_map::iterator it = fEntries.begin(); it != fEntries.end();
+				++it) {
+			for (int32 i = 0; AttributeIndex *index = IndexAt(i); i++)
+				index->Remove(it->second);
+			delete it->second;
+		}
+		fEntries.clear();
+		fRootNode = st.st_ino;
+		fRootListed = 0;
+	}
+	_SyncDirectory(fRootNode, -1, std::string(), fRoot, false);
+	fLoading = false;
+
+	// the reconciled index becomes the new base
+	error = _Compact();
+	if (error != B_OK)
+		return error;
+
+	fThread = spawn_thread(_WatcherThread, "index watcher", B_LOW_PRIORITY,
+		this);
+	if (fThread < 0)
+		return fThread;
+	return resume_thread(fThread);
+}
+
+// Device
+//! Returns the indexed volume.
+dev_t
+VolumeIndex::Device() const
+{
+	return fDevice;
+}
+
+// Root
+//! Returns the path of the directory the volume is indexed from.
+const char *
+VolumeIndex::Root() const
+{
+	return fRoot.c_str();
+}
+
+// CountIndices
+//! Returns the number of indices of the volume.
+int32
+VolumeIndex::CountIndices() const
+{
+	return fIndices.CountItems();
+}
+
+// IndexAt
+//! Returns the index at the given position.
+AttributeIndex *
+VolumeIndex::IndexAt(int32 index) const
+{
+	return (AttributeIndex*)fIndices.ItemAt(index);
+}
+
+// FindIndex
+/*!	\brief Returns the index of an attribute.
+	\param name The name of the attribute
+	\return The index, \c NULL if the attribute isn't indexed.
+*/
+AttributeIndex *
+VolumeIndex::FindIndex(const char *name) const
+{
+	for (int32 i = 0; AttributeIndex *index = IndexAt(i); i++) {
+		if (strcmp(index->Name(), name) == 0)
+			return index;
+	}
+	return NULL;
+}
+
+// NameIndex
+//! Returns the name index, which contains all entries of the volume.
+AttributeIndex *
+VolumeIndex::NameIndex() const
+{
+	return fNameIndex;
+}
+
+// CreateIndex
+/*!	\brief Creates an index for an attribute and adds the entries that have
+		   it to it.
+	\param name The name of the attribute
+	\param type The type of the attribute
+	\return
+	- \c B_OK: Everything went fine.
+	- \c B_FILE_EXISTS: The attribute is already indexed.
+	- \c B_BAD_VALUE: Attributes of the given type can't be indexed.
+*/
+status_t
+VolumeIndex::CreateIndex(const char *name, uint32 type)
+{
+	if (!name || !*name || strlen(name) > kMaxIndexKeyLength
+		|| index_value_kind(type) == INDEX_INVALID_VALUE)
+		return B_BAD_VALUE;
+	if (FindIndex(name))
+		return B_FILE_EXISTS;
+
+	AttributeIndex *index = new AttributeIndex(name, type);
+	fIndices.AddItem(index);
+	_SaveIndices();
+
+	// read the new attribute of every entry
+	for (entry_map::iterator it = fEntries.begin(); it != fEntries.end(); ++it) {
+		index_entry *entry = it->second;
+		std::string path;
+		if (_GetPath(entry->directory, path)) {
+			path += "/";
+			path += entry->name;
+			_ReadAttributes(entry, path.c_str());
+			index->Insert(entry);
+		}
+	}
+	return _Compact();
+}
+
+// RemoveIndex
+/*!	\brief Removes the index of an attribute.
+	\param name The name of the attribute
+	\return
+	- \c B_OK: Everything went fine.
+	- \c B_ENTRY_NOT_FOUND: The attribute isn't indexed.
+	- \c B_NOT_ALLOWED: The index is built into the volume.
+*/
+status_t
+VolumeIndex::RemoveIndex(const char *name)
+{
+	AttributeIndex *index = name ? FindIndex(name) : NULL;
+	if (!index)
+		return B_ENTRY_NOT_FOUND;
+	if (index->IsBuiltIn())
+		return B_NOT_ALLOWED;
+
+	fIndices.RemoveItem(index);
+	delete index;
+	for (entry_map::iterator it = fEntries.begin(); it != fEntries.end(); ++it)
+		it->second->attributes.erase(name);
+	_SaveIndices();
+	return _Compact();
+}
+
+// entry_key
+bool
+VolumeIndex::entry_key::operator<(const entry_key &other) const
+{
+	if (directory != other.directory)
+		return directory < other.directory;
+	return name < other.name;
+}
+
+// _GetPath
+/*!	\brief Returns the path of an indexed directory.
+	\return \c true, if the directory is known, \c false otherwise.
+*/
+bool
+VolumeIndex::_GetPath(ino_t directory, std::string &path) const
+{
+	std::string relative;
+	while (directory != fRootNode) {
+		directory_map::const_iterator it = fDirectories.find(directory);
+		if (it == fDirectories.end())
+			return false;
+		relative.insert(0, it->second.name);
+		relative.insert(0, "/");
+		directory = it->second.parent;
+	}
+	path = fRoot == "/" ? std::string() : fRoot;
+	path += relative;
+	return true;
+}
+
+// _ReadAttributes
+/*!	\brief Reads the values of the indexed attributes of an entry.
+	\param entry The entry
+	\param path The path of the entry
+*/
+void
+VolumeIndex::_ReadAttributes(index_entry *entry, const char *path)
+{
+	int fd = -1;
+	for (int32 i = 0; AttributeIndex *index = IndexAt(i); i++) {
+		if (index->IsBuiltIn())
+			continue;
+		if (fd < 0) {
+			fd = open(path, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_NOCTTY);
+			if (fd < 0)
+				return;
+		}
+		char buffer[kMaxIndexKeyLength + 1];
+		ssize_t size = fs_read_attr(fd, index->Name(), index->Type(), 0,
+			buffer, kMaxIndexKeyLength);
+		index_value value;
+		if (size >= 0 && convert_attribute(index->Type(), buffer, size, value))
+			entry->attributes[index->Name()] = value;
+		else
+			entry->attributes.erase(index->Name());
+	}
+	if (fd >= 0)
+		close(fd);
+}
+
+// _SyncDirectory
+/*!	\brief Starts watching a directory and brings its entries and those of
+		   its subdirectories up to date.
+
+	The directory is only read, if it has been modified since it was read
+	the last time, or \a forceList is \c true.
+*/
+void
+VolumeIndex::_SyncDirectory(ino_t node, ino_t parent, const std::string &name,
+	const std::string &path, bool forceList)
+{
+	struct stat st;
+	if (lstat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)
+		|| st.st_dev != fDevice || st.st_ino != node || node == fStorageNode)
+		return;
+
+	directory_map::iterator dirIt = fDirectories.find(node);
+	if (dirIt == fDirectories.end()) {
+		directory_info info;
+		info.descriptor = -1;
+		info.parent = parent;
+		info.name = name;
+		dirIt = fDirectories.insert(std::make_pair(node, info)).first;
+	}
+	if (dirIt->second.descriptor < 0) {
+		int descriptor = inotify_add_watch(fFD, path.c_str(), kWatchMask);
+		if (descriptor >= 0) {
+			dirIt->second.descriptor = descriptor;
+			fWatches[descriptor] = node;
+		} else {
+			// usually ENOSPC, when fs.inotify.max_user_watches is used up;
+			// the directory is then only kept up to date by _Rescan()
+			if (!fUnwatched) {
+				fprintf(stderr, "VolumeIndex: can't watch %s: %s, rescanning "
+					"%s periodically\n", path.c_str(), strerror(errno),
+					fRoot.c_str());
+				fNextRescan = system_time() + kRescanInterval;
+			}
+			fUnwatched = true;
+		}
+	}
+
+	index_entry *self = NULL;
+	if (node != fRootNode) {
+		entry_map::iterator it = fEntries.find(entry_key(parent, name));
+		if (it == fEntries.end())
+			return;
+		self = it->second;
+	}
+	bigtime_t modified = nanoseconds(st.st_mtim);
+	bigtime_t listed = self ? self->listed : fRootListed;
+
+	entry_map::iterator first = fEntries.lower_bound(entry_key(node, ""));
+	entry_map::iterator last = fEntries.lower_bound(entry_key(node + 1, ""));
+	std::vector<std::string> known;
+	for (entry_map::iterator it = first; it != last; ++it)
+		known.push_back(it->first.name);
+
+	if (forceList || listed != modified) {
+		DIR *dir = opendir(path.c_str());
+		if (dir) {
+			std::set<std::string> present;
+			while (dirent *entry = readdir(dir)) {
+				if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+					continue;
+				present.insert(entry->d_name);
+				_RefreshEntry(node, entry->d_name, path + "/" + entry->d_name);
+			}
+			closedir(dir);
+
+			for (size_t i = 0; i < known.size(); i++) {
+				if (present.find(known[i]) == present.end())
+					_RemoveEntry(node, known[i]);
+			}
+
+			if (self) {
+				self->listed = modified;
+				_JournalAdd(self);
+			} else
+				fRootListed = modified;
+		}
+	} else {
+		for (size_t i = 0; i < known.size(); i++)
+			_RefreshEntry(node, known[i], path + "/" + known[i]);
+	}
+
+	// descend into the subdirectories
+	std::vector<std::pair<ino_t, std::string> > subdirectories;
+	first = fEntries.lower_bound(entry_key(node, ""));
+	last = fEntries.lower_bound(entry_key(node + 1, ""));
+	for (entry_map::iterator it = first; it != last; ++it) {
+		if (it->second->is_directory) {
+			subdirectories.push_back(std::make_pair(it->second->node,
+				it->first.name));
+		}
+	}
+	for (size_t i = 0; i < subdirectories.size(); i++) {
+		_SyncDirectory(subdirectories[i].first, node, subdirectories[i].second,
+			path + "/" + subdirectories[i].second, forceList);
+	}
+}
+
+// _RefreshEntry
+/*!	\brief Brings the index entry of an entry up to date.
+
+	If the node hasn't changed since it was indexed, nothing is done;
+	otherwise the index entry is replaced, or removed, if the entry is gone.
+
+	\return The index entry, \c NULL if the entry doesn't exist.
+*/
+index_entry *
+VolumeIndex::_RefreshEntry(ino_t directory, const std::string &name,
+	const std::string &path, bool readAttributes)
+{
+	struct stat st;
+	if (lstat(path.c_str(), &st) != 0) {
+		_RemoveEntry(directory, name);
+		return NULL;
+	}
+
+	entry_map::iterator it = fEntries.find(entry_key(directory, name));
+	index_entry *old = it != fEntries.end() ? it->second : NULL;
+	bigtime_t changed = nanoseconds(st.st_ctim);
+	if (old && old->node == st.st_ino && old->changed == changed
+		&& old->size == st.st_size && old->modified == st.st_mtime)
+		return old;
+
+	index_entry *entry = new index_entry;
+	entry->node = st.st_ino;
+	entry->directory = directory;
+	entry->name = name;
+	entry->size = st.st_size;
+	entry->modified = st.st_mtime;
+	entry->changed = changed;
+	entry->is_directory = S_ISDIR(st.st_mode);
+	entry->listed = 0;
+	if (old && old->node == entry->node) {
+		entry->listed = old->listed;
+		entry->attributes = old->attributes;
+	}
+	if (readAttributes && (S_ISREG(st.st_mode) || S_ISDIR(st.st_mode)))
+		_ReadAttributes(entry, path.c_str());
+
+	if (old) {
+		if (old->is_directory && old->node != entry->node)
+			_RemoveDirectory(old->node);
+		_UnlinkEntry(old, true);
+	}
+	_InsertEntry(entry);
+	return entry;
+}
+
+// _RemoveEntry
+/*!	\brief Removes an entry, and everything below it, if it's a directory.
+*/
+void
+VolumeIndex::_RemoveEntry(ino_t directory, const std::string &name)
+{
+	entry_map::iterator it = fEntries.find(entry_key(directory, name));
+	if (it == fEntries.end())
+		return;
+	index_entry *entry = it->second;
+	if (entry->is_directory)
+		_RemoveDirectory(entry->node);
+	_UnlinkEntry(entry, true);
+	_JournalRemove(directory, name);
+}
+
+// _RemoveDirectory
+/*!	\brief Removes the entries of a directory and stops watching it.
+*/
+void
+VolumeIndex::_RemoveDirectory(ino_t node)
+{
+	entry_map::iterator first = fEntries.lower_bound(entry_key(node, ""));
+	entry_map::iterator last = fEntries.lower_bound(entry_key(node + 1, ""));
+	std::vector<std::string> names;
+	for (entry_map::iterator it = first; it != last; ++it)
+		names.push_back(it->first.name);
+	for (size_t i = 0; i < names.size(); i++)
+		_RemoveEntry(node, names[i]);
+
+	directory_map::iterator it = fDirectories.find(node);
+	if (it != fDirectories.end()) {
+		if (it->second.descriptor >= 0) {
+			inotify_rm_watch(fFD, it->second.descriptor);
+			fWatches.erase(it->second.descriptor);
+		}
+		fDirectories.erase(it);
+	}
+}
+
+// _InsertEntry
+/*!	\brief Adds a new entry to the volume and its indices.
+*/
+void
+VolumeIndex::_InsertEntry(index_entry *entry)
+{
+	fEntries[entry_key(entry->directory, entry->name)] = entry;
+	for (int32 i = 0; AttributeIndex *index = IndexAt(i); i++)
+		index->Insert(entry);
+	_JournalAdd(entry);
+	if (!fLoading)
+		fListener->EntryAdded(this, entry);
+}
+
+// _UnlinkEntry
+/*!	\brief Removes an entry from the volume and its indices and deletes it.
+	\param entry The entry
+	\param notify Whether to tell the listener about it
+*/
+void
+VolumeIndex::_UnlinkEntry(index_entry *entry, bool notify)
+{
+	if (notify && !fLoading)
+		fListener->EntryRemoved(this, entry);
+	for (int32 i = 0; AttributeIndex *index = IndexAt(i); i++)
+		index->Remove(entry);
+	fEntries.erase(entry_key(entry->directory, entry->name));
+	delete entry;
+}
+
+// _WatcherThread
+int32
+VolumeIndex::_WatcherThread(void *data)
+{
+	((VolumeIndex*)data)->_ReadEvents();
+	return 0;
+}
+
+// _ReadEvents
+/*!	\brief Reads the inotify events of the volume and feeds them into the
+		   index, until the index is deleted.
+*/
+void
+VolumeIndex::_ReadEvents()
+{
+	char *buffer = new char[kEventBufferSize];
+	while (!fQuitting) {
+		if (fUnwatched && system_time() >= fNextRescan) {
+			if (!_LockOwner())
+				break;
+			_Rescan();
+			fOwner->Unlock();
+		}
+
+		struct pollfd pollFD;
+		pollFD.fd = fFD;
+		pollFD.events = POLLIN;
+		if (poll(&pollFD, 1, 500) <= 0)
+			continue;
+
+		// let a burst of events arrive, so it's handled in one go
+		poll(NULL, 0, kCoalesceTimeout);
+
+		ssize_t bytes = read(fFD, buffer, kEventBufferSize);
+		if (bytes <= 0)
+			continue;
+
+		if (!_LockOwner())
+			break;
+
+		for (ssize_t offset = 0; offset < bytes; ) {
+			const inotify_event *event
+				= (const inotify_event*)(buffer + offset);
+			_HandleEvent(event);
+			offset += sizeof(inotify_event) + event->len;
+		}
+		_FlushJournal();
+		fListener->EntriesChanged(this);
+		fOwner->Unlock();
+	}
+	delete[] buffer;
+}
+
+// _LockOwner
+/*!	\brief Locks the owner for the watcher thread.
+
+	The owner is locked while the index is deleted, so this doesn't wait
+	for it forever.
+
+	\return \c true, if the owner is locked, \c false, if the index is
+			about to be deleted.
+*/
+bool
+VolumeIndex::_LockOwner()
+{
+	bool locked = false;
+	while (!fQuitting && !locked)
+		locked = fOwner->LockWithTimeout(100000) == B_OK;
+	if (fQuitting) {
+		if (locked)
+			fOwner->Unlock();
+		return false;
+	}
+	return true;
+}
+
+// _Rescan
+/*!	\brief Brings the index up to date by checking the whole volume, and
+		   tries again to watch the directories that couldn't be watched.
+
+	Only needed while some directories aren't watched. The owner must be
+	locked.
+*/
+void
+VolumeIndex::_Rescan()
+{
+	_SyncDirectory(fRootNode, -1, std::string(), fRoot, false);
+	_FlushJournal();
+	fListener->EntriesChanged(this);
+
+	fUnwatched = false;
+	for (directory_map::iterator it = fDirectories.begin();
+			it != fDirectories.end(); ++it) {
+		if (it->second.descriptor < 0) {
+			fUnwatched = true;
+			break;
+		}
+	}
+	if (!fUnwatched) {
+		fprintf(stderr, "VolumeIndex: watching all of %s again\n",
+			fRoot.c_str());
+	}
+	fNextRescan = system_time() + kRescanInterval;
+}
+
+// _HandleEvent
+/*!	\brief Brings the entry an inotify event is about up to date.
+*/
+void
+VolumeIndex::_HandleEvent(const inotify_event *event)
+{
+	if (event->mask & IN_Q_OVERFLOW) {
+		// events have been lost, everything has to be checked
+		_SyncDirectory(fRootNode, -1, std::string(), fRoot, true);
+		return;
+	}
+
+	std::map<int, ino_t>::iterator it = fWatches.find(event->wd);
+	if (it == fWatches.end())
+		return;
+	ino_t directory = it->second;
+
+	if (event->mask & IN_IGNORED) {
+		// the directory is gone; its entry goes with the event in its parent
+		fWatches.erase(it);
+		directory_map::iterator dirIt = fDirectories.find(directory);
+		if (dirIt != fDirectories.end())
+			dirIt->second.descriptor = -1;
+		return;
+	}
+	if (event->len == 0 || event->name[0] == '\0')
+		return;
+
+	std::string name(event->name);
+	if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+		_RemoveEntry(directory, name);
+		return;
+	}
+
+	std::string path;
+	if (!_GetPath(directory, path))
+		return;
+	path += "/";
+	path += name;
+	index_entry *entry = _RefreshEntry(directory, name, path);
+	if (entry && entry->is_directory
+		&& fDirectories.find(entry->node) == fDirectories.end())
+		_SyncDirectory(entry->node, directory, name, path, false);
+}
+
+// _JournalAdd
+//! Records an added or changed entry in the journal.
+void
+VolumeIndex::_JournalAdd(const index_entry *entry)
+{
+	if (fLoading)
+		return;
+	fJournal += (char)JOURNAL_ADD;
+	write_entry(fJournal, entry);
+	fJournalRecords++;
+}
+
+// _JournalRemove
+//! Records a removed entry in the journal.
+void
+VolumeIndex::_JournalRemove(ino_t directory, const std::string &name)
+{
+	if (fLoading)
+		return;
+	fJournal += (char)JOURNAL_REMOVE;
+	write_int64(fJournal, directory);
+	write_string(fJournal, name);
+	fJournalRecords++;
+}
+
+// _FlushJournal
+/*!	\brief Appends the recorded changes to the journal file, and merges the
+		   journal into the base file, if it has grown large enough.
+*/
+void
+VolumeIndex::_FlushJournal()
+{
+	if (fJournal.empty())
+		return;
+	if (write_file(fStorage + "/journal", fJournal, O_APPEND) != B_OK)
+		return;
+	fJournal.clear();
+	if (fJournalRecords > kMinCompactRecords
+		&& fJournalRecords > (int32)fEntries.size() / 4)
+		_Compact();
+}
+
+// _Load
+/*!	\brief Reads the base file and replays the journal.
+	\return \c B_OK, if a base file for the root has been read, an error
+			code otherwise.
+*/
+status_t
+VolumeIndex::_Load()
+{
+	std::string data;
+	status_t error = read_file(fStorage + "/entries", data);
+	if (error != B_OK)
+		return error;
+
+	record_reader reader(data);
+	if (reader.UInt32() != kIndexMagic || reader.UInt32() != kIndexVersion
+		|| reader.String() != fRoot)
+		return B_BAD_DATA;
+	fRootNode = reader.Int64();
+	fRootListed = reader.Int64();
+	int64 count = reader.Int64();
+	for (int64 i = 0; i < count; i++) {
+		index_entry *entry = reader.Entry();
+		if (!entry)
+			return B_BAD_DATA;
+		_InsertEntry(entry);
+	}
+
+	std::string journal;
+	if (read_file(fStorage + "/journal", journal) != B_OK)
+		return B_OK;
+	record_reader journalReader(journal);
+	while (!journalReader.AtEnd()) {
+		uint8 op = journalReader.UInt8();
+		if (op == JOURNAL_ADD) {
+			index_entry *entry = journalReader.Entry();
+			if (!entry)
+				break;
+			entry_map::iterator it
+				= fEntries.find(entry_key(entry->directory, entry->name));
+			if (it != fEntries.end())
+				_UnlinkEntry(it->second, false);
+			_InsertEntry(entry);
+		} else if (op == JOURNAL_REMOVE) {
+			ino_t directory = journalReader.Int64();
+			std::string name = journalReader.String();
+			entry_map::iterator it = fEntries.find(entry_key(directory, name));
+			if (!journalReader.failed && it != fEntries.end())
+				_UnlinkEntry(it->second, false);
+		} else
+			break;
+	}
+	return B_OK;
+}
+
+// _Compact
+/*!	\brief Writes a new base file and empties the journal.
+*/
+status_t
+VolumeIndex::_Compact()
+{
+	std::string data;
+	write_uint32(data, kIndexMagic);
+	write_uint32(data, kIndexVersion);
+	write_string(data, fRoot);
+	write_int64(data, fRootNode);
+	write_int64(data, fRootListed);
+	write_int64(data, fEntries.size());
+	for (entry_map::iterator it = fEntries.begin(); it != fEntries.end(); ++it)
+		write_entry(data, it->second);
+
+	std::string path = fStorage + "/entries";
+	status_t error = write_file(path + ".new", data, O_TRUNC);
+	if (error == B_OK && rename((path + ".new").c_str(), path.c_str()) != 0)
+		error = errno;
+	if (error != B_OK)
+		return error;
+
+	fJournal.clear();
+	fJournalRecords = 0;
+	return write_file(fStorage + "/journal", std::string(), O_TRUNC);
+}
+
+// _LoadIndices
+/*!	\brief Reads the indices declared on the volume.
+
+	They are stored one per line, the type in hex followed by the name.
+*/
+status_t
+VolumeIndex::_LoadIndices()
+{
+	FILE *file = fopen((fStorage + "/indices").c_str(), "r");
+	if (!file)
+		return errno;
+	char line[B_ATTR_NAME_LENGTH + 16];
+	while (fgets(line, sizeof(line), file)) {
+		uint32 type;
+		char name[B_ATTR_NAME_LENGTH];
+		if (sscanf(line, "%lx %[^\n]", &type, name) == 2 && !FindIndex(name))
+			fIndices.AddItem(new AttributeIndex(name, type));
+	}
+	fclose(file);
+	return B_OK;
+}
+
+// _SaveIndices
+//! Writes the indices declared on the volume.
+status_t
+VolumeIndex::_SaveIndices()
+{
+	FILE *file = fopen((fStorage + "/indices").c_str(), "w");
+	if (!file)
+		return errno;
+	for (int32 i = 0; AttributeIndex *index = IndexAt(i); i++) {
+		if (!index->IsBuiltIn())
+			fprintf(file, "%08lx %s\n", index->Type(), index->Name());
+	}
+	fclose(file);
+	return B_OK;
+}
@@ -0,0 +1,216 @@
+//------------------------------------------------------------------------------
+//	Copyright (c) 2001-2002, OpenBeOS
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a
+//	copy of this software and associated documentation files (the "Software"),
+//	to deal in the Software without restriction, including without limitation
+//	the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//	and/or sell copies of the Software, and to permit persons to whom the
+//	Software is furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in
+//	all copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//	FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//	DEALINGS IN THE SOFTWARE.
+//
+//	File Name:		VolumeIndex.h
+//	Description:	The entries of an indexed volume and the attribute indices
+//					on them.
+//------------------------------------------------------------------------------
+
+#ifndef VOLUME_INDEX_H
+#define VOLUME_INDEX_H
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <List.h>
+#include <OS.h>
+#include <SupportDefs.h>
+
+class BLooper;
+class VolumeIndex;
+struct inotify_event;
+
+//! The kinds of values indices are ordered by
+enum {
+	INDEX_STRING_VALUE,
+	INDEX_INT_VALUE,
+	INDEX_UINT_VALUE,
+	INDEX_FLOAT_VALUE,
+	INDEX_INVALID_VALUE
+};
+
+struct index_value {
+	uint32		kind;			// one of the INDEX_*_VALUE constants
+	int64		int_value;
+	uint64		uint_value;
+	double		float_value;
+	std::string	string_value;
+};
+
+struct index_entry {
+	ino_t		node;
+	ino_t		directory;
+	std::string	name;
+	off_t		size;
+	time_t		modified;
+	bigtime_t	changed;		// ctime in nanoseconds, to skip unchanged nodes
+	bigtime_t	listed;			// mtime in nanoseconds the directory was read at
+	bool		is_directory;
+	std::map<std::string, index_value> attributes;
+};
+
+uint32 index_value_kind(uint32 type);
+int compare_index_values(const index_value &a, const index_value &b);
+
+class AttributeIndex {
+public:
+	AttributeIndex(const char *name, uint32 type);
+
+	const char *Name() const;
+	uint32 Type() const;
+	uint32 Kind() const;
+	bool IsBuiltIn() const;
+
+	bool GetValue(const index_entry *entry, index_value &value) const;
+
+private:
+	struct value_less {
+		value_less(const AttributeIndex *index) : index(index) {}
+		bool operator()(const index_entry *a, const index_entry *b) const;
+
+		const AttributeIndex *index;
+	};
+
+public:
+	typedef std::multiset<index_entry*, value_less> entry_set;
+	typedef entry_set::const_iterator iterator;
+
+	void Insert(index_entry *entry);
+	void Remove(index_entry *entry);
+
+	iterator Begin() const;
+	iterator End() const;
+	iterator LowerBound(const index_value &value) const;
+	iterator UpperBound(const index_value &value) const;
+
+private:
+	void _SetProbe(const index_value &value) const;
+
+	std::string			fName;
+	uint32				fType;
+	uint32				fKind;
+	int32				fField;
+	entry_set			fEntries;
+	mutable index_entry	fProbe;
+};
+
+class IndexListener {
+public:
+	virtual ~IndexListener();
+
+	virtual void EntryAdded(VolumeIndex *volume, const index_entry *entry) = 0;
+	virtual void EntryRemoved(VolumeIndex *volume,
+		const index_entry *entry) = 0;
+	virtual void EntriesChanged(VolumeIndex *volume) = 0;
+};
+
+class VolumeIndex {
+public:
+	VolumeIndex(dev_t device, const char *root, const char *storage,
+		BLooper *owner, IndexListener *listener);
+	~VolumeIndex();
+
+	status_t Init();
+
+	dev_t Device() const;
+	const char *Root() const;
+
+	int32 CountIndices() const;
+	AttributeIndex *IndexAt(int32 index) const;
+	AttributeIndex *FindIndex(const char *name) const;
+	AttributeIndex *NameIndex() const;
+
+	status_t CreateIndex(const char *name, uint32 type);
+	status_t RemoveIndex(const char *name);
+
+private:
+	struct entry_key {
+		entry_key(ino_t directory, const std::string &name)
+			: directory(directory), name(name) {}
+		bool operator<(const entry_key &other) const;
+
+		ino_t		directory;
+		std::string	name;
+	};
+
+	struct directory_info {
+		int			descriptor;		// inotify watch descriptor
+		ino_t		parent;
+		std::string	name;
+	};
+
+	typedef std::map<entry_key, index_entry*> entry_map;
+	typedef std::map<ino_t, directory_info> directory_map;
+
+	bool _GetPath(ino_t directory, std::string &path) const;
+	void _ReadAttributes(index_entry *entry, const char *path);
+
+	void _SyncDirectory(ino_t node, ino_t parent, const std::string &name,
+		const std::string &path, bool forceList);
+	index_entry *_RefreshEntry(ino_t directory, const std::string &name,
+		const std::string &path, bool readAttributes = true);
+	void _RemoveEntry(ino_t directory, const std::string &name);
+	void _RemoveDirectory(ino_t node);
+	void _InsertEntry(index_entry *entry);
+	void _UnlinkEntry(index_entry *entry, bool notify);
+
+	static int32 _WatcherThread(void *data);
+	void _ReadEvents();
+	bool _LockOwner();
+	void _Rescan();
+	void _HandleEvent(const inotify_event *event);
+
+	void _JournalAdd(const index_entry *entry);
+	void _JournalRemove(ino_t directory, const std::string &name);
+	void _FlushJournal();
+	status_t _Load();
+	status_t _Compact();
+	status_t _LoadIndices();
+	status_t _SaveIndices();
+
+	dev_t			fDevice;
+	std::string		fRoot;
+	ino_t			fRootNode;
+	bigtime_t		fRootListed;
+	std::string		fStorage;
+	ino_t			fStorageNode;
+	BLooper			*fOwner;
+	IndexListener	*fListener;
+
+	BList			fIndices;
+	AttributeIndex	*fNameIndex;
+	entry_map		fEntries;
+	directory_map	fDirectories;
+	std::map<int, ino_t> fWatches;
+
+	int				fFD;
+	thread_id		fThread;
+	volatile bool	fQuitting;
+	bool			fLoading;
+	bool			fUnwatched;		// some directories couldn't be watched
+	bigtime_t		fNextRescan;
+
+	std::string		fJournal;
+	int32			fJournalRecords;
+};
+
+#endif	// VOLUME_INDEX_H